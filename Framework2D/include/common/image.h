@@ -1,11 +1,78 @@
 #pragma once
 
-#include <memory>     // For std::unique_ptr
+#include <algorithm>
+#include <cstddef>
+#include <memory>     // For std::shared_ptr
+#include <span>       // For row / pixel views
 #include <stdexcept>  // For exceptions
 #include <vector>
 
 namespace USTC_CG
 {
+// Typed views of one interleaved pixel, used with Image::row_as<>() and
+// Image::at<>(). Their size must equal the channel count of the image.
+struct Gray8
+{
+    unsigned char v;
+};
+struct RGB8
+{
+    unsigned char r, g, b;
+};
+struct RGBA8
+{
+    unsigned char r, g, b, a;
+};
+static_assert(sizeof(Gray8) == 1 && sizeof(RGB8) == 3 && sizeof(RGBA8) == 4);
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1)
+struct PixelRect
+{
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    bool empty() const
+    {
+        return x1 <= x0 || y1 <= y0;
+    }
+    int width() const
+    {
+        return x1 - x0;
+    }
+    int height() const
+    {
+        return y1 - y0;
+    }
+    // Smallest rectangle containing both (an empty side is ignored)
+    PixelRect united(const PixelRect& other) const
+    {
+        if (empty())
+            return other;
+        if (other.empty())
+            return *this;
+        return { std::min(x0, other.x0),
+                 std::min(y0, other.y0),
+                 std::max(x1, other.x1),
+                 std::max(y1, other.y1) };
+    }
+    PixelRect intersected(const PixelRect& other) const
+    {
+        return { std::max(x0, other.x0),
+                 std::max(y0, other.y0),
+                 std::min(x1, other.x1),
+                 std::min(y1, other.y1) };
+    }
+};
+
+// 8-bit interleaved image.
+//
+// The pixel buffer is reference counted and copy-on-write: copying an Image
+// (or assigning one) only shares the buffer, and the first write access
+// through a non-const accessor gives the writer its own copy. Backups and
+// restores are therefore O(1) until one side is actually modified.
+//
+// Read-only code should go through a const Image& so that it never triggers
+// a copy. Pointers obtained from non-const accessors stay valid until the
+// Image is copied or reassigned.
 class Image
 {
    public:
@@ -16,8 +83,8 @@ class Image
         : width_(width),
           height_(height),
           channels_(channels),
-          image_data_(
-              std::make_unique<unsigned char[]>(width * height * channels))
+          image_data_(std::make_shared<unsigned char[]>(
+              static_cast<std::size_t>(width) * height * channels))
     {
     }
 
@@ -34,6 +101,20 @@ class Image
     {
     }
 
+    // Same with data that has its own deleter, such as a buffer allocated
+    // with malloc() by a C library
+    Image(
+        int width,
+        int height,
+        int channels,
+        std::shared_ptr<unsigned char[]> image_data)
+        : width_(width),
+          height_(height),
+          channels_(channels),
+          image_data_(std::move(image_data))
+    {
+    }
+
     // Method to initialize or reinitialize from external data
     void initialize(
         int width,
@@ -47,36 +128,9 @@ class Image
         image_data_ = std::move(image_data);
     }
 
-    Image(const Image& other)
-        : width_(other.width_),
-          height_(other.height_),
-          channels_(other.channels_),
-          image_data_(std::make_unique<unsigned char[]>(
-              other.width_ * other.height_ * other.channels_))
-    {
-        std::copy(
-            other.image_data_.get(),
-            other.image_data_.get() + width_ * height_ * channels_,
-            image_data_.get());
-    }
-
-    Image& operator=(const Image& other)
-    {
-        if (this != &other)
-        {
-            width_ = other.width_;
-            height_ = other.height_;
-            channels_ = other.channels_;
-            image_data_ =
-                std::make_unique<unsigned char[]>(width_ * height_ * channels_);
-            std::copy(
-                other.image_data_.get(),
-                other.image_data_.get() + width_ * height_ * channels_,
-                image_data_.get());
-        }
-        return *this;
-    }
-
+    // Copies share the pixel buffer until one of them is written to.
+    Image(const Image& other) = default;
+    Image& operator=(const Image& other) = default;
     Image(Image&&) noexcept = default;
     Image& operator=(Image&&) noexcept = default;
 
@@ -96,11 +150,127 @@ class Image
         return channels_;
     }
 
-    unsigned char* data() const
+    const unsigned char* data() const
+    {
+        return image_data_.get();
+    }
+    unsigned char* data()
     {
+        detach();
         return image_data_.get();
     }
 
+    // True if both images currently share one pixel buffer.
+    bool shares_data_with(const Image& other) const
+    {
+        return image_data_ == other.image_data_;
+    }
+    // True if another image shares the pixel buffer, so that the next write
+    // access copies it.
+    bool is_shared() const
+    {
+        return image_data_.use_count() > 1;
+    }
+
+    // Copies the pixels of `rect` from an image of the same size. Copying
+    // the full image only shares the buffer.
+    void copy_region_from(const Image& other, PixelRect rect)
+    {
+        if (other.width_ != width_ || other.height_ != height_ ||
+            other.channels_ != channels_)
+        {
+            throw std::invalid_argument("Image size does not match");
+        }
+        rect = rect.intersected({ 0, 0, width_, height_ });
+        if (rect.empty() || shares_data_with(other))
+            return;
+        if (rect.width() == width_ && rect.height() == height_)
+        {
+            image_data_ = other.image_data_;
+            return;
+        }
+        const std::size_t offset =
+            static_cast<std::size_t>(rect.x0) * channels_;
+        const std::size_t bytes =
+            static_cast<std::size_t>(rect.width()) * channels_;
+        for (int y = rect.y0; y < rect.y1; ++y)
+            std::copy_n(other.row(y) + offset, bytes, row(y) + offset);
+    }
+
+    // Number of bytes between the starts of two consecutive rows.
+    std::size_t stride() const
+    {
+        return static_cast<std::size_t>(width_) *
+               static_cast<std::size_t>(channels_);
+    }
+
+    // Zero-copy row access. No bounds checking: the caller guarantees
+    // 0 <= y < height().
+    unsigned char* row(int y)
+    {
+        detach();
+        return image_data_.get() + static_cast<std::size_t>(y) * stride();
+    }
+    const unsigned char* row(int y) const
+    {
+        return image_data_.get() + static_cast<std::size_t>(y) * stride();
+    }
+    std::span<unsigned char> row_span(int y)
+    {
+        return { row(y), stride() };
+    }
+    std::span<const unsigned char> row_span(int y) const
+    {
+        return { row(y), stride() };
+    }
+
+    // Row viewed as typed pixels (RGBA8, RGB8, Gray8...). The pixel layout is
+    // checked once per row instead of once per pixel.
+    template<typename Pixel>
+    std::span<Pixel> row_as(int y)
+    {
+        check_layout<Pixel>();
+        return { reinterpret_cast<Pixel*>(row(y)),
+                 static_cast<std::size_t>(width_) };
+    }
+    template<typename Pixel>
+    std::span<const Pixel> row_as(int y) const
+    {
+        check_layout<Pixel>();
+        return { reinterpret_cast<const Pixel*>(row(y)),
+                 static_cast<std::size_t>(width_) };
+    }
+
+    // Unchecked typed pixel reference, for inner loops whose bounds are
+    // already known to be valid.
+    template<typename Pixel>
+    Pixel& at(int x, int y)
+    {
+        return reinterpret_cast<Pixel*>(row(y))[x];
+    }
+    template<typename Pixel>
+    const Pixel& at(int x, int y) const
+    {
+        return reinterpret_cast<const Pixel*>(row(y))[x];
+    }
+
+    // Bounds-checked, allocation-free view of the channels of one pixel.
+    // Throws std::out_of_range like get_pixel().
+    std::span<unsigned char> pixel(int x, int y)
+    {
+        check_bounds(x, y);
+        return { row(y) + static_cast<std::size_t>(x) * channels_,
+                 static_cast<std::size_t>(channels_) };
+    }
+    std::span<const unsigned char> pixel(int x, int y) const
+    {
+        check_bounds(x, y);
+        return { row(y) + static_cast<std::size_t>(x) * channels_,
+                 static_cast<std::size_t>(channels_) };
+    }
+
+    // Copying accessors, kept for convenience. Prefer pixel() / row_as<>()
+    // in per-pixel loops since these allocate a vector on every call.
     std::vector<unsigned char> get_pixel(int x, int y) const
     {
         if (x < 0 || x >= width_ || y < 0 || y >= height_)
@@ -134,6 +304,7 @@ class Image
             throw std::invalid_argument(
                 "Number of values does not match the number of channels");
         }
+        detach();
         std::size_t index =
             static_cast<std::size_t>(y) * static_cast<std::size_t>(width_) +
             static_cast<std::size_t>(x);
@@ -145,7 +316,37 @@ class Image
     }
 
    private:
+    // Gives this image its own copy of a shared pixel buffer.
+    void detach()
+    {
+        if (image_data_ && image_data_.use_count() > 1)
+        {
+            const std::size_t size = stride() * height_;
+            std::shared_ptr<unsigned char[]> copy(new unsigned char[size]);
+            std::copy_n(image_data_.get(), size, copy.get());
+            image_data_ = std::move(copy);
+        }
+    }
+
+    void check_bounds(int x, int y) const
+    {
+        if (x < 0 || x >= width_ || y < 0 || y >= height_)
+        {
+            throw std::out_of_range("Pixel coordinates out of bounds");
+        }
+    }
+
+    template<typename Pixel>
+    void check_layout() const
+    {
+        if (sizeof(Pixel) != static_cast<std::size_t>(channels_))
+        {
+            throw std::invalid_argument(
+                "Pixel type does not match the number of channels");
+        }
+    }
+
     int width_ = 0, height_ = 0, channels_ = 0;
-    std::unique_ptr<unsigned char[]> image_data_;
+    std::shared_ptr<unsigned char[]> image_data_;
 };
 }  // namespace USTC_CG
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+
+#include "common/image.h"
+
+namespace USTC_CG
+{
+// Planar (structure-of-arrays) float image for numeric kernels.
+//
+// Every channel is stored in its own plane, and every row of a plane starts
+// on a 64-byte boundary: rows are padded to a multiple of kRowAlignment
+// floats. Kernels can thus stream one channel with aligned SIMD loads, and
+// only quantize back to 8 bits once at the end through to_image().
+class ImageF
+{
+   public:
+    static constexpr std::size_t kAlignment = 64;  // Bytes
+    static constexpr std::size_t kRowAlignment = kAlignment / sizeof(float);
+
+    ImageF() = default;
+
+    // Zero-initialized image with width, height, and channels
+    ImageF(int width, int height, int channels);
+
+    // Converts an 8-bit interleaved image, keeping its values in [0, 255]
+    explicit ImageF(const Image& image);
+
+    ImageF(const ImageF& other);
+    ImageF& operator=(const ImageF& other);
+    ImageF(ImageF&&) noexcept = default;
+    ImageF& operator=(ImageF&&) noexcept = default;
+    ~ImageF() = default;
+
+    int width() const
+    {
+        return width_;
+    }
+    int height() const
+    {
+        return height_;
+    }
+    int channels() const
+    {
+        return channels_;
+    }
+
+    // Number of floats between the starts of two consecutive rows of a plane
+    std::size_t stride() const
+    {
+        return stride_;
+    }
+
+    // Channel planes and rows. No bounds checking.
+    float* plane(int channel)
+    {
+        return data_.get() + static_cast<std::size_t>(channel) * plane_size();
+    }
+    const float* plane(int channel) const
+    {
+        return data_.get() + static_cast<std::size_t>(channel) * plane_size();
+    }
+    float* row(int channel, int y)
+    {
+        return plane(channel) + static_cast<std::size_t>(y) * stride_;
+    }
+    const float* row(int channel, int y) const
+    {
+        return plane(channel) + static_cast<std::size_t>(y) * stride_;
+    }
+    // Row without its padding
+    std::span<float> row_span(int channel, int y)
+    {
+        return { row(channel, y), static_cast<std::size_t>(width_) };
+    }
+    std::span<const float> row_span(int channel, int y) const
+    {
+        return { row(channel, y), static_cast<std::size_t>(width_) };
+    }
+
+    void fill(float value);
+
+    // Reloads from an 8-bit interleaved image, reallocating only when the
+    // size changes.
+    void from_image(const Image& image);
+
+    // Quantizes to an 8-bit interleaved image (clamped to [0, 255] and
+    // rounded). When `channels` exceeds channels(), the extra channels of the
+    // result are set to 255 (e.g. planar RGB -> opaque RGBA).
+    Image to_image(int channels = 0) const;
+    // Same, writing into an existing image of the same size.
+    void to_image(Image& image) const;
+
+   private:
+    struct AlignedDeleter
+    {
+        void operator()(float* p) const
+        {
+            ::operator delete[](p, std::align_val_t(kAlignment));
+        }
+    };
+
+    std::size_t plane_size() const
+    {
+        return stride_ * static_cast<std::size_t>(height_);
+    }
+    void allocate(int width, int height, int channels);
+
+    int width_ = 0, height_ = 0, channels_ = 0;
+    std::size_t stride_ = 0;
+    std::unique_ptr<float[], AlignedDeleter> data_;
+};
+}  // namespace USTC_CG
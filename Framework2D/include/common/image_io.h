@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common/image.h"
+
+namespace USTC_CG
+{
+class TiledImage;
+
+// Reads the size and channel count from the header of an image file without
+// decoding it. Returns false if the file cannot be read.
+bool read_image_info(
+    const std::string& filename,
+    int& width,
+    int& height,
+    int& channels);
+
+// Decodes an image file (PNG, JPEG, BMP, TGA, QOI, PAM, ...) into 8-bit
+// interleaved pixels with `channels` channels (those of the file if 0).
+// Throws std::runtime_error on failure.
+Image load_image(const std::string& filename, int channels = 0);
+
+// Decodes an image file into a tiled image of its size (see
+// read_image_info()), converting it to the channels of `image`. PAM files
+// are streamed row by row, so only the memory budget of `image` is
+// resident, as long as it holds a row of tiles; other formats are decoded
+// whole in memory first. Throws std::runtime_error on failure and
+// std::invalid_argument if the sizes differ.
+void load_image(const std::string& filename, TiledImage& image);
+
+// Formats save_image() can write.
+enum class ImageFormat
+{
+    kPng,  // Lossless, compressed on all threads
+    kQoi,  // Lossless, several times faster than PNG but larger
+    kPam,  // Uncompressed pixels: the fastest to write
+    kJpeg,
+    kBmp,
+    kTga,
+};
+
+// Format given by the extension of `filename`: .qoi, .pam, .jpg / .jpeg,
+// .bmp, .tga, and PNG otherwise.
+ImageFormat image_format_for(const std::string& filename);
+
+// Encodes an image in memory. QOI needs 3 or 4 channels. Throws
+// std::runtime_error on failure.
+std::vector<unsigned char> encode_image(const Image& image, ImageFormat format);
+
+// Encodes an image in the format given by the extension of `filename` (see
+// image_format_for()) and writes it. Throws std::runtime_error on failure.
+void save_image(const std::string& filename, const Image& image);
+
+// Writes a tiled image like save_image(), streaming the rows of PAM files
+// (see load_image()); other formats are encoded from a copy in memory.
+void save_image(const std::string& filename, const TiledImage& image);
+}  // namespace USTC_CG
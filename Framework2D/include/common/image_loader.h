@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/image.h"
+
+namespace USTC_CG
+{
+// Decodes image files on a pool of worker threads, so that opening a large
+// file never blocks the UI loop. Several loads run in parallel.
+class ImageLoader
+{
+   public:
+    struct Result
+    {
+        std::shared_ptr<Image> image;    // Full resolution RGBA
+        std::shared_ptr<Image> preview;  // Downsampled copy for quick display
+    };
+    using Callback = std::function<void(const Result&)>;
+
+    // Longest side of the preview, in pixels
+    static constexpr int kPreviewSize = 512;
+
+    // Starts `num_workers` threads (one less than the number of cores if 0).
+    explicit ImageLoader(int num_workers = 0);
+    ~ImageLoader();
+
+    ImageLoader(const ImageLoader&) = delete;
+    ImageLoader& operator=(const ImageLoader&) = delete;
+
+    // Shared pool used by ImageWidget.
+    static ImageLoader& instance();
+
+    // Queues the decoding of `filename`. The optional callback runs on the
+    // worker thread once the result is ready, after the future is set. On
+    // failure the future holds the exception (see load_image()) and the
+    // callback gets an empty result.
+    std::future<Result> load(
+        const std::string& filename,
+        Callback on_done = nullptr);
+
+   private:
+    void worker_loop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
+}  // namespace USTC_CG
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+
+#include "common/image.h"
+
+namespace USTC_CG
+{
+// Whole-image color operations on 8-bit interleaved images. Rows are
+// processed in parallel (see parallel.h), each with SIMD kernels picked at
+// run time for the CPU: SSE4.1 or AVX2 on x86, NEON on ARM64, plain C++
+// elsewhere. Every instruction set gives the same bytes. 3-channel (RGB)
+// and 4-channel (RGBA) images take the vectorized paths; other channel
+// counts use the scalar code.
+
+// Instruction sets of the kernels, from the slowest.
+enum class SimdLevel
+{
+    kScalar,
+    kSse4,
+    kAvx2,
+    kNeon
+};
+
+// "scalar", "sse4", "avx2" or "neon".
+const char* simd_level_name(SimdLevel level);
+// Best level supported by both the build and the CPU.
+SimdLevel max_simd_level();
+// Level in use. Defaults to max_simd_level(), or to the CG2D_SIMD
+// environment variable ("scalar", "sse4"...) if set.
+SimdLevel simd_level();
+// Forces a level, e.g. to compare with the scalar code. Falls back to the
+// best supported level below it, and returns the level now in use.
+SimdLevel set_simd_level(SimdLevel level);
+
+// c -> 255 - c on the color channels. The alpha channel (the 4th one, if
+// any) is left untouched.
+void invert(Image& image);
+
+// Flips the image left-right and / or upside-down, in place.
+void mirror(Image& image, bool is_horizontal, bool is_vertical);
+
+enum class GrayMode
+{
+    kMean,       // (R + G + B) / 3, rounded down
+    kLuminance,  // 0.299 R + 0.587 G + 0.114 B (ITU-R BT.601), rounded
+};
+
+// Replaces RGB by their gray value, alpha is left untouched. Images with
+// less than 3 channels are left as they are.
+void gray_scale(Image& image, GrayMode mode = GrayMode::kMean);
+
+// Channel c of every pixel becomes its channel order[c], e.g. {2, 1, 0, 3}
+// turns RGBA into BGRA. Channels may be repeated. Only the first channels()
+// entries are used, and each must be less than channels(), otherwise
+// std::invalid_argument is thrown.
+void swizzle_channels(Image& image, const std::array<int, 4>& order);
+
+// RGB -> RGBA with a constant alpha, and RGBA -> RGB dropping the alpha.
+// Throw std::invalid_argument on other channel counts.
+Image rgb_to_rgba(const Image& image, unsigned char alpha = 255);
+Image rgba_to_rgb(const Image& image);
+
+// Box-filtered copy, each pixel the mean of a factor x factor block
+// (rounded down). The size is divided by factor and rounded down, to at
+// least one pixel; blocks past the border repeat its last row or column.
+Image downsample(const Image& image, int factor);
+// Factor that brings the longest side of an image of width x height down
+// to at most max_size.
+int downsample_factor(int width, int height, int max_size);
+}  // namespace USTC_CG
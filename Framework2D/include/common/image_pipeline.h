@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "common/image.h"
+#include "common/image_ops.h"
+#include "warper/warp_image.h"
+
+namespace USTC_CG
+{
+// Lazy chain of edits on an image.
+//
+// Operations are only recorded; evaluate() applies all of them in as few
+// passes over memory as possible:
+// - point operations (invert, gray_scale, swizzle_channels) and flips are
+//   fused into one tiled pass: each output row is read once from the
+//   (flipped) source row and all the point operations run on it while it
+//   is in cache;
+// - a warp is a fusion barrier. The operations recorded before it are
+//   applied in one pass first (with nearest sampling, point operations that
+//   leave alpha alone are moved after the warp instead), and the ones
+//   recorded after it run on each warped row as it is produced (flips
+//   become a change of output coordinates).
+//
+// Passes run in place when the pipeline holds the only reference to the
+// image, e.g. when it was given with std::move(). The result is byte for
+// byte the one of applying the same operations one at a time with
+// image_ops.h and warp_image().
+class ImagePipeline
+{
+   public:
+    ImagePipeline() = default;
+    explicit ImagePipeline(Image source);
+
+    // Drops the pending operations and starts over from `source`.
+    void reset(Image source);
+
+    // Recording. Invalid arguments throw std::invalid_argument right away,
+    // as the eager versions would.
+    ImagePipeline& invert();
+    ImagePipeline& gray_scale(GrayMode mode = GrayMode::kMean);
+    ImagePipeline& mirror(bool is_horizontal, bool is_vertical);
+    ImagePipeline& swizzle_channels(const std::array<int, 4>& order);
+    // The warper is kept until the warp is evaluated.
+    ImagePipeline& warp(
+        std::shared_ptr<Warper> warper,
+        Interpolation interpolation = Interpolation::kBilinear);
+
+    // Number of operations recorded since the last evaluate().
+    std::size_t pending() const;
+
+    // Applies the pending operations and returns the result, which is also
+    // the starting point of the operations recorded next. If a warper
+    // throws, the pending operations are dropped and the image is left
+    // partly edited.
+    const Image& evaluate();
+
+   private:
+    struct Op
+    {
+        enum Kind
+        {
+            kInvert,
+            kGray,
+            kMirror,
+            kSwizzle,
+            kWarp
+        } kind = kInvert;
+        GrayMode gray_mode = GrayMode::kMean;
+        bool flip_x = false, flip_y = false;
+        std::array<unsigned char, 4> order{};
+        std::shared_ptr<Warper> warper;
+        Interpolation interpolation = Interpolation::kBilinear;
+    };
+    // Point operations and flips not applied yet: the image they describe
+    // is points(image(flip(x, y))).
+    struct Stage
+    {
+        bool flip_x = false, flip_y = false;
+        std::vector<Op> points;
+
+        bool empty() const
+        {
+            return !flip_x && !flip_y && points.empty();
+        }
+    };
+
+    // Runs the point operations on one row.
+    static void apply_points(
+        const std::vector<Op>& points,
+        unsigned char* row,
+        std::size_t width,
+        int channels);
+    // Whether the point operation gives the same result before and after a
+    // warp with nearest sampling.
+    static bool commutes_with_nearest(const Op& op, int channels);
+    // One fused pass of `stage` over `image`, in place unless its buffer is
+    // shared.
+    static void apply(Image& image, const Stage& stage);
+    // Warps `image`, then applies `post` to each row as it is produced.
+    static Image
+    apply_warp(const Image& image, const Op& warp, const Stage& post);
+
+    Image image_;
+    std::vector<Op> ops_;
+};
+}  // namespace USTC_CG
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "common/image.h"
+
+namespace USTC_CG
+{
+// Encodes and writes image files on a background thread, so that saving a
+// large image never blocks the UI loop. Saves run one at a time, in the
+// order they were queued; the encoders use all cores themselves.
+class ImageSaver
+{
+   public:
+    // Called with whether the file was written
+    using Callback = std::function<void(bool success)>;
+
+    ImageSaver();
+    // Finishes the queued saves before returning.
+    ~ImageSaver();
+
+    ImageSaver(const ImageSaver&) = delete;
+    ImageSaver& operator=(const ImageSaver&) = delete;
+
+    // Shared queue used by ImageWidget.
+    static ImageSaver& instance();
+
+    // Queues the saving of `image` to `filename` (see save_image()). Copies
+    // of an Image share their pixels until written to, so the caller can
+    // keep editing its own copy right away. The optional callback runs on
+    // the worker thread once the file is written, after the future is set.
+    // On failure the future holds the exception.
+    std::future<void> save(
+        const std::string& filename,
+        Image image,
+        Callback on_done = nullptr);
+
+    // Number of saves queued or running.
+    std::size_t pending() const;
+
+   private:
+    void worker_loop();
+
+    std::thread worker_;
+    std::deque<std::function<void()>> tasks_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::size_t pending_ = 0;
+    bool stopping_ = false;
+};
+}  // namespace USTC_CG
@@ -3,12 +3,15 @@
 #include <glad/glad.h>  // Include GLAD before GLFW.
 #include <GLFW/glfw3.h>
 
+#include <future>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "imgui.h"
 #include "common/image.h"
+#include "common/image_loader.h"
 #include "common/widget.h"
 
 namespace USTC_CG
@@ -18,7 +21,10 @@ namespace USTC_CG
 class ImageWidget : public Widget
 {
    public:
-    // Constructs an Image component with a given label and image file.
+    // Constructs an Image component with a given label and image file. The
+    // file is decoded in the background (see ImageLoader): a placeholder is
+    // drawn first, then a downsampled preview, while the full resolution
+    // texture is streamed in over the next frames.
     explicit ImageWidget(const std::string& label, const std::string& filename);
     virtual ~ImageWidget();  // Destructor to manage resources.
 
@@ -28,18 +34,63 @@ class ImageWidget : public Widget
     // Sets the top-left corner position of the image in the GUI.
     void set_position(const ImVec2& pos);
 
-    // Retrieves the size (width, height) of the loaded image.
+    // Retrieves the size (width, height) of the loaded image. It is known
+    // before the pixels are decoded.
     ImVec2 get_image_size() const;
 
+    // True once the file has been decoded (or failed to). Before that data_
+    // is null and editing functions must not be used.
+    bool is_loaded() const;
+
+    // Uploads the whole image to the texture.
     void update();
+    // Uploads only a changed region (plus anything marked dirty before).
+    void update(const PixelRect& rect);
+    // Marks a changed region without uploading it yet. Marked regions are
+    // merged, and their bounding box is uploaded by the next update() or
+    // draw().
+    void mark_dirty(const PixelRect& rect);
 
+    // Saves the image in the background (see ImageSaver), in the format
+    // given by the extension. The outcome is reported on the console.
     void save_to_disk(const std::string& filename);
+    // True while saves started by save_to_disk() are running.
+    bool is_saving() const;
+
+    // Bytes sent to the GPU by the last texture upload.
+    std::size_t last_upload_bytes() const;
+
+   protected:
+    // Called on the UI thread once data_ is available. Subclasses set up the
+    // state derived from the image here rather than in their constructor.
+    virtual void on_image_loaded()
+    {
+    }
+
+    // Draws `overlay` stretched over rows [first_row, height) of the image,
+    // on top of the texture, e.g. a quick low resolution version of an edit
+    // whose result is still being computed. Replaces the previous overlay.
+    void show_overlay(const Image& overlay, int first_row = 0);
+    // Moves the top of the overlay down as the rows above it are done.
+    void set_overlay_row(int first_row);
+    void hide_overlay();
 
    private:
     // Draws the loaded image.
     void draw_image();
 
-    // Loads the image file into OpenGL texture memory.
+    // Picks up the result of the background decoding when it is ready.
+    void poll_loading();
+    // Reports the saves that are done.
+    void poll_saving();
+    // Uploads the next band of rows of a freshly loaded image.
+    void stream_texture();
+
+    // (Re)allocates the texture storage when the image size or format
+    // changes. Pixels are uploaded separately by load_gltexture().
+    void allocate_gltexture();
+
+    // Uploads the dirty region into OpenGL texture memory.
     void load_gltexture();
 
    protected:
@@ -47,6 +98,29 @@ class ImageWidget : public Widget
     std::string filename_;                 // Path to the image file.
     GLuint tex_id_ = 0;                    // OpenGL texture identifier.
 
+    // Texture streaming state. Pixels go through two pixel buffer objects
+    // used in turn, so that filling one does not wait for the previous
+    // transfer from the other.
+    GLuint pbo_ids_[2] = { 0, 0 };
+    int pbo_index_ = 0;
+    int tex_width_ = 0, tex_height_ = 0, tex_channels_ = 0;
+    PixelRect dirty_rect_;  // Region not yet uploaded
+    std::size_t last_upload_bytes_ = 0;
+
+    // Asynchronous loading state. Rows [stream_row_, height) of a newly
+    // loaded image are not in the texture yet; the preview is drawn instead
+    // until they are.
+    std::future<ImageLoader::Result> pending_load_;
+    GLuint preview_tex_id_ = 0;
+    int stream_row_ = 0;
+
+    // Overlay over rows [overlay_row_, height), see show_overlay()
+    GLuint overlay_tex_id_ = 0;
+    int overlay_row_ = 0;
+
+    // Saves not reported yet, with their file names
+    std::vector<std::pair<std::string, std::future<void>>> pending_saves_;
+
     ImVec2 position_ = ImVec2(0.0f, 0.0f);  // Position of the image in the GUI.
     int image_width_ = 0, image_height_ = 0;  // Dimensions of the loaded image.
 };
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace USTC_CG
+{
+// Work-stealing thread pool shared by the data-parallel loops.
+//
+// parallel_for() splits a range recursively: the calling thread pushes the
+// upper halves onto its own deque and keeps the lower one, until the pieces
+// are no larger than the grain. Idle workers steal the oldest (largest)
+// pieces from the other deques. A thread waiting for its loop to finish
+// runs pending pieces meanwhile, so loops may be nested.
+//
+// The number of threads defaults to the CG2D_NUM_THREADS environment
+// variable, or to the number of cores. In deterministic mode every loop
+// runs on the calling thread, chunk by chunk in increasing order, which
+// makes races and scheduling-dependent results reproducible.
+class TaskScheduler
+{
+   public:
+    using RangeBody = std::function<void(int begin, int end)>;
+
+    explicit TaskScheduler(int num_threads = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Pool used by the free functions below.
+    static TaskScheduler& instance();
+
+    // Number of threads running a loop, the calling one included (all cores
+    // if 0). Restarts the workers, so no loop may be running.
+    void set_num_threads(int num_threads);
+    int num_threads() const;
+
+    void set_deterministic(bool deterministic);
+    bool deterministic() const;
+
+    // Calls body(b, e) on sub-ranges covering [begin, end), each of at most
+    // `grain` items, and returns once all are done. The first exception
+    // thrown by the body is rethrown here.
+    void parallel_for(int begin, int end, int grain, const RangeBody& body);
+
+   private:
+    struct Job;
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void start_workers(int num_workers);
+    void stop_workers();
+    void worker_loop(int index);
+    // Splits [begin, end) down to the grain, and runs the lowest piece.
+    void split(const std::shared_ptr<Job>& job, int begin, int end);
+    void push(std::function<void()> task);
+    // Runs one pending task, if any. Returns false if there was none.
+    bool run_one_task();
+
+    // One deque per worker, plus a last one shared by the other threads
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<int> pending_{ 0 };  // Tasks queued, not yet started
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    bool deterministic_ = false;
+};
+
+// Rows per task for row loops over images `width` pixels wide, so that each
+// task covers about `pixels` pixels.
+inline int rows_grain(int width, int pixels = 1 << 16)
+{
+    return std::max(1, pixels / std::max(1, width));
+}
+
+// parallel_for(begin, end, grain, body) on the shared scheduler.
+inline void parallel_for(
+    int begin,
+    int end,
+    int grain,
+    const TaskScheduler::RangeBody& body)
+{
+    TaskScheduler::instance().parallel_for(begin, end, grain, body);
+}
+
+// Row loop: body(y0, y1) over [0, rows).
+inline void
+parallel_for(int rows, int grain, const TaskScheduler::RangeBody& body)
+{
+    TaskScheduler::instance().parallel_for(0, rows, grain, body);
+}
+
+// Maps every chunk of `grain` items of [begin, end) with map(b, e) -> T, and
+// folds the partial results with reduce(T, T) -> T, starting from
+// `identity`. The chunks and the folding order do not depend on the
+// scheduling, so the result is the same for any thread count, even for
+// floating-point sums.
+template<typename T, typename Map, typename Reduce>
+T parallel_reduce(
+    int begin,
+    int end,
+    int grain,
+    T identity,
+    const Map& map,
+    const Reduce& reduce)
+{
+    if (end <= begin)
+        return identity;
+    grain = std::max(1, grain);
+    const int chunks = (end - begin + grain - 1) / grain;
+    std::vector<T> partial(chunks, identity);
+    parallel_for(
+        0,
+        chunks,
+        1,
+        [&](int c0, int c1)
+        {
+            for (int c = c0; c < c1; ++c)
+            {
+                const int b = begin + c * grain;
+                partial[c] = map(b, std::min(end, b + grain));
+            }
+        });
+    T result = identity;
+    for (const T& value : partial)
+        result = reduce(result, value);
+    return result;
+}
+}  // namespace USTC_CG
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace USTC_CG
+{
+// Low-overhead instrumentation of the frame loop and of the algorithms.
+//
+// Timers (ProfileScope) and counters (profile_count()) record events into a
+// ring buffer per thread, with that thread as the only producer and
+// end_frame() as the only consumer, so recording takes no lock. end_frame()
+// sums the events of each stage into a FrameRecord, keeps the last
+// kHistoryFrames records for the overlay and optionally appends them to a
+// CSV or JSON file. Events recorded between two frames, e.g. by background
+// threads, are counted in the next one. The ring of a thread is freed by
+// the first end_frame() after the thread exits.
+//
+// While the profiler is disabled (the default), a scope costs one relaxed
+// atomic load.
+class Profiler
+{
+   public:
+    enum class Kind
+    {
+        kTimer,   // Values are durations in milliseconds
+        kCounter  // Values are summed as given
+    };
+
+    struct Stage
+    {
+        std::string name;
+        Kind kind = Kind::kTimer;
+    };
+
+    struct FrameRecord
+    {
+        std::uint64_t index = 0;
+        double ms = 0;  // From begin_frame() to end_frame()
+        // Per stage id: total milliseconds or counter sum, and the number of
+        // events. Stages registered later are missing at the end.
+        std::vector<double> values;
+        std::vector<std::uint32_t> calls;
+    };
+
+    // Frames kept in history().
+    static constexpr std::size_t kHistoryFrames = 240;
+    // Events per thread between two end_frame(); more are dropped.
+    static constexpr std::size_t kRingEvents = 4096;
+
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    static Profiler& instance();
+
+    static void set_enabled(bool enabled);
+    static bool enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Id of the stage `name`, registered on first use. Names are grouped in
+    // the overlay by their prefix up to '/', e.g. "frame/draw".
+    int register_stage(const std::string& name, Kind kind = Kind::kTimer);
+    std::vector<Stage> stages() const;
+
+    // Records one event of `stage` on the calling thread.
+    void record(int stage, double value);
+
+    // Called by the frame loop around each frame. end_frame() may only be
+    // called from one thread at a time.
+    void begin_frame();
+    void end_frame();
+
+    // Oldest first. Only valid on the thread calling end_frame().
+    const std::deque<FrameRecord>& history() const;
+    // Events lost to full ring buffers since the start.
+    std::uint64_t dropped_events() const;
+
+    // Appends every following frame to `filename`: one JSON object per frame
+    // in an array if it ends in ".json", else CSV rows
+    // "frame,frame_ms,stage,value,calls" with one row per stage recorded
+    // (a row with an empty stage for frames without any event).
+    // Returns false if the file cannot be opened.
+    bool start_dump(const std::string& filename);
+    void stop_dump();
+    bool dumping() const;
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Event
+    {
+        int stage;
+        double value;
+    };
+    struct Ring;
+    struct ThreadRing;
+
+    Ring& thread_ring();
+    void write_frame(const FrameRecord& frame);
+
+    static std::atomic<bool> enabled_;
+
+    mutable std::mutex mutex_;  // Guards stages_ and rings_
+    std::vector<Stage> stages_;
+    std::vector<std::shared_ptr<Ring>> rings_;
+    std::atomic<std::uint64_t> dropped_{ 0 };
+
+    Clock::time_point frame_start_;
+    std::uint64_t frame_index_ = 0;
+    std::deque<FrameRecord> history_;
+    std::ofstream dump_;
+    bool dump_json_ = false;
+    bool dump_empty_ = true;  // No frame written yet
+};
+
+// A stage registered once, typically as a function-local static:
+//
+//     static const ProfileStage stage("warp/idw");
+//     ProfileScope scope(stage);
+struct ProfileStage
+{
+    explicit ProfileStage(
+        const std::string& name,
+        Profiler::Kind kind = Profiler::Kind::kTimer)
+        : id(Profiler::instance().register_stage(name, kind))
+    {
+    }
+
+    int id;
+};
+
+// Records the time from its construction to its destruction.
+class ProfileScope
+{
+   public:
+    explicit ProfileScope(const ProfileStage& stage)
+        : stage_(Profiler::enabled() ? stage.id : -1)
+    {
+        if (stage_ >= 0)
+            start_ = std::chrono::steady_clock::now();
+    }
+
+    ~ProfileScope()
+    {
+        if (stage_ >= 0)
+        {
+            const std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start_;
+            Profiler::instance().record(stage_, elapsed.count());
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+   private:
+    int stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Adds `value` to a counter stage in the current frame.
+inline void profile_count(const ProfileStage& stage, double value)
+{
+    if (Profiler::enabled())
+        Profiler::instance().record(stage.id, value);
+}
+}  // namespace USTC_CG
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace USTC_CG
+{
+// ImGui window over the history of the Profiler: the frame time, then for
+// every stage with events its last, mean and max value per frame and a
+// histogram of the last frames. It also starts and stops the CSV / JSON
+// dump. The profiler is enabled while the window is shown or a dump runs.
+class ProfilerOverlay
+{
+   public:
+    // Draws the window if `*open`; its close button clears `*open`.
+    void draw(bool* open);
+
+   private:
+    void draw_dump_controls();
+
+    char dump_path_[256] = "profile.csv";
+    std::string dump_status_;
+    std::vector<float> samples_;  // Scratch for the plots
+};
+}  // namespace USTC_CG
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "common/image.h"
+
+namespace USTC_CG
+{
+// Out-of-core 8-bit interleaved image for inputs larger than RAM.
+//
+// Pixels are stored in kTileSize x kTileSize tiles inside an unlinked scratch
+// file. Tiles are memory-mapped lazily on first access and unmapped in LRU
+// order once the mapped size exceeds the memory budget; dirty pages are
+// written back to the scratch file by the OS. Each tile is a small
+// row-major image of its own, with tile_stride() bytes per row.
+//
+// The pixel access mirrors Image: pixel() is bounds-checked, at<>() is not,
+// and row_segment() gives the contiguous part of a row up to the tile edge.
+// A pointer returned by any accessor stays valid while fewer than
+// kMinResidentTiles other tiles have been touched since. The class is not
+// thread-safe, even through const accessors.
+class TiledImage
+{
+   public:
+    static constexpr int kTileSize = 256;
+    static constexpr std::size_t kMinResidentTiles = 16;
+    static constexpr std::size_t kDefaultMemoryBudget = std::size_t(256) << 20;
+
+    struct Stats
+    {
+        std::size_t resident_bytes = 0;       // Currently mapped
+        std::size_t peak_resident_bytes = 0;  // High-water mark
+        std::size_t tile_loads = 0;           // Number of mmap calls
+        std::size_t evictions = 0;            // Number of munmap calls
+    };
+
+    // Creates a zero-filled image. The scratch file is created in
+    // `scratch_dir` (the system temporary directory if empty), and removed
+    // when the image is destroyed. Throws std::runtime_error on I/O failure.
+    TiledImage(
+        int width,
+        int height,
+        int channels,
+        std::size_t memory_budget = kDefaultMemoryBudget,
+        const std::string& scratch_dir = "");
+    ~TiledImage();
+
+    TiledImage(const TiledImage&) = delete;
+    TiledImage& operator=(const TiledImage&) = delete;
+
+    int width() const
+    {
+        return width_;
+    }
+    int height() const
+    {
+        return height_;
+    }
+    int channels() const
+    {
+        return channels_;
+    }
+    int tiles_x() const
+    {
+        return tiles_x_;
+    }
+    int tiles_y() const
+    {
+        return tiles_y_;
+    }
+    // Bytes between two consecutive rows of one tile.
+    std::size_t tile_stride() const
+    {
+        return static_cast<std::size_t>(kTileSize) * channels_;
+    }
+    // Pixel rectangle covered by tile (tx, ty), clipped to the image.
+    PixelRect tile_rect(int tx, int ty) const;
+
+    // Data of tile (tx, ty), mapping it if needed. No bounds checking.
+    unsigned char* tile(int tx, int ty)
+    {
+        return map_tile(ty * tiles_x_ + tx);
+    }
+    const unsigned char* tile(int tx, int ty) const
+    {
+        return map_tile(ty * tiles_x_ + tx);
+    }
+
+    // Contiguous pixels of row y from x up to the right edge of its tile.
+    std::span<unsigned char> row_segment(int x, int y)
+    {
+        return { pixel_ptr(x, y), segment_length(x) };
+    }
+    std::span<const unsigned char> row_segment(int x, int y) const
+    {
+        return { pixel_ptr(x, y), segment_length(x) };
+    }
+
+    // Unchecked typed pixel reference (see Image::at<>()).
+    template<typename Pixel>
+    Pixel& at(int x, int y)
+    {
+        return *reinterpret_cast<Pixel*>(pixel_ptr(x, y));
+    }
+    template<typename Pixel>
+    const Pixel& at(int x, int y) const
+    {
+        return *reinterpret_cast<const Pixel*>(pixel_ptr(x, y));
+    }
+
+    // Bounds-checked view of the channels of one pixel.
+    std::span<unsigned char> pixel(int x, int y);
+    std::span<const unsigned char> pixel(int x, int y) const;
+
+    // Copies a window to / from an in-memory image. `rect` is clipped to the
+    // image; for write_region() `image` must have the size of the clipped
+    // rectangle and the same channel count.
+    Image read_region(PixelRect rect) const;
+    void write_region(PixelRect rect, const Image& image);
+
+    // Writes all dirty tiles back to the scratch file.
+    void flush();
+
+    const Stats& stats() const
+    {
+        return stats_;
+    }
+
+   private:
+    struct TileSlot
+    {
+        unsigned char* data = nullptr;
+        std::list<int>::iterator lru;
+    };
+
+    unsigned char* pixel_ptr(int x, int y) const
+    {
+        const int index = (y / kTileSize) * tiles_x_ + x / kTileSize;
+        unsigned char* base =
+            index == last_tile_ ? last_data_ : map_tile(index);
+        return base + (y % kTileSize) * tile_stride() +
+               (x % kTileSize) * channels_;
+    }
+    std::size_t segment_length(int x) const
+    {
+        const int end = std::min(width_, (x / kTileSize + 1) * kTileSize);
+        return static_cast<std::size_t>(end - x) * channels_;
+    }
+    unsigned char* map_tile(int index) const;
+    void evict_lru() const;
+
+    int width_ = 0, height_ = 0, channels_ = 0;
+    int tiles_x_ = 0, tiles_y_ = 0;
+    std::size_t tile_bytes_ = 0;
+    std::size_t memory_budget_ = 0;
+    int fd_ = -1;
+
+    // Mapping state is mutable: mapping a tile does not change the image.
+    mutable std::vector<TileSlot> tiles_;
+    mutable std::list<int> lru_;  // Front is the most recently used tile
+    mutable int last_tile_ = -1;  // One-entry cache for pixel_ptr()
+    mutable unsigned char* last_data_ = nullptr;
+    mutable Stats stats_;
+};
+}  // namespace USTC_CG
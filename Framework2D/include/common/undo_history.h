@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "common/image.h"
+
+namespace USTC_CG
+{
+// Multi-level undo / redo for an image being edited.
+//
+// Each recorded step only keeps the tiles that changed, as the XOR of their
+// old and new bytes, run-length compressed: unchanged bytes XOR to zero, so
+// a step costs memory in proportion to what it changed. Undo and redo apply
+// the same delta in place, in time proportional to the changed tiles.
+//
+// The oldest steps are dropped once the deltas exceed the memory limit.
+class UndoHistory
+{
+   public:
+    static constexpr std::size_t kDefaultMemoryLimit = std::size_t(256) << 20;
+    static constexpr int kTileSize = 64;
+
+    explicit UndoHistory(std::size_t memory_limit = kDefaultMemoryLimit);
+
+    // Forgets all steps; `image` becomes the recorded state.
+    void reset(const Image& image);
+
+    // Records the change from the recorded state to `image`, which becomes
+    // the recorded state, and forgets the redo steps. With `changed`, only
+    // the tiles inside it are compared. A change of image size cannot be
+    // expressed as a delta and resets the history instead.
+    void commit(const Image& image);
+    void commit(const Image& image, const PixelRect& changed);
+
+    bool can_undo() const;
+    bool can_redo() const;
+
+    // Step back / forward. `image` must hold the recorded state; it is
+    // modified in place (it should not share its buffer with other images
+    // than the recorded state). Returns the changed region, empty if there
+    // was no step.
+    PixelRect undo(Image& image);
+    PixelRect redo(Image& image);
+
+    // Last recorded state. It shares its buffer with the images given to
+    // commit() / undo() / redo().
+    const Image& current() const;
+
+    void set_memory_limit(std::size_t bytes);
+    std::size_t memory_limit() const;
+    // Bytes held by the undo and redo deltas.
+    std::size_t memory_usage() const;
+    std::size_t undo_steps() const;
+    std::size_t redo_steps() const;
+
+   private:
+    struct TileDelta
+    {
+        PixelRect rect;
+        std::vector<unsigned char> data;  // Compressed XOR of the tile rows
+    };
+    struct Step
+    {
+        std::vector<TileDelta> tiles;
+        PixelRect rect;  // Union of the tiles
+        std::size_t bytes = 0;
+    };
+
+    // Applies `step` to `image` (undo and redo alike, XOR being its own
+    // inverse) and makes the result the recorded state.
+    PixelRect apply(const Step& step, Image& image);
+    void trim();
+
+    Image current_;
+    std::deque<Step> undo_, redo_;
+    std::size_t memory_limit_;
+    std::size_t memory_usage_ = 0;
+};
+}  // namespace USTC_CG
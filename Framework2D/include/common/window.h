@@ -3,8 +3,12 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 
+#include "common/profiler_overlay.h"
+
 namespace USTC_CG
 {
 
@@ -13,6 +17,24 @@ namespace USTC_CG
 class Window
 {
    public:
+    // kContinuous redraws every vsync frame. kOnDemand blocks until input
+    // arrives or a redraw is requested, and then draws a few frames so
+    // that ImGui can settle.
+    enum class RenderMode
+    {
+        kContinuous,
+        kOnDemand
+    };
+
+    // Counters to measure the cost of an idle window.
+    struct RenderStats
+    {
+        std::uint64_t frames = 0;   // Frames rendered
+        std::uint64_t wakeups = 0;  // Returns from an idle wait
+        double wait_seconds = 0;    // Time blocked waiting for events
+        double cpu_seconds = 0;     // Process CPU time spent in run()
+    };
+
     // Constructor that sets the window's title.
     explicit Window(const std::string& window_name);
 
@@ -24,7 +46,20 @@ class Window
     // Enters the main rendering loop.
     void run();
 
-    //
+    void set_render_mode(RenderMode mode);
+    RenderMode render_mode() const;
+    const RenderStats& render_stats() const;
+
+    // Asks for `frames` more frames in on-demand mode, e.g. while a widget
+    // animates or after a background job has finished. Widgets that keep
+    // calling it every frame (realtime drag, simulation) get continuous
+    // rendering for as long as they do. Safe to call from any thread.
+    static void request_redraw(int frames = 1);
+
+    // Shows the profiler overlay (also toggled with F12). Timings are only
+    // recorded while it is shown or dumping to a file.
+    void set_profiler_visible(bool visible);
+    bool profiler_visible() const;
 
    protected:
     // Virtual draw function to be implemented by derived classes for custom
@@ -41,10 +76,24 @@ class Window
     // Handles the rendering of each frame.
     void render();
 
+    // Longest wait without any event in on-demand mode, in seconds.
+    static constexpr double kIdleTimeout = 0.5;
+    // Frames drawn after every input event.
+    static constexpr int kFramesPerEvent = 3;
+
     std::string name_;              // Name (title) of the window.
     GLFWwindow* window_ = nullptr;  // Pointer to the GLFW window.
     int width_ = 1280;              // Width of the window.
     int height_ = 720;              // Height of the window.
+
+    RenderMode render_mode_ = RenderMode::kOnDemand;
+    RenderStats render_stats_;
+    ProfilerOverlay profiler_overlay_;
+    bool show_profiler_ = false;
+    // Frames still to be drawn before going idle, shared by all windows.
+    static std::atomic<int> pending_frames_;
+    // True while the loop is blocked waiting for events.
+    static std::atomic<bool> waiting_;
 };
 
 }  // namespace USTC_CG
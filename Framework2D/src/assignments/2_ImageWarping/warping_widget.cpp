@@ -1,33 +1,140 @@
 #include "warping_widget.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 
+#include "common/image_ops.h"
+#include "common/window.h"
 #include "warper/IDW_warper.h"
+#include "warper/forward_warp.h"
+#include "warper/local_IDW_warper.h"
 #include "warper/NN_warper.h"
 #include "warper/RBF_warper.h"
+#include "warper/triangulation_warper.h"
+#include "warper/warp_image.h"
 namespace USTC_CG
 {
 using uchar = unsigned char;
 
+namespace
+{
+std::vector<Point2f> to_points(const std::vector<ImVec2>& points)
+{
+    std::vector<Point2f> result;
+    result.reserve(points.size());
+    for (const ImVec2& p : points)
+        result.push_back({ p.x, p.y });
+    return result;
+}
+
+bool same_points(const std::vector<ImVec2>& a, const std::vector<ImVec2>& b)
+{
+    return std::equal(
+        a.begin(),
+        a.end(),
+        b.begin(),
+        b.end(),
+        [](const ImVec2& p, const ImVec2& q)
+        { return p.x == q.x && p.y == q.y; });
+}
+
+// A simple "fish-eye" warping function, as a forward map: the pixel at
+// (x, y) of the input goes to warp(x, y) in the result
+class FisheyeWarper : public Warper
+{
+   public:
+    FisheyeWarper(int width, int height)
+        : center_x_(width / 2.0f),
+          center_y_(height / 2.0f)
+    {
+    }
+
+    std::pair<float, float> warp(float x, float y) override
+    {
+        float dx = x - center_x_;
+        float dy = y - center_y_;
+        float distance = std::sqrt(dx * dx + dy * dy);
+
+        // Simple non-linear transformation r -> r' = f(r)
+        float new_distance = std::sqrt(distance) * 10;
+
+        if (distance == 0)
+            return { center_x_, center_y_ };
+        // (x', y')
+        float ratio = new_distance / distance;
+        return { center_x_ + dx * ratio, center_y_ + dy * ratio };
+    }
+
+   private:
+    float center_x_, center_y_;
+};
+
+// Methods quick enough to fit for every frame of a drag
+bool live_supported(WarpingWidget::WarpingType type)
+{
+    return type == WarpingWidget::kIDW || type == WarpingWidget::kLocalIDW ||
+           type == WarpingWidget::kRBF;
+}
+
+// Warpers of the live previews, made on the worker of the preview
+WarpPreview::Factory live_factory(WarpingWidget::WarpingType type)
+{
+    return [type](
+               const std::vector<Point2f>& target_points,
+               const std::vector<Point2f>& source_points)
+               -> std::shared_ptr<Warper>
+    {
+        switch (type)
+        {
+            case WarpingWidget::kIDW:
+                return std::make_shared<IDWWarper>(
+                    target_points, source_points);
+            case WarpingWidget::kLocalIDW:
+                return std::make_shared<LocalIDWWarper>(
+                    target_points, source_points);
+            case WarpingWidget::kRBF:
+                if (target_points.empty())
+                    return nullptr;
+                return std::make_shared<RBFWarper>(
+                    target_points, source_points);
+            default: return nullptr;
+        }
+    };
+}
+}  // namespace
+
 WarpingWidget::WarpingWidget(
     const std::string& label,
     const std::string& filename)
     : ImageWidget(label, filename)
 {
-    if (data_)
-        back_up_ = std::make_shared<Image>(*data_);
-    annoy_index_ = new Annoy::AnnoyIndex<
-        int,
-        double,
-        Annoy::Euclidean,
-        Annoy::Kiss32Random,
-        Annoy::AnnoyIndexSingleThreadedBuildPolicy>(2);
+    // Wake up an idle window when a live warp is ready
+    preview_ = std::make_unique<WarpPreview>(
+        [] { Window::request_redraw(); });
+}
+
+WarpingWidget::~WarpingWidget() noexcept
+{
+    cancel_training();
+}
+
+void WarpingWidget::on_image_loaded()
+{
+    cancel_training();
+    back_up_ = std::make_shared<Image>(*data_);
+    pipeline_.reset(*data_);
+    history_.reset(*data_);
 }
 
 void WarpingWidget::draw()
 {
+    poll_training();
+    apply_pending_edits();
+    poll_live();
     // Draw the image
     ImageWidget::draw();
     // Draw the canvas
@@ -35,109 +142,28 @@ void WarpingWidget::draw()
         select_points();
 }
 
-void WarpingWidget::build_annoy_index()
+void WarpingWidget::apply_pending_edits()
 {
-    if (!data_)
+    if (!is_loaded() || !pipeline_.pending())
         return;
-
-    const int w = data_->width();
-    const int h = data_->height();
-
-    for (int y = 0; y < h; ++y)
-    {
-        for (int x = 0; x < w; ++x)
-        {
-            double point[2] = { static_cast<double>(x),
-                                static_cast<double>(y) };
-            annoy_index_->add_item(y * w + x, point);
-        }
-    }
-    annoy_index_->build(10, 1);  // 构建10棵树
-    index_built_ = true;
+    // The recorded edits start from the last image committed
+    stop_live();
+    *data_ = pipeline_.evaluate();
+    history_.commit(*data_);
+    // After change the image, we should reload the image data to the renderer
+    update();
 }
-
 void WarpingWidget::invert()
 {
-    for (int i = 0; i < data_->width(); ++i)
-    {
-        for (int j = 0; j < data_->height(); ++j)
-        {
-            const auto color = data_->get_pixel(i, j);
-            data_->set_pixel(
-                i,
-                j,
-                { static_cast<uchar>(255 - color[0]),
-                  static_cast<uchar>(255 - color[1]),
-                  static_cast<uchar>(255 - color[2]) });
-        }
-    }
-    // After change the image, we should reload the image data to the renderer
-    update();
+    pipeline_.invert();
 }
 void WarpingWidget::mirror(bool is_horizontal, bool is_vertical)
 {
-    Image image_tmp(*data_);
-    int width = data_->width();
-    int height = data_->height();
-
-    if (is_horizontal)
-    {
-        if (is_vertical)
-        {
-            for (int i = 0; i < width; ++i)
-            {
-                for (int j = 0; j < height; ++j)
-                {
-                    data_->set_pixel(
-                        i,
-                        j,
-                        image_tmp.get_pixel(width - 1 - i, height - 1 - j));
-                }
-            }
-        }
-        else
-        {
-            for (int i = 0; i < width; ++i)
-            {
-                for (int j = 0; j < height; ++j)
-                {
-                    data_->set_pixel(
-                        i, j, image_tmp.get_pixel(width - 1 - i, j));
-                }
-            }
-        }
-    }
-    else
-    {
-        if (is_vertical)
-        {
-            for (int i = 0; i < width; ++i)
-            {
-                for (int j = 0; j < height; ++j)
-                {
-                    data_->set_pixel(
-                        i, j, image_tmp.get_pixel(i, height - 1 - j));
-                }
-            }
-        }
-    }
-
-    // After change the image, we should reload the image data to the renderer
-    update();
+    pipeline_.mirror(is_horizontal, is_vertical);
 }
 void WarpingWidget::gray_scale()
 {
-    for (int i = 0; i < data_->width(); ++i)
-    {
-        for (int j = 0; j < data_->height(); ++j)
-        {
-            const auto color = data_->get_pixel(i, j);
-            uchar gray_value = (color[0] + color[1] + color[2]) / 3;
-            data_->set_pixel(i, j, { gray_value, gray_value, gray_value });
-        }
-    }
-    // After change the image, we should reload the image data to the renderer
-    update();
+    pipeline_.gray_scale();
 }
 void WarpingWidget::warping()
 {
@@ -146,45 +172,42 @@ void WarpingWidget::warping()
     // Please design a class for such warping operations, utilizing the
     // encapsulation, inheritance, and polymorphism features of C++.
 
+    stop_live();
+    // Only the Warper based methods are recorded in pipeline_, the others
+    // start from the image with the recorded edits applied
+    if (warping_type_ == kDefault || warping_type_ == kFisheye)
+        apply_pending_edits();
+    // Read the source through a const reference so that it keeps sharing
+    // its buffer with back_up_
+    const Image& source_image = *data_;
     // Create a new image to store the result
-    Image warped_image(*data_);
-    // Initialize the color of result image
-    for (int y = 0; y < data_->height(); ++y)
+    Image warped_image(source_image);
+
+    // The map goes from the result back to the source (backward warping)
+    const std::vector<Point2f> source_points = to_points(start_points_);
+    const std::vector<Point2f> target_points = to_points(end_points_);
+    // Same map as the last one, e.g. warping again after a restore: resample
+    // through its field without evaluating a warper
+    if (field_ && warping_type_ == field_type_ &&
+        field_->width() == data_->width() &&
+        field_->height() == data_->height() &&
+        same_points(start_points_, field_start_points_) &&
+        same_points(end_points_, field_end_points_))
     {
-        for (int x = 0; x < data_->width(); ++x)
-        {
-            warped_image.set_pixel(x, y, { 0, 0, 0 });
-        }
+        pipeline_.warp(std::make_shared<FieldWarper>(field_));
+        return;
     }
-
+    std::shared_ptr<Warper> warper;
     switch (warping_type_)
     {
         case kDefault: break;
         case kFisheye:
         {
-            // Example: (simplified) "fish-eye" warping
-            // For each (x, y) from the input image, the "fish-eye" warping
-            // transfer it to (x', y') in the new image: Note: For this
-            // transformation ("fish-eye" warping), one can also calculate the
-            // inverse (x', y') -> (x, y) to fill in the "gaps".
-            for (int y = 0; y < data_->height(); ++y)
-            {
-                for (int x = 0; x < data_->width(); ++x)
-                {
-                    // Apply warping function to (x, y), and we can get (x', y')
-                    auto [new_x, new_y] =
-                        fisheye_warping(x, y, data_->width(), data_->height());
-                    // Copy the color from the original image to the result
-                    // image
-                    if (new_x >= 0 && new_x < data_->width() && new_y >= 0 &&
-                        new_y < data_->height())
-                    {
-                        std::vector<unsigned char> pixel =
-                            data_->get_pixel(x, y);
-                        warped_image.set_pixel(new_x, new_y, pixel);
-                    }
-                }
-            }
+            // Example: (simplified) "fish-eye" warping. It maps each pixel
+            // of the input to the result (forward warping): the pixels are
+            // splatted there, and the gaps between them are filled.
+            FisheyeWarper fisheye(data_->width(), data_->height());
+            warped_image = forward_warp(fisheye, source_image);
             break;
         }
         case kIDW:
@@ -192,16 +215,14 @@ void WarpingWidget::warping()
             // HW2_TODO: Implement the IDW warping
             // use selected points start_points_, end_points_ to construct the
             // map
-            IDWWarper warper(end_points_, start_points_);
-            for (int y = 0; y < data_->height(); y++)
-            {
-                for (int x = 0; x < data_->width(); x++)
-                {
-                    auto [src_x, src_y] = warper.warp(x, y);
-                    auto pixel = bilinear_interpolation(src_x, src_y);
-                    warped_image.set_pixel(x, y, pixel);
-                }
-            }
+            warper =
+                std::make_shared<IDWWarper>(target_points, source_points);
+            break;
+        }
+        case kLocalIDW:
+        {
+            warper = std::make_shared<LocalIDWWarper>(
+                target_points, source_points);
             break;
         }
         case kRBF:
@@ -215,45 +236,186 @@ void WarpingWidget::warping()
                           << std::endl;
                 return;
             }
-            RBFWarper warper(end_points_, start_points_);
-            for (int y = 0; y < data_->height(); y++)
-            {
-                for (int x = 0; x < data_->width(); x++)
-                {
-                    auto [src_x, src_y] = warper.warp(x, y);
-                    auto pixel = bilinear_interpolation(src_x, src_y);
-                    warped_image.set_pixel(x, y, pixel);
-                }
-            }
+            // Usually a few points were added or moved since the last fit,
+            // which refit() updates instead of solving again
+            if (rbf_warper_)
+                rbf_warper_->refit(target_points, source_points);
+            else
+                rbf_warper_ = std::make_shared<RBFWarper>(
+                    target_points, source_points);
+            warper = rbf_warper_;
             break;
         }
+        case kTriangulation:
+        {
+            // Piecewise affine: rasterized exactly, in one pass over the
+            // pixels whatever the number of points
+            const TriangulationWarper mesh(
+                target_points,
+                source_points,
+                data_->width(),
+                data_->height());
+            apply_field(
+                std::make_shared<const WarpField>(
+                    mesh.bake(data_->width(), data_->height())),
+                kTriangulation,
+                start_points_,
+                end_points_);
+            return;
+        }
         case kNN:
         {
             std::cout
                 << "You shouldn't use the NN method if you have few points"
                 << std::endl;
-            NNWarper warper(end_points_, start_points_);
-            for (int y = 0; y < data_->height(); y++)
-            {
-                for (int x = 0; x < data_->width(); x++)
-                {
-                    auto [src_x, src_y] = warper.warp(x, y);
-                    auto pixel = bilinear_interpolation(src_x, src_y);
-                    warped_image.set_pixel(x, y, pixel);
-                }
-            }
+            if (start_points_.empty())
+                return;
+            // Applied by poll_training() when trained
+            start_training();
+            return;
         }
         default: break;
     }
 
+    if (warper)
+    {
+        apply_warper(*warper, warping_type_, start_points_, end_points_);
+        return;
+    }
     *data_ = std::move(warped_image);
+    pipeline_.reset(*data_);
+    history_.commit(*data_);
     update();
 }
+void WarpingWidget::apply_warper(
+    Warper& warper,
+    WarpingType type,
+    const std::vector<ImVec2>& start_points,
+    const std::vector<ImVec2>& end_points)
+{
+    // The maps are smooth: evaluate them on a lattice, refined where
+    // interpolating it would be off by more than a quarter pixel
+    auto field = std::make_shared<const WarpField>(
+        WarpField::bake_coarse(warper, data_->width(), data_->height()));
+    apply_field(std::move(field), type, start_points, end_points);
+}
+void WarpingWidget::apply_field(
+    std::shared_ptr<const WarpField> field,
+    WarpingType type,
+    const std::vector<ImVec2>& start_points,
+    const std::vector<ImVec2>& end_points)
+{
+    field_ = std::move(field);
+    field_type_ = type;
+    field_start_points_ = start_points;
+    field_end_points_ = end_points;
+    // Fused with the edits recorded after it
+    pipeline_.warp(std::make_shared<FieldWarper>(field_));
+}
+void WarpingWidget::start_training()
+{
+    // Already training on these points
+    if (is_training() && same_points(start_points_, nn_start_points_) &&
+        same_points(end_points_, nn_end_points_))
+        return;
+    cancel_training();
+    nn_start_points_ = start_points_;
+    nn_end_points_ = end_points_;
+    auto state = std::make_shared<NNTraining>();
+    nn_state_ = state;
+    // Backward warp, as for the other methods
+    nn_training_ = NNWarper::train_async(
+        to_points(end_points_),
+        to_points(start_points_),
+        [state](const NNWarper::Progress& progress)
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->progress = progress;
+            return !state->cancel;
+        });
+}
+void WarpingWidget::poll_training()
+{
+    if (!is_training())
+        return;
+    if (nn_training_.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready)
+    {
+        // Keep drawing, to show the progress and pick up the result
+        Window::request_redraw();
+        return;
+    }
+    const NNWarper::Progress progress = training_progress();
+    nn_state_.reset();
+    std::shared_ptr<NNWarper> warper;
+    try
+    {
+        warper = nn_training_.get();
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "NN training failed: " << e.what() << std::endl;
+        return;
+    }
+    if (progress.cached)
+        std::cout << "NN weights found in the cache" << std::endl;
+    else
+        std::cout << "NN trained in " << progress.steps
+                  << " steps, loss " << progress.loss << std::endl;
+    if (!is_loaded())
+        return;
+    stop_live();
+    apply_warper(*warper, kNN, nn_start_points_, nn_end_points_);
+}
+void WarpingWidget::cancel_training()
+{
+    if (nn_state_)
+        nn_state_->cancel = true;
+    nn_state_.reset();
+    // The future of a promise does not wait for it
+    nn_training_ = {};
+}
+NNWarper::Progress WarpingWidget::training_progress() const
+{
+    if (!nn_state_)
+        return {};
+    std::lock_guard<std::mutex> lock(nn_state_->mutex);
+    return nn_state_->progress;
+}
 void WarpingWidget::restore()
 {
+    cancel_training();
+    stop_live();
     *data_ = *back_up_;
+    pipeline_.reset(*data_);
+    // Restoring can be undone too
+    history_.commit(*data_);
     update();
 }
+void WarpingWidget::undo()
+{
+    cancel_training();
+    stop_live();
+    apply_pending_edits();
+    // Drop the reference of the pipeline so that the step is applied to
+    // data_ in place
+    pipeline_.reset(Image());
+    const PixelRect rect = history_.undo(*data_);
+    pipeline_.reset(*data_);
+    if (!rect.empty())
+        update(rect);
+}
+void WarpingWidget::redo()
+{
+    cancel_training();
+    stop_live();
+    apply_pending_edits();
+    pipeline_.reset(Image());
+    const PixelRect rect = history_.redo(*data_);
+    pipeline_.reset(*data_);
+    if (!rect.empty())
+        update(rect);
+}
 void WarpingWidget::set_default()
 {
     warping_type_ = kDefault;
@@ -274,10 +436,24 @@ void WarpingWidget::set_NN()
 {
     warping_type_ = kNN;
 }
+void WarpingWidget::set_local_IDW()
+{
+    warping_type_ = kLocalIDW;
+}
+void WarpingWidget::set_triangulation()
+{
+    warping_type_ = kTriangulation;
+}
 void WarpingWidget::enable_selecting(bool flag)
 {
     flag_enable_selecting_points_ = flag;
 }
+void WarpingWidget::set_live_preview(bool flag)
+{
+    if (live_preview_ && !flag)
+        stop_live();
+    live_preview_ = flag;
+}
 void WarpingWidget::select_points()
 {
     /// Invisible button over the canvas to capture mouse interactions.
@@ -301,11 +477,20 @@ void WarpingWidget::select_points()
     if (draw_status_)
     {
         end_ = ImVec2(io.MousePos.x - position_.x, io.MousePos.y - position_.y);
+        const bool live =
+            live_preview_ && is_loaded() && live_supported(warping_type_);
         if (!ImGui::IsMouseDown(ImGuiMouseButton_Left))
         {
             start_points_.push_back(start_);
             end_points_.push_back(end_);
             draw_status_ = false;
+            if (live)
+                request_live(true);
+        }
+        else if (live && (!live_ || end_.x != live_end_.x ||
+                          end_.y != live_end_.y))
+        {
+            request_live(false);
         }
     }
     // Visualization
@@ -330,113 +515,102 @@ void WarpingWidget::select_points()
 }
 void WarpingWidget::init_selections()
 {
+    // The next live warps start from the current image
+    stop_live();
     start_points_.clear();
     end_points_.clear();
 }
 
-std::pair<int, int> WarpingWidget::fisheye_warping(
-    int& x,
-    int& y,
-    const int& width,
-    const int& height)
-{
-    float center_x = width / 2.0f;
-    float center_y = height / 2.0f;
-    float dx = x - center_x;
-    float dy = y - center_y;
-    float distance = std::sqrt(dx * dx + dy * dy);
-
-    // Simple non-linear transformation r -> r' = f(r)
-    float new_distance = std::sqrt(distance) * 10;
-
-    if (distance == 0)
-    {
-        return { static_cast<int>(center_x), static_cast<int>(center_y) };
-    }
-    // (x', y')
-    float ratio = new_distance / distance;
-    int new_x = static_cast<int>(center_x + dx * ratio);
-    int new_y = static_cast<int>(center_y + dy * ratio);
-
-    return { new_x, new_y };
+void WarpingWidget::begin_live()
+{
+    apply_pending_edits();
+    live_base_ = *data_;
+    live_committed_ = *data_;
+    live_type_ = warping_type_;
+    preview_->set_source(live_base_, live_factory(live_type_));
+    live_ = true;
 }
 
-std::vector<uchar> WarpingWidget::bilinear_interpolation(float& x, float& y)
+void WarpingWidget::request_live(bool full)
 {
-    int x0 = std::floor(x);
-    int y0 = std::floor(y);
-    int x1 = x0 + 1;
-    int y1 = y0 + 1;
-
-    // 边界检查
-    x0 = std::clamp(x0, 0, data_->width() - 1);
-    x1 = std::clamp(x1, 0, data_->width() - 1);
-    y0 = std::clamp(y0, 0, data_->height() - 1);
-    y1 = std::clamp(y1, 0, data_->height() - 1);
-
-    float dx = x - x0;
-    float dy = y - y0;
-
-    auto p00 = data_->get_pixel(x0, y0);
-    auto p01 = data_->get_pixel(x0, y1);
-    auto p10 = data_->get_pixel(x1, y0);
-    auto p11 = data_->get_pixel(x1, y1);
-
-    std::vector<uchar> result(3);
-    for (int i = 0; i < 3; ++i)
+    // Changing the method starts over from the last image applied
+    if (live_ && live_type_ != warping_type_)
+        stop_live();
+    if (!live_)
+        begin_live();
+    // Backward warps, as in warping()
+    std::vector<Point2f> target_points = to_points(end_points_);
+    std::vector<Point2f> source_points = to_points(start_points_);
+    if (full)
     {
-        float val = (1 - dx) * (1 - dy) * p00[i] + (1 - dx) * dy * p01[i] +
-                    dx * (1 - dy) * p10[i] + dx * dy * p11[i];
-        result[i] = static_cast<uchar>(std::clamp(val, 0.0f, 255.0f));
+        preview_->request_full(target_points, source_points);
+        live_rendering_ = true;
+        live_rows_ = 0;
+        return;
     }
-    return result;
-}
-
-std::vector<uchar> WarpingWidget::nearest_neighbor_interpolation(
-    float& x,
-    float& y)
-{
-    int nearest_x = static_cast<int>(std::round(x));
-    int nearest_y = static_cast<int>(std::round(y));
-
-    nearest_x = std::clamp(nearest_x, 0, data_->width() - 1);
-    nearest_y = std::clamp(nearest_y, 0, data_->height() - 1);
-
-    return data_->get_pixel(nearest_x, nearest_y);
+    target_points.push_back({ end_.x, end_.y });
+    source_points.push_back({ start_.x, start_.y });
+    preview_->request_proxy(target_points, source_points);
+    // A new drag drops the full warp in progress
+    drop_live_rows();
+    live_end_ = end_;
 }
 
-std::vector<uchar> WarpingWidget::ann_nearest_neighbor_interpolation(
-    float& x,
-    float& y)
+void WarpingWidget::poll_live()
 {
-    if (!index_built_)
+    if (!live_)
+        return;
+    if (const auto proxy = preview_->take_proxy())
+        show_overlay(*proxy, live_rendering_ ? live_rows_ : 0);
+    if (!live_rendering_)
+        return;
+    const WarpPreview::Progress progress = preview_->full_progress();
+    if (progress.warp && progress.rows_done > live_rows_)
     {
-        build_annoy_index();
+        // The new rows replace the proxy from the top
+        const PixelRect rect = {
+            0, live_rows_, data_->width(), progress.rows_done
+        };
+        data_->copy_region_from(progress.warp->result(), rect);
+        mark_dirty(rect);
+        live_rows_ = progress.rows_done;
+        set_overlay_row(live_rows_);
     }
-
-    double query[2] = { static_cast<double>(x), static_cast<double>(y) };
-    std::vector<int> result_ids;  // 改用vector接收结果
-    std::vector<double> distances;
-
-    // 查找最近邻
-    annoy_index_->get_nns_by_vector(query, 1, -1, &result_ids, &distances);
-
-    // 将线性索引转换为坐标
-    const int w = data_->width();
-
-    if (!result_ids.empty())
+    if (!progress.done)
+        return;
+    live_rendering_ = false;
+    hide_overlay();
+    if (!progress.warp)
     {
-        int nearest_id = result_ids[0];
-        int nearest_x = static_cast<int>(std::round(nearest_id % w));
-        int nearest_y = static_cast<int>(std::round(nearest_id / w));
-
-        return data_->get_pixel(
-            std::clamp(nearest_x, 0, w - 1),
-            std::clamp(nearest_y, 0, data_->height() - 1));
+        std::cout << "Live warp failed" << std::endl;
+        return;
     }
-    else
+    pipeline_.reset(*data_);
+    history_.commit(*data_);
+    live_committed_ = *data_;
+}
+
+void WarpingWidget::drop_live_rows()
+{
+    if (live_rendering_ && live_rows_ > 0)
     {
-        return { 0, 0, 0 };
+        const PixelRect rect = { 0, 0, data_->width(), live_rows_ };
+        data_->copy_region_from(live_committed_, rect);
+        mark_dirty(rect);
     }
+    live_rendering_ = false;
+    live_rows_ = 0;
+}
+
+void WarpingWidget::stop_live()
+{
+    if (!live_)
+        return;
+    preview_->cancel();
+    hide_overlay();
+    drop_live_rows();
+    live_ = false;
+    live_base_ = Image();
+    live_committed_ = Image();
+}
 }  // namespace USTC_CG
-}
\ No newline at end of file
@@ -1,8 +1,16 @@
 #pragma once
 
+#include <atomic>
+#include <future>
+#include <mutex>
+
+#include "common/image_pipeline.h"
 #include "common/image_widget.h"
-#include <annoylib.h>
-#include <kissrandom.h>
+#include "common/undo_history.h"
+#include "warper/NN_warper.h"
+#include "warper/RBF_warper.h"
+#include "warper/warp_field.h"
+#include "warper/warp_preview.h"
 
 
 namespace USTC_CG
@@ -16,16 +24,32 @@ class WarpingWidget : public ImageWidget
     explicit WarpingWidget(
         const std::string& label,
         const std::string& filename);
-    virtual ~WarpingWidget() noexcept = default;
+    ~WarpingWidget() noexcept override;
 
     void draw() override;
 
-    // Simple edit functions
+    // Simple edit functions, available once is_loaded() is true. They are
+    // recorded and applied together, in one fused pass, when the image is
+    // next drawn or saved.
     void invert();
     void mirror(bool is_horizontal, bool is_vertical);
     void gray_scale();
     void warping();
     void restore();
+    // Step through the edits applied so far. Each apply_pending_edits(),
+    // warp and restore is one step.
+    void undo();
+    void redo();
+    // Applies the recorded edits to the displayed image now.
+    void apply_pending_edits();
+
+    // The NN method trains in the background: warping() returns at once,
+    // and the warp is applied when the training is over.
+    bool is_training() const
+    {
+        return nn_training_.valid();
+    }
+    NNWarper::Progress training_progress() const;
 
     // Enumeration for supported warping types.
     // HW2_TODO: more warping types.
@@ -36,6 +60,8 @@ class WarpingWidget : public ImageWidget
         kIDW = 2,
         kRBF = 3,
         kNN = 4,
+        kLocalIDW = 5,
+        kTriangulation = 6,
     };
     // Warping type setters.
     void set_default();
@@ -43,33 +69,101 @@ class WarpingWidget : public ImageWidget
     void set_IDW();
     void set_RBF();
     void set_NN();
+    void set_local_IDW();
+    void set_triangulation();
 
     // Point selecting interaction
     void enable_selecting(bool flag);
+    // With live preview, the warp (IDW, local IDW or RBF) is shown while a
+    // pair of points is dragged, on a downsampled copy, and applied at full
+    // resolution, band by band, when the mouse is released.
+    void set_live_preview(bool flag);
     void select_points();
     void init_selections();
 
+   protected:
+    void on_image_loaded() override;
+
    private:
     // Store the original image data
     std::shared_ptr<Image> back_up_;
+    // Edits not applied to data_ yet
+    ImagePipeline pipeline_;
+    // Edits applied to data_
+    UndoHistory history_;
     // The selected point couples for image warping
     std::vector<ImVec2> start_points_, end_points_;
+    // Map of the last warp, and the method and points it was baked from
+    std::shared_ptr<const WarpField> field_;
+    WarpingType field_type_ = kDefault;
+    std::vector<ImVec2> field_start_points_, field_end_points_;
+    // Last RBF fit, refitted in place when the points change
+    std::shared_ptr<RBFWarper> rbf_warper_;
+
+    // NN training in progress, and the points it fits. The state is shared
+    // with the training thread, which may outlive the widget.
+    struct NNTraining
+    {
+        std::atomic<bool> cancel = false;
+        std::mutex mutex;
+        NNWarper::Progress progress;
+    };
+    std::future<std::shared_ptr<NNWarper>> nn_training_;
+    std::shared_ptr<NNTraining> nn_state_;
+    std::vector<ImVec2> nn_start_points_, nn_end_points_;
+
+    // Live preview. The live warps all start from live_base_, the image
+    // before the first of them, with all the points selected so far;
+    // live_committed_ is the last one applied in full (the base at first).
+    bool live_preview_ = false;
+    std::unique_ptr<WarpPreview> preview_;
+    bool live_ = false;
+    WarpingType live_type_ = kDefault;
+    Image live_base_, live_committed_;
+    // Full resolution warp being copied into data_, and its rows copied so
+    // far
+    bool live_rendering_ = false;
+    int live_rows_ = 0;
+    ImVec2 live_end_;  // End point of the last proxy request
 
     ImVec2 start_, end_;
     bool flag_enable_selecting_points_ = false;
     bool draw_status_ = false;
     WarpingType warping_type_;
 
-    Annoy::AnnoyIndex<int, double, Annoy::Euclidean, Annoy::Kiss32Random, Annoy::AnnoyIndexSingleThreadedBuildPolicy>* annoy_index_;
-    bool index_built_ = false;
-
    private:
-    // A simple "fish-eye" warping function
-    std::pair<int, int> fisheye_warping(int& x, int& y, const int& width, const int& height);
-    std::vector<unsigned char> bilinear_interpolation(float& x, float& y);
-    std::vector<uchar> nearest_neighbor_interpolation(float& x, float& y);
-    std::vector<uchar> ann_nearest_neighbor_interpolation(float& x, float& y);
-    void build_annoy_index();
+    // Records the warp through `field`, made by the given method and points,
+    // in pipeline_
+    void apply_field(
+        std::shared_ptr<const WarpField> field,
+        WarpingType type,
+        const std::vector<ImVec2>& start_points,
+        const std::vector<ImVec2>& end_points);
+    // Same with the field baked from the warper
+    void apply_warper(
+        Warper& warper,
+        WarpingType type,
+        const std::vector<ImVec2>& start_points,
+        const std::vector<ImVec2>& end_points);
+    // Starts training an NN on the selected points
+    void start_training();
+    // Applies the trained NN once the training is over
+    void poll_training();
+    // Stops the training in progress, whose warp is then dropped
+    void cancel_training();
+
+    // Starts live warps from the current image
+    void begin_live();
+    // Queues a warp of the selected points, plus the pair being dragged if
+    // any
+    void request_live(bool full);
+    // Shows the live results that are ready
+    void poll_live();
+    // Puts back the rows of data_ written by a full warp that did not
+    // finish
+    void drop_live_rows();
+    // Back to the last warp applied in full, and ends the live warps
+    void stop_live();
 };
 
 }  // namespace USTC_CG
\ No newline at end of file
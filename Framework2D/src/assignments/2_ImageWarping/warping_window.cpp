@@ -17,7 +17,7 @@ void ImageWarping::draw()
     draw_toolbar();
     if (flag_open_file_dialog_)
         draw_open_image_file_dialog();
-    if (flag_save_file_dialog_ && p_image_)
+    if (flag_save_file_dialog_ && p_image_ && p_image_->is_loaded())
         draw_save_image_file_dialog();
 
     const ImGuiViewport* viewport = ImGui::GetMainViewport();
@@ -51,25 +51,26 @@ void ImageWarping::draw_toolbar()
             ImGui::EndMenu();
         }
         ImGui::Separator();
-        if (ImGui::MenuItem("Invert") && p_image_)
+        if (ImGui::MenuItem("Invert") && p_image_ && p_image_->is_loaded())
         {
             p_image_->invert();
         }
-        if (ImGui::MenuItem("Mirror") && p_image_)
+        if (ImGui::MenuItem("Mirror") && p_image_ && p_image_->is_loaded())
         {
             p_image_->mirror(true, false);
         }
-        if (ImGui::MenuItem("GrayScale") && p_image_)
+        if (ImGui::MenuItem("GrayScale") && p_image_ && p_image_->is_loaded())
         {
             p_image_->gray_scale();
         }
         ImGui::Separator();
-        if (ImGui::MenuItem("Select Points") && p_image_)
+        if (ImGui::MenuItem("Select Points") && p_image_ &&
+            p_image_->is_loaded())
         {
             p_image_->init_selections();
             p_image_->enable_selecting(true);
         }
-        if (ImGui::MenuItem("Warping") && p_image_)
+        if (ImGui::MenuItem("Warping") && p_image_ && p_image_->is_loaded())
         {
             p_image_->enable_selecting(false);
             p_image_->warping();
@@ -82,6 +83,8 @@ void ImageWarping::draw_toolbar()
         ImGui::RadioButton("IDW", &warping_type, 1);
         ImGui::RadioButton("RBF", &warping_type, 2);
         ImGui::RadioButton("NN", &warping_type, 3);
+        ImGui::RadioButton("Local IDW", &warping_type, 4);
+        ImGui::RadioButton("Triangulation", &warping_type, 5);
         if (warping_type == 0 && p_image_)
             p_image_->set_fisheye();
         else if (warping_type == 1 && p_image_)
@@ -90,12 +93,50 @@ void ImageWarping::draw_toolbar()
             p_image_->set_RBF();
         else if (warping_type == 3 && p_image_)
             p_image_->set_NN();
+        else if (warping_type == 4 && p_image_)
+            p_image_->set_local_IDW();
+        else if (warping_type == 5 && p_image_)
+            p_image_->set_triangulation();
         // HW2_TODO: You can add more interactions for IDW, RBF, etc.
+        static bool live_preview = false;
+        ImGui::Checkbox("Live preview", &live_preview);
+        if (p_image_)
+            p_image_->set_live_preview(live_preview);
         ImGui::Separator();
-        if (ImGui::MenuItem("Restore") && p_image_)
+        if (ImGui::MenuItem("Restore") && p_image_ && p_image_->is_loaded())
         {
             p_image_->restore();
         }
+        ImGuiIO& io = ImGui::GetIO();
+        const bool shortcuts = io.KeyCtrl && !io.WantTextInput;
+        if ((ImGui::MenuItem("Undo", "Ctrl+Z") ||
+             (shortcuts && ImGui::IsKeyPressed(ImGuiKey_Z, false))) &&
+            p_image_ && p_image_->is_loaded())
+        {
+            p_image_->undo();
+        }
+        if ((ImGui::MenuItem("Redo", "Ctrl+Y") ||
+             (shortcuts && ImGui::IsKeyPressed(ImGuiKey_Y, false))) &&
+            p_image_ && p_image_->is_loaded())
+        {
+            p_image_->redo();
+        }
+        if (p_image_ && p_image_->is_training())
+        {
+            const NNWarper::Progress progress =
+                p_image_->training_progress();
+            ImGui::Separator();
+            ImGui::Text(
+                "Training NN: step %lu, loss %.3g",
+                progress.steps,
+                progress.loss);
+        }
+        // Saving runs in the background
+        if (p_image_ && p_image_->is_saving())
+        {
+            ImGui::Separator();
+            ImGui::TextUnformatted("Saving...");
+        }
         ImGui::EndMainMenuBar();
     }
 }
@@ -117,7 +158,9 @@ void ImageWarping::draw_open_image_file_dialog()
     config.path = DATA_PATH;
     config.flags = ImGuiFileDialogFlags_Modal;
     ImGuiFileDialog::Instance()->OpenDialog(
-        "ChooseImageOpenFileDlg", "Choose Image File", ".png,.jpg", config);
+        "ChooseImageOpenFileDlg", "Choose Image File",
+        ".png,.jpg,.qoi,.pam",
+        config);
     ImVec2 main_size = ImGui::GetMainViewport()->WorkSize;
     ImVec2 dlg_size(main_size.x / 2, main_size.y / 2);
     if (ImGuiFileDialog::Instance()->Display(
@@ -140,7 +183,9 @@ void ImageWarping::draw_save_image_file_dialog()
     config.path = DATA_PATH;
     config.flags = ImGuiFileDialogFlags_Modal;
     ImGuiFileDialog::Instance()->OpenDialog(
-        "ChooseImageSaveFileDlg", "Save Image As...", ".png", config);
+        "ChooseImageSaveFileDlg", "Save Image As...",
+        ".png,.qoi,.pam",
+        config);
     ImVec2 main_size = ImGui::GetMainViewport()->WorkSize;
     ImVec2 dlg_size(main_size.x / 2, main_size.y / 2);
     if (ImGuiFileDialog::Instance()->Display(
@@ -152,7 +197,10 @@ void ImageWarping::draw_save_image_file_dialog()
                 ImGuiFileDialog::Instance()->GetFilePathName();
             std::string label = filePathName;
             if (p_image_)
+            {
+                p_image_->apply_pending_edits();
                 p_image_->save_to_disk(filePathName);
+            }
         }
         ImGuiFileDialog::Instance()->Close();
         flag_save_file_dialog_ = false;
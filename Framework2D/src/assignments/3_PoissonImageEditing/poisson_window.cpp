@@ -22,7 +22,7 @@ void PoissonWindow::draw()
         draw_open_target_image_file_dialog();
     if (flag_open_source_file_dialog_ && p_target_)
         draw_open_source_image_file_dialog();
-    if (flag_save_file_dialog_ && p_target_)
+    if (flag_save_file_dialog_ && p_target_ && p_target_->is_loaded())
         draw_save_image_file_dialog();
 
     if (p_target_)
@@ -63,6 +63,22 @@ void PoissonWindow::draw_toolbar()
             p_target_->restore();
         }
         add_tooltips("Replace the target image with back up data.");
+        ImGuiIO& io = ImGui::GetIO();
+        const bool shortcuts = io.KeyCtrl && !io.WantTextInput;
+        if ((ImGui::MenuItem("Undo", "Ctrl+Z") ||
+             (shortcuts && ImGui::IsKeyPressed(ImGuiKey_Z, false))) &&
+            p_target_)
+        {
+            p_target_->undo();
+        }
+        add_tooltips("Undo the last clone.");
+        if ((ImGui::MenuItem("Redo", "Ctrl+Y") ||
+             (shortcuts && ImGui::IsKeyPressed(ImGuiKey_Y, false))) &&
+            p_target_)
+        {
+            p_target_->redo();
+        }
+        add_tooltips("Redo the last undone clone.");
 
         ImGui::Separator();
 
@@ -114,6 +130,13 @@ void PoissonWindow::draw_toolbar()
             "seamless the selected region to the target image by mix_gradient method."
         );
 
+        // Saving runs in the background
+        if (p_target_ && p_target_->is_saving())
+        {
+            ImGui::Separator();
+            ImGui::TextUnformatted("Saving...");
+        }
+
         ImGui::EndMainMenuBar();
     }
 }
@@ -160,7 +183,10 @@ void PoissonWindow::draw_open_target_image_file_dialog()
     config.path = DATA_PATH;
     config.flags = ImGuiFileDialogFlags_Modal;
     ImGuiFileDialog::Instance()->OpenDialog(
-        "ChooseTargetOpenFileDlg", "Choose Image File", ".jpg,.png", config);
+        "ChooseTargetOpenFileDlg",
+        "Choose Image File",
+        ".jpg,.png,.qoi,.pam",
+        config);
     ImVec2 main_size = ImGui::GetMainViewport()->WorkSize;
     ImVec2 dlg_size(main_size.x / 2, main_size.y / 2);
     if (ImGuiFileDialog::Instance()->Display(
@@ -186,7 +212,10 @@ void PoissonWindow::draw_open_source_image_file_dialog()
     config.path = DATA_PATH;
     config.flags = ImGuiFileDialogFlags_Modal;
     ImGuiFileDialog::Instance()->OpenDialog(
-        "ChooseSourceOpenFileDlg", "Choose Image File", ".jpg,.png", config);
+        "ChooseSourceOpenFileDlg",
+        "Choose Image File",
+        ".jpg,.png,.qoi,.pam",
+        config);
     ImVec2 main_size = ImGui::GetMainViewport()->WorkSize;
     ImVec2 dlg_size(main_size.x / 2, main_size.y / 2);
     if (ImGuiFileDialog::Instance()->Display(
@@ -213,7 +242,10 @@ void PoissonWindow::draw_save_image_file_dialog()
     config.path = DATA_PATH;
     config.flags = ImGuiFileDialogFlags_Modal;
     ImGuiFileDialog::Instance()->OpenDialog(
-        "ChooseImageSaveFileDlg", "Save Image As...", ".jpg", config);
+        "ChooseImageSaveFileDlg",
+        "Save Image As...",
+        ".jpg,.png,.qoi,.pam",
+        config);
     ImVec2 main_size = ImGui::GetMainViewport()->WorkSize;
     ImVec2 dlg_size(main_size.x / 2, main_size.y / 2);
     if (ImGuiFileDialog::Instance()->Display(
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cmath>
 
+#include "common/parallel.h"
 #include "shapes/freehand.h"
 #include "shapes/rect.h"
 
@@ -15,17 +16,20 @@ SourceImageWidget::SourceImageWidget(
     const std::string& filename)
     : ImageWidget(label, filename)
 {
-    if (data_)
-        selected_region_mask_ =
-            std::make_shared<Image>(data_->width(), data_->height(), 1);
+}
+
+void SourceImageWidget::on_image_loaded()
+{
+    selected_region_mask_ =
+        std::make_shared<Image>(data_->width(), data_->height(), 1);
 }
 
 void SourceImageWidget::draw()
 {
     // Draw the image
     ImageWidget::draw();
-    // Draw selected region
-    if (flag_enable_selecting_region_)
+    // Draw selected region (the mask exists once the image is loaded)
+    if (flag_enable_selecting_region_ && is_loaded())
         select_region();
 }
 
@@ -153,26 +157,35 @@ void SourceImageWidget::update_selected_region()
     // their own get_interior_pixels()
     std::vector<std::pair<int, int>> interior_pixels =
         selected_shape_->get_interior_pixels();
+    Image& mask = *selected_region_mask_;
+    // Detach once here, not concurrently in the workers
+    uchar* const data = mask.data();
     // Clear the selected region mask
-    for (int i = 0; i < selected_region_mask_->width(); ++i)
-        for (int j = 0; j < selected_region_mask_->height(); ++j)
-            selected_region_mask_->set_pixel(i, j, { 0 });
-    // Set the selected pixels with 255
-    for (const auto& pixel : interior_pixels)
-    {
-        int x = pixel.first;
-        int y = pixel.second;
-        // 检查 x 和 y 是否在 selected_region_mask_ 的边界内
-        if (x >= 0 && x < selected_region_mask_->width() && y >= 0 &&
-            y < selected_region_mask_->height())
+    parallel_for(
+        mask.height(),
+        rows_grain(mask.width()),
+        [&](int y0, int y1)
         {
-            // Image::set_pixel 函数需要一个 std::vector<unsigned char>
-            // 类型的参数，而原始代码 {255} 只是一个初始化列表。
-            // 为了让类型匹配，需要显式地构造一个 std::vector<unsigned char>
-            // 对象。 由于图像只有一个通道，所以向量中只需要一个元素。
-            selected_region_mask_->set_pixel(
-                x, y, std::vector<unsigned char>{ 255 });
-        }
-    }
+            std::fill(data + y0 * mask.stride(), data + y1 * mask.stride(), 0);
+        });
+    // Set the selected pixels with 255. The shapes list each pixel once, so
+    // the tasks write disjoint bytes.
+    const int channels = mask.channels();
+    parallel_for(
+        static_cast<int>(interior_pixels.size()),
+        1 << 16,
+        [&](int begin, int end)
+        {
+            for (int i = begin; i < end; ++i)
+            {
+                const int x = interior_pixels[i].first;
+                const int y = interior_pixels[i].second;
+                // 检查 x 和 y 是否在 selected_region_mask_ 的边界内
+                if (x >= 0 && x < mask.width() && y >= 0 && y < mask.height())
+                {
+                    data[y * mask.stride() + x * channels] = 255;
+                }
+            }
+        });
 }
 }  // namespace USTC_CG
@@ -37,6 +37,9 @@ class SourceImageWidget : public ImageWidget
     // We return the start point of the selected region as default.
     ImVec2 get_position() const;
 
+   protected:
+    void on_image_loaded() override;
+
    private:
     // Event handlers for mouse interactions.
     void mouse_click_event();
@@ -1,6 +1,10 @@
 #include "target_image_widget.h"
 
+#include <algorithm>
 #include <cmath>
+#include <utility>
+
+#include "common/parallel.h"
 
 namespace USTC_CG
 {
@@ -11,8 +15,12 @@ TargetImageWidget::TargetImageWidget(
     const std::string& filename)
     : ImageWidget(label, filename)
 {
-    if (data_)
-        back_up_ = std::make_shared<Image>(*data_);
+}
+
+void TargetImageWidget::on_image_loaded()
+{
+    back_up_ = std::make_shared<Image>(*data_);
+    history_.reset(*data_);
 }
 
 void TargetImageWidget::draw()
@@ -63,10 +71,34 @@ void TargetImageWidget::set_mixgradient()
 
 void TargetImageWidget::restore()
 {
+    if (!is_loaded())
+        return;
+    // O(1): data_ shares the buffer of back_up_ until the next edit
     *data_ = *back_up_;
+    cloned_rect_ = {};
+    // Restoring can be undone too
+    history_.commit(*data_);
     update();
 }
 
+void TargetImageWidget::undo()
+{
+    if (!is_loaded() || edit_status_)
+        return;
+    const PixelRect rect = history_.undo(*data_);
+    if (!rect.empty())
+        update(rect);
+}
+
+void TargetImageWidget::redo()
+{
+    if (!is_loaded() || edit_status_)
+        return;
+    const PixelRect rect = history_.redo(*data_);
+    if (!rect.empty())
+        update(rect);
+}
+
 void TargetImageWidget::set_paste()
 {
     clone_type_ = kPaste;
@@ -91,34 +123,55 @@ void TargetImageWidget::clone()
     // The **value** of the mask should be 0 or 255: 0 for the background and
     // 255 for the selected region.
     std::shared_ptr<Image> mask = source_image_->get_region_mask();
+    // Region written by the previous clone, restored below
+    const PixelRect previous_rect = cloned_rect_;
+    const int offset_x = static_cast<int>(mouse_position_.x) -
+                         static_cast<int>(source_image_->get_position().x);
+    const int offset_y = static_cast<int>(mouse_position_.y) -
+                         static_cast<int>(source_image_->get_position().y);
 
     switch (clone_type_)
     {
         case USTC_CG::TargetImageWidget::kDefault: break;
         case USTC_CG::TargetImageWidget::kPaste:
         {
-            restore();
+            restore_cloned_region();
 
-            for (int x = 0; x < mask->width(); ++x)
-            {
-                for (int y = 0; y < mask->height(); ++y)
+            const std::shared_ptr<const Image> src = source_image_->get_data();
+            const int channels = data_->channels();
+            const int src_channels = src->channels();
+            const int copy_channels = std::min(channels, src_channels);
+            const Image& mask_image = *mask;
+            // Detach once here, not concurrently in the workers
+            uchar* const tar_data = data_->data();
+            const std::size_t tar_stride = data_->stride();
+            parallel_for(
+                mask_image.height(),
+                rows_grain(mask_image.width()),
+                [&](int y0, int y1)
                 {
-                    int tar_x =
-                        static_cast<int>(mouse_position_.x) + x -
-                        static_cast<int>(source_image_->get_position().x);
-                    int tar_y =
-                        static_cast<int>(mouse_position_.y) + y -
-                        static_cast<int>(source_image_->get_position().y);
-                    if (0 <= tar_x && tar_x < image_width_ && 0 <= tar_y &&
-                        tar_y < image_height_ && mask->get_pixel(x, y)[0] > 0)
+                    for (int y = y0; y < y1; ++y)
                     {
-                        data_->set_pixel(
-                            tar_x,
-                            tar_y,
-                            source_image_->get_data()->get_pixel(x, y));
+                        const int tar_y = y + offset_y;
+                        if (tar_y < 0 || tar_y >= image_height_)
+                            continue;
+                        const uchar* mask_row = mask_image.row(y);
+                        const uchar* src_row = src->row(y);
+                        uchar* tar_row = tar_data + tar_y * tar_stride;
+                        for (int x = 0; x < mask_image.width(); ++x)
+                        {
+                            const int tar_x = x + offset_x;
+                            if (0 <= tar_x && tar_x < image_width_ &&
+                                mask_row[x * mask_image.channels()] > 0)
+                            {
+                                std::copy_n(
+                                    src_row + x * src_channels,
+                                    copy_channels,
+                                    tar_row + tar_x * channels);
+                            }
+                        }
                     }
-                }
-            }
+                });
             break;
         }
         case USTC_CG::TargetImageWidget::kSeamlessType:
@@ -126,14 +179,10 @@ void TargetImageWidget::clone()
             // HW3_TODO: You should implement your own seamless cloning. For
             // each pixel in the selected region, calculate the final RGB color
             // by solving Poisson Equations.
-            restore();
+            restore_cloned_region();
 
             // 1. 获取源图像、mask图像、offset等参数
             auto src = source_image_->get_data();
-            int offset_x = static_cast<int>(mouse_position_.x) -
-                           static_cast<int>(source_image_->get_position().x);
-            int offset_y = static_cast<int>(mouse_position_.y) -
-                           static_cast<int>(source_image_->get_position().y);
 
             // 2. 创建 Seamless 对象，并调用其 solve() 函数
             Seamless seamless_clone(src, data_, mask, offset_x, offset_y);
@@ -147,14 +196,10 @@ void TargetImageWidget::clone()
 
         case USTC_CG::TargetImageWidget::kMixgradient:
         {
-            restore();
+            restore_cloned_region();
 
             // 1. 获取源图像、mask图像、offset等参数
             auto src = source_image_->get_data();
-            int offset_x = static_cast<int>(mouse_position_.x) -
-                           static_cast<int>(source_image_->get_position().x);
-            int offset_y = static_cast<int>(mouse_position_.y) -
-                           static_cast<int>(source_image_->get_position().y);
 
             // 2. 创建 Seamless 对象，并调用其 solve() 函数
             MixGradient mixgradient_clone(src, data_, mask, offset_x, offset_y);
@@ -167,8 +212,29 @@ void TargetImageWidget::clone()
         }
         default: break;
     }
+    if (clone_type_ != kDefault)
+    {
+        // Only this region differs from the recorded state now
+        PixelRect bounds = mask_bounds(*mask);
+        bounds = { bounds.x0 + offset_x,
+                   bounds.y0 + offset_y,
+                   bounds.x1 + offset_x,
+                   bounds.y1 + offset_y };
+        cloned_rect_ =
+            bounds.intersected({ 0, 0, image_width_, image_height_ });
+    }
 
-    update();
+    // Only the restored and the newly cloned regions changed
+    update(previous_rect.united(cloned_rect_));
+}
+
+void TargetImageWidget::restore_cloned_region()
+{
+    // data_ and the recorded state only differ inside the region of the
+    // last clone, so copying it back is enough. This avoids a full-frame
+    // copy per clone in realtime mode.
+    data_->copy_region_from(history_.current(), cloned_rect_);
+    cloned_rect_ = {};
 }
 
 void TargetImageWidget::mouse_click_event()
@@ -193,6 +259,10 @@ void TargetImageWidget::mouse_release_event()
     if (edit_status_)
     {
         edit_status_ = false;
+        // One step per click, however many times the clone was redone while
+        // dragging. The next clone starts from the result.
+        history_.commit(*data_, cloned_rect_);
+        cloned_rect_ = {};
     }
 }
 
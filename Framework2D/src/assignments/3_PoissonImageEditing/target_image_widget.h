@@ -2,6 +2,7 @@
 
 #include "source_image_widget.h"
 #include "common/image_widget.h"
+#include "common/undo_history.h"
 #include "CloneMethods/Seamless.h"
 #include "CloneMethods/Mixgradient.h"
 
@@ -34,6 +35,10 @@ class TargetImageWidget : public ImageWidget
     void set_realtime(bool flag);
     // Restore the target image
     void restore();
+    // Step through the recorded clones. A clone is recorded when the mouse
+    // is released.
+    void undo();
+    void redo();
     // HW3_TODO: Add more types of cloning, we have implemented the "Paste"
     // type, you can implement seamless cloning, mix-gradient cloning, etc.
     void set_paste();
@@ -43,6 +48,9 @@ class TargetImageWidget : public ImageWidget
     // The clone function
     void clone();
 
+   protected:
+    void on_image_loaded() override;
+
    private:
     // Event handlers for mouse interactions.
     void mouse_click_event();
@@ -52,8 +60,16 @@ class TargetImageWidget : public ImageWidget
     // Calculates mouse's relative position in the canvas.
     ImVec2 mouse_pos_in_canvas() const;
 
+    // Undo the clone not recorded yet by copying its region back from the
+    // recorded state
+    void restore_cloned_region();
+
     // Store the original image data
     std::shared_ptr<Image> back_up_;
+    // Recorded clones
+    UndoHistory history_;
+    // Region of data_ written by the clone not recorded yet (empty if none)
+    PixelRect cloned_rect_;
     // Source image
     std::shared_ptr<SourceImageWidget> source_image_;
     CloneType clone_type_ = kDefault;
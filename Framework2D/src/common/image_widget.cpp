@@ -1,45 +1,54 @@
 #include "common/image_widget.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <stdexcept>
 
-#define STB_IMAGE_IMPLEMENTATION
+#include "common/image_io.h"
+#include "common/image_saver.h"
+#include "common/profiler.h"
+#include "common/window.h"
 #include "iostream"
-#include "stb_image.h"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
 
 namespace USTC_CG
 {
+namespace
+{
+// Upper bound of the bytes streamed per frame while a new image is uploaded
+constexpr std::size_t kStreamBytesPerFrame = std::size_t(8) << 20;
+}  // namespace
+
 ImageWidget::ImageWidget(const std::string& label, const std::string& filename)
     : filename_(filename),
       Widget(label)
 {
     glGenTextures(1, &tex_id_);
-    auto image_data =
-        stbi_load(filename.c_str(), &image_width_, &image_height_, NULL, 4);
-    if (image_data == nullptr)
-    {
-        std::cout << "Failed to load image from file " << filename << std::endl;
-        data_ = std::make_shared<Image>(image_width_, image_height_, 4);
-    }
-    else
-    {
-        std::cout << "Successfully load image from file " << filename
-                  << std::endl;
-        std::unique_ptr<unsigned char[]> tmp(image_data);
-        data_ = std::make_shared<Image>(
-            image_width_, image_height_, 4, std::move(tmp));
-    }
-    load_gltexture();
+    glGenBuffers(2, pbo_ids_);
+    // Only the header is read here, so that the layout is known right away
+    int channels = 0;
+    if (!read_image_info(filename, image_width_, image_height_, channels))
+        image_width_ = image_height_ = 0;
+    // Wake up an idle window when the pixels are ready
+    pending_load_ = ImageLoader::instance().load(
+        filename,
+        [](const ImageLoader::Result&) { Window::request_redraw(); });
 }
 
 ImageWidget::~ImageWidget()
 {
+    glDeleteTextures(1, &preview_tex_id_);
+    glDeleteTextures(1, &overlay_tex_id_);
+    glDeleteBuffers(2, pbo_ids_);
     glDeleteTextures(1, &tex_id_);
 }
 
 void ImageWidget::draw()
 {
+    poll_loading();
+    poll_saving();
+    stream_texture();
+    load_gltexture();
     draw_image();
 }
 
@@ -53,76 +62,361 @@ ImVec2 ImageWidget::get_image_size() const
     return ImVec2((float)image_width_, (float)image_height_);
 }
 
+bool ImageWidget::is_loaded() const
+{
+    return data_ != nullptr;
+}
+
 void ImageWidget::update()
 {
+    if (data_)
+    {
+        // Everything is uploaded now, so progressive streaming is over
+        stream_row_ = data_->height();
+        update({ 0, 0, data_->width(), data_->height() });
+    }
+}
+
+void ImageWidget::update(const PixelRect& rect)
+{
+    mark_dirty(rect);
     load_gltexture();
 }
 
-void ImageWidget::save_to_disk(const std::string& filename)
+void ImageWidget::mark_dirty(const PixelRect& rect)
 {
-    if (data_)
+    dirty_rect_ = dirty_rect_.united(rect);
+}
+
+void ImageWidget::show_overlay(const Image& overlay, int first_row)
+{
+    GLenum format;
+    if (overlay.channels() == 3)
+        format = GL_RGB;
+    else if (overlay.channels() == 4)
+        format = GL_RGBA;
+    else
+        throw std::runtime_error("Unsupported number of channels");
+    if (!overlay_tex_id_)
     {
-        stbi_write_png(
-            filename.c_str(),
-            data_->width(),
-            data_->height(),
-            data_->channels(),
-            data_->data(),
-            data_->width() * data_->channels());
+        glGenTextures(1, &overlay_tex_id_);
+        glBindTexture(GL_TEXTURE_2D, overlay_tex_id_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     }
+    // Small enough to be uploaded at once
+    glBindTexture(GL_TEXTURE_2D, overlay_tex_id_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        format,
+        overlay.width(),
+        overlay.height(),
+        0,
+        format,
+        GL_UNSIGNED_BYTE,
+        overlay.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    overlay_row_ = first_row;
 }
 
-void ImageWidget::load_gltexture()
+void ImageWidget::set_overlay_row(int first_row)
 {
-    glBindTexture(GL_TEXTURE_2D, tex_id_);
+    overlay_row_ = first_row;
+}
 
-    // Setup filtering parameters for display
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void ImageWidget::hide_overlay()
+{
+    if (overlay_tex_id_)
+    {
+        glDeleteTextures(1, &overlay_tex_id_);
+        overlay_tex_id_ = 0;
+    }
+}
 
-    // Upload pixels into texture (different type of channels)
-    if (data_->channels() == 3)
+std::size_t ImageWidget::last_upload_bytes() const
+{
+    return last_upload_bytes_;
+}
+
+void ImageWidget::save_to_disk(const std::string& filename)
+{
+    if (!data_)
+        return;
+    // O(1): the saver shares the pixels of data_, and later edits copy them
+    pending_saves_.emplace_back(
+        filename,
+        ImageSaver::instance().save(
+            filename,
+            *data_,
+            [](bool) { Window::request_redraw(); }));
+}
+
+bool ImageWidget::is_saving() const
+{
+    return !pending_saves_.empty();
+}
+
+void ImageWidget::poll_saving()
+{
+    auto done = [](std::pair<std::string, std::future<void>>& save)
+    {
+        if (save.second.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready)
+            return false;
+        try
+        {
+            save.second.get();
+            std::cout << "Successfully save image to file " << save.first
+                      << std::endl;
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << e.what() << std::endl;
+        }
+        return true;
+    };
+    pending_saves_.erase(
+        std::remove_if(pending_saves_.begin(), pending_saves_.end(), done),
+        pending_saves_.end());
+}
+
+void ImageWidget::poll_loading()
+{
+    if (!pending_load_.valid() ||
+        pending_load_.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready)
+        return;
+
+    ImageLoader::Result result;
+    try
+    {
+        result = pending_load_.get();
+    }
+    catch (const std::exception& e)
     {
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        std::cout << e.what() << std::endl;
+    }
+    if (result.image == nullptr)
+    {
+        data_ = std::make_shared<Image>(image_width_, image_height_, 4);
+    }
+    else
+    {
+        std::cout << "Successfully load image from file " << filename_
+                  << std::endl;
+        data_ = result.image;
+        image_width_ = data_->width();
+        image_height_ = data_->height();
+    }
+
+    // Show the preview at once, and stream the full resolution afterwards
+    allocate_gltexture();
+    stream_row_ = 0;
+    if (result.preview)
+    {
+        const Image& preview = *result.preview;
+        glGenTextures(1, &preview_tex_id_);
+        glBindTexture(GL_TEXTURE_2D, preview_tex_id_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexImage2D(
             GL_TEXTURE_2D,
             0,
-            GL_RGB,
-            image_width_,
-            image_height_,
+            GL_RGBA,
+            preview.width(),
+            preview.height(),
             0,
-            GL_RGB,
+            GL_RGBA,
             GL_UNSIGNED_BYTE,
-            data_->data());
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 4); 
+            preview.data());
     }
-    else if (data_->channels() == 4)
+
+    on_image_loaded();
+}
+
+void ImageWidget::stream_texture()
+{
+    if (!data_ || stream_row_ >= data_->height())
     {
-        glTexImage2D(
+        if (preview_tex_id_)
+        {
+            glDeleteTextures(1, &preview_tex_id_);
+            preview_tex_id_ = 0;
+        }
+        return;
+    }
+    const int rows = static_cast<int>(std::max<std::size_t>(
+        1, kStreamBytesPerFrame / std::max<std::size_t>(1, data_->stride())));
+    const int end = std::min(data_->height(), stream_row_ + rows);
+    mark_dirty({ 0, stream_row_, data_->width(), end });
+    stream_row_ = end;
+    // Keep drawing until the last band is in, then once more to drop the
+    // preview
+    Window::request_redraw();
+}
+
+void ImageWidget::allocate_gltexture()
+{
+    const Image& image = *data_;
+    GLenum format;
+    if (image.channels() == 3)
+        format = GL_RGB;
+    else if (image.channels() == 4)
+        format = GL_RGBA;
+    else
+        throw std::runtime_error("Unsupported number of channels");
+
+    glBindTexture(GL_TEXTURE_2D, tex_id_);
+
+    // Setup filtering parameters for display
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Storage only, the pixels are streamed by load_gltexture()
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        format,
+        image.width(),
+        image.height(),
+        0,
+        format,
+        GL_UNSIGNED_BYTE,
+        nullptr);
+
+    tex_width_ = image.width();
+    tex_height_ = image.height();
+    tex_channels_ = image.channels();
+}
+
+void ImageWidget::load_gltexture()
+{
+    static const ProfileStage upload_stage("frame/texture_upload");
+    static const ProfileStage bytes_stage(
+        "frame/texture_upload_bytes", Profiler::Kind::kCounter);
+
+    if (!data_)
+        return;
+    // Read through a const reference so that a buffer shared with a backup
+    // is not copied just for the upload.
+    const Image& image = *data_;
+    if (image.width() != tex_width_ || image.height() != tex_height_ ||
+        image.channels() != tex_channels_)
+    {
+        allocate_gltexture();
+        dirty_rect_ = { 0, 0, tex_width_, tex_height_ };
+    }
+
+    const PixelRect rect =
+        dirty_rect_.intersected({ 0, 0, tex_width_, tex_height_ });
+    dirty_rect_ = {};
+    if (rect.empty())
+        return;
+
+    ProfileScope scope(upload_stage);
+    const GLenum format = tex_channels_ == 3 ? GL_RGB : GL_RGBA;
+    const std::size_t row_bytes =
+        static_cast<std::size_t>(rect.width()) * tex_channels_;
+    const std::size_t bytes = row_bytes * rect.height();
+    const std::size_t offset =
+        static_cast<std::size_t>(rect.x0) * tex_channels_;
+
+    glBindTexture(GL_TEXTURE_2D, tex_id_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Pack the dirty rows into the next pixel buffer. Re-specifying its
+    // storage first lets the driver hand out fresh memory instead of waiting
+    // for a transfer that still reads the old one.
+    pbo_index_ = 1 - pbo_index_;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_ids_[pbo_index_]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    auto* dst = static_cast<unsigned char*>(glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER,
+        0,
+        bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (dst)
+    {
+        for (int y = rect.y0; y < rect.y1; ++y)
+            std::memcpy(
+                dst + (y - rect.y0) * row_bytes,
+                image.row(y) + offset,
+                row_bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glTexSubImage2D(
             GL_TEXTURE_2D,
             0,
-            GL_RGBA,
-            image_width_,
-            image_height_,
-            0,
-            GL_RGBA,
+            rect.x0,
+            rect.y0,
+            rect.width(),
+            rect.height(),
+            format,
             GL_UNSIGNED_BYTE,
-            data_->data());
+            nullptr);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
     }
     else
     {
-        throw std::runtime_error("Unsupported number of channels");
+        // Mapping failed: upload straight from client memory
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, tex_width_);
+        glTexSubImage2D(
+            GL_TEXTURE_2D,
+            0,
+            rect.x0,
+            rect.y0,
+            rect.width(),
+            rect.height(),
+            format,
+            GL_UNSIGNED_BYTE,
+            image.row(rect.y0) + offset);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    last_upload_bytes_ = bytes;
+    profile_count(bytes_stage, static_cast<double>(bytes));
 }
 
 void ImageWidget::draw_image()
 {
     auto draw_list = ImGui::GetWindowDrawList();
+    ImVec2 p_min = position_;
+    ImVec2 p_max = ImVec2(p_min.x + image_width_, p_min.y + image_height_);
     if (data_)
     {
-        ImVec2 p_min = position_;
-        ImVec2 p_max = ImVec2(p_min.x + image_width_, p_min.y + image_height_);
-        draw_list->AddImage((intptr_t)tex_id_, p_min, p_max);
+        // The preview covers the rows that are not streamed yet
+        if (preview_tex_id_)
+            draw_list->AddImage((intptr_t)preview_tex_id_, p_min, p_max);
+        const float loaded =
+            image_height_ > 0 ? float(stream_row_) / image_height_ : 1.0f;
+        draw_list->AddImage(
+            (intptr_t)tex_id_,
+            p_min,
+            ImVec2(p_max.x, p_min.y + loaded * image_height_),
+            ImVec2(0, 0),
+            ImVec2(1, std::min(loaded, 1.0f)));
+        // The overlay hides the rows below its top
+        if (overlay_tex_id_ && overlay_row_ < image_height_)
+        {
+            const float top = float(overlay_row_) / image_height_;
+            draw_list->AddImage(
+                (intptr_t)overlay_tex_id_,
+                ImVec2(p_min.x, p_min.y + overlay_row_),
+                p_max,
+                ImVec2(0, top),
+                ImVec2(1, 1));
+        }
+    }
+    else
+    {
+        // Placeholder while the file is decoded
+        draw_list->AddRectFilled(p_min, p_max, IM_COL32(64, 64, 64, 255));
+        draw_list->AddText(
+            ImVec2(p_min.x + 8, p_min.y + 8),
+            IM_COL32(255, 255, 255, 255),
+            "Loading...");
     }
 }
 }  // namespace USTC_CG
\ No newline at end of file
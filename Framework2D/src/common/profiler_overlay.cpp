@@ -0,0 +1,123 @@
+#include "common/profiler_overlay.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+
+#include "common/profiler.h"
+
+namespace USTC_CG
+{
+void ProfilerOverlay::draw(bool* open)
+{
+    Profiler& profiler = Profiler::instance();
+    Profiler::set_enabled(*open || profiler.dumping());
+    if (!*open)
+        return;
+
+    ImGui::SetNextWindowSize(ImVec2(420, 520), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    const auto& history = profiler.history();
+    if (history.empty())
+    {
+        ImGui::TextUnformatted("No frame recorded yet.");
+        draw_dump_controls();
+        ImGui::End();
+        return;
+    }
+
+    const ImVec2 plot_size(ImGui::GetContentRegionAvail().x, 40);
+    auto plot = [&](const char* label, double last, const char* unit)
+    {
+        float max_value = 0;
+        double sum = 0;
+        for (float value : samples_)
+        {
+            max_value = std::max(max_value, value);
+            sum += value;
+        }
+        ImGui::Text(
+            "%s: last %.3g%s, mean %.3g%s, max %.3g%s",
+            label,
+            last,
+            unit,
+            sum / samples_.size(),
+            unit,
+            double(max_value),
+            unit);
+        ImGui::PushID(label);
+        ImGui::PlotHistogram(
+            "",
+            samples_.data(),
+            static_cast<int>(samples_.size()),
+            0,
+            nullptr,
+            0.0f,
+            max_value,
+            plot_size);
+        ImGui::PopID();
+    };
+
+    samples_.clear();
+    for (const auto& frame : history)
+        samples_.push_back(static_cast<float>(frame.ms));
+    plot("frame", history.back().ms, " ms");
+    ImGui::Text(
+        "%zu frames, %llu events dropped",
+        history.size(),
+        static_cast<unsigned long long>(profiler.dropped_events()));
+    ImGui::Separator();
+
+    const std::vector<Profiler::Stage> stages = profiler.stages();
+    for (std::size_t stage = 0; stage < stages.size(); ++stage)
+    {
+        samples_.clear();
+        bool recorded = false;
+        for (const auto& frame : history)
+        {
+            const bool has = stage < frame.values.size();
+            recorded = recorded || (has && frame.calls[stage] > 0);
+            samples_.push_back(
+                has ? static_cast<float>(frame.values[stage]) : 0.0f);
+        }
+        if (!recorded)
+            continue;
+        const bool timer = stages[stage].kind == Profiler::Kind::kTimer;
+        plot(
+            stages[stage].name.c_str(),
+            samples_.back(),
+            timer ? " ms" : "");
+    }
+
+    ImGui::Separator();
+    draw_dump_controls();
+    ImGui::End();
+}
+
+void ProfilerOverlay::draw_dump_controls()
+{
+    Profiler& profiler = Profiler::instance();
+    ImGui::InputText("File", dump_path_, sizeof(dump_path_));
+    if (!profiler.dumping())
+    {
+        if (ImGui::Button("Start dump"))
+        {
+            dump_status_ = profiler.start_dump(dump_path_)
+                               ? std::string("Dumping to ") + dump_path_
+                               : std::string("Cannot open ") + dump_path_;
+        }
+    }
+    else if (ImGui::Button("Stop dump"))
+    {
+        profiler.stop_dump();
+        dump_status_ = std::string("Saved ") + dump_path_;
+    }
+    if (!dump_status_.empty())
+        ImGui::TextUnformatted(dump_status_.c_str());
+}
+}  // namespace USTC_CG
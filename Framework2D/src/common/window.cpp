@@ -4,10 +4,17 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include <algorithm>
+#include <ctime>
 #include <iostream>
 
+#include "common/profiler.h"
+
 namespace USTC_CG
 {
+std::atomic<int> Window::pending_frames_{ 1 };
+std::atomic<bool> Window::waiting_{ false };
+
 Window::Window(const std::string& window_name) : name_(window_name)
 {
     if (!init_glfw())
@@ -50,20 +57,93 @@ bool Window::init()
 void Window::run()
 {
     glfwShowWindow(window_);
+    request_redraw(kFramesPerEvent);
 
+    const std::clock_t cpu_start = std::clock();
     while (!glfwWindowShouldClose(window_))
     {
         if (!glfwGetWindowAttrib(window_, GLFW_VISIBLE) ||
             glfwGetWindowAttrib(window_, GLFW_ICONIFIED))
+        {
             glfwWaitEvents();
-        else
+            request_redraw(kFramesPerEvent);
+        }
+        else if (
+            render_mode_ == RenderMode::kContinuous ||
+            pending_frames_.load() > 0)
         {
             glfwPollEvents();
+            if (pending_frames_.load() > 0)
+                pending_frames_.fetch_sub(1);
             render();
+            ++render_stats_.frames;
         }
+        else
+        {
+            // Nothing to draw: sleep until an event, an empty event posted
+            // by request_redraw(), or the timeout. Returning early means
+            // something happened, so draw again.
+            waiting_.store(true);
+            if (pending_frames_.load() > 0)
+            {
+                // Requested between the check above and now
+                waiting_.store(false);
+                continue;
+            }
+            const double start = glfwGetTime();
+            glfwWaitEventsTimeout(kIdleTimeout);
+            const double waited = glfwGetTime() - start;
+            waiting_.store(false);
+            render_stats_.wait_seconds += waited;
+            ++render_stats_.wakeups;
+            // (with some slack, the timeout has a coarse resolution)
+            if (waited < 0.9 * kIdleTimeout)
+                request_redraw(kFramesPerEvent);
+        }
+        render_stats_.cpu_seconds =
+            double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
     }
 }
 
+void Window::set_render_mode(RenderMode mode)
+{
+    render_mode_ = mode;
+    request_redraw(kFramesPerEvent);
+}
+
+Window::RenderMode Window::render_mode() const
+{
+    return render_mode_;
+}
+
+const Window::RenderStats& Window::render_stats() const
+{
+    return render_stats_;
+}
+
+void Window::request_redraw(int frames)
+{
+    int current = pending_frames_.load();
+    while (current < frames &&
+           !pending_frames_.compare_exchange_weak(current, frames))
+    {
+    }
+    // Wakes up the loop if it is blocked in glfwWaitEventsTimeout()
+    if (waiting_.load())
+        glfwPostEmptyEvent();
+}
+
+void Window::set_profiler_visible(bool visible)
+{
+    show_profiler_ = visible;
+    request_redraw(kFramesPerEvent);
+}
+
+bool Window::profiler_visible() const
+{
+    return show_profiler_;
+}
+
 void Window::draw()
 {
     // Placeholder for custom draw logic, should be overridden in derived
@@ -128,22 +208,50 @@ bool Window::init_gui()
 
 void Window::render()
 {
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
+    static const ProfileStage new_frame_stage("frame/new_frame");
+    static const ProfileStage draw_stage("frame/draw");
+    static const ProfileStage imgui_render_stage("frame/imgui_render");
+    static const ProfileStage gl_render_stage("frame/gl_render");
+    // Includes the wait for vsync, and the GL commands queued above
+    static const ProfileStage swap_stage("frame/swap");
 
-    draw();
+    Profiler& profiler = Profiler::instance();
+    profiler.begin_frame();
+    {
+        ProfileScope scope(new_frame_stage);
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+    }
 
-    ImGui::Render();
+    {
+        ProfileScope scope(draw_stage);
+        draw();
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_F12, false))
+        show_profiler_ = !show_profiler_;
+    profiler_overlay_.draw(&show_profiler_);
 
-    glfwGetFramebufferSize(window_, &width_, &height_);
-    glViewport(0, 0, width_, height_);
-    glClearColor(0.35f, 0.45f, 0.50f, 1.00f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    {
+        ProfileScope scope(imgui_render_stage);
+        ImGui::Render();
+    }
 
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    {
+        ProfileScope scope(gl_render_stage);
+        glfwGetFramebufferSize(window_, &width_, &height_);
+        glViewport(0, 0, width_, height_);
+        glClearColor(0.35f, 0.45f, 0.50f, 1.00f);
+        glClear(GL_COLOR_BUFFER_BIT);
 
-    glfwSwapBuffers(window_);
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
+
+    {
+        ProfileScope scope(swap_stage);
+        glfwSwapBuffers(window_);
+    }
+    profiler.end_frame();
 }
 
 }  // namespace USTC_CG
\ No newline at end of file
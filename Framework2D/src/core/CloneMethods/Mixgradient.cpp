@@ -4,7 +4,8 @@
 #include <iostream>
 #include <stdexcept>
 
-#include "Log.h"
+#include "common/Log.h"
+#include "common/profiler.h"
 
 namespace USTC_CG
 {
@@ -15,9 +16,9 @@ void MixGradient::build_poisson_equation()
 {
     // TODO: 实现 Mix Gradient 的泊松方程构建
     // 在这里实现你的 Mix Gradient 特定的泊松方程构建逻辑
-    const auto& src = get_source_image();
-    const auto& mask = get_mask();
-    const auto& tar = get_target_image();
+    const std::shared_ptr<const Image> src = get_source_image();
+    const std::shared_ptr<const Image> mask = get_mask();
+    const std::shared_ptr<const Image> tar = get_target_image();
     const int width = mask->width();
     const int height = mask->height();
 
@@ -32,11 +33,13 @@ void MixGradient::build_poisson_equation()
 
     index_map.clear();
     int index = 0;
+    const int mask_channels = mask->channels();
     for (int y = 0; y < height; ++y)
     {
+        const unsigned char* mask_row = mask->row(y);
         for (int x = 0; x < width; ++x)
         {
-            if (mask->get_pixel(x, y)[0] > 128)
+            if (mask_row[x * mask_channels] > 128)
             {
                 index_map[y * width + x] = index++;
             }
@@ -86,10 +89,11 @@ void MixGradient::build_poisson_equation()
                 // neighbor not in the mask
                 else
                 {
+                    const auto tar_pixel = tar->pixel(
+                        nx + get_offset_x(), ny + get_offset_y());
                     for (int c = 0; c < 3; ++c)
                     {
-                        b_(i, c) += tar->get_pixel(
-                            nx + get_offset_x(), ny + get_offset_y())[c];
+                        b_(i, c) += tar_pixel[c];
                     }
                 }
                 neighbor_count++;
@@ -99,28 +103,29 @@ void MixGradient::build_poisson_equation()
         triplets.emplace_back(i, i, neighbor_count);
 
         // consider the gradient of src image
-        for (int c = 0; c < 3; ++c)
+        const auto src_pixel = src->pixel(x, y);
+        const auto tar_pixel =
+            tar->pixel(x + get_offset_x(), y + get_offset_y());
+        for (const auto& [nx, ny] : neighbors)
         {
-            const double src_val = src->get_pixel(x, y)[c];
-            const double tar_val =
-                tar->get_pixel(x + get_offset_x(), y + get_offset_y())[c];
-            for (const auto& [nx, ny] : neighbors)
+            if (nx >= 0 && nx < width && ny >= 0 && ny < height)
             {
-                if (nx >= 0 && nx < width && ny >= 0 && ny < height)
+                const auto src_neighbor = src->pixel(nx, ny);
+                const auto tar_neighbor =
+                    tar->pixel(nx + get_offset_x(), ny + get_offset_y());
+                for (int c = 0; c < 3; ++c)
                 {
-                    if (std::abs(
-                            tar_val -
-                            tar->get_pixel(
-                                nx + get_offset_x(), ny + get_offset_y())[c]) >
-                        std::abs(src_val - src->get_pixel(nx, ny)[c]))
+                    const double src_grad =
+                        static_cast<double>(src_pixel[c]) - src_neighbor[c];
+                    const double tar_grad =
+                        static_cast<double>(tar_pixel[c]) - tar_neighbor[c];
+                    if (std::abs(tar_grad) > std::abs(src_grad))
                     {
-                        b_(i, c) += tar_val - tar->get_pixel(
-                                                  nx + get_offset_x(),
-                                                  ny + get_offset_y())[c];
+                        b_(i, c) += tar_grad;
                     }
                     else
                     {
-                        b_(i, c) += src_val - src->get_pixel(nx, ny)[c];
+                        b_(i, c) += src_grad;
                     }
                 }
             }
@@ -142,6 +147,10 @@ void MixGradient::build_poisson_equation()
 
 std::shared_ptr<Image> MixGradient::solve()
 {
+    static const ProfileStage solve_stage("poisson/mixgradient");
+    static const ProfileStage factorize_stage("poisson/factorize");
+    ProfileScope scope(solve_stage);
+
     // TODO: 实现 Mix Gradient 的 solve 算法
     // 在这里实现你的 Mix Gradient 特定的求解逻辑
     logger.setLogLevel(LogLevel::Info);
@@ -155,6 +164,7 @@ std::shared_ptr<Image> MixGradient::solve()
 
     if (!matrix_precomputed_)
     {
+        ProfileScope factorize_scope(factorize_stage);
         build_poisson_equation();
         precompute_matrix();
         matrix_precomputed_ = true;
@@ -2,7 +2,7 @@
 
 #include "Seamless.h"
 #include "clonemethod.h"
-#include "common/image_widget.h"
+#include "common/image.h"
 
 namespace USTC_CG {
 
@@ -18,7 +18,7 @@ public:
 
     std::shared_ptr<Image> solve() override;
 
-private:
+protected:
     void build_poisson_equation() override;
 };
 
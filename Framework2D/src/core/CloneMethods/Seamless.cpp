@@ -4,7 +4,8 @@
 #include <iostream>
 #include <stdexcept>
 
-#include "Log.h"
+#include "common/Log.h"
+#include "common/profiler.h"
 
 namespace USTC_CG
 {
@@ -13,6 +14,10 @@ using uchar = unsigned char;
 
 std::shared_ptr<Image> Seamless::solve()
 {
+    static const ProfileStage solve_stage("poisson/seamless");
+    static const ProfileStage factorize_stage("poisson/factorize");
+    ProfileScope scope(solve_stage);
+
     logger.setLogLevel(LogLevel::Info);
 
     auto result = get_target_image();
@@ -24,6 +29,7 @@ std::shared_ptr<Image> Seamless::solve()
 
     if (!matrix_precomputed_)
     {
+        ProfileScope factorize_scope(factorize_stage);
         build_poisson_equation();
         precompute_matrix();
         matrix_precomputed_ = true;
@@ -81,14 +87,12 @@ void Seamless::solve_channel(int channel)
         if (target_x >= 0 && target_x < target_width && target_y >= 0 &&
             target_y < target_height)
         {
-            auto pixel = result->get_pixel(target_x, target_y);
+            const auto pixel = result->pixel(target_x, target_y);
             const double solved_value = x[i];
 
             // 带溢出保护的数值转换
             pixel[channel] =
                 static_cast<uchar>(std::clamp(solved_value, 0.0, 255.0));
-
-            result->set_pixel(target_x, target_y, pixel);
             valid_count++;
         }
         else
@@ -107,8 +111,9 @@ void Seamless::solve_channel(int channel)
 
 void Seamless::build_poisson_equation()
 {
-    const auto& src = get_source_image();
-    const auto& mask = get_mask();
+    const std::shared_ptr<const Image> src = get_source_image();
+    const std::shared_ptr<const Image> tar = get_target_image();
+    const std::shared_ptr<const Image> mask = get_mask();
     const int width = mask->width();
     const int height = mask->height();
 
@@ -123,11 +128,13 @@ void Seamless::build_poisson_equation()
 
     index_map.clear();
     int index = 0;
+    const int mask_channels = mask->channels();
     for (int y = 0; y < height; ++y)
     {
+        const unsigned char* mask_row = mask->row(y);
         for (int x = 0; x < width; ++x)
         {
-            if (mask->get_pixel(x, y)[0] > 128)
+            if (mask_row[x * mask_channels] > 128)
             {
                 index_map[y * width + x] = index++;
             }
@@ -177,10 +184,11 @@ void Seamless::build_poisson_equation()
                 // neighbor not in the mask
                 else
                 {
+                    const auto tar_pixel = tar->pixel(
+                        nx + get_offset_x(), ny + get_offset_y());
                     for (int c = 0; c < 3; ++c)
                     {
-                        b_(i, c) += get_target_image()->get_pixel(
-                            nx + get_offset_x(), ny + get_offset_y())[c];
+                        b_(i, c) += tar_pixel[c];
                     }
                 }
                 neighbor_count++;
@@ -190,15 +198,20 @@ void Seamless::build_poisson_equation()
         triplets.emplace_back(i, i, neighbor_count);
 
         // consider the gradient of src image
+        const auto src_pixel = src->pixel(x, y);
         for (int c = 0; c < 3; ++c)
         {
-            const double src_val = src->get_pixel(x, y)[c];
+            const double src_val = src_pixel[c];
             b_(i, c) += neighbor_count * src_val;
-            for (const auto& [nx, ny] : neighbors)
+        }
+        for (const auto& [nx, ny] : neighbors)
+        {
+            if (nx >= 0 && nx < width && ny >= 0 && ny < height)
             {
-                if (nx >= 0 && nx < width && ny >= 0 && ny < height)
+                const auto src_neighbor = src->pixel(nx, ny);
+                for (int c = 0; c < 3; ++c)
                 {
-                    b_(i, c) -= src->get_pixel(nx, ny)[c];
+                    b_(i, c) -= src_neighbor[c];
                 }
             }
         }
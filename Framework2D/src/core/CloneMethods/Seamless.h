@@ -1,8 +1,11 @@
 #pragma once
 
+#include <memory>
+#include <unordered_map>
+
 #include "Eigen/Sparse"
 #include "clonemethod.h"
-#include "common/image_widget.h"
+#include "common/image.h"
 
 namespace USTC_CG
 {
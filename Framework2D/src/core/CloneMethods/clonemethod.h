@@ -0,0 +1,105 @@
+#pragma once
+#include "common/image.h"
+#include "common/tiled_image.h"
+
+namespace USTC_CG
+{
+class CloneMethod
+{
+   public:
+    CloneMethod(
+        std::shared_ptr<Image> src,
+        std::shared_ptr<Image> dst,
+        std::shared_ptr<Image> mask,
+        int offset_x,
+        int offset_y)
+        : src_img_(src),
+          tar_img_(dst),
+          src_selected_mask(mask),
+          offset_x_(offset_x),
+          offset_y_(offset_y)
+    {
+    }
+    virtual ~CloneMethod() = default;
+    virtual std::shared_ptr<Image> solve() = 0;
+
+   public:
+    std::shared_ptr<Image> get_source_image() const
+    {
+        return src_img_;
+    }
+    std::shared_ptr<Image> get_target_image() const
+    {
+        return tar_img_;
+    }
+    std::shared_ptr<Image> get_mask() const
+    {
+        return src_selected_mask;
+    }
+    int get_offset_x() const
+    {
+        return offset_x_;
+    }
+    int get_offset_y() const
+    {
+        return offset_y_;
+    }
+
+   private:
+    std::shared_ptr<Image> src_img_;
+    std::shared_ptr<Image> tar_img_;
+    std::shared_ptr<Image> src_selected_mask;
+
+    int offset_x_, offset_y_;
+
+};
+
+// Bounding box of the non-zero pixels of a mask
+inline PixelRect mask_bounds(const Image& mask)
+{
+    PixelRect bounds{ mask.width(), mask.height(), 0, 0 };
+    for (int y = 0; y < mask.height(); ++y)
+    {
+        const unsigned char* row = mask.row(y);
+        for (int x = 0; x < mask.width(); ++x)
+        {
+            if (row[x * mask.channels()] > 0)
+            {
+                bounds.x0 = std::min(bounds.x0, x);
+                bounds.x1 = std::max(bounds.x1, x + 1);
+                bounds.y0 = std::min(bounds.y0, y);
+                bounds.y1 = std::max(bounds.y1, y + 1);
+            }
+        }
+    }
+    return bounds;
+}
+
+// Out-of-core cloning into a TiledImage target. Only the window covered by
+// the mask plus a one-pixel border (the Dirichlet boundary) is loaded into
+// memory, solved with `Method` and written back, so resident memory is
+// bounded by the size of the selection, not by the target.
+template<typename Method>
+void clone_into_tiled(
+    std::shared_ptr<Image> src,
+    TiledImage& target,
+    std::shared_ptr<Image> mask,
+    int offset_x,
+    int offset_y)
+{
+    const PixelRect bounds = mask_bounds(*mask);
+    if (bounds.empty())
+        return;
+    const PixelRect window =
+        PixelRect{ bounds.x0 + offset_x - 1,
+                   bounds.y0 + offset_y - 1,
+                   bounds.x1 + offset_x + 1,
+                   bounds.y1 + offset_y + 1 }
+            .intersected({ 0, 0, target.width(), target.height() });
+    auto roi = std::make_shared<Image>(target.read_region(window));
+    Method method(
+        src, roi, mask, offset_x - window.x0, offset_y - window.y0);
+    target.write_region(window, *method.solve());
+}
+
+}  // namespace USTC_CG
\ No newline at end of file
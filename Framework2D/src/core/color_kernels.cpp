@@ -0,0 +1,242 @@
+#include "color_kernels.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+
+#if defined(CG2D_SIMD_X86) && defined(_MSC_VER) && !defined(__clang__)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace USTC_CG
+{
+namespace color_kernels
+{
+namespace
+{
+void xor_pattern(uchar* row, std::size_t bytes, const uchar* pattern)
+{
+    scalar_xor_pattern(row, bytes, pattern);
+}
+void gray_rgb(uchar* row, std::size_t pixels, const GrayWeights& w)
+{
+    scalar_gray(row, pixels, 3, w);
+}
+void gray_rgba(uchar* row, std::size_t pixels, const GrayWeights& w)
+{
+    scalar_gray(row, pixels, 4, w);
+}
+void reverse_gray(uchar* row, std::size_t pixels)
+{
+    scalar_reverse(row, pixels, 1);
+}
+void reverse_rgb(uchar* row, std::size_t pixels)
+{
+    scalar_reverse(row, pixels, 3);
+}
+void reverse_rgba(uchar* row, std::size_t pixels)
+{
+    scalar_reverse(row, pixels, 4);
+}
+void swizzle_rgb(uchar* row, std::size_t pixels, const uchar* order)
+{
+    scalar_swizzle(row, pixels, 3, order);
+}
+void swizzle_rgba(uchar* row, std::size_t pixels, const uchar* order)
+{
+    scalar_swizzle(row, pixels, 4, order);
+}
+
+bool cpu_supports(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::kScalar: return true;
+#if defined(CG2D_SIMD_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+        case SimdLevel::kSse4:
+        {
+            int info[4];
+            __cpuid(info, 1);
+            return (info[2] & (1 << 19)) != 0;
+        }
+        case SimdLevel::kAvx2:
+        {
+            int info[4];
+            __cpuid(info, 1);
+            // AVX, and the OS saving the YMM registers
+            const bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+                             (_xgetbv(0) & 6) == 6;
+            __cpuidex(info, 7, 0);
+            return avx && (info[1] & (1 << 5));
+        }
+#else
+        case SimdLevel::kSse4:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.1");
+        case SimdLevel::kAvx2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+#endif
+#if defined(CG2D_SIMD_NEON)
+        // Part of the base ARMv8 instruction set
+        case SimdLevel::kNeon: return true;
+#endif
+        default: return false;
+    }
+}
+
+const Table* table_of(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::kSse4: return sse4_table();
+        case SimdLevel::kAvx2: return avx2_table();
+        case SimdLevel::kNeon: return neon_table();
+        default: return &scalar_table();
+    }
+}
+
+bool supported(SimdLevel level)
+{
+    return table_of(level) && cpu_supports(level);
+}
+
+// Best supported level that is not above `level`
+const Table& best_table(SimdLevel level)
+{
+    for (SimdLevel l : { SimdLevel::kNeon, SimdLevel::kAvx2, SimdLevel::kSse4 })
+    {
+        if (l <= level && supported(l))
+            return *table_of(l);
+    }
+    return scalar_table();
+}
+
+const Table& initial_table()
+{
+    if (const char* env = std::getenv("CG2D_SIMD"))
+    {
+        for (SimdLevel l : { SimdLevel::kScalar,
+                             SimdLevel::kSse4,
+                             SimdLevel::kAvx2,
+                             SimdLevel::kNeon })
+        {
+            if (std::string(env) == simd_level_name(l))
+                return best_table(l);
+        }
+    }
+    return best_table(SimdLevel::kNeon);
+}
+
+std::atomic<const Table*>& current_table()
+{
+    static std::atomic<const Table*> table{ &initial_table() };
+    return table;
+}
+}  // namespace
+
+const Table& scalar_table()
+{
+    static const Table table{ "scalar",
+                              SimdLevel::kScalar,
+                              xor_pattern,
+                              gray_rgb,
+                              gray_rgba,
+                              reverse_gray,
+                              reverse_rgb,
+                              reverse_rgba,
+                              swizzle_rgb,
+                              swizzle_rgba,
+                              scalar_rgb_to_rgba,
+                              scalar_rgba_to_rgb };
+    return table;
+}
+
+const Table& current()
+{
+    return *current_table().load(std::memory_order_relaxed);
+}
+
+void invert_row(uchar* row, std::size_t pixels, int channels)
+{
+    // Pixels start at multiples of 4 bytes in 4-channel rows, so the
+    // pattern lines up with RGBA
+    static const uchar rgb[4] = { 255, 255, 255, 0 };
+    static const uchar all[4] = { 255, 255, 255, 255 };
+    current().xor_pattern(row, pixels * channels, channels == 4 ? rgb : all);
+}
+
+void gray_row(uchar* row, std::size_t pixels, int channels, GrayMode mode)
+{
+    if (channels < 3)
+        return;
+    // Weights in 1/32768. floor(s * 10923 / 32768) == floor(s / 3) for all
+    // s <= 3 * 255.
+    const GrayWeights weights = mode == GrayMode::kMean
+                                    ? GrayWeights{ 10923, 10923, 10923, 0 }
+                                    : GrayWeights{ 9798, 19235, 3735, 16384 };
+    if (channels == 3)
+        current().gray_rgb(row, pixels, weights);
+    else if (channels == 4)
+        current().gray_rgba(row, pixels, weights);
+    else
+        scalar_gray(row, pixels, channels, weights);
+}
+
+void reverse_row(uchar* row, std::size_t pixels, int channels)
+{
+    switch (channels)
+    {
+        case 1: current().reverse_gray(row, pixels); break;
+        case 3: current().reverse_rgb(row, pixels); break;
+        case 4: current().reverse_rgba(row, pixels); break;
+        default: scalar_reverse(row, pixels, channels);
+    }
+}
+
+void swizzle_row(
+    uchar* row,
+    std::size_t pixels,
+    int channels,
+    const uchar* order)
+{
+    if (channels == 3)
+        current().swizzle_rgb(row, pixels, order);
+    else if (channels == 4)
+        current().swizzle_rgba(row, pixels, order);
+    else
+        scalar_swizzle(row, pixels, channels, order);
+}
+}  // namespace color_kernels
+
+const char* simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::kSse4: return "sse4";
+        case SimdLevel::kAvx2: return "avx2";
+        case SimdLevel::kNeon: return "neon";
+        default: return "scalar";
+    }
+}
+
+SimdLevel max_simd_level()
+{
+    return color_kernels::best_table(SimdLevel::kNeon).level;
+}
+
+SimdLevel simd_level()
+{
+    return color_kernels::current().level;
+}
+
+SimdLevel set_simd_level(SimdLevel level)
+{
+    const color_kernels::Table& table = color_kernels::best_table(level);
+    color_kernels::current_table().store(&table, std::memory_order_relaxed);
+    return table.level;
+}
+}  // namespace USTC_CG
@@ -0,0 +1,169 @@
+#pragma once
+
+// Row kernels behind the color operations of image_ops.h, one table per
+// instruction set. The table in use is picked at run time from the CPU
+// features (see current()).
+//
+// Every SIMD kernel produces exactly the bytes of its scalar version, which
+// it also uses for the pixels that do not fill a whole vector.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "common/image_ops.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define CG2D_SIMD_X86 1
+#endif
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define CG2D_SIMD_NEON 1
+#endif
+
+namespace USTC_CG
+{
+namespace color_kernels
+{
+using uchar = unsigned char;
+
+// gray = (r * r_weight + g * g_weight + b * b_weight + bias) >> 15
+struct GrayWeights
+{
+    int r, g, b, bias;
+};
+
+struct Table
+{
+    const char* name;
+    SimdLevel level;
+
+    // bytes[i] ^= pattern[i % 4] over [row, row + bytes)
+    void (*xor_pattern)(uchar* row, std::size_t bytes, const uchar* pattern);
+    // RGB replaced by the weighted gray, alpha (if any) left as is
+    void (*gray_rgb)(uchar* row, std::size_t pixels, const GrayWeights& w);
+    void (*gray_rgba)(uchar* row, std::size_t pixels, const GrayWeights& w);
+    // Reverses the order of the pixels of a row, in place
+    void (*reverse_gray)(uchar* row, std::size_t pixels);
+    void (*reverse_rgb)(uchar* row, std::size_t pixels);
+    void (*reverse_rgba)(uchar* row, std::size_t pixels);
+    // Channel c of each pixel becomes its channel order[c], in place
+    void (*swizzle_rgb)(uchar* row, std::size_t pixels, const uchar* order);
+    void (*swizzle_rgba)(uchar* row, std::size_t pixels, const uchar* order);
+    // Interleaved RGB <-> RGBA conversions, src and dst do not overlap
+    void (*rgb_to_rgba)(
+        const uchar* src,
+        uchar* dst,
+        std::size_t pixels,
+        uchar alpha);
+    void (*rgba_to_rgb)(const uchar* src, uchar* dst, std::size_t pixels);
+};
+
+// Table used by image_ops, see set_simd_level().
+const Table& current();
+
+// Tables of each instruction set, nullptr when the build does not target
+// it. They do not check that the CPU supports it.
+const Table& scalar_table();
+const Table* sse4_table();
+const Table* avx2_table();
+const Table* neon_table();
+
+// Whole-row operations on rows of `pixels` pixels of `channels` channels,
+// with the current kernels. Shared by image_ops and the fused passes of
+// ImagePipeline.
+void invert_row(uchar* row, std::size_t pixels, int channels);
+void gray_row(uchar* row, std::size_t pixels, int channels, GrayMode mode);
+void reverse_row(uchar* row, std::size_t pixels, int channels);
+// `order` holds `channels` valid channel indices
+void swizzle_row(
+    uchar* row,
+    std::size_t pixels,
+    int channels,
+    const uchar* order);
+
+// Scalar kernels, also used for the tails of the SIMD ones. They have
+// internal linkage so that the SIMD translation units, built for a newer
+// instruction set, never provide the copy called by the others.
+namespace
+{
+inline void
+scalar_xor_pattern(uchar* row, std::size_t bytes, const uchar* pattern)
+{
+    for (std::size_t i = 0; i < bytes; ++i)
+        row[i] ^= pattern[i & 3];
+}
+
+inline uchar gray_value(const uchar* color, const GrayWeights& w)
+{
+    return static_cast<uchar>(
+        (color[0] * w.r + color[1] * w.g + color[2] * w.b + w.bias) >> 15);
+}
+
+inline void scalar_gray(
+    uchar* row,
+    std::size_t pixels,
+    int channels,
+    const GrayWeights& w)
+{
+    for (std::size_t x = 0; x < pixels; ++x, row += channels)
+        row[0] = row[1] = row[2] = gray_value(row, w);
+}
+
+inline void scalar_reverse(uchar* row, std::size_t pixels, int channels)
+{
+    if (pixels < 2)
+        return;
+    uchar* left = row;
+    uchar* right = row + (pixels - 1) * channels;
+    for (; left < right; left += channels, right -= channels)
+    {
+        for (int c = 0; c < channels; ++c)
+            std::swap(left[c], right[c]);
+    }
+}
+
+inline void scalar_swizzle(
+    uchar* row,
+    std::size_t pixels,
+    int channels,
+    const uchar* order)
+{
+    uchar color[4];
+    for (std::size_t x = 0; x < pixels; ++x, row += channels)
+    {
+        std::memcpy(color, row, channels);
+        for (int c = 0; c < channels; ++c)
+            row[c] = color[order[c]];
+    }
+}
+
+inline void scalar_rgb_to_rgba(
+    const uchar* src,
+    uchar* dst,
+    std::size_t pixels,
+    uchar alpha)
+{
+    for (std::size_t x = 0; x < pixels; ++x, src += 3, dst += 4)
+    {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = alpha;
+    }
+}
+
+inline void
+scalar_rgba_to_rgb(const uchar* src, uchar* dst, std::size_t pixels)
+{
+    for (std::size_t x = 0; x < pixels; ++x, src += 4, dst += 3)
+    {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+    }
+}
+}  // namespace
+}  // namespace color_kernels
+}  // namespace USTC_CG
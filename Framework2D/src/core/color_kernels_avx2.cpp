@@ -0,0 +1,155 @@
+// AVX2 color kernels, 32 bytes at a time. AVX2 byte shuffles stay within
+// each 16-byte half, which suits 1- and 4-byte pixels; the 3-byte (RGB)
+// kernels are the SSE4.1 ones.
+#include "color_kernels.h"
+
+#if defined(CG2D_SIMD_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#define CG2D_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CG2D_TARGET_AVX2
+#endif
+
+namespace USTC_CG
+{
+namespace color_kernels
+{
+namespace
+{
+CG2D_TARGET_AVX2 inline __m256i load(const uchar* p)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+CG2D_TARGET_AVX2 inline void store(uchar* p, __m256i v)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+CG2D_TARGET_AVX2 void
+xor_pattern(uchar* row, std::size_t bytes, const uchar* pattern)
+{
+    int word;
+    std::memcpy(&word, pattern, 4);
+    const __m256i mask = _mm256_set1_epi32(word);
+    std::size_t i = 0;
+    for (; i + 32 <= bytes; i += 32)
+        store(row + i, _mm256_xor_si256(load(row + i), mask));
+    scalar_xor_pattern(row + i, bytes - i, pattern);
+}
+
+CG2D_TARGET_AVX2 void
+gray_rgba(uchar* row, std::size_t pixels, const GrayWeights& w)
+{
+    const __m256i weights = _mm256_setr_epi16(
+        w.r, w.g, w.b, 0, w.r, w.g, w.b, 0, w.r, w.g, w.b, 0, w.r, w.g, w.b, 0);
+    const __m256i bias = _mm256_set1_epi32(w.bias);
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1,
+        0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m256i zero = _mm256_setzero_si256();
+    std::size_t x = 0;
+    for (; x + 8 <= pixels; x += 8)
+    {
+        uchar* p = row + 4 * x;
+        const __m256i v = load(p);
+        // Per 16-byte half: pixels 0-1 and 2-3, summed in pixel order
+        const __m256i lo =
+            _mm256_madd_epi16(_mm256_unpacklo_epi8(v, zero), weights);
+        const __m256i hi =
+            _mm256_madd_epi16(_mm256_unpackhi_epi8(v, zero), weights);
+        const __m256i sum = _mm256_srli_epi32(
+            _mm256_add_epi32(_mm256_hadd_epi32(lo, hi), bias), 15);
+        const __m256i gray = _mm256_shuffle_epi8(sum, spread);
+        store(p, _mm256_blendv_epi8(gray, v, alpha));
+    }
+    scalar_gray(row + 4 * x, pixels - x, 4, w);
+}
+
+CG2D_TARGET_AVX2 void reverse_gray(uchar* row, std::size_t pixels)
+{
+    const __m256i reverse = _mm256_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    uchar* left = row;
+    uchar* right = row + pixels;
+    for (; right - left >= 64; left += 32, right -= 32)
+    {
+        // Reverse within the halves, then swap the halves
+        const __m256i a = _mm256_permute4x64_epi64(
+            _mm256_shuffle_epi8(load(left), reverse), 0x4E);
+        const __m256i b = _mm256_permute4x64_epi64(
+            _mm256_shuffle_epi8(load(right - 32), reverse), 0x4E);
+        store(left, b);
+        store(right - 32, a);
+    }
+    scalar_reverse(left, right - left, 1);
+}
+
+CG2D_TARGET_AVX2 void reverse_rgba(uchar* row, std::size_t pixels)
+{
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    uchar* left = row;
+    uchar* right = row + 4 * pixels;
+    for (; right - left >= 64; left += 32, right -= 32)
+    {
+        const __m256i a = load(left);
+        const __m256i b = load(right - 32);
+        store(left, _mm256_permutevar8x32_epi32(b, reverse));
+        store(right - 32, _mm256_permutevar8x32_epi32(a, reverse));
+    }
+    scalar_reverse(left, (right - left) / 4, 4);
+}
+
+CG2D_TARGET_AVX2 void
+swizzle_rgba(uchar* row, std::size_t pixels, const uchar* order)
+{
+    alignas(32) char indices[32];
+    for (int i = 0; i < 32; ++i)
+        indices[i] = static_cast<char>(i % 16 / 4 * 4 + order[i % 4]);
+    const __m256i shuffle = load(reinterpret_cast<const uchar*>(indices));
+    std::size_t x = 0;
+    for (; x + 8 <= pixels; x += 8)
+        store(row + 4 * x, _mm256_shuffle_epi8(load(row + 4 * x), shuffle));
+    scalar_swizzle(row + 4 * x, pixels - x, 4, order);
+}
+
+Table make_table()
+{
+    Table table = *sse4_table();
+    table.name = "avx2";
+    table.level = SimdLevel::kAvx2;
+    table.xor_pattern = xor_pattern;
+    table.gray_rgba = gray_rgba;
+    table.reverse_gray = reverse_gray;
+    table.reverse_rgba = reverse_rgba;
+    table.swizzle_rgba = swizzle_rgba;
+    return table;
+}
+}  // namespace
+
+const Table* avx2_table()
+{
+    static const Table table = make_table();
+    return &table;
+}
+}  // namespace color_kernels
+}  // namespace USTC_CG
+
+#else
+
+namespace USTC_CG
+{
+namespace color_kernels
+{
+const Table* avx2_table()
+{
+    return nullptr;
+}
+}  // namespace color_kernels
+}  // namespace USTC_CG
+
+#endif
@@ -0,0 +1,215 @@
+// NEON color kernels (ARM64), 16 pixels at a time. The structured loads
+// and stores (vld3q / vld4q) deinterleave the channels, so RGB and RGBA
+// take the same paths.
+#include "color_kernels.h"
+
+#if defined(CG2D_SIMD_NEON)
+
+#include <arm_neon.h>
+
+namespace USTC_CG
+{
+namespace color_kernels
+{
+namespace
+{
+// Gray values of 8 pixels
+inline uint8x8_t
+gray8(uint8x8_t r, uint8x8_t g, uint8x8_t b, const GrayWeights& w)
+{
+    const uint16x8_t r16 = vmovl_u8(r);
+    const uint16x8_t g16 = vmovl_u8(g);
+    const uint16x8_t b16 = vmovl_u8(b);
+    const uint32x4_t bias = vdupq_n_u32(static_cast<uint32_t>(w.bias));
+    uint32x4_t lo = vmlal_n_u16(bias, vget_low_u16(r16), w.r);
+    lo = vmlal_n_u16(lo, vget_low_u16(g16), w.g);
+    lo = vmlal_n_u16(lo, vget_low_u16(b16), w.b);
+    uint32x4_t hi = vmlal_n_u16(bias, vget_high_u16(r16), w.r);
+    hi = vmlal_n_u16(hi, vget_high_u16(g16), w.g);
+    hi = vmlal_n_u16(hi, vget_high_u16(b16), w.b);
+    return vmovn_u16(vcombine_u16(vshrn_n_u32(lo, 15), vshrn_n_u32(hi, 15)));
+}
+
+inline uint8x16_t
+gray16(uint8x16_t r, uint8x16_t g, uint8x16_t b, const GrayWeights& w)
+{
+    return vcombine_u8(
+        gray8(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b), w),
+        gray8(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b), w));
+}
+
+inline uint8x16_t reverse16(uint8x16_t v)
+{
+    v = vrev64q_u8(v);
+    return vextq_u8(v, v, 8);
+}
+
+void xor_pattern(uchar* row, std::size_t bytes, const uchar* pattern)
+{
+    uint32_t word;
+    std::memcpy(&word, pattern, 4);
+    const uint8x16_t mask = vreinterpretq_u8_u32(vdupq_n_u32(word));
+    std::size_t i = 0;
+    for (; i + 16 <= bytes; i += 16)
+        vst1q_u8(row + i, veorq_u8(vld1q_u8(row + i), mask));
+    scalar_xor_pattern(row + i, bytes - i, pattern);
+}
+
+void gray_rgb(uchar* row, std::size_t pixels, const GrayWeights& w)
+{
+    std::size_t x = 0;
+    for (; x + 16 <= pixels; x += 16)
+    {
+        uint8x16x3_t v = vld3q_u8(row + 3 * x);
+        v.val[0] = v.val[1] = v.val[2] =
+            gray16(v.val[0], v.val[1], v.val[2], w);
+        vst3q_u8(row + 3 * x, v);
+    }
+    scalar_gray(row + 3 * x, pixels - x, 3, w);
+}
+
+void gray_rgba(uchar* row, std::size_t pixels, const GrayWeights& w)
+{
+    std::size_t x = 0;
+    for (; x + 16 <= pixels; x += 16)
+    {
+        uint8x16x4_t v = vld4q_u8(row + 4 * x);
+        v.val[0] = v.val[1] = v.val[2] =
+            gray16(v.val[0], v.val[1], v.val[2], w);
+        vst4q_u8(row + 4 * x, v);
+    }
+    scalar_gray(row + 4 * x, pixels - x, 4, w);
+}
+
+void reverse_gray(uchar* row, std::size_t pixels)
+{
+    uchar* left = row;
+    uchar* right = row + pixels;
+    for (; right - left >= 32; left += 16, right -= 16)
+    {
+        const uint8x16_t a = vld1q_u8(left);
+        const uint8x16_t b = vld1q_u8(right - 16);
+        vst1q_u8(left, reverse16(b));
+        vst1q_u8(right - 16, reverse16(a));
+    }
+    scalar_reverse(left, right - left, 1);
+}
+
+void reverse_rgb(uchar* row, std::size_t pixels)
+{
+    uchar* left = row;
+    uchar* right = row + 3 * pixels;
+    for (; right - left >= 96; left += 48, right -= 48)
+    {
+        uint8x16x3_t a = vld3q_u8(left);
+        uint8x16x3_t b = vld3q_u8(right - 48);
+        for (int c = 0; c < 3; ++c)
+        {
+            a.val[c] = reverse16(a.val[c]);
+            b.val[c] = reverse16(b.val[c]);
+        }
+        vst3q_u8(left, b);
+        vst3q_u8(right - 48, a);
+    }
+    scalar_reverse(left, (right - left) / 3, 3);
+}
+
+void reverse_rgba(uchar* row, std::size_t pixels)
+{
+    uchar* left = row;
+    uchar* right = row + 4 * pixels;
+    for (; right - left >= 32; left += 16, right -= 16)
+    {
+        uint32x4_t a = vrev64q_u32(vreinterpretq_u32_u8(vld1q_u8(left)));
+        uint32x4_t b = vrev64q_u32(vreinterpretq_u32_u8(vld1q_u8(right - 16)));
+        vst1q_u8(left, vreinterpretq_u8_u32(vextq_u32(b, b, 2)));
+        vst1q_u8(right - 16, vreinterpretq_u8_u32(vextq_u32(a, a, 2)));
+    }
+    scalar_reverse(left, (right - left) / 4, 4);
+}
+
+void swizzle_rgb(uchar* row, std::size_t pixels, const uchar* order)
+{
+    std::size_t x = 0;
+    for (; x + 16 <= pixels; x += 16)
+    {
+        const uint8x16x3_t v = vld3q_u8(row + 3 * x);
+        uint8x16x3_t out;
+        for (int c = 0; c < 3; ++c)
+            out.val[c] = v.val[order[c]];
+        vst3q_u8(row + 3 * x, out);
+    }
+    scalar_swizzle(row + 3 * x, pixels - x, 3, order);
+}
+
+void swizzle_rgba(uchar* row, std::size_t pixels, const uchar* order)
+{
+    std::size_t x = 0;
+    for (; x + 16 <= pixels; x += 16)
+    {
+        const uint8x16x4_t v = vld4q_u8(row + 4 * x);
+        uint8x16x4_t out;
+        for (int c = 0; c < 4; ++c)
+            out.val[c] = v.val[order[c]];
+        vst4q_u8(row + 4 * x, out);
+    }
+    scalar_swizzle(row + 4 * x, pixels - x, 4, order);
+}
+
+void rgb_to_rgba(const uchar* src, uchar* dst, std::size_t pixels, uchar alpha)
+{
+    std::size_t x = 0;
+    for (; x + 16 <= pixels; x += 16)
+    {
+        const uint8x16x3_t v = vld3q_u8(src + 3 * x);
+        uint8x16x4_t out;
+        out.val[0] = v.val[0];
+        out.val[1] = v.val[1];
+        out.val[2] = v.val[2];
+        out.val[3] = vdupq_n_u8(alpha);
+        vst4q_u8(dst + 4 * x, out);
+    }
+    scalar_rgb_to_rgba(src + 3 * x, dst + 4 * x, pixels - x, alpha);
+}
+
+void rgba_to_rgb(const uchar* src, uchar* dst, std::size_t pixels)
+{
+    std::size_t x = 0;
+    for (; x + 16 <= pixels; x += 16)
+    {
+        const uint8x16x4_t v = vld4q_u8(src + 4 * x);
+        uint8x16x3_t out;
+        out.val[0] = v.val[0];
+        out.val[1] = v.val[1];
+        out.val[2] = v.val[2];
+        vst3q_u8(dst + 3 * x, out);
+    }
+    scalar_rgba_to_rgb(src + 4 * x, dst + 3 * x, pixels - x);
+}
+}  // namespace
+
+const Table* neon_table()
+{
+    static const Table table{ "neon",       SimdLevel::kNeon, xor_pattern,
+                              gray_rgb,     gray_rgba,        reverse_gray,
+                              reverse_rgb,  reverse_rgba,     swizzle_rgb,
+                              swizzle_rgba, rgb_to_rgba,      rgba_to_rgb };
+    return &table;
+}
+}  // namespace color_kernels
+}  // namespace USTC_CG
+
+#else
+
+namespace USTC_CG
+{
+namespace color_kernels
+{
+const Table* neon_table()
+{
+    return nullptr;
+}
+}  // namespace color_kernels
+}  // namespace USTC_CG
+
+#endif
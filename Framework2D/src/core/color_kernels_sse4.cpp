@@ -0,0 +1,237 @@
+// SSE4.1 color kernels (SSSE3 byte shuffles, SSE4.1 blends), 16 bytes at a
+// time.
+#include "color_kernels.h"
+
+#if defined(CG2D_SIMD_X86)
+
+#include <immintrin.h>
+
+// GCC and Clang only emit SSE4.1 for functions marked so; MSVC always
+// accepts the intrinsics.
+#if defined(__GNUC__)
+#define CG2D_TARGET_SSE4 __attribute__((target("sse4.1")))
+#else
+#define CG2D_TARGET_SSE4
+#endif
+
+namespace USTC_CG
+{
+namespace color_kernels
+{
+namespace
+{
+CG2D_TARGET_SSE4 inline __m128i load(const uchar* p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+CG2D_TARGET_SSE4 inline void store(uchar* p, __m128i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+// Gray values of 4 RGBx pixels, one per 32-bit lane
+CG2D_TARGET_SSE4 inline __m128i
+gray4(__m128i rgbx, __m128i weights, __m128i bias)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(rgbx, zero), weights);
+    const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(rgbx, zero), weights);
+    return _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(lo, hi), bias), 15);
+}
+
+CG2D_TARGET_SSE4 void
+xor_pattern(uchar* row, std::size_t bytes, const uchar* pattern)
+{
+    int word;
+    std::memcpy(&word, pattern, 4);
+    const __m128i mask = _mm_set1_epi32(word);
+    std::size_t i = 0;
+    for (; i + 16 <= bytes; i += 16)
+        store(row + i, _mm_xor_si128(load(row + i), mask));
+    scalar_xor_pattern(row + i, bytes - i, pattern);
+}
+
+CG2D_TARGET_SSE4 void
+gray_rgba(uchar* row, std::size_t pixels, const GrayWeights& w)
+{
+    const __m128i weights = _mm_setr_epi16(w.r, w.g, w.b, 0, w.r, w.g, w.b, 0);
+    const __m128i bias = _mm_set1_epi32(w.bias);
+    const __m128i spread =
+        _mm_setr_epi8(0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    std::size_t x = 0;
+    for (; x + 4 <= pixels; x += 4)
+    {
+        uchar* p = row + 4 * x;
+        const __m128i v = load(p);
+        const __m128i gray = _mm_shuffle_epi8(gray4(v, weights, bias), spread);
+        store(p, _mm_blendv_epi8(gray, v, alpha));
+    }
+    scalar_gray(row + 4 * x, pixels - x, 4, w);
+}
+
+CG2D_TARGET_SSE4 void
+gray_rgb(uchar* row, std::size_t pixels, const GrayWeights& w)
+{
+    const __m128i weights = _mm_setr_epi16(w.r, w.g, w.b, 0, w.r, w.g, w.b, 0);
+    const __m128i bias = _mm_set1_epi32(w.bias);
+    const __m128i expand =
+        _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i spread =
+        _mm_setr_epi8(0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, -1, -1, -1, -1);
+    // The last 4 bytes loaded belong to the next pixels
+    const __m128i keep =
+        _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1);
+    std::size_t x = 0;
+    for (; 3 * x + 16 <= 3 * pixels; x += 4)
+    {
+        uchar* p = row + 3 * x;
+        const __m128i v = load(p);
+        const __m128i gray = _mm_shuffle_epi8(
+            gray4(_mm_shuffle_epi8(v, expand), weights, bias), spread);
+        store(p, _mm_blendv_epi8(gray, v, keep));
+    }
+    scalar_gray(row + 3 * x, pixels - x, 3, w);
+}
+
+// Reverses a row by swapping reversed 16-byte blocks from both ends, then
+// the middle with the scalar code.
+CG2D_TARGET_SSE4 void reverse_gray(uchar* row, std::size_t pixels)
+{
+    const __m128i reverse =
+        _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    uchar* left = row;
+    uchar* right = row + pixels;
+    for (; right - left >= 32; left += 16, right -= 16)
+    {
+        const __m128i a = load(left);
+        const __m128i b = load(right - 16);
+        store(left, _mm_shuffle_epi8(b, reverse));
+        store(right - 16, _mm_shuffle_epi8(a, reverse));
+    }
+    scalar_reverse(left, right - left, 1);
+}
+
+CG2D_TARGET_SSE4 void reverse_rgba(uchar* row, std::size_t pixels)
+{
+    uchar* left = row;
+    uchar* right = row + 4 * pixels;
+    for (; right - left >= 32; left += 16, right -= 16)
+    {
+        const __m128i a = load(left);
+        const __m128i b = load(right - 16);
+        store(left, _mm_shuffle_epi32(b, 0x1B));
+        store(right - 16, _mm_shuffle_epi32(a, 0x1B));
+    }
+    scalar_reverse(left, (right - left) / 4, 4);
+}
+
+// Blocks of 5 pixels: bytes 0-14 of the left load, 1-15 of the right one.
+// The remaining byte of each store is written back unchanged.
+CG2D_TARGET_SSE4 void reverse_rgb(uchar* row, std::size_t pixels)
+{
+    const __m128i to_left =
+        _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1);
+    const __m128i to_right =
+        _mm_setr_epi8(-1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2);
+    const __m128i keep_last =
+        _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1);
+    const __m128i keep_first =
+        _mm_setr_epi8(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    uchar* left = row;
+    uchar* right = row + 3 * pixels;
+    for (; right - left >= 32; left += 15, right -= 15)
+    {
+        const __m128i a = load(left);
+        const __m128i b = load(right - 16);
+        store(
+            left, _mm_blendv_epi8(_mm_shuffle_epi8(b, to_left), a, keep_last));
+        store(
+            right - 16,
+            _mm_blendv_epi8(_mm_shuffle_epi8(a, to_right), b, keep_first));
+    }
+    scalar_reverse(left, (right - left) / 3, 3);
+}
+
+CG2D_TARGET_SSE4 void
+swizzle_rgba(uchar* row, std::size_t pixels, const uchar* order)
+{
+    alignas(16) char indices[16];
+    for (int i = 0; i < 16; ++i)
+        indices[i] = static_cast<char>(i / 4 * 4 + order[i % 4]);
+    const __m128i shuffle = load(reinterpret_cast<const uchar*>(indices));
+    std::size_t x = 0;
+    for (; x + 4 <= pixels; x += 4)
+        store(row + 4 * x, _mm_shuffle_epi8(load(row + 4 * x), shuffle));
+    scalar_swizzle(row + 4 * x, pixels - x, 4, order);
+}
+
+CG2D_TARGET_SSE4 void
+swizzle_rgb(uchar* row, std::size_t pixels, const uchar* order)
+{
+    // 5 pixels per load, the 16th byte is kept
+    alignas(16) char indices[16];
+    for (int i = 0; i < 15; ++i)
+        indices[i] = static_cast<char>(i / 3 * 3 + order[i % 3]);
+    indices[15] = 15;
+    const __m128i shuffle = load(reinterpret_cast<const uchar*>(indices));
+    std::size_t x = 0;
+    for (; 3 * x + 16 <= 3 * pixels; x += 5)
+        store(row + 3 * x, _mm_shuffle_epi8(load(row + 3 * x), shuffle));
+    scalar_swizzle(row + 3 * x, pixels - x, 3, order);
+}
+
+CG2D_TARGET_SSE4 void
+rgb_to_rgba(const uchar* src, uchar* dst, std::size_t pixels, uchar alpha)
+{
+    const __m128i expand =
+        _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha_bytes =
+        _mm_set1_epi32(static_cast<int>(static_cast<unsigned>(alpha) << 24));
+    std::size_t x = 0;
+    for (; 3 * x + 16 <= 3 * pixels; x += 4)
+    {
+        const __m128i v = _mm_shuffle_epi8(load(src + 3 * x), expand);
+        store(dst + 4 * x, _mm_or_si128(v, alpha_bytes));
+    }
+    scalar_rgb_to_rgba(src + 3 * x, dst + 4 * x, pixels - x, alpha);
+}
+
+CG2D_TARGET_SSE4 void
+rgba_to_rgb(const uchar* src, uchar* dst, std::size_t pixels)
+{
+    const __m128i pack =
+        _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    std::size_t x = 0;
+    // Each store spills 4 bytes that the next one overwrites
+    for (; 3 * x + 16 <= 3 * pixels; x += 4)
+        store(dst + 3 * x, _mm_shuffle_epi8(load(src + 4 * x), pack));
+    scalar_rgba_to_rgb(src + 4 * x, dst + 3 * x, pixels - x);
+}
+}  // namespace
+
+const Table* sse4_table()
+{
+    static const Table table{ "sse4",       SimdLevel::kSse4, xor_pattern,
+                              gray_rgb,     gray_rgba,        reverse_gray,
+                              reverse_rgb,  reverse_rgba,     swizzle_rgb,
+                              swizzle_rgba, rgb_to_rgba,      rgba_to_rgb };
+    return &table;
+}
+}  // namespace color_kernels
+}  // namespace USTC_CG
+
+#else
+
+namespace USTC_CG
+{
+namespace color_kernels
+{
+const Table* sse4_table()
+{
+    return nullptr;
+}
+}  // namespace color_kernels
+}  // namespace USTC_CG
+
+#endif
@@ -0,0 +1,976 @@
+#include "image_codecs.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "common/parallel.h"
+
+namespace USTC_CG
+{
+namespace image_codecs
+{
+using uchar = unsigned char;
+
+namespace
+{
+void put_be32(std::vector<uchar>& out, std::uint32_t value)
+{
+    out.push_back(static_cast<uchar>(value >> 24));
+    out.push_back(static_cast<uchar>(value >> 16));
+    out.push_back(static_cast<uchar>(value >> 8));
+    out.push_back(static_cast<uchar>(value));
+}
+
+std::uint32_t get_be32(const uchar* p)
+{
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+           (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+}
+
+// --- PNG -------------------------------------------------------------------
+
+constexpr int kWindowSize = 32768;
+constexpr int kHashBits = 15;
+constexpr int kMaxChain = 8;
+constexpr int kMinMatch = 3;
+constexpr int kMaxMatch = 258;
+// Matches at least this long are taken without looking one byte further
+constexpr int kLazyLimit = 16;
+// Raw bytes per strip compressed by one task
+constexpr std::size_t kStripBytes = std::size_t(1) << 20;
+
+// Fixed Huffman codes of deflate (RFC 1951, 3.2.6), bit-reversed so that
+// they can be written LSB first, and the length / distance symbols.
+struct DeflateTables
+{
+    std::uint16_t literal_code[288];
+    uchar literal_bits[288];
+    // For match lengths 3..258: symbol - 257, extra bits, extra value
+    uchar length_symbol[kMaxMatch + 1];
+    uchar length_extra_bits[kMaxMatch + 1];
+    std::uint16_t length_extra[kMaxMatch + 1];
+    std::uint16_t distance_base[30];
+    uchar distance_extra_bits[30];
+    uchar distance_code[30];
+    // Distance symbols, indexed as in distance_symbol()
+    uchar distance_symbols[512];
+
+    DeflateTables()
+    {
+        auto reverse = [](unsigned code, int bits)
+        {
+            unsigned result = 0;
+            for (int i = 0; i < bits; ++i)
+                result |= ((code >> i) & 1u) << (bits - 1 - i);
+            return static_cast<std::uint16_t>(result);
+        };
+        for (int s = 0; s < 288; ++s)
+        {
+            unsigned code;
+            int bits;
+            if (s < 144)
+                code = 0x30 + s, bits = 8;
+            else if (s < 256)
+                code = 0x190 + s - 144, bits = 9;
+            else if (s < 280)
+                code = s - 256, bits = 7;
+            else
+                code = 0xC0 + s - 280, bits = 8;
+            literal_code[s] = reverse(code, bits);
+            literal_bits[s] = static_cast<uchar>(bits);
+        }
+
+        static const std::uint16_t length_base[29] = {
+            3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+            31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+        };
+        static const uchar length_bits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                               1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                               4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        for (int s = 0; s < 29; ++s)
+        {
+            const int end = s + 1 < 29 ? length_base[s + 1] : kMaxMatch + 1;
+            for (int length = length_base[s]; length < end; ++length)
+            {
+                length_symbol[length] = static_cast<uchar>(s);
+                length_extra_bits[length] = length_bits[s];
+                length_extra[length] =
+                    static_cast<std::uint16_t>(length - length_base[s]);
+            }
+        }
+
+        int base = 1;
+        for (int s = 0; s < 30; ++s)
+        {
+            distance_base[s] = static_cast<std::uint16_t>(base);
+            distance_extra_bits[s] = static_cast<uchar>(s < 4 ? 0 : s / 2 - 1);
+            distance_code[s] = static_cast<uchar>(reverse(s, 5));
+            const int end = base + (1 << distance_extra_bits[s]);
+            for (int distance = base; distance < end; ++distance)
+                distance_symbols[symbol_index(distance)] =
+                    static_cast<uchar>(s);
+            base = end;
+        }
+    }
+
+    // Distances above 256 start their symbols on multiples of 128
+    static int symbol_index(int distance)
+    {
+        return distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+    }
+    int distance_symbol(int distance) const
+    {
+        return distance_symbols[symbol_index(distance)];
+    }
+};
+
+const DeflateTables& deflate_tables()
+{
+    static const DeflateTables tables;
+    return tables;
+}
+
+class BitWriter
+{
+   public:
+    explicit BitWriter(std::vector<uchar>& out) : out_(out)
+    {
+    }
+
+    // Writes the `count` low bits of `value`, LSB first.
+    void put(std::uint32_t value, int count)
+    {
+        bits_ |= std::uint64_t(value) << count_;
+        count_ += count;
+        while (count_ >= 8)
+        {
+            out_.push_back(static_cast<uchar>(bits_));
+            bits_ >>= 8;
+            count_ -= 8;
+        }
+    }
+
+    void align()
+    {
+        if (count_ > 0)
+            put(0, 8 - count_);
+    }
+
+   private:
+    std::vector<uchar>& out_;
+    std::uint64_t bits_ = 0;
+    int count_ = 0;
+};
+
+// Number of equal leading bytes of a and b, up to `max_length`
+int match_length(const uchar* a, const uchar* b, int max_length)
+{
+    int length = 0;
+    // Eight bytes at a time: the first difference is the lowest set byte of
+    // the XOR (little endian) or the highest one (big endian)
+    while (length + 8 <= max_length)
+    {
+        std::uint64_t x, y;
+        std::memcpy(&x, a + length, 8);
+        std::memcpy(&y, b + length, 8);
+        if (x != y)
+        {
+            const std::uint64_t diff = x ^ y;
+            if constexpr (std::endian::native == std::endian::little)
+                return length + std::countr_zero(diff) / 8;
+            else
+                return length + std::countl_zero(diff) / 8;
+        }
+        length += 8;
+    }
+    while (length < max_length && a[length] == b[length])
+        ++length;
+    return length;
+}
+
+// Compresses data[begin, end) as one fixed Huffman block, matching into
+// data[0, begin) as well. Unless `last`, the block is followed by an empty
+// stored block, which aligns the output on a byte so that the strip can be
+// concatenated with the next one.
+void deflate_strip(
+    const uchar* data,
+    int begin,
+    int end,
+    bool last,
+    std::vector<uchar>& out)
+{
+    const DeflateTables& tables = deflate_tables();
+    std::vector<int> head(std::size_t(1) << kHashBits, -1);
+    std::vector<int> prev(kWindowSize, -1);
+    auto hash = [&](int pos)
+    {
+        const std::uint32_t key = std::uint32_t(data[pos]) << 16 |
+                                  std::uint32_t(data[pos + 1]) << 8 |
+                                  data[pos + 2];
+        return (key * 2654435761u) >> (32 - kHashBits);
+    };
+    auto insert = [&](int pos)
+    {
+        if (pos + kMinMatch > end)
+            return;
+        const std::uint32_t h = hash(pos);
+        prev[pos & (kWindowSize - 1)] = head[h];
+        head[h] = pos;
+    };
+    auto find = [&](int pos, int& distance)
+    {
+        if (pos + kMinMatch > end)
+            return 0;
+        const int max_length = std::min(kMaxMatch, end - pos);
+        int best = 0;
+        int candidate = head[hash(pos)];
+        for (int chain = 0; chain < kMaxChain && candidate >= 0 &&
+                            pos - candidate <= kWindowSize;
+             ++chain)
+        {
+            if (data[candidate + best] == data[pos + best])
+            {
+                const int length =
+                    match_length(data + candidate, data + pos, max_length);
+                if (length > best)
+                {
+                    best = length;
+                    distance = pos - candidate;
+                    if (best == max_length)
+                        break;
+                }
+            }
+            const int next = prev[candidate & (kWindowSize - 1)];
+            // Entries overwritten by newer positions end the chain
+            if (next >= candidate)
+                break;
+            candidate = next;
+        }
+        return best >= kMinMatch ? best : 0;
+    };
+
+    BitWriter writer(out);
+    auto literal = [&](int symbol)
+    {
+        writer.put(
+            tables.literal_code[symbol], tables.literal_bits[symbol]);
+    };
+    writer.put(last ? 1 : 0, 1);
+    writer.put(1, 2);  // Fixed Huffman codes
+
+    for (int pos = std::max(0, begin - kWindowSize); pos < begin; ++pos)
+        insert(pos);
+    int pos = begin;
+    int distance = 0;
+    int length = find(pos, distance);
+    while (pos < end)
+    {
+        insert(pos);
+        if (length && length < kLazyLimit)
+        {
+            // A longer match one byte further is worth a literal
+            int next_distance = 0;
+            const int next_length = find(pos + 1, next_distance);
+            if (next_length > length)
+            {
+                literal(data[pos]);
+                ++pos;
+                length = next_length;
+                distance = next_distance;
+                continue;
+            }
+        }
+        if (length)
+        {
+            literal(257 + tables.length_symbol[length]);
+            writer.put(
+                tables.length_extra[length], tables.length_extra_bits[length]);
+            const int symbol = tables.distance_symbol(distance);
+            writer.put(tables.distance_code[symbol], 5);
+            writer.put(
+                distance - tables.distance_base[symbol],
+                tables.distance_extra_bits[symbol]);
+            for (int k = 1; k < length; ++k)
+                insert(pos + k);
+            pos += length;
+        }
+        else
+        {
+            literal(data[pos]);
+            ++pos;
+        }
+        length = pos < end ? find(pos, distance) : 0;
+    }
+    literal(256);  // End of block
+    if (!last)
+    {
+        // Empty stored block
+        writer.put(0, 3);
+        writer.align();
+        out.insert(out.end(), { 0x00, 0x00, 0xFF, 0xFF });
+    }
+    writer.align();
+}
+
+std::uint32_t adler32(const uchar* data, std::size_t size)
+{
+    constexpr std::uint32_t kBase = 65521;
+    // Largest n such that 255 n (n + 1) / 2 + (n + 1) (kBase - 1) fits in
+    // 32 bits
+    constexpr std::size_t kBlock = 5552;
+    std::uint32_t a = 1, b = 0;
+    while (size > 0)
+    {
+        const std::size_t n = std::min(size, kBlock);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= kBase;
+        b %= kBase;
+        data += n;
+        size -= n;
+    }
+    return b << 16 | a;
+}
+
+// Checksum of the concatenation of two blocks, the second `size2` bytes long
+std::uint32_t
+adler32_combine(std::uint32_t adler1, std::uint32_t adler2, std::size_t size2)
+{
+    constexpr std::uint32_t kBase = 65521;
+    const std::uint32_t rem = static_cast<std::uint32_t>(size2 % kBase);
+    std::uint32_t sum1 = adler1 & 0xFFFF;
+    std::uint32_t sum2 = static_cast<std::uint32_t>(
+        (std::uint64_t(rem) * sum1) % kBase);
+    sum1 += (adler2 & 0xFFFF) + kBase - 1;
+    sum2 += ((adler1 >> 16) & 0xFFFF) + ((adler2 >> 16) & 0xFFFF) + kBase -
+            rem;
+    if (sum1 >= kBase)
+        sum1 -= kBase;
+    if (sum1 >= kBase)
+        sum1 -= kBase;
+    if (sum2 >= (kBase << 1))
+        sum2 -= (kBase << 1);
+    if (sum2 >= kBase)
+        sum2 -= kBase;
+    return sum1 | (sum2 << 16);
+}
+
+std::uint32_t crc32(std::uint32_t crc, const uchar* data, std::size_t size)
+{
+    static const auto table = []
+    {
+        std::array<std::uint32_t, 256> t{};
+        for (std::uint32_t n = 0; n < 256; ++n)
+        {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uchar paeth(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return static_cast<uchar>(a);
+    return static_cast<uchar>(pb <= pc ? b : c);
+}
+
+// Filters `row` into `out` with the predictor predict(left, up, up left)
+// and returns the sum of the absolute (signed) filtered values.
+template<typename Predict>
+long apply_filter(
+    const uchar* row,
+    const uchar* up,
+    std::size_t size,
+    int bpp,
+    uchar* out,
+    Predict predict)
+{
+    long cost = 0;
+    const std::size_t first = std::min<std::size_t>(bpp, size);
+    for (std::size_t i = 0; i < first; ++i)
+    {
+        out[i] = static_cast<uchar>(row[i] - predict(0, up[i], 0));
+        cost += std::abs(static_cast<signed char>(out[i]));
+    }
+    for (std::size_t i = first; i < size; ++i)
+    {
+        out[i] = static_cast<uchar>(
+            row[i] - predict(row[i - bpp], up[i], up[i - bpp]));
+        cost += std::abs(static_cast<signed char>(out[i]));
+    }
+    return cost;
+}
+
+// Writes the filter byte and the filtered row to `out`, with the filter
+// that gives the smallest sum of absolute (signed) values, as stb does.
+// `up` is a row of zeros for the first row.
+void filter_row(
+    const uchar* row,
+    const uchar* up,
+    std::size_t size,
+    int bpp,
+    uchar* out,
+    std::vector<uchar>& scratch)
+{
+    scratch.resize(size);
+    long best_cost = -1;
+    auto consider = [&](int filter, auto predict)
+    {
+        const long cost =
+            apply_filter(row, up, size, bpp, scratch.data(), predict);
+        if (best_cost < 0 || cost < best_cost)
+        {
+            best_cost = cost;
+            out[0] = static_cast<uchar>(filter);
+            std::copy_n(scratch.data(), size, out + 1);
+        }
+    };
+    consider(0, [](int, int, int) { return 0; });
+    consider(1, [](int a, int, int) { return a; });
+    consider(2, [](int, int b, int) { return b; });
+    consider(3, [](int a, int b, int) { return (a + b) / 2; });
+    consider(4, [](int a, int b, int c) { return int(paeth(a, b, c)); });
+}
+
+void put_chunk(
+    std::vector<uchar>& out,
+    const char* type,
+    const uchar* data,
+    std::size_t size,
+    std::uint32_t crc)
+{
+    put_be32(out, static_cast<std::uint32_t>(size));
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_be32(out, crc);
+}
+
+// --- QOI -------------------------------------------------------------------
+
+constexpr uchar kQoiIndex = 0x00;
+constexpr uchar kQoiDiff = 0x40;
+constexpr uchar kQoiLuma = 0x80;
+constexpr uchar kQoiRun = 0xC0;
+constexpr uchar kQoiRgb = 0xFE;
+constexpr uchar kQoiRgba = 0xFF;
+constexpr uchar kQoiMask = 0xC0;
+constexpr std::size_t kQoiHeaderSize = 14;
+constexpr uchar kQoiEnd[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+struct QoiPixel
+{
+    uchar r = 0, g = 0, b = 0, a = 255;
+
+    bool operator==(const QoiPixel& other) const
+    {
+        return r == other.r && g == other.g && b == other.b && a == other.a;
+    }
+    int hash() const
+    {
+        return (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+    }
+};
+
+// --- PAM -------------------------------------------------------------------
+
+const char* pam_tuple_type(int channels)
+{
+    switch (channels)
+    {
+        case 1: return "GRAYSCALE";
+        case 2: return "GRAYSCALE_ALPHA";
+        case 3: return "RGB";
+        default: return "RGB_ALPHA";
+    }
+}
+
+// Parses the header, returning the offset of the pixels (0 if invalid)
+std::size_t parse_pam_header(
+    const uchar* data,
+    std::size_t size,
+    int& width,
+    int& height,
+    int& channels)
+{
+    if (!is_pam(data, size))
+        return 0;
+    width = height = channels = 0;
+    int max_value = 0;
+    std::size_t pos = 3;
+    while (pos < size)
+    {
+        // One "KEY value" line at a time
+        const uchar* newline = std::find(data + pos, data + size, uchar('\n'));
+        if (newline == data + size)
+            return 0;
+        const std::size_t line_end = newline - data;
+        const std::string line(
+            reinterpret_cast<const char*>(data + pos), line_end - pos);
+        pos = line_end + 1;
+        const std::size_t space = line.find(' ');
+        const std::string key = line.substr(0, space);
+        const int value =
+            space == std::string::npos ? 0 : std::atoi(line.c_str() + space);
+        if (key == "ENDHDR")
+        {
+            const bool valid = width > 0 && height > 0 && channels >= 1 &&
+                               channels <= 4 && max_value == 255;
+            return valid ? pos : 0;
+        }
+        if (key == "WIDTH")
+            width = value;
+        else if (key == "HEIGHT")
+            height = value;
+        else if (key == "DEPTH")
+            channels = value;
+        else if (key == "MAXVAL")
+            max_value = value;
+    }
+    return 0;
+}
+
+uchar luminance(const uchar* rgb)
+{
+    return static_cast<uchar>((rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29) >> 8);
+}
+}  // namespace
+
+std::vector<uchar> encode_png(const Image& image)
+{
+    const int width = image.width();
+    const int height = image.height();
+    const int channels = image.channels();
+    static const uchar color_types[5] = { 0, 0, 4, 2, 6 };
+    if (channels < 1 || channels > 4)
+        throw std::runtime_error("Unsupported number of channels for PNG");
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("Cannot encode an empty image");
+
+    const std::size_t stride = image.stride();
+    const std::size_t filtered_stride = stride + 1;
+    const int strip_rows = static_cast<int>(
+        std::max<std::size_t>(1, kStripBytes / filtered_stride));
+    const int strips = (height + strip_rows - 1) / strip_rows;
+    // Rows before a strip that are filtered again for its dictionary
+    const int window_rows = static_cast<int>(
+        (kWindowSize + filtered_stride - 1) / filtered_stride);
+
+    struct Strip
+    {
+        std::vector<uchar> data;
+        std::uint32_t adler = 1;
+        std::size_t raw_size = 0;
+    };
+    std::vector<Strip> results(strips);
+    const std::vector<uchar> zeros(stride, 0);
+    parallel_for(
+        0,
+        strips,
+        1,
+        [&](int s0, int s1)
+        {
+            std::vector<uchar> filtered, scratch;
+            for (int s = s0; s < s1; ++s)
+            {
+                const int y0 = s * strip_rows;
+                const int y1 = std::min(height, y0 + strip_rows);
+                const int first = std::max(0, y0 - window_rows);
+                filtered.resize((y1 - first) * filtered_stride);
+                for (int y = first; y < y1; ++y)
+                {
+                    filter_row(
+                        image.row(y),
+                        y > 0 ? image.row(y - 1) : zeros.data(),
+                        stride,
+                        channels,
+                        filtered.data() + (y - first) * filtered_stride,
+                        scratch);
+                }
+                const int begin =
+                    static_cast<int>((y0 - first) * filtered_stride);
+                const int end = static_cast<int>(filtered.size());
+                Strip& strip = results[s];
+                deflate_strip(
+                    filtered.data(), begin, end, s + 1 == strips, strip.data);
+                strip.raw_size = end - begin;
+                strip.adler = adler32(filtered.data() + begin, strip.raw_size);
+            }
+        });
+
+    // One IDAT chunk per strip: the zlib header goes in the first one, the
+    // checksum of all the data in the last one
+    std::uint32_t adler = 1;
+    for (const Strip& strip : results)
+        adler = adler32_combine(adler, strip.adler, strip.raw_size);
+    results.front().data.insert(results.front().data.begin(), { 0x78, 0x01 });
+    put_be32(results.back().data, adler);
+    std::vector<std::uint32_t> crcs(strips);
+    parallel_for(
+        0,
+        strips,
+        1,
+        [&](int s0, int s1)
+        {
+            for (int s = s0; s < s1; ++s)
+            {
+                const std::vector<uchar>& data = results[s].data;
+                crcs[s] = crc32(
+                    crc32(0, reinterpret_cast<const uchar*>("IDAT"), 4),
+                    data.data(),
+                    data.size());
+            }
+        });
+
+    std::size_t total = 8 + 25 + 12;
+    for (const Strip& strip : results)
+        total += strip.data.size() + 12;
+    std::vector<uchar> out = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.reserve(total);
+    std::vector<uchar> header;
+    put_be32(header, width);
+    put_be32(header, height);
+    header.insert(header.end(), { 8, color_types[channels], 0, 0, 0 });
+    put_chunk(
+        out,
+        "IHDR",
+        header.data(),
+        header.size(),
+        crc32(
+            crc32(0, reinterpret_cast<const uchar*>("IHDR"), 4),
+            header.data(),
+            header.size()));
+    for (int s = 0; s < strips; ++s)
+    {
+        const std::vector<uchar>& data = results[s].data;
+        put_chunk(out, "IDAT", data.data(), data.size(), crcs[s]);
+    }
+    put_chunk(
+        out,
+        "IEND",
+        nullptr,
+        0,
+        crc32(0, reinterpret_cast<const uchar*>("IEND"), 4));
+    return out;
+}
+
+std::vector<uchar> encode_qoi(const Image& image)
+{
+    const int channels = image.channels();
+    if (channels != 3 && channels != 4)
+        throw std::runtime_error("QOI only stores RGB and RGBA images");
+    const std::size_t pixels =
+        static_cast<std::size_t>(image.width()) * image.height();
+
+    std::vector<uchar> out = { 'q', 'o', 'i', 'f' };
+    // Worst case: a tag byte per pixel, plus the header and end marker
+    out.reserve(kQoiHeaderSize + pixels * (channels + 1) + sizeof(kQoiEnd));
+    put_be32(out, image.width());
+    put_be32(out, image.height());
+    out.push_back(static_cast<uchar>(channels));
+    out.push_back(0);  // sRGB with linear alpha
+
+    QoiPixel index[64] = {};
+    for (QoiPixel& p : index)
+        p.a = 0;
+    QoiPixel previous;
+    int run = 0;
+    const uchar* src = image.data();
+    for (std::size_t i = 0; i < pixels; ++i, src += channels)
+    {
+        QoiPixel pixel;
+        pixel.r = src[0];
+        pixel.g = src[1];
+        pixel.b = src[2];
+        if (channels == 4)
+            pixel.a = src[3];
+
+        if (pixel == previous)
+        {
+            ++run;
+            if (run == 62 || i + 1 == pixels)
+            {
+                out.push_back(static_cast<uchar>(kQoiRun | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0)
+        {
+            out.push_back(static_cast<uchar>(kQoiRun | (run - 1)));
+            run = 0;
+        }
+        const int hash = pixel.hash();
+        if (index[hash] == pixel)
+        {
+            out.push_back(static_cast<uchar>(kQoiIndex | hash));
+        }
+        else
+        {
+            index[hash] = pixel;
+            if (pixel.a == previous.a)
+            {
+                const int dr = static_cast<signed char>(pixel.r - previous.r);
+                const int dg = static_cast<signed char>(pixel.g - previous.g);
+                const int db = static_cast<signed char>(pixel.b - previous.b);
+                const int dr_dg = dr - dg;
+                const int db_dg = db - dg;
+                if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+                {
+                    out.push_back(static_cast<uchar>(
+                        kQoiDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                }
+                else if (
+                    dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 &&
+                    db_dg > -9 && db_dg < 8)
+                {
+                    out.push_back(static_cast<uchar>(kQoiLuma | (dg + 32)));
+                    out.push_back(
+                        static_cast<uchar>((dr_dg + 8) << 4 | (db_dg + 8)));
+                }
+                else
+                {
+                    out.insert(
+                        out.end(), { kQoiRgb, pixel.r, pixel.g, pixel.b });
+                }
+            }
+            else
+            {
+                out.insert(
+                    out.end(),
+                    { kQoiRgba, pixel.r, pixel.g, pixel.b, pixel.a });
+            }
+        }
+        previous = pixel;
+    }
+    out.insert(out.end(), kQoiEnd, kQoiEnd + sizeof(kQoiEnd));
+    return out;
+}
+
+std::string pam_header(int width, int height, int channels)
+{
+    return "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " +
+           std::to_string(height) + "\nDEPTH " + std::to_string(channels) +
+           "\nMAXVAL 255\nTUPLTYPE " + pam_tuple_type(channels) +
+           "\nENDHDR\n";
+}
+
+std::vector<uchar> encode_pam(const Image& image)
+{
+    const std::string header =
+        pam_header(image.width(), image.height(), image.channels());
+    const std::size_t size = image.stride() * image.height();
+    std::vector<uchar> out(header.size() + size);
+    std::copy(header.begin(), header.end(), out.begin());
+    std::copy_n(image.data(), size, out.begin() + header.size());
+    return out;
+}
+
+bool is_qoi(const uchar* data, std::size_t size)
+{
+    return size >= kQoiHeaderSize && std::memcmp(data, "qoif", 4) == 0;
+}
+
+bool is_pam(const uchar* data, std::size_t size)
+{
+    return size >= 3 && std::memcmp(data, "P7\n", 3) == 0;
+}
+
+bool qoi_info(
+    const uchar* data,
+    std::size_t size,
+    int& width,
+    int& height,
+    int& channels)
+{
+    if (!is_qoi(data, size))
+        return false;
+    const std::uint32_t w = get_be32(data + 4);
+    const std::uint32_t h = get_be32(data + 8);
+    channels = data[12];
+    // The limit of the reference implementation
+    constexpr std::uint64_t kMaxPixels = 400000000;
+    if (w == 0 || h == 0 || std::uint64_t(w) * h > kMaxPixels ||
+        (channels != 3 && channels != 4))
+        return false;
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    return true;
+}
+
+bool pam_info(
+    const uchar* data,
+    std::size_t size,
+    int& width,
+    int& height,
+    int& channels)
+{
+    return parse_pam_header(data, size, width, height, channels) != 0;
+}
+
+std::size_t pam_pixel_offset(const uchar* data, std::size_t size)
+{
+    int width = 0, height = 0, channels = 0;
+    return parse_pam_header(data, size, width, height, channels);
+}
+
+Image decode_qoi(const uchar* data, std::size_t size)
+{
+    int width = 0, height = 0, channels = 0;
+    if (!qoi_info(data, size, width, height, channels))
+        throw std::runtime_error("Invalid QOI header");
+    Image image(width, height, channels);
+    const std::size_t pixels = static_cast<std::size_t>(width) * height;
+    const std::size_t chunks_end = size - std::min(size, sizeof(kQoiEnd));
+
+    QoiPixel index[64] = {};
+    for (QoiPixel& p : index)
+        p.a = 0;
+    QoiPixel pixel;
+    int run = 0;
+    std::size_t p = kQoiHeaderSize;
+    uchar* dst = image.data();
+    for (std::size_t i = 0; i < pixels; ++i, dst += channels)
+    {
+        if (run > 0)
+        {
+            --run;
+        }
+        else
+        {
+            if (p >= chunks_end)
+                throw std::runtime_error("Truncated QOI data");
+            const uchar b1 = data[p++];
+            if (b1 == kQoiRgb)
+            {
+                if (p + 3 > chunks_end)
+                    throw std::runtime_error("Truncated QOI data");
+                pixel.r = data[p];
+                pixel.g = data[p + 1];
+                pixel.b = data[p + 2];
+                p += 3;
+            }
+            else if (b1 == kQoiRgba)
+            {
+                if (p + 4 > chunks_end)
+                    throw std::runtime_error("Truncated QOI data");
+                pixel.r = data[p];
+                pixel.g = data[p + 1];
+                pixel.b = data[p + 2];
+                pixel.a = data[p + 3];
+                p += 4;
+            }
+            else if ((b1 & kQoiMask) == kQoiIndex)
+            {
+                pixel = index[b1];
+            }
+            else if ((b1 & kQoiMask) == kQoiDiff)
+            {
+                pixel.r += ((b1 >> 4) & 0x03) - 2;
+                pixel.g += ((b1 >> 2) & 0x03) - 2;
+                pixel.b += (b1 & 0x03) - 2;
+            }
+            else if ((b1 & kQoiMask) == kQoiLuma)
+            {
+                if (p >= chunks_end)
+                    throw std::runtime_error("Truncated QOI data");
+                const uchar b2 = data[p++];
+                const int dg = (b1 & 0x3F) - 32;
+                pixel.r += dg - 8 + ((b2 >> 4) & 0x0F);
+                pixel.g += dg;
+                pixel.b += dg - 8 + (b2 & 0x0F);
+            }
+            else
+            {
+                run = b1 & 0x3F;
+            }
+            index[pixel.hash()] = pixel;
+        }
+        dst[0] = pixel.r;
+        dst[1] = pixel.g;
+        dst[2] = pixel.b;
+        if (channels == 4)
+            dst[3] = pixel.a;
+    }
+    return image;
+}
+
+Image decode_pam(const uchar* data, std::size_t size)
+{
+    int width = 0, height = 0, channels = 0;
+    const std::size_t offset =
+        parse_pam_header(data, size, width, height, channels);
+    if (offset == 0)
+        throw std::runtime_error("Invalid PAM header");
+    const std::size_t row_bytes = static_cast<std::size_t>(width) * channels;
+    if ((size - offset) / row_bytes < static_cast<std::size_t>(height))
+        throw std::runtime_error("Truncated PAM data");
+    const std::size_t bytes = row_bytes * height;
+    auto pixels = std::unique_ptr<uchar[]>(new uchar[bytes]);
+    std::copy_n(data + offset, bytes, pixels.get());
+    return Image(width, height, channels, std::move(pixels));
+}
+
+Image convert_channels(const Image& image, int channels)
+{
+    const int from = image.channels();
+    if (channels == from)
+        return image;
+    if (from < 1 || from > 4 || channels < 1 || channels > 4)
+        throw std::runtime_error("Unsupported channel conversion");
+    Image result(image.width(), image.height(), channels);
+    const std::size_t width = image.width();
+    uchar* const data = result.data();
+    parallel_for(
+        image.height(),
+        rows_grain(image.width()),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                const uchar* src = image.row(y);
+                uchar* dst = data + y * result.stride();
+                for (std::size_t x = 0; x < width;
+                     ++x, src += from, dst += channels)
+                {
+                    const bool color = from >= 3;
+                    const uchar gray = color ? luminance(src) : src[0];
+                    const uchar alpha =
+                        from == 2 ? src[1] : from == 4 ? src[3] : 255;
+                    if (channels <= 2)
+                    {
+                        dst[0] = gray;
+                    }
+                    else
+                    {
+                        dst[0] = color ? src[0] : gray;
+                        dst[1] = color ? src[1] : gray;
+                        dst[2] = color ? src[2] : gray;
+                    }
+                    if (channels == 2 || channels == 4)
+                        dst[channels - 1] = alpha;
+                }
+            }
+        });
+    return result;
+}
+}  // namespace image_codecs
+}  // namespace USTC_CG
@@ -0,0 +1,59 @@
+#pragma once
+
+// Encoders and decoders behind image_io.h that do not come from stb.
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "common/image.h"
+
+namespace USTC_CG
+{
+namespace image_codecs
+{
+// PNG with the rows filtered and deflated in independent strips, on all
+// threads. Each strip starts from the last 32 KiB of the previous one as
+// its dictionary, so the result is as small as a sequential encoding with
+// the same (fixed Huffman) coder.
+std::vector<unsigned char> encode_png(const Image& image);
+
+// QOI, "The Quite OK Image Format": fast lossless coding of RGB(A) images.
+// Throws std::runtime_error for other channel counts.
+std::vector<unsigned char> encode_qoi(const Image& image);
+
+// Netpbm PAM: a short text header followed by the raw pixels.
+std::vector<unsigned char> encode_pam(const Image& image);
+// The header alone, for writing the rows of a PAM file one at a time.
+std::string pam_header(int width, int height, int channels);
+
+// Whether `data` starts like a QOI / PAM file.
+bool is_qoi(const unsigned char* data, std::size_t size);
+bool is_pam(const unsigned char* data, std::size_t size);
+
+// Header information, false if the header is invalid.
+bool qoi_info(
+    const unsigned char* data,
+    std::size_t size,
+    int& width,
+    int& height,
+    int& channels);
+bool pam_info(
+    const unsigned char* data,
+    std::size_t size,
+    int& width,
+    int& height,
+    int& channels);
+// Offset of the pixels of a PAM file, 0 if the header is invalid.
+std::size_t pam_pixel_offset(const unsigned char* data, std::size_t size);
+
+// Decoders. The result has the channels of the file. They throw
+// std::runtime_error on malformed data.
+Image decode_qoi(const unsigned char* data, std::size_t size);
+Image decode_pam(const unsigned char* data, std::size_t size);
+
+// Converts between 1 (gray), 2 (gray, alpha), 3 (RGB) and 4 (RGBA)
+// channels the way stb_image does when asked for a channel count.
+Image convert_channels(const Image& image, int channels);
+}  // namespace image_codecs
+}  // namespace USTC_CG
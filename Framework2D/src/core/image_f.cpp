@@ -0,0 +1,196 @@
+#include "common/image_f.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace USTC_CG
+{
+namespace
+{
+// Interleaved 8-bit row -> one float per channel plane. The channel count is
+// a template parameter so that the strided loads are known at compile time
+// and the loop vectorizes.
+template<int C>
+void deinterleave_row(
+    const unsigned char* __restrict src,
+    float* const* dst,
+    int width)
+{
+    for (int c = 0; c < C; ++c)
+    {
+        float* __restrict out = dst[c];
+        for (int x = 0; x < width; ++x)
+            out[x] = static_cast<float>(src[x * C + c]);
+    }
+}
+
+void deinterleave_row(
+    const unsigned char* src,
+    float* const* dst,
+    int width,
+    int channels)
+{
+    switch (channels)
+    {
+        case 1: deinterleave_row<1>(src, dst, width); break;
+        case 2: deinterleave_row<2>(src, dst, width); break;
+        case 3: deinterleave_row<3>(src, dst, width); break;
+        case 4: deinterleave_row<4>(src, dst, width); break;
+        default:
+            for (int c = 0; c < channels; ++c)
+                for (int x = 0; x < width; ++x)
+                    dst[c][x] = static_cast<float>(src[x * channels + c]);
+            break;
+    }
+}
+
+inline unsigned char quantize(float v)
+{
+    return static_cast<unsigned char>(std::clamp(v, 0.0f, 255.0f) + 0.5f);
+}
+
+template<int C>
+void interleave_row(
+    const float* const* src,
+    unsigned char* __restrict dst,
+    int width)
+{
+    for (int c = 0; c < C; ++c)
+    {
+        const float* __restrict in = src[c];
+        for (int x = 0; x < width; ++x)
+            dst[x * C + c] = quantize(in[x]);
+    }
+}
+
+void interleave_row(
+    const float* const* src,
+    unsigned char* dst,
+    int width,
+    int src_channels,
+    int dst_channels)
+{
+    if (src_channels == dst_channels)
+    {
+        switch (dst_channels)
+        {
+            case 1: interleave_row<1>(src, dst, width); return;
+            case 3: interleave_row<3>(src, dst, width); return;
+            case 4: interleave_row<4>(src, dst, width); return;
+            default: break;
+        }
+    }
+    const int copied = std::min(src_channels, dst_channels);
+    for (int x = 0; x < width; ++x)
+    {
+        unsigned char* pixel = dst + x * dst_channels;
+        for (int c = 0; c < copied; ++c)
+            pixel[c] = quantize(src[c][x]);
+        for (int c = copied; c < dst_channels; ++c)
+            pixel[c] = 255;
+    }
+}
+}  // namespace
+
+ImageF::ImageF(int width, int height, int channels)
+{
+    allocate(width, height, channels);
+    fill(0.0f);
+}
+
+ImageF::ImageF(const Image& image)
+{
+    from_image(image);
+}
+
+ImageF::ImageF(const ImageF& other)
+{
+    allocate(other.width_, other.height_, other.channels_);
+    if (data_)
+        std::memcpy(
+            data_.get(),
+            other.data_.get(),
+            plane_size() * channels_ * sizeof(float));
+}
+
+ImageF& ImageF::operator=(const ImageF& other)
+{
+    if (this != &other)
+    {
+        if (width_ != other.width_ || height_ != other.height_ ||
+            channels_ != other.channels_)
+            allocate(other.width_, other.height_, other.channels_);
+        if (data_)
+            std::memcpy(
+                data_.get(),
+                other.data_.get(),
+                plane_size() * channels_ * sizeof(float));
+    }
+    return *this;
+}
+
+void ImageF::allocate(int width, int height, int channels)
+{
+    if (width < 0 || height < 0 || channels < 0)
+    {
+        throw std::invalid_argument("Negative image dimensions");
+    }
+    width_ = width;
+    height_ = height;
+    channels_ = channels;
+    // Pad rows so that every row of every plane starts 64-byte aligned
+    stride_ = (static_cast<std::size_t>(width) + kRowAlignment - 1) /
+              kRowAlignment * kRowAlignment;
+    const std::size_t count = plane_size() * static_cast<std::size_t>(channels);
+    data_.reset(
+        count ? new (std::align_val_t(kAlignment)) float[count] : nullptr);
+}
+
+void ImageF::fill(float value)
+{
+    if (data_)
+        std::fill_n(data_.get(), plane_size() * channels_, value);
+}
+
+void ImageF::from_image(const Image& image)
+{
+    if (width_ != image.width() || height_ != image.height() ||
+        channels_ != image.channels())
+        allocate(image.width(), image.height(), image.channels());
+
+    std::vector<float*> planes(channels_);
+    for (int y = 0; y < height_; ++y)
+    {
+        for (int c = 0; c < channels_; ++c)
+            planes[c] = row(c, y);
+        deinterleave_row(image.row(y), planes.data(), width_, channels_);
+        // Keep the padding deterministic for kernels that read whole strides
+        for (int c = 0; c < channels_; ++c)
+            std::fill(planes[c] + width_, planes[c] + stride_, 0.0f);
+    }
+}
+
+Image ImageF::to_image(int channels) const
+{
+    Image image(width_, height_, channels > 0 ? channels : channels_);
+    to_image(image);
+    return image;
+}
+
+void ImageF::to_image(Image& image) const
+{
+    if (image.width() != width_ || image.height() != height_)
+    {
+        throw std::invalid_argument("Image size does not match");
+    }
+    std::vector<const float*> planes(channels_);
+    for (int y = 0; y < height_; ++y)
+    {
+        for (int c = 0; c < channels_; ++c)
+            planes[c] = row(c, y);
+        interleave_row(
+            planes.data(), image.row(y), width_, channels_, image.channels());
+    }
+}
+}  // namespace USTC_CG
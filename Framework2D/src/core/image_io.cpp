@@ -0,0 +1,247 @@
+#include "common/image_io.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+#include "common/tiled_image.h"
+#include "image_codecs.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+namespace USTC_CG
+{
+using uchar = unsigned char;
+
+namespace
+{
+std::string extension(const std::string& filename)
+{
+    const std::size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos)
+        return "";
+    std::string ext = filename.substr(dot + 1);
+    std::transform(
+        ext.begin(),
+        ext.end(),
+        ext.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext;
+}
+
+// Reads at most `max_size` bytes of a file
+bool read_file(
+    const std::string& filename,
+    std::vector<uchar>& data,
+    std::size_t max_size = std::numeric_limits<std::size_t>::max())
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    const std::size_t size =
+        std::min<std::size_t>(static_cast<std::size_t>(file.tellg()), max_size);
+    file.seekg(0);
+    data.resize(size);
+    file.read(
+        reinterpret_cast<char*>(data.data()),
+        static_cast<std::streamsize>(size));
+    return static_cast<std::size_t>(file.gcount()) == size;
+}
+}  // namespace
+
+bool read_image_info(
+    const std::string& filename,
+    int& width,
+    int& height,
+    int& channels)
+{
+    // The headers of QOI and PAM files are short
+    std::vector<uchar> header;
+    if (!read_file(filename, header, 4096))
+        return false;
+    if (image_codecs::is_qoi(header.data(), header.size()))
+        return image_codecs::qoi_info(
+            header.data(), header.size(), width, height, channels);
+    if (image_codecs::is_pam(header.data(), header.size()))
+        return image_codecs::pam_info(
+            header.data(), header.size(), width, height, channels);
+    return stbi_info(filename.c_str(), &width, &height, &channels) != 0;
+}
+
+Image load_image(const std::string& filename, int channels)
+{
+    std::vector<uchar> file;
+    if (!read_file(filename, file))
+        throw std::runtime_error("Failed to read image file " + filename);
+    if (image_codecs::is_qoi(file.data(), file.size()) ||
+        image_codecs::is_pam(file.data(), file.size()))
+    {
+        Image image = image_codecs::is_qoi(file.data(), file.size())
+                          ? image_codecs::decode_qoi(file.data(), file.size())
+                          : image_codecs::decode_pam(file.data(), file.size());
+        if (channels > 0)
+            image = image_codecs::convert_channels(image, channels);
+        return image;
+    }
+
+    int width = 0, height = 0, file_channels = 0;
+    // stbi_load is reentrant as long as the global flip / conversion
+    // settings are left alone, which is the case in this project.
+    uchar* data = stbi_load_from_memory(
+        file.data(),
+        static_cast<int>(file.size()),
+        &width,
+        &height,
+        &file_channels,
+        channels);
+    if (data == nullptr)
+    {
+        throw std::runtime_error(
+            "Failed to load image from file " + filename + ": " +
+            stbi_failure_reason());
+    }
+    return Image(
+        width,
+        height,
+        channels > 0 ? channels : file_channels,
+        std::shared_ptr<uchar[]>(data, stbi_image_free));
+}
+
+void load_image(const std::string& filename, TiledImage& image)
+{
+    std::vector<uchar> header;
+    if (!read_file(filename, header, 4096))
+        throw std::runtime_error("Failed to read image file " + filename);
+    const std::size_t offset =
+        image_codecs::pam_pixel_offset(header.data(), header.size());
+    if (offset == 0)
+    {
+        const Image decoded = load_image(filename, image.channels());
+        if (decoded.width() != image.width() ||
+            decoded.height() != image.height())
+        {
+            throw std::invalid_argument("Image size does not match");
+        }
+        image.write_region({ 0, 0, image.width(), image.height() }, decoded);
+        return;
+    }
+
+    int width = 0, height = 0, channels = 0;
+    image_codecs::pam_info(
+        header.data(), header.size(), width, height, channels);
+    if (width != image.width() || height != image.height())
+        throw std::invalid_argument("Image size does not match");
+    std::ifstream file(filename, std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(offset));
+    Image row(width, 1, channels);
+    for (int y = 0; y < height; ++y)
+    {
+        file.read(
+            reinterpret_cast<char*>(row.data()),
+            static_cast<std::streamsize>(row.stride()));
+        if (!file)
+            throw std::runtime_error("Truncated PAM data in " + filename);
+        // Released before the next row is read, so that row is not copied
+        // on write
+        const Image converted =
+            image_codecs::convert_channels(row, image.channels());
+        image.write_region({ 0, y, width, y + 1 }, converted);
+    }
+}
+
+ImageFormat image_format_for(const std::string& filename)
+{
+    const std::string ext = extension(filename);
+    if (ext == "qoi")
+        return ImageFormat::kQoi;
+    if (ext == "pam")
+        return ImageFormat::kPam;
+    if (ext == "jpg" || ext == "jpeg")
+        return ImageFormat::kJpeg;
+    if (ext == "bmp")
+        return ImageFormat::kBmp;
+    if (ext == "tga")
+        return ImageFormat::kTga;
+    return ImageFormat::kPng;
+}
+
+std::vector<uchar> encode_image(const Image& image, ImageFormat format)
+{
+    switch (format)
+    {
+        case ImageFormat::kPng: return image_codecs::encode_png(image);
+        case ImageFormat::kQoi: return image_codecs::encode_qoi(image);
+        case ImageFormat::kPam: return image_codecs::encode_pam(image);
+        default: break;
+    }
+    std::vector<uchar> out;
+    auto append = [](void* context, void* data, int size)
+    {
+        auto* out = static_cast<std::vector<uchar>*>(context);
+        out->insert(
+            out->end(),
+            static_cast<const uchar*>(data),
+            static_cast<const uchar*>(data) + size);
+    };
+    const int w = image.width(), h = image.height(), c = image.channels();
+    int ok = 0;
+    if (format == ImageFormat::kJpeg)
+        ok = stbi_write_jpg_to_func(append, &out, w, h, c, image.data(), 95);
+    else if (format == ImageFormat::kBmp)
+        ok = stbi_write_bmp_to_func(append, &out, w, h, c, image.data());
+    else
+        ok = stbi_write_tga_to_func(append, &out, w, h, c, image.data());
+    if (!ok)
+        throw std::runtime_error("Failed to encode image");
+    return out;
+}
+
+void save_image(const std::string& filename, const Image& image)
+{
+    const std::vector<uchar> data =
+        encode_image(image, image_format_for(filename));
+    std::ofstream file(filename, std::ios::binary);
+    file.write(
+        reinterpret_cast<const char*>(data.data()),
+        static_cast<std::streamsize>(data.size()));
+    if (!file)
+    {
+        throw std::runtime_error("Failed to save image to file " + filename);
+    }
+}
+
+void save_image(const std::string& filename, const TiledImage& image)
+{
+    const int width = image.width(), height = image.height();
+    if (image_format_for(filename) != ImageFormat::kPam)
+    {
+        save_image(filename, image.read_region({ 0, 0, width, height }));
+        return;
+    }
+    std::ofstream file(filename, std::ios::binary);
+    const std::string header =
+        image_codecs::pam_header(width, height, image.channels());
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width;)
+        {
+            const auto segment = image.row_segment(x, y);
+            file.write(
+                reinterpret_cast<const char*>(segment.data()),
+                static_cast<std::streamsize>(segment.size()));
+            x += static_cast<int>(segment.size()) / image.channels();
+        }
+    }
+    if (!file)
+    {
+        throw std::runtime_error("Failed to save image to file " + filename);
+    }
+}
+}  // namespace USTC_CG
@@ -0,0 +1,102 @@
+#include "common/image_loader.h"
+
+#include <algorithm>
+
+#include "common/image_io.h"
+#include "common/image_ops.h"
+
+namespace USTC_CG
+{
+namespace
+{
+ImageLoader::Result decode(const std::string& filename)
+{
+    ImageLoader::Result result;
+    result.image = std::make_shared<Image>(load_image(filename, 4));
+    const Image& image = *result.image;
+    result.preview = std::make_shared<Image>(downsample(
+        image,
+        downsample_factor(
+            image.width(), image.height(), ImageLoader::kPreviewSize)));
+    return result;
+}
+}  // namespace
+
+ImageLoader::ImageLoader(int num_workers)
+{
+    if (num_workers <= 0)
+        num_workers = std::max(
+            1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    for (int i = 0; i < num_workers; ++i)
+        workers_.emplace_back(&ImageLoader::worker_loop, this);
+}
+
+ImageLoader::~ImageLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+ImageLoader& ImageLoader::instance()
+{
+    static ImageLoader loader;
+    return loader;
+}
+
+std::future<ImageLoader::Result> ImageLoader::load(
+    const std::string& filename,
+    Callback on_done)
+{
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto future = promise->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.emplace_back(
+            [filename, on_done = std::move(on_done), promise]()
+            {
+                Result result;
+                try
+                {
+                    result = decode(filename);
+                }
+                catch (...)
+                {
+                    promise->set_exception(std::current_exception());
+                    if (on_done)
+                        on_done(Result{});
+                    return;
+                }
+                // The future is set first, so that it is ready when the
+                // callback wakes the thread waiting on it
+                promise->set_value(result);
+                if (on_done)
+                    on_done(result);
+            });
+    }
+    cv_.notify_one();
+    return future;
+}
+
+void ImageLoader::worker_loop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            // Pending loads are dropped on shutdown
+            if (stopping_)
+                return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+}  // namespace USTC_CG
@@ -0,0 +1,194 @@
+#include "common/image_ops.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "color_kernels.h"
+#include "common/parallel.h"
+
+namespace USTC_CG
+{
+using uchar = unsigned char;
+
+namespace
+{
+// Runs body(row) on every row of `image`, in parallel. The buffer is
+// detached once here, not concurrently in the workers.
+template<typename Body>
+void for_each_row(Image& image, const Body& body)
+{
+    uchar* const data = image.data();
+    const std::size_t stride = image.stride();
+    parallel_for(
+        image.height(),
+        rows_grain(image.width()),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+                body(data + y * stride);
+        });
+}
+}  // namespace
+
+void invert(Image& image)
+{
+    const std::size_t width = image.width();
+    const int channels = image.channels();
+    for_each_row(
+        image,
+        [&](uchar* row) { color_kernels::invert_row(row, width, channels); });
+}
+
+void mirror(Image& image, bool is_horizontal, bool is_vertical)
+{
+    if (!is_horizontal && !is_vertical)
+        return;
+
+    const int width = image.width();
+    const int height = image.height();
+    const int channels = image.channels();
+    const std::size_t stride = image.stride();
+    if (!is_vertical)
+    {
+        for_each_row(
+            image,
+            [&](uchar* row)
+            { color_kernels::reverse_row(row, width, channels); });
+        return;
+    }
+
+    // Swaps the rows y and height - 1 - y, reversing both if needed
+    uchar* const data = image.data();
+    parallel_for(
+        (height + 1) / 2,
+        rows_grain(width),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                uchar* top = data + y * stride;
+                uchar* bottom = data + (height - 1 - y) * stride;
+                if (is_horizontal)
+                {
+                    color_kernels::reverse_row(top, width, channels);
+                    if (bottom != top)
+                        color_kernels::reverse_row(bottom, width, channels);
+                }
+                if (bottom != top)
+                    std::swap_ranges(top, top + stride, bottom);
+            }
+        });
+}
+
+void gray_scale(Image& image, GrayMode mode)
+{
+    const int channels = image.channels();
+    if (channels < 3)
+        return;
+    const std::size_t width = image.width();
+    for_each_row(
+        image,
+        [&](uchar* row)
+        { color_kernels::gray_row(row, width, channels, mode); });
+}
+
+void swizzle_channels(Image& image, const std::array<int, 4>& order)
+{
+    const int channels = image.channels();
+    if (channels > 4)
+        throw std::invalid_argument("Too many channels to swizzle");
+    uchar indices[4] = {};
+    for (int c = 0; c < channels; ++c)
+    {
+        if (order[c] < 0 || order[c] >= channels)
+            throw std::invalid_argument("Invalid channel index");
+        indices[c] = static_cast<uchar>(order[c]);
+    }
+    const std::size_t width = image.width();
+    for_each_row(
+        image,
+        [&](uchar* row)
+        { color_kernels::swizzle_row(row, width, channels, indices); });
+}
+
+Image rgb_to_rgba(const Image& image, unsigned char alpha)
+{
+    if (image.channels() != 3)
+        throw std::invalid_argument("Expected an RGB image");
+    Image result(image.width(), image.height(), 4);
+    const auto& kernels = color_kernels::current();
+    const std::size_t width = image.width();
+    uchar* const data = result.data();
+    parallel_for(
+        image.height(),
+        rows_grain(image.width()),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                kernels.rgb_to_rgba(
+                    image.row(y), data + y * result.stride(), width, alpha);
+            }
+        });
+    return result;
+}
+
+Image rgba_to_rgb(const Image& image)
+{
+    if (image.channels() != 4)
+        throw std::invalid_argument("Expected an RGBA image");
+    Image result(image.width(), image.height(), 3);
+    const auto& kernels = color_kernels::current();
+    const std::size_t width = image.width();
+    uchar* const data = result.data();
+    parallel_for(
+        image.height(),
+        rows_grain(image.width()),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                kernels.rgba_to_rgb(
+                    image.row(y), data + y * result.stride(), width);
+            }
+        });
+    return result;
+}
+
+Image downsample(const Image& image, int factor)
+{
+    if (factor < 1)
+        throw std::invalid_argument("Downsampling factor must be positive");
+    const int width = std::max(1, image.width() / factor);
+    const int height = std::max(1, image.height() / factor);
+    const int channels = image.channels();
+    Image result(width, height, channels);
+    std::vector<unsigned> sum(static_cast<std::size_t>(width) * channels);
+    for (int y = 0; y < height; ++y)
+    {
+        std::fill(sum.begin(), sum.end(), 0u);
+        for (int sy = y * factor; sy < (y + 1) * factor; ++sy)
+        {
+            const uchar* src = image.row(std::min(sy, image.height() - 1));
+            for (int x = 0; x < width * factor; ++x)
+            {
+                const int sx = std::min(x, image.width() - 1);
+                for (int c = 0; c < channels; ++c)
+                    sum[(x / factor) * channels + c] += src[sx * channels + c];
+            }
+        }
+        uchar* dst = result.row(y);
+        const unsigned count = static_cast<unsigned>(factor * factor);
+        for (std::size_t i = 0; i < sum.size(); ++i)
+            dst[i] = static_cast<uchar>(sum[i] / count);
+    }
+    return result;
+}
+
+int downsample_factor(int width, int height, int max_size)
+{
+    return std::max(
+        1, (std::max(width, height) + max_size - 1) / std::max(1, max_size));
+}
+}  // namespace USTC_CG
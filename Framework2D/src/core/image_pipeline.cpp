@@ -0,0 +1,389 @@
+#include "common/image_pipeline.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "color_kernels.h"
+#include "common/parallel.h"
+
+namespace USTC_CG
+{
+using uchar = unsigned char;
+
+namespace
+{
+// Evaluates the wrapped warper at flipped output coordinates. The flips are
+// integer reflections, so the wrapped warper sees exactly the coordinates
+// it would see if the flip were applied to its result afterwards.
+class FlippedWarper : public Warper
+{
+   public:
+    FlippedWarper(Warper& warper, int width, int height, bool fx, bool fy)
+        : warper_(warper),
+          width_(width),
+          height_(height),
+          flip_x_(fx),
+          flip_y_(fy)
+    {
+    }
+
+    std::pair<float, float> warp(float x, float y) override
+    {
+        return warper_.warp(
+            flip_x_ ? width_ - 1 - x : x, flip_y_ ? height_ - 1 - y : y);
+    }
+    void warp_batch(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) override
+    {
+        // The result may overwrite the coordinates, so they are flipped in
+        // place
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            out_x[i] = flip_x_ ? width_ - 1 - xs[i] : xs[i];
+            out_y[i] = flip_y_ ? height_ - 1 - ys[i] : ys[i];
+        }
+        warper_.warp_batch(out_x, out_y, out_x, out_y, n);
+    }
+    bool is_thread_safe() const override
+    {
+        return warper_.is_thread_safe();
+    }
+
+   private:
+    Warper& warper_;
+    int width_, height_;
+    bool flip_x_, flip_y_;
+};
+}  // namespace
+
+ImagePipeline::ImagePipeline(Image source) : image_(std::move(source))
+{
+}
+
+void ImagePipeline::reset(Image source)
+{
+    image_ = std::move(source);
+    ops_.clear();
+}
+
+ImagePipeline& ImagePipeline::invert()
+{
+    // Two inverts in a row cancel out
+    if (!ops_.empty() && ops_.back().kind == Op::kInvert)
+        ops_.pop_back();
+    else
+    {
+        Op op;
+        op.kind = Op::kInvert;
+        ops_.push_back(op);
+    }
+    return *this;
+}
+
+ImagePipeline& ImagePipeline::gray_scale(GrayMode mode)
+{
+    // A gray image is left as is by either mode
+    if (image_.channels() >= 3 &&
+        (ops_.empty() || ops_.back().kind != Op::kGray))
+    {
+        Op op;
+        op.kind = Op::kGray;
+        op.gray_mode = mode;
+        ops_.push_back(op);
+    }
+    return *this;
+}
+
+ImagePipeline& ImagePipeline::mirror(bool is_horizontal, bool is_vertical)
+{
+    if (!is_horizontal && !is_vertical)
+        return *this;
+    if (!ops_.empty() && ops_.back().kind == Op::kMirror)
+    {
+        Op& last = ops_.back();
+        last.flip_x ^= is_horizontal;
+        last.flip_y ^= is_vertical;
+        if (!last.flip_x && !last.flip_y)
+            ops_.pop_back();
+        return *this;
+    }
+    Op op;
+    op.kind = Op::kMirror;
+    op.flip_x = is_horizontal;
+    op.flip_y = is_vertical;
+    ops_.push_back(op);
+    return *this;
+}
+
+ImagePipeline& ImagePipeline::swizzle_channels(const std::array<int, 4>& order)
+{
+    const int channels = image_.channels();
+    if (channels > 4)
+        throw std::invalid_argument("Too many channels to swizzle");
+    Op op;
+    op.kind = Op::kSwizzle;
+    for (int c = 0; c < channels; ++c)
+    {
+        if (order[c] < 0 || order[c] >= channels)
+            throw std::invalid_argument("Invalid channel index");
+        op.order[c] = static_cast<uchar>(order[c]);
+    }
+    // Two swizzles in a row make one
+    if (!ops_.empty() && ops_.back().kind == Op::kSwizzle)
+    {
+        Op& last = ops_.back();
+        bool identity = true;
+        std::array<uchar, 4> composed{};
+        for (int c = 0; c < channels; ++c)
+        {
+            composed[c] = last.order[op.order[c]];
+            identity = identity && composed[c] == c;
+        }
+        last.order = composed;
+        if (identity)
+            ops_.pop_back();
+        return *this;
+    }
+    ops_.push_back(op);
+    return *this;
+}
+
+ImagePipeline& ImagePipeline::warp(
+    std::shared_ptr<Warper> warper,
+    Interpolation interpolation)
+{
+    Op op;
+    op.kind = Op::kWarp;
+    op.warper = std::move(warper);
+    op.interpolation = interpolation;
+    ops_.push_back(std::move(op));
+    return *this;
+}
+
+std::size_t ImagePipeline::pending() const
+{
+    return ops_.size();
+}
+
+const Image& ImagePipeline::evaluate()
+{
+    if (ops_.empty())
+        return image_;
+
+    Image current = std::move(image_);
+    const int channels = current.channels();
+    // Operations not applied yet: the pre-stage of the next warp, or the
+    // post-stage of `warp`
+    Stage stage;
+    const Op* warp = nullptr;
+    auto flush = [&]
+    {
+        if (warp)
+            current = apply_warp(current, *warp, stage);
+        else if (!stage.empty())
+            apply(current, stage);
+        stage = {};
+        warp = nullptr;
+    };
+    try
+    {
+        for (const Op& op : ops_)
+        {
+            switch (op.kind)
+            {
+                case Op::kMirror:
+                    stage.flip_x ^= op.flip_x;
+                    stage.flip_y ^= op.flip_y;
+                    break;
+                case Op::kWarp:
+                {
+                    if (warp)
+                        flush();
+                    // Nearest sampling copies pixels, so the point
+                    // operations on the sampled channels may as well run on
+                    // the warped rows
+                    Stage carried;
+                    if (op.interpolation == Interpolation::kNearest &&
+                        !stage.flip_x && !stage.flip_y &&
+                        std::all_of(
+                            stage.points.begin(),
+                            stage.points.end(),
+                            [&](const Op& point) {
+                                return commutes_with_nearest(point, channels);
+                            }))
+                    {
+                        carried.points = std::move(stage.points);
+                        stage = {};
+                    }
+                    flush();
+                    stage = std::move(carried);
+                    warp = &op;
+                    break;
+                }
+                default: stage.points.push_back(op); break;
+            }
+        }
+        flush();
+    }
+    catch (...)
+    {
+        image_ = std::move(current);
+        ops_.clear();
+        throw;
+    }
+    image_ = std::move(current);
+    ops_.clear();
+    return image_;
+}
+
+void ImagePipeline::apply_points(
+    const std::vector<Op>& points,
+    uchar* row,
+    std::size_t width,
+    int channels)
+{
+    for (const Op& op : points)
+    {
+        switch (op.kind)
+        {
+            case Op::kInvert:
+                color_kernels::invert_row(row, width, channels);
+                break;
+            case Op::kGray:
+                color_kernels::gray_row(row, width, channels, op.gray_mode);
+                break;
+            case Op::kSwizzle:
+                color_kernels::swizzle_row(
+                    row, width, channels, op.order.data());
+                break;
+            default: break;
+        }
+    }
+}
+
+bool ImagePipeline::commutes_with_nearest(const Op& op, int channels)
+{
+    // Warps only sample the color channels, and keep alpha in place
+    if (op.kind != Op::kSwizzle || channels < 4)
+        return true;
+    return op.order[0] < 3 && op.order[1] < 3 && op.order[2] < 3 &&
+           op.order[3] == 3;
+}
+
+void ImagePipeline::apply(Image& image, const Stage& stage)
+{
+    const int width = image.width();
+    const int height = image.height();
+    const int channels = image.channels();
+    const std::size_t stride = image.stride();
+    if (image.is_shared())
+    {
+        // Write a new buffer rather than copying the shared one first: one
+        // read of each source row, then everything in cache
+        const std::size_t size = stride * height;
+        Image result(
+            width,
+            height,
+            channels,
+            std::unique_ptr<uchar[]>(new uchar[size]));
+        uchar* const data = result.data();
+        parallel_for(
+            height,
+            rows_grain(width),
+            [&](int y0, int y1)
+            {
+                for (int y = y0; y < y1; ++y)
+                {
+                    uchar* row = data + y * stride;
+                    std::copy_n(
+                        image.row(stage.flip_y ? height - 1 - y : y),
+                        stride,
+                        row);
+                    if (stage.flip_x)
+                        color_kernels::reverse_row(row, width, channels);
+                    apply_points(stage.points, row, width, channels);
+                }
+            });
+        image = std::move(result);
+        return;
+    }
+
+    // In place, on the rows y and height - 1 - y together when flipping
+    // upside-down
+    uchar* const data = image.data();
+    auto finish_row = [&](uchar* row)
+    {
+        if (stage.flip_x)
+            color_kernels::reverse_row(row, width, channels);
+        apply_points(stage.points, row, width, channels);
+    };
+    parallel_for(
+        stage.flip_y ? (height + 1) / 2 : height,
+        rows_grain(width),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                uchar* top = data + y * stride;
+                uchar* bottom =
+                    stage.flip_y ? data + (height - 1 - y) * stride : top;
+                finish_row(top);
+                if (bottom != top)
+                {
+                    finish_row(bottom);
+                    std::swap_ranges(top, top + stride, bottom);
+                }
+            }
+        });
+}
+
+Image ImagePipeline::apply_warp(
+    const Image& image,
+    const Op& warp,
+    const Stage& post)
+{
+    const int width = image.width();
+    const int height = image.height();
+    const int channels = image.channels();
+    const bool flipped = post.flip_x || post.flip_y;
+    FlippedWarper flipped_warper(
+        *warp.warper, width, height, post.flip_x, post.flip_y);
+    Warper& warper = flipped ? flipped_warper : *warp.warper;
+    WarpRowHook finish_row;
+    if (!post.empty())
+    {
+        finish_row = [&](uchar* row, int y)
+        {
+            // The warp kept the alpha of (x, y), the flipped result needs
+            // the one of the flipped position
+            if (flipped && channels > 3)
+            {
+                const uchar* src = image.row(post.flip_y ? height - 1 - y : y);
+                for (int x = 0; x < width; ++x)
+                {
+                    const int sx = post.flip_x ? width - 1 - x : x;
+                    std::copy(
+                        src + sx * channels + 3,
+                        src + (sx + 1) * channels,
+                        row + x * channels + 3);
+                }
+            }
+            apply_points(post.points, row, width, channels);
+        };
+    }
+    // A baked field is read row by row, unless flips move the positions
+    const auto* field_warper = dynamic_cast<FieldWarper*>(warp.warper.get());
+    if (!flipped && field_warper != nullptr &&
+        field_warper->field().width() == width &&
+        field_warper->field().height() == height)
+    {
+        return warp_image(
+            field_warper->field(), image, warp.interpolation, finish_row);
+    }
+    return warp_image(warper, image, warp.interpolation, finish_row);
+}
+}  // namespace USTC_CG
@@ -0,0 +1,97 @@
+#include "common/image_saver.h"
+
+#include <memory>
+
+#include "common/image_io.h"
+#include "common/parallel.h"
+
+namespace USTC_CG
+{
+ImageSaver::ImageSaver()
+{
+    // The encoders run on the shared scheduler: make sure it is created
+    // first, so that it is destroyed after the queue is drained
+    TaskScheduler::instance();
+    worker_ = std::thread(&ImageSaver::worker_loop, this);
+}
+
+ImageSaver::~ImageSaver()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    worker_.join();
+}
+
+ImageSaver& ImageSaver::instance()
+{
+    static ImageSaver saver;
+    return saver;
+}
+
+std::future<void> ImageSaver::save(
+    const std::string& filename,
+    Image image,
+    Callback on_done)
+{
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.emplace_back(
+            [filename,
+             image = std::move(image),
+             on_done = std::move(on_done),
+             promise]()
+            {
+                try
+                {
+                    save_image(filename, image);
+                }
+                catch (...)
+                {
+                    promise->set_exception(std::current_exception());
+                    if (on_done)
+                        on_done(false);
+                    return;
+                }
+                // The future is set first, so that it is ready when the
+                // callback wakes the thread waiting on it
+                promise->set_value();
+                if (on_done)
+                    on_done(true);
+            });
+        ++pending_;
+    }
+    cv_.notify_one();
+    return future;
+}
+
+std::size_t ImageSaver::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+void ImageSaver::worker_loop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            // Unlike loads, queued saves are finished on shutdown
+            if (tasks_.empty())
+                return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+        std::lock_guard<std::mutex> lock(mutex_);
+        --pending_;
+    }
+}
+}  // namespace USTC_CG
@@ -0,0 +1,217 @@
+#include "common/parallel.h"
+
+#include <cstdlib>
+#include <exception>
+
+namespace USTC_CG
+{
+namespace
+{
+// Scheduler and deque of the current worker thread, if any
+thread_local TaskScheduler* tls_scheduler = nullptr;
+thread_local int tls_queue = -1;
+
+int default_num_threads()
+{
+    if (const char* env = std::getenv("CG2D_NUM_THREADS"))
+    {
+        const int n = std::atoi(env);
+        if (n > 0)
+            return n;
+    }
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+}  // namespace
+
+struct TaskScheduler::Job
+{
+    const RangeBody* body = nullptr;
+    int grain = 1;
+    std::atomic<int> remaining{ 0 };  // Items not processed yet
+    std::atomic<bool> failed{ false };
+    std::mutex error_mutex;
+    std::exception_ptr error;
+};
+
+TaskScheduler::TaskScheduler(int num_threads)
+{
+    start_workers((num_threads > 0 ? num_threads : default_num_threads()) - 1);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    stop_workers();
+}
+
+TaskScheduler& TaskScheduler::instance()
+{
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+void TaskScheduler::set_num_threads(int num_threads)
+{
+    stop_workers();
+    start_workers((num_threads > 0 ? num_threads : default_num_threads()) - 1);
+}
+
+int TaskScheduler::num_threads() const
+{
+    return static_cast<int>(workers_.size()) + 1;
+}
+
+void TaskScheduler::set_deterministic(bool deterministic)
+{
+    deterministic_ = deterministic;
+}
+
+bool TaskScheduler::deterministic() const
+{
+    return deterministic_;
+}
+
+void TaskScheduler::start_workers(int num_workers)
+{
+    stopping_ = false;
+    queues_.clear();
+    for (int i = 0; i <= num_workers; ++i)
+        queues_.push_back(std::make_unique<Queue>());
+    for (int i = 0; i < num_workers; ++i)
+        workers_.emplace_back(&TaskScheduler::worker_loop, this, i);
+}
+
+void TaskScheduler::stop_workers()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
+    workers_.clear();
+}
+
+void TaskScheduler::parallel_for(
+    int begin,
+    int end,
+    int grain,
+    const RangeBody& body)
+{
+    if (end <= begin)
+        return;
+    grain = std::max(1, grain);
+    if (deterministic_ || workers_.empty() || end - begin <= grain)
+    {
+        for (int b = begin; b < end; b += std::min(grain, end - b))
+            body(b, b + std::min(grain, end - b));
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->body = &body;
+    job->grain = grain;
+    job->remaining = end - begin;
+    split(job, begin, end);
+    // Help with the pending pieces (of this loop or of others) until the
+    // whole range is done
+    while (job->remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!run_one_task())
+            std::this_thread::yield();
+    }
+    if (job->error)
+        std::rethrow_exception(job->error);
+}
+
+void TaskScheduler::split(const std::shared_ptr<Job>& job, int begin, int end)
+{
+    while (end - begin > job->grain)
+    {
+        const int mid = begin + (end - begin) / 2;
+        push([this, job, mid, end] { split(job, mid, end); });
+        end = mid;
+    }
+    // After a failure the remaining pieces are only counted down
+    if (!job->failed.load(std::memory_order_relaxed))
+    {
+        try
+        {
+            (*job->body)(begin, end);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(job->error_mutex);
+            if (!job->error)
+                job->error = std::current_exception();
+            job->failed = true;
+        }
+    }
+    job->remaining.fetch_sub(end - begin, std::memory_order_acq_rel);
+}
+
+void TaskScheduler::push(std::function<void()> task)
+{
+    Queue& queue = tls_scheduler == this ? *queues_[tls_queue] : *queues_.back();
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    pending_.fetch_add(1, std::memory_order_release);
+    {
+        // Pairs with the predicate check of sleeping workers
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_one();
+}
+
+bool TaskScheduler::run_one_task()
+{
+    const int count = static_cast<int>(queues_.size());
+    const int own = tls_scheduler == this ? tls_queue : count - 1;
+    std::function<void()> task;
+    {
+        // Newest piece of our own deque first: it is the smallest and its
+        // data is still in cache
+        Queue& queue = *queues_[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+    // Otherwise steal the oldest piece of another deque
+    for (int i = 1; i < count && !task; ++i)
+    {
+        Queue& queue = *queues_[(own + i) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task)
+        return false;
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void TaskScheduler::worker_loop(int index)
+{
+    tls_scheduler = this;
+    tls_queue = index;
+    while (true)
+    {
+        if (run_one_task())
+            continue;
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(
+            lock, [this] { return stopping_ || pending_.load() > 0; });
+        if (stopping_)
+            return;
+    }
+}
+}  // namespace USTC_CG
@@ -0,0 +1,246 @@
+#include "common/profiler.h"
+
+#include <array>
+#include <vector>
+
+namespace USTC_CG
+{
+namespace
+{
+void write_json_string(std::ostream& out, const std::string& text)
+{
+    out << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+}  // namespace
+
+// Single-producer single-consumer queue: the owning thread advances head,
+// end_frame() advances tail.
+struct Profiler::Ring
+{
+    std::array<Event, kRingEvents> events;
+    std::atomic<std::uint64_t> head{ 0 };
+    std::atomic<std::uint64_t> tail{ 0 };
+    // Set when the owning thread exits, after its last event
+    std::atomic<bool> released{ false };
+};
+
+// The ring of the calling thread. Both the thread and the profiler hold it,
+// so whichever lets go last frees it.
+struct Profiler::ThreadRing
+{
+    Profiler* owner = nullptr;
+    std::shared_ptr<Ring> ring;
+
+    ~ThreadRing()
+    {
+        if (ring)
+            ring->released.store(true, std::memory_order_release);
+    }
+};
+
+std::atomic<bool> Profiler::enabled_{ false };
+
+Profiler::Profiler() : frame_start_(Clock::now())
+{
+}
+
+Profiler::~Profiler()
+{
+    set_enabled(false);
+    stop_dump();
+}
+
+Profiler& Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::set_enabled(bool enabled)
+{
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+int Profiler::register_stage(const std::string& name, Kind kind)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < stages_.size(); ++i)
+    {
+        if (stages_[i].name == name)
+            return static_cast<int>(i);
+    }
+    stages_.push_back({ name, kind });
+    return static_cast<int>(stages_.size()) - 1;
+}
+
+std::vector<Profiler::Stage> Profiler::stages() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stages_;
+}
+
+Profiler::Ring& Profiler::thread_ring()
+{
+    // The profiler keeps the ring of a thread that has exited until its
+    // events are collected
+    thread_local ThreadRing local;
+    if (local.owner != this)
+    {
+        if (local.ring)
+            local.ring->released.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(std::make_shared<Ring>());
+        local.ring = rings_.back();
+        local.owner = this;
+    }
+    return *local.ring;
+}
+
+void Profiler::record(int stage, double value)
+{
+    Ring& ring = thread_ring();
+    const std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= kRingEvents)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.events[head % kRingEvents] = { stage, value };
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::begin_frame()
+{
+    frame_start_ = Clock::now();
+}
+
+void Profiler::end_frame()
+{
+    const std::chrono::duration<double, std::milli> elapsed =
+        Clock::now() - frame_start_;
+    FrameRecord frame;
+    frame.index = frame_index_++;
+    frame.ms = elapsed.count();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frame.values.assign(stages_.size(), 0.0);
+        frame.calls.assign(stages_.size(), 0);
+        // Drained even while disabled, so that a frame never gets the
+        // events of an earlier profiling session. The rings of the threads
+        // that have exited are freed once drained.
+        std::erase_if(
+            rings_,
+            [&](const std::shared_ptr<Ring>& ring)
+            {
+                // Read before head, so that a released ring has no event
+                // left after this
+                const bool released =
+                    ring->released.load(std::memory_order_acquire);
+                const std::uint64_t tail =
+                    ring->tail.load(std::memory_order_relaxed);
+                const std::uint64_t head =
+                    ring->head.load(std::memory_order_acquire);
+                for (std::uint64_t i = tail; i < head; ++i)
+                {
+                    const Event& event = ring->events[i % kRingEvents];
+                    frame.values[event.stage] += event.value;
+                    ++frame.calls[event.stage];
+                }
+                ring->tail.store(head, std::memory_order_release);
+                return released;
+            });
+    }
+    if (!enabled())
+        return;
+    if (dump_.is_open())
+        write_frame(frame);
+    history_.push_back(std::move(frame));
+    if (history_.size() > kHistoryFrames)
+        history_.pop_front();
+}
+
+const std::deque<Profiler::FrameRecord>& Profiler::history() const
+{
+    return history_;
+}
+
+std::uint64_t Profiler::dropped_events() const
+{
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+bool Profiler::start_dump(const std::string& filename)
+{
+    stop_dump();
+    dump_.open(filename);
+    if (!dump_)
+        return false;
+    dump_json_ = filename.size() >= 5 &&
+                 filename.compare(filename.size() - 5, 5, ".json") == 0;
+    dump_empty_ = true;
+    if (dump_json_)
+        dump_ << "[";
+    else
+        dump_ << "frame,frame_ms,stage,value,calls\n";
+    return true;
+}
+
+void Profiler::stop_dump()
+{
+    if (!dump_.is_open())
+        return;
+    if (dump_json_)
+        dump_ << (dump_empty_ ? "]\n" : "\n]\n");
+    dump_.close();
+}
+
+bool Profiler::dumping() const
+{
+    return dump_.is_open();
+}
+
+void Profiler::write_frame(const FrameRecord& frame)
+{
+    const std::vector<Stage> names = stages();
+    if (dump_json_)
+    {
+        dump_ << (dump_empty_ ? "\n" : ",\n");
+        dump_ << "  {\"frame\": " << frame.index << ", \"ms\": " << frame.ms
+              << ", \"stages\": {";
+        bool first = true;
+        for (std::size_t i = 0; i < frame.values.size(); ++i)
+        {
+            if (frame.calls[i] == 0)
+                continue;
+            dump_ << (first ? "" : ", ");
+            write_json_string(dump_, names[i].name);
+            dump_ << ": {\"value\": " << frame.values[i]
+                  << ", \"calls\": " << frame.calls[i] << "}";
+            first = false;
+        }
+        dump_ << "}}";
+    }
+    else
+    {
+        bool any = false;
+        for (std::size_t i = 0; i < frame.values.size(); ++i)
+        {
+            if (frame.calls[i] == 0)
+                continue;
+            dump_ << frame.index << ',' << frame.ms << ',' << names[i].name
+                  << ',' << frame.values[i] << ',' << frame.calls[i] << '\n';
+            any = true;
+        }
+        if (!any)
+            dump_ << frame.index << ',' << frame.ms << ",,0,0\n";
+    }
+    dump_empty_ = false;
+}
+}  // namespace USTC_CG
@@ -0,0 +1,250 @@
+#include "common/tiled_image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+// mman.h takes off_t offsets, which are 32 bits here
+#define off_t int64_t
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <fcntl.h>
+#include <io.h>
+#include <stdio.h>
+
+#include "mman.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace USTC_CG
+{
+namespace
+{
+// Creates a scratch file that is removed from the file system as soon as it
+// is closed, and returns its descriptor.
+int open_scratch_file(const std::string& scratch_dir)
+{
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    char* name = _tempnam(
+        scratch_dir.empty() ? nullptr : scratch_dir.c_str(), "cg_tiles_");
+    if (name == nullptr)
+        return -1;
+    const int fd = _open(
+        name,
+        _O_RDWR | _O_CREAT | _O_EXCL | _O_BINARY | _O_TEMPORARY,
+        _S_IREAD | _S_IWRITE);
+    free(name);
+    return fd;
+#else
+    std::string path = scratch_dir.empty() ? "/tmp" : scratch_dir;
+    path += "/cg_tiles_XXXXXX";
+    const int fd = mkstemp(path.data());
+    if (fd != -1)
+        unlink(path.c_str());
+    return fd;
+#endif
+}
+
+bool resize_file(int fd, std::uint64_t size)
+{
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    return _chsize_s(fd, static_cast<__int64>(size)) == 0;
+#else
+    return ftruncate(fd, static_cast<off_t>(size)) == 0;
+#endif
+}
+
+void close_file(int fd)
+{
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+}  // namespace
+
+TiledImage::TiledImage(
+    int width,
+    int height,
+    int channels,
+    std::size_t memory_budget,
+    const std::string& scratch_dir)
+    : width_(width),
+      height_(height),
+      channels_(channels),
+      tiles_x_((width + kTileSize - 1) / kTileSize),
+      tiles_y_((height + kTileSize - 1) / kTileSize),
+      // kTileSize^2 is a multiple of 64 KiB, so every tile offset satisfies
+      // the mmap alignment on all platforms.
+      tile_bytes_(static_cast<std::size_t>(kTileSize) * kTileSize * channels)
+{
+    if (width <= 0 || height <= 0 || channels <= 0)
+    {
+        throw std::invalid_argument("Invalid tiled image dimensions");
+    }
+    memory_budget_ = std::max(memory_budget, kMinResidentTiles * tile_bytes_);
+    tiles_.resize(static_cast<std::size_t>(tiles_x_) * tiles_y_);
+
+    fd_ = open_scratch_file(scratch_dir);
+    if (fd_ == -1)
+    {
+        throw std::runtime_error("Failed to create tile scratch file");
+    }
+    // A sparse file: untouched tiles read as zeros and use no disk space
+    if (!resize_file(fd_, std::uint64_t(tile_bytes_) * tiles_.size()))
+    {
+        close_file(fd_);
+        throw std::runtime_error("Failed to allocate tile scratch file");
+    }
+}
+
+TiledImage::~TiledImage()
+{
+    for (auto& slot : tiles_)
+    {
+        if (slot.data)
+            munmap(slot.data, tile_bytes_);
+    }
+    close_file(fd_);
+}
+
+PixelRect TiledImage::tile_rect(int tx, int ty) const
+{
+    return { tx * kTileSize,
+             ty * kTileSize,
+             std::min(width_, (tx + 1) * kTileSize),
+             std::min(height_, (ty + 1) * kTileSize) };
+}
+
+std::span<unsigned char> TiledImage::pixel(int x, int y)
+{
+    if (x < 0 || x >= width_ || y < 0 || y >= height_)
+    {
+        throw std::out_of_range("Pixel coordinates out of bounds");
+    }
+    return { pixel_ptr(x, y), static_cast<std::size_t>(channels_) };
+}
+
+std::span<const unsigned char> TiledImage::pixel(int x, int y) const
+{
+    if (x < 0 || x >= width_ || y < 0 || y >= height_)
+    {
+        throw std::out_of_range("Pixel coordinates out of bounds");
+    }
+    return { pixel_ptr(x, y), static_cast<std::size_t>(channels_) };
+}
+
+unsigned char* TiledImage::map_tile(int index) const
+{
+    TileSlot& slot = tiles_[index];
+    if (slot.data)
+    {
+        lru_.splice(lru_.begin(), lru_, slot.lru);
+    }
+    else
+    {
+        while (stats_.resident_bytes + tile_bytes_ > memory_budget_)
+            evict_lru();
+        void* data = mmap(
+            nullptr,
+            tile_bytes_,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED,
+            fd_,
+            static_cast<off_t>(std::uint64_t(index) * tile_bytes_));
+        if (data == MAP_FAILED)
+        {
+            throw std::runtime_error("Failed to map image tile");
+        }
+        slot.data = static_cast<unsigned char*>(data);
+        lru_.push_front(index);
+        slot.lru = lru_.begin();
+        stats_.resident_bytes += tile_bytes_;
+        stats_.peak_resident_bytes =
+            std::max(stats_.peak_resident_bytes, stats_.resident_bytes);
+        ++stats_.tile_loads;
+    }
+    last_tile_ = index;
+    last_data_ = slot.data;
+    return slot.data;
+}
+
+void TiledImage::evict_lru() const
+{
+    const int index = lru_.back();
+    lru_.pop_back();
+    TileSlot& slot = tiles_[index];
+    munmap(slot.data, tile_bytes_);
+    slot.data = nullptr;
+    if (last_tile_ == index)
+        last_tile_ = -1;
+    stats_.resident_bytes -= tile_bytes_;
+    ++stats_.evictions;
+}
+
+Image TiledImage::read_region(PixelRect rect) const
+{
+    rect = rect.intersected({ 0, 0, width_, height_ });
+    if (rect.empty())
+        return Image();
+    Image image(rect.width(), rect.height(), channels_);
+    for (int y = rect.y0; y < rect.y1; ++y)
+    {
+        unsigned char* dst = image.row(y - rect.y0);
+        for (int x = rect.x0; x < rect.x1;)
+        {
+            const auto segment = row_segment(x, y);
+            const std::size_t bytes = std::min(
+                segment.size(),
+                static_cast<std::size_t>(rect.x1 - x) * channels_);
+            std::memcpy(dst, segment.data(), bytes);
+            dst += bytes;
+            x += static_cast<int>(bytes / channels_);
+        }
+    }
+    return image;
+}
+
+void TiledImage::write_region(PixelRect rect, const Image& image)
+{
+    rect = rect.intersected({ 0, 0, width_, height_ });
+    if (rect.empty())
+        return;
+    if (image.width() != rect.width() || image.height() != rect.height() ||
+        image.channels() != channels_)
+    {
+        throw std::invalid_argument("Region size does not match");
+    }
+    for (int y = rect.y0; y < rect.y1; ++y)
+    {
+        const unsigned char* src = image.row(y - rect.y0);
+        for (int x = rect.x0; x < rect.x1;)
+        {
+            const auto segment = row_segment(x, y);
+            const std::size_t bytes = std::min(
+                segment.size(),
+                static_cast<std::size_t>(rect.x1 - x) * channels_);
+            std::memcpy(segment.data(), src, bytes);
+            src += bytes;
+            x += static_cast<int>(bytes / channels_);
+        }
+    }
+}
+
+void TiledImage::flush()
+{
+    for (auto& slot : tiles_)
+    {
+        if (slot.data)
+            msync(slot.data, tile_bytes_, MS_SYNC);
+    }
+}
+}  // namespace USTC_CG
@@ -0,0 +1,312 @@
+#include "common/undo_history.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/parallel.h"
+
+namespace USTC_CG
+{
+using uchar = unsigned char;
+
+namespace
+{
+// Zero runs shorter than this are cheaper to store as literals
+constexpr std::size_t kMinZeroRun = 4;
+
+void put_varint(std::vector<uchar>& out, std::size_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uchar>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uchar>(value));
+}
+
+std::size_t get_varint(const uchar*& p)
+{
+    std::size_t value = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        const uchar byte = *p++;
+        value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+}
+
+// Encodes `delta` as (zero run, literal length, literals) triples. Trailing
+// zeros are implied.
+void encode(const uchar* delta, std::size_t size, std::vector<uchar>& out)
+{
+    std::size_t i = 0;
+    while (i < size)
+    {
+        std::size_t zeros_end = i;
+        while (zeros_end < size && delta[zeros_end] == 0)
+            ++zeros_end;
+        if (zeros_end == size)
+            break;
+        // The literal run ends at the next long enough zero run
+        std::size_t end = zeros_end;
+        while (end < size)
+        {
+            if (delta[end] != 0)
+            {
+                ++end;
+                continue;
+            }
+            std::size_t run = end;
+            while (run < size && run - end < kMinZeroRun && delta[run] == 0)
+                ++run;
+            if (run - end >= kMinZeroRun || run == size)
+                break;
+            end = run;
+        }
+        put_varint(out, zeros_end - i);
+        put_varint(out, end - zeros_end);
+        out.insert(out.end(), delta + zeros_end, delta + end);
+        i = end;
+    }
+}
+
+// Inverse of encode(), into a zeroed buffer of `size` bytes.
+void decode(const std::vector<uchar>& data, uchar* delta, std::size_t size)
+{
+    std::memset(delta, 0, size);
+    const uchar* p = data.data();
+    const uchar* end = p + data.size();
+    std::size_t i = 0;
+    while (p < end)
+    {
+        i += get_varint(p);
+        const std::size_t length = get_varint(p);
+        std::memcpy(delta + i, p, length);
+        p += length;
+        i += length;
+    }
+}
+}  // namespace
+
+UndoHistory::UndoHistory(std::size_t memory_limit)
+    : memory_limit_(memory_limit)
+{
+}
+
+void UndoHistory::reset(const Image& image)
+{
+    current_ = image;
+    undo_.clear();
+    redo_.clear();
+    memory_usage_ = 0;
+}
+
+void UndoHistory::commit(const Image& image)
+{
+    commit(image, { 0, 0, image.width(), image.height() });
+}
+
+void UndoHistory::commit(const Image& image, const PixelRect& changed)
+{
+    if (image.width() != current_.width() ||
+        image.height() != current_.height() ||
+        image.channels() != current_.channels())
+    {
+        reset(image);
+        return;
+    }
+    const PixelRect rect =
+        changed.intersected({ 0, 0, image.width(), image.height() });
+    if (rect.empty() || image.shares_data_with(current_))
+    {
+        current_ = image;
+        return;
+    }
+
+    // Tiles of the grid overlapping `rect`
+    const int tx0 = rect.x0 / kTileSize, ty0 = rect.y0 / kTileSize;
+    const int tx1 = (rect.x1 + kTileSize - 1) / kTileSize;
+    const int ty1 = (rect.y1 + kTileSize - 1) / kTileSize;
+    const int tiles_x = tx1 - tx0;
+    const int channels = image.channels();
+    const Image& before = current_;  // Read only: no detach
+    std::vector<TileDelta> tiles(
+        static_cast<std::size_t>(tiles_x) * (ty1 - ty0));
+    parallel_for(
+        0,
+        static_cast<int>(tiles.size()),
+        4,
+        [&](int begin, int end)
+        {
+            std::vector<uchar> delta;
+            for (int i = begin; i < end; ++i)
+            {
+                const int tx = tx0 + i % tiles_x;
+                const int ty = ty0 + i / tiles_x;
+                const PixelRect tile{
+                    tx * kTileSize,
+                    ty * kTileSize,
+                    std::min(image.width(), (tx + 1) * kTileSize),
+                    std::min(image.height(), (ty + 1) * kTileSize) };
+                const std::size_t offset =
+                    static_cast<std::size_t>(tile.x0) * channels;
+                const std::size_t row_bytes =
+                    static_cast<std::size_t>(tile.width()) * channels;
+                delta.resize(row_bytes * tile.height());
+                bool changed_tile = false;
+                for (int y = tile.y0; y < tile.y1; ++y)
+                {
+                    const uchar* a = before.row(y) + offset;
+                    const uchar* b = image.row(y) + offset;
+                    uchar* d = delta.data() + (y - tile.y0) * row_bytes;
+                    if (std::memcmp(a, b, row_bytes) == 0)
+                    {
+                        std::memset(d, 0, row_bytes);
+                        continue;
+                    }
+                    changed_tile = true;
+                    for (std::size_t k = 0; k < row_bytes; ++k)
+                        d[k] = a[k] ^ b[k];
+                }
+                if (!changed_tile)
+                    continue;
+                tiles[i].rect = tile;
+                encode(delta.data(), delta.size(), tiles[i].data);
+                tiles[i].data.shrink_to_fit();
+            }
+        });
+
+    Step step;
+    for (TileDelta& tile : tiles)
+    {
+        if (tile.rect.empty())
+            continue;
+        step.rect = step.rect.united(tile.rect);
+        step.bytes += tile.data.size() + sizeof(TileDelta);
+        step.tiles.push_back(std::move(tile));
+    }
+    current_ = image;
+    if (step.tiles.empty())
+        return;
+
+    for (const Step& s : redo_)
+        memory_usage_ -= s.bytes;
+    redo_.clear();
+    memory_usage_ += step.bytes;
+    undo_.push_back(std::move(step));
+    trim();
+}
+
+bool UndoHistory::can_undo() const
+{
+    return !undo_.empty();
+}
+
+bool UndoHistory::can_redo() const
+{
+    return !redo_.empty();
+}
+
+PixelRect UndoHistory::undo(Image& image)
+{
+    if (undo_.empty())
+        return {};
+    redo_.push_back(std::move(undo_.back()));
+    undo_.pop_back();
+    return apply(redo_.back(), image);
+}
+
+PixelRect UndoHistory::redo(Image& image)
+{
+    if (redo_.empty())
+        return {};
+    undo_.push_back(std::move(redo_.back()));
+    redo_.pop_back();
+    return apply(undo_.back(), image);
+}
+
+PixelRect UndoHistory::apply(const Step& step, Image& image)
+{
+    // Release our reference first, so that writing to `image` does not copy
+    // the whole buffer
+    current_ = Image();
+    const int channels = image.channels();
+    uchar* const data = image.data();
+    const std::size_t stride = image.stride();
+    parallel_for(
+        0,
+        static_cast<int>(step.tiles.size()),
+        4,
+        [&](int begin, int end)
+        {
+            std::vector<uchar> delta;
+            for (int i = begin; i < end; ++i)
+            {
+                const TileDelta& tile = step.tiles[i];
+                const std::size_t offset =
+                    static_cast<std::size_t>(tile.rect.x0) * channels;
+                const std::size_t row_bytes =
+                    static_cast<std::size_t>(tile.rect.width()) * channels;
+                delta.resize(row_bytes * tile.rect.height());
+                decode(tile.data, delta.data(), delta.size());
+                for (int y = tile.rect.y0; y < tile.rect.y1; ++y)
+                {
+                    uchar* row = data + y * stride + offset;
+                    const uchar* d =
+                        delta.data() + (y - tile.rect.y0) * row_bytes;
+                    for (std::size_t k = 0; k < row_bytes; ++k)
+                        row[k] ^= d[k];
+                }
+            }
+        });
+    current_ = image;
+    return step.rect;
+}
+
+const Image& UndoHistory::current() const
+{
+    return current_;
+}
+
+void UndoHistory::set_memory_limit(std::size_t bytes)
+{
+    memory_limit_ = bytes;
+    trim();
+}
+
+std::size_t UndoHistory::memory_limit() const
+{
+    return memory_limit_;
+}
+
+std::size_t UndoHistory::memory_usage() const
+{
+    return memory_usage_;
+}
+
+std::size_t UndoHistory::undo_steps() const
+{
+    return undo_.size();
+}
+
+std::size_t UndoHistory::redo_steps() const
+{
+    return redo_.size();
+}
+
+void UndoHistory::trim()
+{
+    // Redo steps go first: they are the least likely to be used
+    while (memory_usage_ > memory_limit_ && !redo_.empty())
+    {
+        memory_usage_ -= redo_.front().bytes;
+        redo_.pop_front();
+    }
+    while (memory_usage_ > memory_limit_ && !undo_.empty())
+    {
+        memory_usage_ -= undo_.front().bytes;
+        undo_.pop_front();
+    }
+}
+}  // namespace USTC_CG
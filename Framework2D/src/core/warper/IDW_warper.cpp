@@ -0,0 +1,132 @@
+#include "IDW_warper.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "warp_kernels.h"
+
+namespace USTC_CG
+{
+namespace
+{
+// Kernel of the exponent mu, if any
+bool idw_power(float mu, warp_kernels::IdwPower& power)
+{
+    if (mu == 1.0f)
+        power = warp_kernels::IdwPower::kOne;
+    else if (mu == 2.0f)
+        power = warp_kernels::IdwPower::kTwo;
+    else if (mu == 4.0f)
+        power = warp_kernels::IdwPower::kFour;
+    else
+        return false;
+    return true;
+}
+}  // namespace
+
+IDWWarper::IDWWarper(
+    const std::vector<Point2f>& start_points,
+    const std::vector<Point2f>& end_points,
+    float mu)
+    : mu_(mu)
+{
+    const std::size_t n = std::min(start_points.size(), end_points.size());
+    x_.resize(n);
+    y_.resize(n);
+    dx_.resize(n);
+    dy_.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        x_[i] = start_points[i].x;
+        y_[i] = start_points[i].y;
+        dx_[i] = end_points[i].x - start_points[i].x;
+        dy_[i] = end_points[i].y - start_points[i].y;
+    }
+}
+
+std::pair<float, float> IDWWarper::warp(float x, float y)
+{
+    std::pair<float, float> result;
+    warp_pow(&x, &y, &result.first, &result.second, 1);
+    return result;
+}
+
+void IDWWarper::warp_batch(
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    warp_kernels::IdwPower power;
+    if (idw_power(mu_, power))
+    {
+        const warp_kernels::IdwPoints points{
+            x_.data(), y_.data(), dx_.data(), dy_.data(), x_.size()
+        };
+        warp_kernels::current().idw(points, power, xs, ys, out_x, out_y, n);
+    }
+    else
+    {
+        warp_pow(xs, ys, out_x, out_y, n);
+    }
+}
+
+// Any exponent, and single points: the scalar kernel where it exists, so
+// that warp() and warp_batch() agree
+void IDWWarper::warp_pow(
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n) const
+{
+    warp_kernels::IdwPower power;
+    if (idw_power(mu_, power))
+    {
+        const warp_kernels::IdwPoints points{
+            x_.data(), y_.data(), dx_.data(), dy_.data(), x_.size()
+        };
+        warp_kernels::scalar_table().idw(
+            points, power, xs, ys, out_x, out_y, n);
+        return;
+    }
+
+    constexpr float epsilon = warp_kernels::kIdwEpsilon;
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        const float x = xs[j];
+        const float y = ys[j];
+        float sum_w = 0.0f;
+        float sum_wx = 0.0f;
+        float sum_wy = 0.0f;
+        for (size_t i = 0; i < x_.size(); i++)
+        {
+            // calculate the drift to the control point
+            float dx = x - x_[i];
+            float dy = y - y_[i];
+
+            float dist_sq = dx * dx + dy * dy;
+
+            // calculate the weight term sigma_i = 1/(dist^u + epsilon)
+            float sigma = 1.0f / (powf(dist_sq, mu_ / 2) + epsilon);
+
+            // f(p) = \sum_{i=1}^n w_i(p)q_i
+            // w_i(p) = sigma_i(p) / sum_sigma
+            sum_w += sigma;
+            sum_wx += sigma * dx_[i];
+            sum_wy += sigma * dy_[i];
+        }
+        if (sum_w < epsilon)
+        {
+            out_x[j] = x;
+            out_y[j] = y;
+        }
+        else
+        {
+            out_x[j] = x + sum_wx / sum_w;
+            out_y[j] = y + sum_wy / sum_w;
+        }
+    }
+}
+}  // namespace USTC_CG
\ No newline at end of file
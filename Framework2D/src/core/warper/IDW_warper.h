@@ -0,0 +1,40 @@
+// HW2_TODO: Implement the IDWWarper class
+#pragma once
+
+#include "warper.h"
+namespace USTC_CG
+{
+class IDWWarper : public Warper
+{
+   public:
+    // Weights 1 / (d^mu + epsilon) at distance d from a control point.
+    // mu = 1, 2 and 4 have SIMD kernels.
+    IDWWarper(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points,
+        float mu = 2.0f);
+    virtual ~IDWWarper() = default;
+    // HW2_TODO: Implement the warp(...) function with IDW interpolation
+    std::pair<float, float> warp(float x, float y) override;
+    void warp_batch(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) override;
+
+   private:
+    void warp_pow(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) const;
+
+    float mu_;
+    // Control points as arrays for the kernels: start x and y, end - start
+    std::vector<float> x_, y_, dx_, dy_;
+
+    // HW2_TODO: other functions or variables if you need
+};
+}  // namespace USTC_CG
\ No newline at end of file
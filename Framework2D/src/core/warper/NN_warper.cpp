@@ -0,0 +1,464 @@
+#include "NN_warper.h"
+
+#include <dlib/dnn.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace USTC_CG
+{
+struct NNWarper::Weights
+{
+    // Normalization of the coordinates to [-1, 1] over the bounding box of
+    // the start points, for both the inputs and the outputs
+    float x_offset = 0, y_offset = 0;
+    float x_scale = 1, y_scale = 1;
+    // Layers as out[o] = b[o] + sum_i w[o][i] * in[i], ELU after the hidden
+    // ones
+    float w1[kHidden][2], b1[kHidden];
+    float w2[kHidden][kHidden], b2[kHidden];
+    float w3[2][kHidden], b3[2];
+};
+
+namespace
+{
+constexpr int kHidden = NNWarper::kHidden;
+using net_type = dlib::loss_mean_squared_multioutput<dlib::fc<
+    2,
+    dlib::elu<dlib::fc<
+        kHidden,
+        dlib::elu<dlib::fc<kHidden, dlib::input<dlib::matrix<float>>>>>>>>;
+
+// Loss (mean squared error per point, in normalized coordinates) below
+// which training stops: about a tenth of a pixel over a 500 pixel wide box
+constexpr double kLossTarget = 1e-7;
+// Trained sets of control points kept in the cache
+constexpr std::size_t kCacheSize = 16;
+
+// Copies an fc layer of dlib, whose weights are stored as w[i][o], into
+// w[o][i] and b[o]
+template <typename Layer, std::size_t Out, std::size_t In>
+void copy_layer(const Layer& layer, float (&w)[Out][In], float (&b)[Out])
+{
+    const auto weights = layer.layer_details().get_weights();
+    const auto biases = layer.layer_details().get_biases();
+    for (std::size_t o = 0; o < Out; ++o)
+    {
+        for (std::size_t i = 0; i < In; ++i)
+            w[o][i] = weights.get().host()[i * Out + o];
+        b[o] = biases.get().host()[o];
+    }
+}
+
+// ELU activation of dlib, alpha = 1
+inline float elu(float v)
+{
+    return v > 0 ? v : std::exp(v) - 1.0f;
+}
+
+// Trained weights of the last few sets of control points, most recently
+// used first. Entries are matched by hash, then compared point by point.
+class WeightsCache
+{
+   public:
+    using Weights = std::shared_ptr<const void>;
+
+    static std::uint64_t hash(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points)
+    {
+        // FNV-1a over the bits of the coordinates
+        std::uint64_t h = 14695981039346656037ull;
+        auto add = [&h](float v)
+        {
+            std::uint32_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            for (int k = 0; k < 4; ++k)
+            {
+                h ^= (bits >> (8 * k)) & 0xff;
+                h *= 1099511628211ull;
+            }
+        };
+        for (const auto* points : { &start_points, &end_points })
+        {
+            for (const Point2f& p : *points)
+            {
+                add(p.x);
+                add(p.y);
+            }
+        }
+        return h;
+    }
+
+    static WeightsCache& instance()
+    {
+        static WeightsCache cache;
+        return cache;
+    }
+
+    Weights find(
+        std::uint64_t key,
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (it->key != key || !equal(it->start_points, start_points) ||
+                !equal(it->end_points, end_points))
+                continue;
+            Entry entry = std::move(*it);
+            entries_.erase(it);
+            entries_.push_front(std::move(entry));
+            return entries_.front().weights;
+        }
+        return nullptr;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+    }
+
+    void insert(
+        std::uint64_t key,
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points,
+        Weights weights)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.push_front(
+            { key, start_points, end_points, std::move(weights) });
+        if (entries_.size() > kCacheSize)
+            entries_.pop_back();
+    }
+
+   private:
+    struct Entry
+    {
+        std::uint64_t key;
+        std::vector<Point2f> start_points, end_points;
+        Weights weights;
+    };
+
+    static bool equal(
+        const std::vector<Point2f>& a,
+        const std::vector<Point2f>& b)
+    {
+        return a.size() == b.size() &&
+               std::equal(
+                   a.begin(),
+                   a.end(),
+                   b.begin(),
+                   [](const Point2f& p, const Point2f& q)
+                   { return p.x == q.x && p.y == q.y; });
+    }
+
+    std::mutex mutex_;
+    std::deque<Entry> entries_;
+};
+
+// Background thread of NNWarper::train_async(). Training jobs queued when
+// it stops are dropped (their futures report a broken promise), and the
+// running one is stopped at its next progress report.
+class TrainingQueue
+{
+   public:
+    static TrainingQueue& instance()
+    {
+        static TrainingQueue queue;
+        return queue;
+    }
+
+    ~TrainingQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            tasks_.clear();
+        }
+        cv_.notify_all();
+        worker_.join();
+    }
+
+    void push(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+    bool stopping() const
+    {
+        return stopping_;
+    }
+
+   private:
+    TrainingQueue()
+    {
+        // The jobs use the cache, so it must be constructed first: statics
+        // are destroyed in reverse order, and the cache then outlives the
+        // worker
+        WeightsCache::instance();
+        worker_ = std::thread(&TrainingQueue::worker_loop, this);
+    }
+
+    void worker_loop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(
+                    lock,
+                    [this] { return stopping_ || !tasks_.empty(); });
+                if (stopping_)
+                    return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<bool> stopping_ = false;
+    std::deque<std::function<void()>> tasks_;
+};
+}  // namespace
+
+NNWarper::NNWarper(
+    const std::vector<Point2f>& start_points,
+    const std::vector<Point2f>& end_points,
+    const ProgressCallback& on_progress)
+    : start_points_(start_points),
+      end_points_(end_points)
+{
+    if (start_points.empty() || start_points.size() != end_points.size())
+    {
+        throw std::runtime_error("Invalid input points");
+    }
+
+    WeightsCache& cache = WeightsCache::instance();
+    const std::uint64_t key = WeightsCache::hash(start_points, end_points);
+    weights_ = std::static_pointer_cast<const Weights>(
+        cache.find(key, start_points, end_points));
+    if (weights_)
+    {
+        if (on_progress)
+        {
+            Progress progress;
+            progress.cached = true;
+            on_progress(progress);
+        }
+        return;
+    }
+
+    auto weights = std::make_shared<Weights>();
+
+    // 计算数据范围，用于归一化
+    float min_x = start_points[0].x, max_x = start_points[0].x;
+    float min_y = start_points[0].y, max_y = start_points[0].y;
+
+    for (const auto& p : start_points)
+    {
+        min_x = std::min(min_x, p.x);
+        max_x = std::max(max_x, p.x);
+        min_y = std::min(min_y, p.y);
+        max_y = std::max(max_y, p.y);
+    }
+
+    // 存储归一化参数，用于后续推断
+    weights->x_scale = max_x - min_x > 1e-6f ? 2.0f / (max_x - min_x) : 1.0f;
+    weights->y_scale = max_y - min_y > 1e-6f ? 2.0f / (max_y - min_y) : 1.0f;
+    weights->x_offset = min_x;
+    weights->y_offset = min_y;
+
+    // 准备训练数据（归一化后）
+    std::vector<dlib::matrix<float>> inputs, targets;
+    inputs.reserve(start_points.size());
+    targets.reserve(end_points.size());
+
+    for (size_t i = 0; i < start_points.size(); i++)
+    {
+        // 归一化输入数据到 [-1, 1] 范围
+        dlib::matrix<float> input(2, 1);
+        input(0, 0) = (start_points[i].x - min_x) * weights->x_scale - 1.0f;
+        input(1, 0) = (start_points[i].y - min_y) * weights->y_scale - 1.0f;
+        inputs.push_back(input);
+
+        // 同样归一化输出数据
+        dlib::matrix<float> target(2, 1);
+        target(0, 0) = (end_points[i].x - min_x) * weights->x_scale - 1.0f;
+        target(1, 0) = (end_points[i].y - min_y) * weights->y_scale - 1.0f;
+        targets.push_back(target);
+    }
+
+    // 配置训练器
+    net_type net;
+    dlib::dnn_trainer<net_type> trainer(net);
+    const double min_learning_rate = 1e-6;
+    trainer.set_learning_rate(0.01);
+    trainer.set_min_learning_rate(min_learning_rate);
+    const std::size_t batch =
+        std::min<std::size_t>(32, start_points.size());
+    trainer.set_mini_batch_size(batch);
+
+    // Same schedule as trainer.train(), one mini-batch at a time, so that
+    // training can stop early and report its progress
+    Progress progress;
+    bool stop = false;
+    while (!stop)
+    {
+        for (std::size_t i = 0; i < inputs.size() && !stop; i += batch)
+        {
+            const std::size_t end = std::min(i + batch, inputs.size());
+            trainer.train_one_step(
+                inputs.begin() + i,
+                inputs.begin() + end,
+                targets.begin() + i);
+            ++progress.steps;
+            if (progress.steps % kReportSteps != 0 &&
+                progress.steps < kMaxSteps)
+                continue;
+            // Waits for the steps queued so far
+            progress.loss = trainer.get_average_loss();
+            progress.learning_rate = trainer.get_learning_rate();
+            // dlib lowers the learning rate tenfold each time the loss
+            // stops improving; once it is down to the minimum (give or take
+            // the rounding of those steps), the weights hardly move
+            stop = progress.steps >= kMaxSteps ||
+                   progress.loss < kLossTarget ||
+                   progress.learning_rate < 1.5 * min_learning_rate;
+            if (on_progress && !on_progress(progress))
+                throw std::runtime_error("NN training stopped");
+        }
+    }
+
+    // Waits for the trainer to finish updating the network
+    trainer.get_net();
+    copy_layer(dlib::layer<5>(net), weights->w1, weights->b1);
+    copy_layer(dlib::layer<3>(net), weights->w2, weights->b2);
+    copy_layer(dlib::layer<1>(net), weights->w3, weights->b3);
+    weights_ = weights;
+    cache.insert(key, start_points, end_points, weights_);
+}
+
+NNWarper::~NNWarper() = default;
+
+std::future<std::shared_ptr<NNWarper>> NNWarper::train_async(
+    const std::vector<Point2f>& start_points,
+    const std::vector<Point2f>& end_points,
+    ProgressCallback on_progress)
+{
+    auto promise = std::make_shared<std::promise<std::shared_ptr<NNWarper>>>();
+    auto future = promise->get_future();
+    TrainingQueue& queue = TrainingQueue::instance();
+    queue.push(
+        [start_points,
+         end_points,
+         on_progress = std::move(on_progress),
+         promise,
+         &queue]()
+        {
+            try
+            {
+                promise->set_value(std::make_shared<NNWarper>(
+                    start_points,
+                    end_points,
+                    [&](const Progress& progress)
+                    {
+                        return !queue.stopping() &&
+                               (!on_progress || on_progress(progress));
+                    }));
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        });
+    return future;
+}
+
+void NNWarper::clear_cache()
+{
+    WeightsCache::instance().clear();
+}
+
+std::pair<float, float> NNWarper::warp(float x, float y)
+{
+    std::pair<float, float> result;
+    warp_batch(&x, &y, &result.first, &result.second, 1);
+    return result;
+}
+
+void NNWarper::warp_batch(
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    // Points per block: the hidden activations of a block stay in the L1
+    // cache, and the multiply-adds over its points vectorize
+    constexpr std::size_t kBlock = 64;
+    const Weights& w = *weights_;
+
+    float in[2][kBlock], h1[kHidden][kBlock], h2[kHidden][kBlock];
+    for (std::size_t first = 0; first < n; first += kBlock)
+    {
+        const std::size_t m = std::min(kBlock, n - first);
+        for (std::size_t j = 0; j < m; ++j)
+        {
+            in[0][j] = (xs[first + j] - w.x_offset) * w.x_scale - 1.0f;
+            in[1][j] = (ys[first + j] - w.y_offset) * w.y_scale - 1.0f;
+        }
+        for (int o = 0; o < kHidden; ++o)
+        {
+            for (std::size_t j = 0; j < m; ++j)
+                h1[o][j] = elu(
+                    w.b1[o] + w.w1[o][0] * in[0][j] + w.w1[o][1] * in[1][j]);
+        }
+        for (int o = 0; o < kHidden; ++o)
+        {
+            float* h = h2[o];
+            for (std::size_t j = 0; j < m; ++j)
+                h[j] = w.b2[o];
+            for (int i = 0; i < kHidden; ++i)
+            {
+                const float wi = w.w2[o][i];
+                for (std::size_t j = 0; j < m; ++j)
+                    h[j] += wi * h1[i][j];
+            }
+            for (std::size_t j = 0; j < m; ++j)
+                h[j] = elu(h[j]);
+        }
+        // 反归一化输出
+        for (std::size_t j = 0; j < m; ++j)
+        {
+            float u = w.b3[0], v = w.b3[1];
+            for (int i = 0; i < kHidden; ++i)
+            {
+                u += w.w3[0][i] * h2[i][j];
+                v += w.w3[1][i] * h2[i][j];
+            }
+            out_x[first + j] = (u + 1.0f) / w.x_scale + w.x_offset;
+            out_y[first + j] = (v + 1.0f) / w.y_scale + w.y_offset;
+        }
+    }
+}
+}  // namespace USTC_CG
@@ -0,0 +1,80 @@
+// HW2_TODO: Implement the NNWarper class
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+
+#include "warper.h"
+
+namespace USTC_CG
+{
+// Small MLP (2-10-10-2, ELU) fitted to the control points with dlib, on
+// coordinates normalized to the bounding box of the start points.
+//
+// Training is the expensive part: it stops once the loss has not improved
+// for a while, at kMaxSteps mini-batches, or when the progress callback asks
+// to. Trained weights are cached for the last few sets of control points, so
+// warping again with the same points does not train again. Inference then
+// runs a fused forward pass over plain arrays, for whole rows at a time,
+// without dlib.
+class NNWarper : public Warper
+{
+   public:
+    static constexpr int kHidden = 10;
+    static constexpr unsigned long kMaxSteps = 10000;
+    // Mini-batches between two progress reports
+    static constexpr unsigned long kReportSteps = 100;
+
+    struct Progress
+    {
+        unsigned long steps = 0;  // Mini-batches trained so far
+        double loss = 0;          // Average loss of the recent mini-batches
+        double learning_rate = 0;
+        bool cached = false;  // The weights came from the cache
+    };
+    // Called on the training thread after every kReportSteps mini-batches
+    // and once at the end. Returning false stops the training, which then
+    // throws.
+    using ProgressCallback = std::function<bool(const Progress&)>;
+
+    // Trains synchronously, unless the points are in the cache. Throws
+    // std::runtime_error if there are no points or the counts differ.
+    NNWarper(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points,
+        const ProgressCallback& on_progress = nullptr);
+    ~NNWarper() override;
+
+    // Trains on a background thread shared by all NNWarpers, one network
+    // at a time (dlib's trainer runs its own thread per network). The
+    // future holds the warper, or the exception if training failed or was
+    // stopped.
+    static std::future<std::shared_ptr<NNWarper>> train_async(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points,
+        ProgressCallback on_progress = nullptr);
+
+    // Forgets the weights trained so far, e.g. to measure the training.
+    static void clear_cache();
+
+    // HW2_TODO: Implement the warp(...) function with IDW interpolation
+    std::pair<float, float> warp(float x, float y) override;
+    void warp_batch(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) override;
+
+   private:
+    // Parameters of the trained network, copied out of dlib, with the
+    // normalization of the coordinates
+    struct Weights;
+
+    std::vector<Point2f> start_points_;
+    std::vector<Point2f> end_points_;
+    // HW2_TODO: other functions or variables if you need
+    std::shared_ptr<const Weights> weights_;
+};
+}  // namespace USTC_CG
@@ -0,0 +1,590 @@
+#include "RBF_warper.h"
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include "warp_kernels.h"
+
+namespace USTC_CG
+{
+namespace
+{
+// Thin plate spline kernel between two control points
+double spline_kernel(const Point2f& a, const Point2f& b)
+{
+    const double dx = a.x - b.x;
+    const double dy = a.y - b.y;
+    const double r_sq = dx * dx + dy * dy;
+    return r_sq * std::log(std::sqrt(r_sq) + 1e-9);
+}
+
+bool same_point(const Point2f& a, const Point2f& b)
+{
+    return a.x == b.x && a.y == b.y;
+}
+}  // namespace
+
+struct RBFWarper::Factorization
+{
+    // Spline: inverse of K = [[0, P^T]; [P, R]], the 3 affine constraints
+    // first, then a row per control point, P holding (x, y, 1). Rows of
+    // points left out by an update are 0.
+    Eigen::MatrixXd inverse;
+    bool has_inverse = false;
+    int updates = 0;
+
+    // Wendland kernels: affine least squares around the centroid, and the
+    // kernel matrix
+    double mean_x = 0, mean_y = 0;
+    Eigen::Matrix3d normal;
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> kernel;
+    bool has_kernel = false;
+};
+
+RBFWarper::RBFWarper(
+    const std::vector<Point2f>& start_points,
+    const std::vector<Point2f>& end_points)
+    : start_points_(start_points),
+      end_points_(end_points),
+      factorization_(std::make_unique<Factorization>())
+{
+    fit();
+}
+
+RBFWarper::~RBFWarper() = default;
+
+void RBFWarper::refit(
+    const std::vector<Point2f>& start_points,
+    const std::vector<Point2f>& end_points)
+{
+    const std::size_t n = start_points.size();
+    const std::size_t old_n = start_points_.size();
+    std::size_t moved = 0;
+    for (std::size_t i = 0; i < std::min(n, old_n); ++i)
+        moved += !same_point(start_points[i], start_points_[i]);
+    const std::size_t changes = moved + std::max(n, old_n) - std::min(n, old_n);
+    const bool valid = n == end_points.size() && n >= 1;
+    const bool was_valid = old_n == end_points_.size() && old_n >= 1;
+
+    // Only the end points moved: same system, new right-hand side
+    if (valid && was_valid && changes == 0)
+    {
+        end_points_ = end_points;
+        if (compact() && factorization_->has_kernel)
+        {
+            solve_compact();
+            return;
+        }
+        if (!compact() && factorization_->has_inverse)
+        {
+            solve_dense();
+            return;
+        }
+    }
+
+    // Start points changed: about 6 (n + 3)^2 operations per update of the
+    // spline inverse, against about 2 (n + 3)^3 to compute it again
+    Factorization& f = *factorization_;
+    const bool update = valid && was_valid && !compact() &&
+                        n <= kDenseMaxPoints && f.has_inverse &&
+                        4 * changes <= n &&
+                        f.updates + static_cast<int>(changes) <= kMaxUpdates;
+    if (!update)
+    {
+        start_points_ = start_points;
+        end_points_ = end_points;
+        fit();
+        return;
+    }
+    f.updates += static_cast<int>(changes);
+    // The inverse always matches start_points_, but for the rows set to 0
+    bool ok = true;
+    for (std::size_t i = old_n; i-- > n && ok;)
+        ok = remove_row(i);
+    const Eigen::Index size = 3 + static_cast<Eigen::Index>(n);
+    const Eigen::Index old_size = f.inverse.rows();
+    f.inverse.conservativeResize(size, size);
+    if (size > old_size)
+    {
+        f.inverse.bottomRows(size - old_size).setZero();
+        f.inverse.rightCols(size - old_size).setZero();
+    }
+    start_points_.resize(n);
+    for (std::size_t i = 0; i < n && ok; ++i)
+    {
+        if (i < old_n && same_point(start_points[i], start_points_[i]))
+            continue;
+        if (i < old_n)
+            ok = remove_row(i);
+        start_points_[i] = start_points[i];
+        ok = ok && insert_row(i);
+    }
+    start_points_ = start_points;
+    end_points_ = end_points;
+    if (!ok)
+    {
+        fit();
+        return;
+    }
+    update_arrays();
+    solve_dense();
+}
+
+void RBFWarper::fit()
+{
+    const std::size_t n = start_points_.size();
+    factorization_ = std::make_unique<Factorization>();
+    support_ = 0;
+    grid_ = PointGrid();
+    center_ = { 0, 0 };
+    scale_ = 1;
+    inv_scale_ = 1;
+    alpha_x_.clear();
+    alpha_y_.clear();
+    if (n != end_points_.size() || n < 1)
+    {
+        // Only the affine part remains: no displacement at all
+        A_[0][0] = 0.0f; A_[0][1] = 0.0f;
+        A_[1][0] = 0.0f; A_[1][1] = 0.0f;
+        b_.x = 0.0f; b_.y = 0.0f;
+        x_.clear();
+        y_.clear();
+        return;
+    }
+    if (n <= kDenseMaxPoints)
+        fit_dense();
+    else
+        fit_compact();
+}
+
+void RBFWarper::fit_dense()
+{
+    using namespace Eigen;
+    const std::size_t n = start_points_.size();
+    // Centered on the bounding box of the control points, which spans
+    // [-1, 1] on its longer side
+    float min_x = start_points_[0].x, max_x = min_x;
+    float min_y = start_points_[0].y, max_y = min_y;
+    for (const Point2f& p : start_points_)
+    {
+        min_x = std::min(min_x, p.x);
+        max_x = std::max(max_x, p.x);
+        min_y = std::min(min_y, p.y);
+        max_y = std::max(max_y, p.y);
+    }
+    center_ = { 0.5f * (min_x + max_x), 0.5f * (min_y + max_y) };
+    const float extent = 0.5f * std::max(max_x - min_x, max_y - min_y);
+    scale_ = extent > 0 ? extent : 1.0f;
+    inv_scale_ = 1.0f / scale_;
+    update_arrays();
+
+    // K = [[0, P^T]; [P, R]]
+    MatrixXd K = MatrixXd::Zero(n + 3, n + 3);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const Point2f p = { x_[i], y_[i] };
+        for (std::size_t j = 0; j < i; ++j)
+        {
+            K(3 + i, 3 + j) = spline_kernel(p, { x_[j], y_[j] });
+            K(3 + j, 3 + i) = K(3 + i, 3 + j);
+        }
+        K(3 + i, 0) = K(0, 3 + i) = p.x;
+        K(3 + i, 1) = K(1, 3 + i) = p.y;
+        K(3 + i, 2) = K(2, 3 + i) = 1.0;
+    }
+    // Entries of very different size are left where control points are
+    // far from their bounding box, after updates: invert D K D, with D
+    // scaling each row and column to a largest entry near 1
+    VectorXd scale(n + 3);
+    for (Index i = 0; i < K.rows(); ++i)
+    {
+        const double largest = K.row(i).cwiseAbs().maxCoeff();
+        scale(i) = largest > 0 ? 1.0 / std::sqrt(largest) : 1.0;
+    }
+    const MatrixXd scaled = scale.asDiagonal() * K * scale.asDiagonal();
+    const MatrixXd scaled_inverse = scaled.partialPivLu().inverse();
+    // Fewer than 3 points, or all on a line, or repeated: no inverse, and
+    // the least squares solution of QR instead
+    const VectorXd probe = VectorXd::LinSpaced(n + 3, 1.0, 2.0);
+    const double error = (scaled * (scaled_inverse * probe) - probe).norm();
+    Factorization& f = *factorization_;
+    if (error < 1e-6 * probe.norm())
+    {
+        f.inverse =
+            scale.asDiagonal() * scaled_inverse * scale.asDiagonal();
+        f.has_inverse = true;
+        solve_dense();
+        return;
+    }
+    MatrixX2d rhs = MatrixX2d::Zero(n + 3, 2);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        rhs(3 + i, 0) =
+            (double(end_points_[i].x) - start_points_[i].x) / scale_;
+        rhs(3 + i, 1) =
+            (double(end_points_[i].y) - start_points_[i].y) / scale_;
+    }
+    const MatrixX2d alpha = K.colPivHouseholderQr().solve(rhs);
+    alpha_x_.resize(n);
+    alpha_y_.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        alpha_x_[i] = static_cast<float>(alpha(3 + i, 0));
+        alpha_y_[i] = static_cast<float>(alpha(3 + i, 1));
+    }
+    A_[0][0] = static_cast<float>(alpha(0, 0));
+    A_[0][1] = static_cast<float>(alpha(1, 0));
+    A_[1][0] = static_cast<float>(alpha(0, 1));
+    A_[1][1] = static_cast<float>(alpha(1, 1));
+    b_.x = static_cast<float>(alpha(2, 0));
+    b_.y = static_cast<float>(alpha(2, 1));
+}
+
+void RBFWarper::solve_dense()
+{
+    const std::size_t n = start_points_.size();
+    Eigen::MatrixX2d displacement(n, 2);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        displacement(i, 0) =
+            (double(end_points_[i].x) - start_points_[i].x) / scale_;
+        displacement(i, 1) =
+            (double(end_points_[i].y) - start_points_[i].y) / scale_;
+    }
+    // The right-hand side is 0 on the affine constraints
+    const Eigen::MatrixX2d alpha =
+        factorization_->inverse.rightCols(n) * displacement;
+    alpha_x_.resize(n);
+    alpha_y_.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        alpha_x_[i] = static_cast<float>(alpha(3 + i, 0));
+        alpha_y_[i] = static_cast<float>(alpha(3 + i, 1));
+    }
+    A_[0][0] = static_cast<float>(alpha(0, 0));
+    A_[0][1] = static_cast<float>(alpha(1, 0));
+    A_[1][0] = static_cast<float>(alpha(0, 1));
+    A_[1][1] = static_cast<float>(alpha(1, 1));
+    b_.x = static_cast<float>(alpha(2, 0));
+    b_.y = static_cast<float>(alpha(2, 1));
+}
+
+bool RBFWarper::remove_row(std::size_t i)
+{
+    // Inverse of K without row and column r, from the inverse [[E, f];
+    // [f^T, g]] of K (r last): E - f f^T / g
+    Eigen::MatrixXd& inverse = factorization_->inverse;
+    const Eigen::Index r = 3 + static_cast<Eigen::Index>(i);
+    Eigen::VectorXd f = inverse.col(r);
+    const double g = f(r);
+    if (!(std::abs(g) > 0) || !std::isfinite(g))
+        return false;
+    f(r) = 0;
+    inverse.noalias() -= f * (f.transpose() / g);
+    inverse.row(r).setZero();
+    inverse.col(r).setZero();
+    return true;
+}
+
+bool RBFWarper::insert_row(std::size_t i)
+{
+    // Inverse of K bordered by row and column r = (b, c), from the inverse
+    // M of K (0 on r): with u = M b and s = c - b^T u, M + u u^T / s, then
+    // -u / s on row and column r and 1 / s at (r, r)
+    Eigen::MatrixXd& inverse = factorization_->inverse;
+    const std::size_t n = start_points_.size();
+    const Eigen::Index r = 3 + static_cast<Eigen::Index>(i);
+    const Point2f p = normalized(start_points_[i].x, start_points_[i].y);
+    Eigen::VectorXd b(inverse.rows());
+    b(0) = p.x;
+    b(1) = p.y;
+    b(2) = 1.0;
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        b(3 + j) = spline_kernel(
+            p, normalized(start_points_[j].x, start_points_[j].y));
+    }
+    b(r) = 0;
+    const Eigen::VectorXd u = inverse * b;
+    // c = K(r, r) = 0
+    const double s = -b.dot(u);
+    // Only rounding is left of s when the point adds nothing to the
+    // system, e.g. it is already a control point
+    if (!(std::abs(s) > 1e-9 * b.norm() * u.norm()))
+        return false;
+    inverse.noalias() += u * (u.transpose() / s);
+    inverse.row(r) = -u.transpose() / s;
+    inverse.col(r) = -u / s;
+    inverse(r, r) = 1.0 / s;
+    return true;
+}
+
+void RBFWarper::update_arrays()
+{
+    x_.resize(start_points_.size());
+    y_.resize(start_points_.size());
+    for (std::size_t i = 0; i < start_points_.size(); ++i)
+    {
+        const Point2f p = normalized(start_points_[i].x, start_points_[i].y);
+        x_[i] = p.x;
+        y_[i] = p.y;
+    }
+}
+
+void RBFWarper::fit_compact()
+{
+    const std::size_t n = start_points_.size();
+    std::vector<float> xs(n), ys(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        xs[i] = start_points_[i].x;
+        ys[i] = start_points_[i].y;
+    }
+    const float spacing = PointGrid::spacing(xs.data(), ys.data(), n);
+    support_ = std::max(
+        std::sqrt(kSupportNeighbors / 3.14159265f) * spacing, 1e-3f);
+    // With cells as wide as the support, the points within the support of
+    // a point are in the 3 x 3 cells around its own
+    grid_ = PointGrid(xs.data(), ys.data(), n, support_);
+    support_ = grid_.cell_size();
+    x_.resize(n);
+    y_.resize(n);
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        x_[j] = xs[grid_.order()[j]];
+        y_[j] = ys[grid_.order()[j]];
+    }
+
+    // Normal equations of the affine least squares, around the centroid
+    // for conditioning
+    Factorization& f = *factorization_;
+    f.mean_x = 0;
+    f.mean_y = 0;
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        f.mean_x += x_[j];
+        f.mean_y += y_[j];
+    }
+    f.mean_x /= n;
+    f.mean_y /= n;
+    f.normal.setZero();
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        const Eigen::Vector3d p(x_[j] - f.mean_x, y_[j] - f.mean_y, 1.0);
+        f.normal += p * p.transpose();
+    }
+
+    // Kernel matrix, sparse and positive definite. The small ridge keeps
+    // it so when control points coincide.
+    constexpr double ridge = 1e-8;
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(n * static_cast<std::size_t>(4 * kSupportNeighbors));
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        const int cx = grid_.cell_x(x_[j]);
+        const int cy = grid_.cell_y(y_[j]);
+        const int i0 = std::max(cx - 1, 0);
+        const int i1 = std::min(cx + 1, grid_.cells_x() - 1);
+        for (int cj = std::max(cy - 1, 0);
+             cj <= std::min(cy + 1, grid_.cells_y() - 1);
+             ++cj)
+        {
+            for (int k = grid_.begin(i0, cj); k < grid_.end(i1, cj); ++k)
+            {
+                const double dx = x_[j] - x_[k];
+                const double dy = y_[j] - y_[k];
+                const double t = std::sqrt(dx * dx + dy * dy) / support_;
+                if (t >= 1.0)
+                    continue;
+                const double s = (1.0 - t) * (1.0 - t);
+                double phi = s * s * (4.0 * t + 1.0);
+                if (static_cast<std::size_t>(k) == j)
+                    phi += ridge;
+                triplets.emplace_back(static_cast<int>(j), k, phi);
+            }
+        }
+    }
+    Eigen::SparseMatrix<double> kernel(n, n);
+    kernel.setFromTriplets(triplets.begin(), triplets.end());
+    f.kernel.compute(kernel);
+    // Should not happen; the affine fit alone is the best left
+    f.has_kernel = f.kernel.info() == Eigen::Success;
+    solve_compact();
+}
+
+void RBFWarper::solve_compact()
+{
+    const std::size_t n = start_points_.size();
+    const Factorization& f = *factorization_;
+    Eigen::Matrix<double, 3, 2> moments = Eigen::Matrix<double, 3, 2>::Zero();
+    Eigen::MatrixX2d residual(n, 2);
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        const int i = grid_.order()[j];
+        const Eigen::Vector3d p(x_[j] - f.mean_x, y_[j] - f.mean_y, 1.0);
+        residual(j, 0) = end_points_[i].x - start_points_[i].x;
+        residual(j, 1) = end_points_[i].y - start_points_[i].y;
+        moments += p * residual.row(j);
+    }
+    // Rank deficient when the points lie on a line: then any of the best
+    // fits will do
+    const Eigen::Matrix<double, 3, 2> affine =
+        f.normal.colPivHouseholderQr().solve(moments);
+    float offset[2];
+    for (int d = 0; d < 2; ++d)
+    {
+        A_[d][0] = static_cast<float>(affine(0, d));
+        A_[d][1] = static_cast<float>(affine(1, d));
+        offset[d] = static_cast<float>(
+            affine(2, d) - affine(0, d) * f.mean_x - affine(1, d) * f.mean_y);
+    }
+    b_ = { offset[0], offset[1] };
+    // What the kernels interpolate: the displacements the affine map, as
+    // evaluated, misses
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        for (int d = 0; d < 2; ++d)
+            residual(j, d) -= A_[d][0] * x_[j] + A_[d][1] * y_[j] + offset[d];
+    }
+
+    alpha_x_.assign(n, 0.0f);
+    alpha_y_.assign(n, 0.0f);
+    if (!f.has_kernel)
+        return;
+    const Eigen::MatrixX2d alpha = f.kernel.solve(residual);
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        alpha_x_[j] = static_cast<float>(alpha(j, 0));
+        alpha_y_[j] = static_cast<float>(alpha(j, 1));
+    }
+}
+
+std::pair<float, float> RBFWarper::warp(float x, float y)
+{
+    std::pair<float, float> result;
+    warp_points(
+        warp_kernels::scalar_table(),
+        &x,
+        &y,
+        &result.first,
+        &result.second,
+        1);
+    return result;
+}
+
+void RBFWarper::warp_batch(
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    warp_points(warp_kernels::current(), xs, ys, out_x, out_y, n);
+}
+
+void RBFWarper::warp_points(
+    const warp_kernels::Table& kernels,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n) const
+{
+    if (compact())
+    {
+        warp_compact(kernels, xs, ys, out_x, out_y, n);
+        return;
+    }
+    // Without a solution (alpha_x_ empty) only the affine part remains
+    const warp_kernels::TpsPoints points{
+        x_.data(),
+        y_.data(),
+        alpha_x_.data(),
+        alpha_y_.data(),
+        alpha_x_.size(),
+        { { A_[0][0], A_[0][1], b_.x }, { A_[1][0], A_[1][1], b_.y } }
+    };
+    // In normalized coordinates, a chunk at a time. The chunk is read
+    // before it is written, so the result may overwrite the coordinates.
+    constexpr std::size_t kChunk = 256;
+    float u[kChunk], v[kChunk], warped_u[kChunk], warped_v[kChunk];
+    for (std::size_t start = 0; start < n; start += kChunk)
+    {
+        const std::size_t count = std::min(kChunk, n - start);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const Point2f p = normalized(xs[start + i], ys[start + i]);
+            u[i] = p.x;
+            v[i] = p.y;
+        }
+        kernels.tps(points, u, v, warped_u, warped_v, count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out_x[start + i] = center_.x + scale_ * warped_u[i];
+            out_y[start + i] = center_.y + scale_ * warped_v[i];
+        }
+    }
+}
+
+void RBFWarper::warp_compact(
+    const warp_kernels::Table& kernels,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n) const
+{
+    // Each tile sums over the control points of the cells within the
+    // support of its bounding box, which the grid keeps in index order:
+    // a point sums the same nonzero terms in the same order in any tile
+    std::vector<float> x, y, weight_x, weight_y;
+    for (std::size_t start = 0; start < n; start += kTilePoints)
+    {
+        const std::size_t count = std::min(kTilePoints, n - start);
+        const auto [min_x, max_x] =
+            std::minmax_element(xs + start, xs + start + count);
+        const auto [min_y, max_y] =
+            std::minmax_element(ys + start, ys + start + count);
+        const int i0 = grid_.cell_x(*min_x - support_);
+        const int i1 = grid_.cell_x(*max_x + support_);
+        const int j0 = grid_.cell_y(*min_y - support_);
+        const int j1 = grid_.cell_y(*max_y + support_);
+        x.clear();
+        y.clear();
+        weight_x.clear();
+        weight_y.clear();
+        for (int j = j0; j <= j1; ++j)
+        {
+            const int begin = grid_.begin(i0, j);
+            const int end = grid_.end(i1, j);
+            x.insert(x.end(), x_.begin() + begin, x_.begin() + end);
+            y.insert(y.end(), y_.begin() + begin, y_.begin() + end);
+            weight_x.insert(
+                weight_x.end(),
+                alpha_x_.begin() + begin,
+                alpha_x_.begin() + end);
+            weight_y.insert(
+                weight_y.end(),
+                alpha_y_.begin() + begin,
+                alpha_y_.begin() + end);
+        }
+        const warp_kernels::WendlandPoints points{
+            x.data(),
+            y.data(),
+            weight_x.data(),
+            weight_y.data(),
+            x.size(),
+            1.0f / support_,
+            { { A_[0][0], A_[0][1], b_.x }, { A_[1][0], A_[1][1], b_.y } }
+        };
+        kernels.wendland(
+            points,
+            xs + start,
+            ys + start,
+            out_x + start,
+            out_y + start,
+            count);
+    }
+}
+}  // namespace USTC_CG
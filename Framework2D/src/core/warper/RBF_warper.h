@@ -0,0 +1,135 @@
+// HW2_TODO: Implement the RBFWarper class
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include "point_grid.h"
+#include "warper.h"
+namespace USTC_CG
+{
+namespace warp_kernels
+{
+struct Table;
+}
+
+// Up to kDenseMaxPoints control points, a thin plate spline solved densely
+// (O(n^3)) and summed over every control point for every pixel. With more,
+// an affine map fitted by least squares plus compactly supported Wendland
+// kernels that interpolate what it misses: a sparse system, and a sum over
+// the few control points whose support covers the pixel. Far from the
+// control points this map is affine, where the spline would bend.
+//
+// The spline is fitted and evaluated in coordinates centered on the control
+// points and scaled to about [-1, 1]: in pixels, its kernels reach 10^7 on
+// a large image, and their sum in float cancels to a few pixels of error.
+//
+// refit() reuses the factorization for edits: moved end points only change
+// the right-hand side, and the spline updates the inverse of its system in
+// O(n^2) per start point added, moved or removed.
+class RBFWarper : public Warper
+{
+   public:
+    // Past this, the float sums of the spline miss the control points by a
+    // tenth of a pixel and more, and cost more than the compact kernels
+    static constexpr std::size_t kDenseMaxPoints = 128;
+    // Control points within the support of a Wendland kernel, on average
+    static constexpr float kSupportNeighbors = 24;
+
+    RBFWarper(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points);
+    ~RBFWarper() override;
+
+    // Fits the new control points, as a new RBFWarper would (up to
+    // rounding), updating the current fit when few start points changed.
+    // Points are matched by index: a point removed from the middle moves
+    // every point after it.
+    void refit(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points);
+
+    // HW2_TODO: Implement the warp(...) function with RBF interpolation
+    std::pair<float, float> warp(float x, float y) override;
+    void warp_batch(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) override;
+
+    // Whether the Wendland kernels are used, and their radius
+    bool compact() const
+    {
+        return support_ > 0;
+    }
+    float support() const
+    {
+        return support_;
+    }
+
+   private:
+    // Points of a batch that share a list of candidates (compact kernels)
+    static constexpr std::size_t kTilePoints = 16;
+    // Updates of the inverse after which it is computed again, before
+    // rounding errors pile up
+    static constexpr int kMaxUpdates = 64;
+
+    // Inverse of the spline system, or factorization of the Wendland
+    // kernels (defined with Eigen in the source)
+    struct Factorization;
+
+    // Fits start_points_ and end_points_ from scratch
+    void fit();
+    void fit_dense();
+    void fit_compact();
+    // Weights for end_points_ with the current factorization
+    void solve_dense();
+    void solve_compact();
+    // Updates of the inverse for start_points_[i], false when the system
+    // gets (nearly) singular
+    bool remove_row(std::size_t i);
+    bool insert_row(std::size_t i);
+    void update_arrays();
+    // Spline coordinates of a point in pixels, computed the same way for
+    // the control points and the points warped
+    Point2f normalized(float x, float y) const
+    {
+        return { (x - center_.x) * inv_scale_, (y - center_.y) * inv_scale_ };
+    }
+    void warp_points(
+        const warp_kernels::Table& kernels,
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) const;
+
+    // warp_points() with the Wendland kernels, tile by tile
+    void warp_compact(
+        const warp_kernels::Table& kernels,
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) const;
+
+    std::vector<Point2f> start_points_;
+    std::vector<Point2f> end_points_;
+    // HW2_TODO: other functions or variables if you need
+    std::vector<float> alpha_x_;              // RBF x方向权重
+    std::vector<float> alpha_y_;              // RBF y方向权重
+    float A_[2][2] = { { 0, 0 }, { 0, 0 } };  // 仿射矩阵
+    Point2f b_{ 0, 0 };                        // 平移向量
+    // Control points as arrays for the kernels: in grid order with compact
+    // kernels, else normalized()
+    std::vector<float> x_, y_;
+    // With the spline, A_, b_ and the weights map normalized() coordinates
+    // to displacements in units of scale_ pixels
+    Point2f center_{ 0, 0 };
+    float scale_ = 1, inv_scale_ = 1;
+    float support_ = 0;
+    PointGrid grid_;
+    std::unique_ptr<Factorization> factorization_;
+};
+}  // namespace USTC_CG
\ No newline at end of file
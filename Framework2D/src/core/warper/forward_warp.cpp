@@ -0,0 +1,431 @@
+#include "forward_warp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "common/parallel.h"
+#include "common/profiler.h"
+
+namespace USTC_CG
+{
+using uchar = unsigned char;
+
+namespace
+{
+constexpr float kFar = 1e20f;
+
+// Scratch arrays of distance_1d() for lines of up to n cells
+struct DistanceScratch
+{
+    explicit DistanceScratch(int n)
+        : v(n),
+          z(n + 1),
+          d(n)
+    {
+    }
+    std::vector<int> v;
+    std::vector<float> z, d;
+};
+
+// Lower envelope of the parabolas (q - p)^2 + f[p] (Felzenszwalb and
+// Huttenlocher): f[q] becomes min over p of (q - p)^2 + f[p], in place.
+// Values of kFar or more are no parabola.
+void distance_1d(float* f, int n, DistanceScratch& s)
+{
+    int k = -1;
+    for (int q = 0; q < n; ++q)
+    {
+        if (f[q] >= kFar)
+            continue;
+        const float fq = f[q] + float(q) * float(q);
+        float start = -kFar;
+        while (k >= 0)
+        {
+            const int p = s.v[k];
+            start = (fq - (f[p] + float(p) * float(p))) / (2.0f * (q - p));
+            if (start > s.z[k])
+                break;
+            --k;
+        }
+        if (k < 0)
+            start = -kFar;
+        ++k;
+        s.v[k] = q;
+        s.z[k] = start;
+        s.z[k + 1] = kFar;
+    }
+    // No parabola: the line stays at kFar
+    if (k < 0)
+        return;
+    k = 0;
+    for (int q = 0; q < n; ++q)
+    {
+        while (s.z[k + 1] < q)
+            ++k;
+        const float dq = float(q - s.v[k]);
+        s.d[q] = dq * dq + f[s.v[k]];
+    }
+    std::copy_n(s.d.begin(), n, f);
+}
+
+// Squared Euclidean distance transform of a width x height grid, in place:
+// every cell gets its squared distance to the nearest cell that was 0
+// (kFar or more if there is none). Cells must be 0 or kFar.
+void distance_transform(std::vector<float>& grid, int width, int height)
+{
+    parallel_for(
+        height,
+        rows_grain(width),
+        [&](int y0, int y1)
+        {
+            DistanceScratch scratch(width);
+            for (int y = y0; y < y1; ++y)
+                distance_1d(
+                    grid.data() + std::size_t(y) * width, width, scratch);
+        });
+    // Columns are copied out kColumnBlock at a time, so that each row of
+    // the grid is read and written in whole cache lines
+    constexpr int kColumnBlock = 16;
+    const int blocks = (width + kColumnBlock - 1) / kColumnBlock;
+    parallel_for(
+        blocks,
+        std::max(1, rows_grain(height) / kColumnBlock),
+        [&](int b0, int b1)
+        {
+            DistanceScratch scratch(height);
+            std::vector<float> columns(std::size_t(kColumnBlock) * height);
+            for (int b = b0; b < b1; ++b)
+            {
+                const int x0 = b * kColumnBlock;
+                const int count = std::min(kColumnBlock, width - x0);
+                for (int y = 0; y < height; ++y)
+                {
+                    const float* row = grid.data() + std::size_t(y) * width;
+                    for (int i = 0; i < count; ++i)
+                        columns[std::size_t(i) * height + y] = row[x0 + i];
+                }
+                for (int i = 0; i < count; ++i)
+                    distance_1d(
+                        columns.data() + std::size_t(i) * height,
+                        height,
+                        scratch);
+                for (int y = 0; y < height; ++y)
+                {
+                    float* row = grid.data() + std::size_t(y) * width;
+                    for (int i = 0; i < count; ++i)
+                        row[x0 + i] = columns[std::size_t(i) * height + y];
+                }
+            }
+        });
+}
+
+// Splat buffer and pyramid levels. Each pixel holds three colors (unused
+// ones stay 0) and a weight, interleaved so that a splat touches one cache
+// line per pixel.
+constexpr int kLanes = 4;
+constexpr int kWeight = 3;
+
+struct Level
+{
+    Level(int width, int height)
+        : width(width),
+          height(height),
+          data(std::size_t(width) * height * kLanes)
+    {
+    }
+    float* at(int x, int y)
+    {
+        return data.data() + (std::size_t(y) * width + x) * kLanes;
+    }
+    const float* at(int x, int y) const
+    {
+        return data.data() + (std::size_t(y) * width + x) * kLanes;
+    }
+
+    int width, height;
+    std::vector<float> data;
+};
+
+// Pixels to fill: not covered, but within the closing of the covered
+// pixels by a disk of the given radius. The closing spares the background
+// around the covered region, which a dilation alone would eat into. Empty
+// if there is none.
+std::vector<uchar> gaps(const Level& splats, float radius)
+{
+    const int width = splats.width;
+    const int height = splats.height;
+    const std::size_t size = std::size_t(width) * height;
+    std::vector<float> grid(size);
+    bool holes = false;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const bool covered = splats.data[i * kLanes + kWeight] > 0;
+        grid[i] = covered ? 0 : kFar;
+        holes |= !covered;
+    }
+    if (!holes)
+        return {};
+    // Dilation, then erosion: distance to the pixels out of the dilation
+    const float radius_sq = radius * radius;
+    distance_transform(grid, width, height);
+    for (float& d : grid)
+        d = d <= radius_sq ? kFar : 0;
+    distance_transform(grid, width, height);
+    std::vector<uchar> fill(size);
+    holes = false;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        fill[i] = !(splats.data[i * kLanes + kWeight] > 0) &&
+                  grid[i] > radius_sq;
+        holes |= fill[i] != 0;
+    }
+    if (!holes)
+        return {};
+    return fill;
+}
+
+// Half resolution of a level: colors averaged with their weights, weights
+// summed and clamped to 1
+Level pull(const Level& level)
+{
+    Level parent((level.width + 1) / 2, (level.height + 1) / 2);
+    parallel_for(
+        parent.height,
+        rows_grain(parent.width),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                const int cy1 = std::min(2 * y + 1, level.height - 1);
+                for (int x = 0; x < parent.width; ++x)
+                {
+                    const int cx1 = std::min(2 * x + 1, level.width - 1);
+                    // Children repeated at an odd border count twice,
+                    // which does not change the mean
+                    const float* children[4] = { level.at(2 * x, 2 * y),
+                                                 level.at(cx1, 2 * y),
+                                                 level.at(2 * x, cy1),
+                                                 level.at(cx1, cy1) };
+                    float sum[kLanes] = {};
+                    for (const float* child : children)
+                    {
+                        for (int c = 0; c < kWeight; ++c)
+                            sum[c] += child[kWeight] * child[c];
+                        sum[kWeight] += child[kWeight];
+                    }
+                    if (!(sum[kWeight] > 0))
+                        continue;
+                    float* out = parent.at(x, y);
+                    for (int c = 0; c < kWeight; ++c)
+                        out[c] = sum[c] / sum[kWeight];
+                    out[kWeight] = std::min(sum[kWeight], 1.0f);
+                }
+            }
+        });
+    return parent;
+}
+
+// Completes the pixels of `level` that are not fully covered with the
+// parent level, sampled bilinearly. Only the pixels with `mask` set (if
+// given) are completed.
+void push(Level& level, const Level& parent, const std::vector<uchar>* mask)
+{
+    parallel_for(
+        level.height,
+        rows_grain(level.width),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                // Center of pixel y in the parent
+                const float py = std::max(0.5f * y - 0.25f, 0.0f);
+                const int py0 = std::min(int(py), parent.height - 1);
+                const int py1 = std::min(py0 + 1, parent.height - 1);
+                const float fy = py - py0;
+                for (int x = 0; x < level.width; ++x)
+                {
+                    float* out = level.at(x, y);
+                    if (!(out[kWeight] < 1) ||
+                        (mask && !(*mask)[std::size_t(y) * level.width + x]))
+                        continue;
+                    const float px = std::max(0.5f * x - 0.25f, 0.0f);
+                    const int px0 = std::min(int(px), parent.width - 1);
+                    const int px1 = std::min(px0 + 1, parent.width - 1);
+                    const float fx = px - px0;
+                    const float* p00 = parent.at(px0, py0);
+                    const float* p10 = parent.at(px1, py0);
+                    const float* p01 = parent.at(px0, py1);
+                    const float* p11 = parent.at(px1, py1);
+                    const float w = out[kWeight];
+                    for (int c = 0; c < kWeight; ++c)
+                    {
+                        const float up =
+                            (1 - fy) * ((1 - fx) * p00[c] + fx * p10[c]) +
+                            fy * ((1 - fx) * p01[c] + fx * p11[c]);
+                        out[c] = w * out[c] + (1 - w) * up;
+                    }
+                    out[kWeight] = 1;
+                }
+            }
+        });
+}
+
+// Adds a splat of weight w and color c to pixel p
+inline void splat(float* p, const float* c, float w)
+{
+    for (int i = 0; i < kWeight; ++i)
+        p[i] += w * c[i];
+    p[kWeight] += w;
+}
+}  // namespace
+
+Image forward_warp(
+    Warper& warper,
+    const Image& source,
+    const ForwardWarpOptions& options)
+{
+    static const ProfileStage stage("warp/forward_warp");
+    ProfileScope scope(stage);
+
+    if (options.max_hole < 0)
+        throw std::invalid_argument("Invalid forward warp options");
+    const int width = source.width();
+    const int height = source.height();
+    const int channels = source.channels();
+    const int color_channels = std::min(channels, 3);
+    // The result keeps the alpha channel of the source
+    Image result(source);
+    if (width == 0 || height == 0)
+        return result;
+
+    // Splats, band by band of source rows: the positions of a band are
+    // evaluated in parallel, then splatted. The targets of different rows
+    // overlap, so splatting is serial.
+    constexpr int kBandRows = 64;
+    Level splats(width, height);
+    std::vector<float> map_x(std::size_t(width) * kBandRows);
+    std::vector<float> map_y(map_x.size());
+    for (int b0 = 0; b0 < height; b0 += kBandRows)
+    {
+        const int b1 = std::min(height, b0 + kBandRows);
+        parallel_for(
+            b1 - b0,
+            warper.is_thread_safe() ? rows_grain(width, 4096) : kBandRows,
+            [&](int i0, int i1)
+            {
+                for (int i = i0; i < i1; ++i)
+                {
+                    float* xs = map_x.data() + std::size_t(i) * width;
+                    float* ys = map_y.data() + std::size_t(i) * width;
+                    for (int x = 0; x < width; ++x)
+                    {
+                        xs[x] = static_cast<float>(x);
+                        ys[x] = static_cast<float>(b0 + i);
+                    }
+                    warper.warp_batch(xs, ys, xs, ys, width);
+                }
+            });
+        for (int y = b0; y < b1; ++y)
+        {
+            const uchar* src = source.row(y);
+            const float* xs = map_x.data() + std::size_t(y - b0) * width;
+            const float* ys = map_y.data() + std::size_t(y - b0) * width;
+            for (int x = 0; x < width; ++x)
+            {
+                // Also rejects NaN
+                if (!(xs[x] > -1 && xs[x] < width && ys[x] > -1 &&
+                      ys[x] < height))
+                    continue;
+                float color[kWeight] = {};
+                for (int c = 0; c < color_channels; ++c)
+                    color[c] = src[x * channels + c];
+                const int x0 = static_cast<int>(std::floor(xs[x]));
+                const int y0 = static_cast<int>(std::floor(ys[x]));
+                const float fx = xs[x] - x0;
+                const float fy = ys[x] - y0;
+                if (x0 >= 0 && x0 + 1 < width && y0 >= 0 && y0 + 1 < height)
+                {
+                    float* p = splats.at(x0, y0);
+                    float* q = p + std::size_t(width) * kLanes;
+                    splat(p, color, (1 - fx) * (1 - fy));
+                    splat(p + kLanes, color, fx * (1 - fy));
+                    splat(q, color, (1 - fx) * fy);
+                    splat(q + kLanes, color, fx * fy);
+                    continue;
+                }
+                // On the border, drop the corners out of the image
+                for (int k = 0; k < 4; ++k)
+                {
+                    const int tx = x0 + (k & 1);
+                    const int ty = y0 + (k >> 1);
+                    if (tx >= 0 && tx < width && ty >= 0 && ty < height)
+                        splat(
+                            splats.at(tx, ty),
+                            color,
+                            ((k & 1) ? fx : 1 - fx) * ((k >> 1) ? fy : 1 - fy));
+                }
+            }
+        }
+    }
+    // Weighted means, and weights clamped to 1 for the pyramid
+    parallel_for(
+        height,
+        rows_grain(width),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    float* p = splats.at(x, y);
+                    if (!(p[kWeight] > 0))
+                        continue;
+                    for (int c = 0; c < kWeight; ++c)
+                        p[c] /= p[kWeight];
+                    p[kWeight] = std::min(p[kWeight], 1.0f);
+                }
+            }
+        });
+
+    const std::vector<uchar> fill = gaps(splats, 0.5f * options.max_hole);
+    if (!fill.empty())
+    {
+        // Push-pull, down to a single pixel. Gaps are within max_hole / 2
+        // of covered pixels, so they are completed from the coarse levels
+        // near them.
+        std::vector<Level> levels;
+        levels.push_back(pull(splats));
+        while (levels.back().width > 1 || levels.back().height > 1)
+            levels.push_back(pull(levels.back()));
+        for (std::size_t k = levels.size() - 1; k > 0; --k)
+            push(levels[k - 1], levels[k], nullptr);
+        // Only the gaps of the finest level take the pyramid, covered
+        // pixels keep their own splats
+        push(splats, levels.front(), &fill);
+    }
+
+    uchar* const data = result.data();
+    const std::size_t stride = result.stride();
+    parallel_for(
+        height,
+        rows_grain(width),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                uchar* row = data + y * stride;
+                const float* p = splats.at(0, y);
+                for (int x = 0; x < width; ++x, p += kLanes)
+                {
+                    // Pixels left uncovered are 0
+                    for (int c = 0; c < color_channels; ++c)
+                        row[x * channels + c] = static_cast<uchar>(
+                            std::clamp(p[c], 0.0f, 255.0f) + 0.5f);
+                }
+            }
+        });
+    return result;
+}
+}  // namespace USTC_CG
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common/image.h"
+#include "warper.h"
+
+namespace USTC_CG
+{
+// Parameters of forward_warp().
+struct ForwardWarpOptions
+{
+    // Widest gap between splatted pixels that is filled, in pixels.
+    // Uncovered regions wider than this, e.g. around an image that the map
+    // shrinks, keep the background.
+    int max_hole = 32;
+};
+
+// Forward warping: every pixel (x, y) of the source moves to
+// warper.warp(x, y) in the result, so `warper` maps source coordinates to
+// result coordinates (the reverse of warp_image()). The result has the size
+// of the source and keeps its alpha channel.
+//
+// Each source pixel is splatted onto the four result pixels around its
+// position with bilinear weights, into float accumulation buffers, and the
+// pixels that got any weight take the weighted mean of their splats. Where
+// the map spreads the pixels apart, the gaps left are filled by push-pull:
+// the covered pixels are averaged down a pyramid of half resolutions, and
+// each gap takes the color of the finest level that covers it,
+// interpolated bilinearly on the way back up. Gaps are told apart from the
+// background by a morphological closing of the covered pixels, of radius
+// max_hole / 2, computed with two exact distance transforms. Every stage is
+// one or two linear passes over the image; the background has zero color
+// channels.
+Image forward_warp(
+    Warper& warper,
+    const Image& source,
+    const ForwardWarpOptions& options = {});
+}  // namespace USTC_CG
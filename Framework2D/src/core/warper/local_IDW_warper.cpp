@@ -0,0 +1,311 @@
+#include "local_IDW_warper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "warp_kernels.h"
+
+namespace USTC_CG
+{
+LocalIDWWarper::LocalIDWWarper(
+    const std::vector<Point2f>& start_points,
+    const std::vector<Point2f>& end_points,
+    int neighbors)
+    : neighbors_(std::max(neighbors, 1))
+{
+    const std::size_t n = std::min(start_points.size(), end_points.size());
+    std::vector<float> xs(n), ys(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        xs[i] = start_points[i].x;
+        ys[i] = start_points[i].y;
+    }
+    // About two points per cell
+    grid_ = PointGrid(
+        xs.data(),
+        ys.data(),
+        n,
+        std::sqrt(2.0f) * PointGrid::spacing(xs.data(), ys.data(), n));
+    x_.resize(n);
+    y_.resize(n);
+    dx_.resize(n);
+    dy_.resize(n);
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        const int i = grid_.order()[j];
+        x_[j] = xs[i];
+        y_[j] = ys[i];
+        dx_[j] = end_points[i].x - xs[i];
+        dy_[j] = end_points[i].y - ys[i];
+    }
+}
+
+std::pair<float, float> LocalIDWWarper::warp(float x, float y)
+{
+    std::pair<float, float> result;
+    warp_batch(&x, &y, &result.first, &result.second, 1);
+    return result;
+}
+
+void LocalIDWWarper::warp_batch(
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    // Few control points: plain IDW over all of them
+    if (x_.size() <=
+        kDirectPointsPerNeighbor * static_cast<std::size_t>(neighbors_))
+    {
+        const warp_kernels::IdwPoints points{
+            x_.data(), y_.data(), dx_.data(), dy_.data(), x_.size()
+        };
+        warp_kernels::current().idw(
+            points, warp_kernels::IdwPower::kTwo, xs, ys, out_x, out_y, n);
+        return;
+    }
+    Scratch scratch;
+    for (std::size_t i = 0; i < n; i += kTilePoints)
+    {
+        warp_tile(
+            xs + i,
+            ys + i,
+            out_x + i,
+            out_y + i,
+            std::min(kTilePoints, n - i),
+            scratch);
+    }
+}
+
+void LocalIDWWarper::warp_tile(
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n,
+    Scratch& scratch) const
+{
+    const std::size_t k = neighbors_;
+    // The k + 1 nearest control points of a point p of the tile are within
+    // d(p, c) + d_k+1(c) of p, hence within 2h + d_k+1(c) of the center c,
+    // where h is the half diagonal of the tile
+    float min_x = xs[0], max_x = xs[0], min_y = ys[0], max_y = ys[0];
+    for (std::size_t i = 1; i < n; ++i)
+    {
+        min_x = std::min(min_x, xs[i]);
+        max_x = std::max(max_x, xs[i]);
+        min_y = std::min(min_y, ys[i]);
+        max_y = std::max(max_y, ys[i]);
+    }
+    const float center_x = 0.5f * (min_x + max_x);
+    const float center_y = 0.5f * (min_y + max_y);
+    const float diagonal = std::hypot(max_x - min_x, max_y - min_y);
+    auto& near = scratch.near;
+    const float nearest_k = gather(center_x, center_y, diagonal, near);
+    // Where control points are dense, a tile wider than the neighborhood
+    // would gather several times k candidates
+    if (n > 1 && diagonal > nearest_k)
+    {
+        const std::size_t half = n / 2;
+        warp_tile(xs, ys, out_x, out_y, half, scratch);
+        warp_tile(
+            xs + half, ys + half, out_x + half, out_y + half, n - half,
+            scratch);
+        return;
+    }
+
+    // The candidates, contiguous and in index order, so that a point sums
+    // the same neighbors in the same order in any batch
+    const float radius = (nearest_k + diagonal) * kSlack;
+    near.erase(
+        std::remove_if(
+            near.begin(),
+            near.end(),
+            [&](const auto& c) { return c.first > radius * radius; }),
+        near.end());
+    std::sort(
+        near.begin(),
+        near.end(),
+        [](const auto& a, const auto& b) { return a.second < b.second; });
+    const std::size_t m = near.size();
+    scratch.x.resize(m);
+    scratch.y.resize(m);
+    scratch.dx.resize(m);
+    scratch.dy.resize(m);
+    scratch.dist_sq.resize(m);
+    scratch.weight.resize(m);
+    float* cx = scratch.x.data();
+    float* cy = scratch.y.data();
+    float* cdx = scratch.dx.data();
+    float* cdy = scratch.dy.data();
+    float* dist_sq = scratch.dist_sq.data();
+    float* weight = scratch.weight.data();
+    for (std::size_t j = 0; j < m; ++j)
+    {
+        const int p = near[j].second;
+        cx[j] = x_[p];
+        cy[j] = y_[p];
+        cdx[j] = dx_[p];
+        cdy[j] = dy_[p];
+    }
+
+    const warp_kernels::Table& kernels = warp_kernels::current();
+    // Candidate at the distance R of the previous point, a good guess for
+    // the next one
+    std::size_t last = m;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const float x = xs[i];
+        const float y = ys[i];
+        for (std::size_t j = 0; j < m; ++j)
+        {
+            const float dx = x - cx[j];
+            const float dy = y - cy[j];
+            dist_sq[j] = dx * dx + dy * dy;
+        }
+        const float r_sq = m > k ? select(dist_sq, m, last, scratch) : 0.0f;
+        // Weights, 0 from R on: only the k nearest count, without a branch
+        kernels.shepard(dist_sq, r_sq > 0 ? 1.0f / r_sq : 0.0f, weight, m);
+        float sum_w = 0.0f;
+        float sum_wx = 0.0f;
+        float sum_wy = 0.0f;
+        for (std::size_t j = 0; j < m; ++j)
+        {
+            sum_w += weight[j];
+            sum_wx += weight[j] * cdx[j];
+            sum_wy += weight[j] * cdy[j];
+        }
+        // Unlike IDW, tapered weights are legitimately tiny far from the
+        // control points: only a point whose k nearest all tie with the
+        // (k + 1)-th, and so weigh 0, keeps its position
+        if (!(sum_w > 0))
+        {
+            out_x[i] = x;
+            out_y[i] = y;
+        }
+        else
+        {
+            out_x[i] = x + sum_wx / sum_w;
+            out_y[i] = y + sum_wy / sum_w;
+        }
+    }
+}
+
+float LocalIDWWarper::select(
+    const float* dist_sq,
+    std::size_t m,
+    std::size_t& last,
+    Scratch& scratch) const
+{
+    // A step to the next point moves the candidate at R by a rank or so:
+    // count those below the guess, then if it is off by one take the next
+    // distance above or below it
+    const std::size_t k = neighbors_;
+    if (last < m)
+    {
+        const float guess = dist_sq[last];
+        std::size_t below = 0, at_most = 0;
+        for (std::size_t j = 0; j < m; ++j)
+        {
+            below += dist_sq[j] < guess;
+            at_most += dist_sq[j] <= guess;
+        }
+        if (below <= k && at_most > k)
+            return guess;
+        float r_sq = -1;
+        if (at_most == k)
+        {
+            r_sq = std::numeric_limits<float>::infinity();
+            for (std::size_t j = 0; j < m; ++j)
+            {
+                const float d = dist_sq[j] > guess ? dist_sq[j] : r_sq;
+                r_sq = d < r_sq ? d : r_sq;
+            }
+        }
+        else if (below == k + 1)
+        {
+            r_sq = 0;
+            for (std::size_t j = 0; j < m; ++j)
+            {
+                const float d = dist_sq[j] < guess ? dist_sq[j] : r_sq;
+                r_sq = d > r_sq ? d : r_sq;
+            }
+        }
+        if (r_sq >= 0)
+        {
+            last = std::find(dist_sq, dist_sq + m, r_sq) - dist_sq;
+            return r_sq;
+        }
+    }
+    auto& selection = scratch.selection;
+    selection.resize(m);
+    for (std::size_t j = 0; j < m; ++j)
+        selection[j] = { dist_sq[j], static_cast<int>(j) };
+    std::nth_element(selection.begin(), selection.begin() + k, selection.end());
+    last = selection[k].second;
+    return selection[k].first;
+}
+
+float LocalIDWWarper::gather(
+    float x,
+    float y,
+    float margin,
+    std::vector<std::pair<float, int>>& near) const
+{
+    // Rings of cells around the cell of (x, y), until every point within
+    // the radius is found: the cells left are all farther
+    const std::size_t k = neighbors_;
+    const int cx = grid_.cell_x(x);
+    const int cy = grid_.cell_y(y);
+    const int cells_x = grid_.cells_x();
+    const int cells_y = grid_.cells_y();
+    const float size = grid_.cell_size();
+    near.clear();
+    float nearest_k = 0;
+    for (int ring = 0;; ++ring)
+    {
+        const int i0 = cx - ring, i1 = cx + ring;
+        const int j0 = cy - ring, j1 = cy + ring;
+        for (int j = std::max(j0, 0); j <= std::min(j1, cells_y - 1); ++j)
+        {
+            // Whole rows at the top and bottom of the ring, else its ends
+            const bool edge = j == j0 || j == j1;
+            const int step = edge ? 1 : i1 - i0;
+            for (int i = i0; i <= i1; i += std::max(step, 1))
+            {
+                if (i < 0 || i >= cells_x)
+                    continue;
+                for (int p = grid_.begin(i, j); p < grid_.end(i, j); ++p)
+                {
+                    const float dx = x - x_[p];
+                    const float dy = y - y_[p];
+                    near.emplace_back(dx * dx + dy * dy, p);
+                }
+            }
+        }
+
+        // Distance to the nearest cell outside the rings searched
+        float bound = std::numeric_limits<float>::infinity();
+        if (i0 > 0)
+            bound = std::min(bound, x - (grid_.origin_x() + i0 * size));
+        if (i1 < cells_x - 1)
+            bound = std::min(bound, grid_.origin_x() + (i1 + 1) * size - x);
+        if (j0 > 0)
+            bound = std::min(bound, y - (grid_.origin_y() + j0 * size));
+        if (j1 < cells_y - 1)
+            bound = std::min(bound, grid_.origin_y() + (j1 + 1) * size - y);
+        if (near.size() > k)
+        {
+            std::nth_element(near.begin(), near.begin() + k, near.end());
+            nearest_k = std::sqrt(near[k].first);
+            if (bound >= (nearest_k + margin) * kSlack)
+                break;
+        }
+        if (bound == std::numeric_limits<float>::infinity())
+            break;
+    }
+    return nearest_k;
+}
+}  // namespace USTC_CG
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "point_grid.h"
+#include "warper.h"
+
+namespace USTC_CG
+{
+// IDW over the nearest control points only, for dense correspondences
+// (thousands of pairs) where IDWWarper, which sums over every point for
+// every pixel, is too slow.
+//
+// A point blends the displacements of its k nearest control points with
+// the IDW weights 1 / (d^2 + epsilon) tapered by (1 - d^2 / R^2)^2, where R
+// is the distance to the (k + 1)-th nearest control point (a modified
+// Shepard method).
+// The weight of a point thus vanishes before it leaves the neighbors, so
+// the map is continuous. With at most k control points this is IDWWarper
+// with mu = 2, and so it is with at most kDirectPointsPerNeighbor * k: the
+// SIMD kernels of IDWWarper sum over that many points faster than the
+// neighbors are searched.
+//
+// The control points are bucketed in a uniform grid. warp_batch() splits
+// its points into tiles of neighboring points that share one list of
+// candidates, which contains the k + 1 nearest control points of every
+// point of the tile. The cost is about O(points * k) instead of
+// O(points * control points).
+class LocalIDWWarper : public Warper
+{
+   public:
+    LocalIDWWarper(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points,
+        int neighbors = 16);
+
+    std::pair<float, float> warp(float x, float y) override;
+    void warp_batch(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) override;
+
+    int neighbors() const
+    {
+        return neighbors_;
+    }
+
+    // Crossover of warp_batch() with IDWWarper, on 1 megapixel with 16
+    // neighbors: about 3 control points per neighbor with the scalar
+    // kernels, 12 with SSE4 and 80 with AVX2
+    static constexpr std::size_t kDirectPointsPerNeighbor = 16;
+
+   private:
+    // Points of a batch that share a list of candidates
+    static constexpr std::size_t kTilePoints = 64;
+
+    // Relative margin of the search radii, for rounding
+    static constexpr float kSlack = 1.0001f;
+
+    struct Scratch
+    {
+        // Control points near the tile, and their squared distance to it
+        std::vector<std::pair<float, int>> near;
+        // Candidates of the tile: position, displacement, and for the
+        // current point squared distance and weight
+        std::vector<float> x, y, dx, dy, dist_sq, weight;
+        std::vector<std::pair<float, int>> selection;
+    };
+
+    void warp_tile(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n,
+        Scratch& scratch) const;
+    // Distance R of the (k + 1)-th nearest of the m candidates, squared,
+    // guessing that it is the candidate `last`, which is updated
+    float select(
+        const float* dist_sq,
+        std::size_t m,
+        std::size_t& last,
+        Scratch& scratch) const;
+    // Replaces `near` with every control point within d + margin of (x, y)
+    // at least, where d is the distance from (x, y) to its (k + 1)-th
+    // nearest control point, and returns d.
+    float gather(
+        float x,
+        float y,
+        float margin,
+        std::vector<std::pair<float, int>>& near) const;
+
+    int neighbors_;
+    PointGrid grid_;
+    // Control points in grid order: start x and y, end - start
+    std::vector<float> x_, y_, dx_, dy_;
+};
+}  // namespace USTC_CG
@@ -0,0 +1,78 @@
+#include "point_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace USTC_CG
+{
+PointGrid::PointGrid(
+    const float* xs,
+    const float* ys,
+    std::size_t n,
+    float cell_size)
+{
+    if (n == 0)
+        return;
+    float min_x = xs[0], max_x = min_x;
+    float min_y = ys[0], max_y = min_y;
+    for (std::size_t i = 1; i < n; ++i)
+    {
+        min_x = std::min(min_x, xs[i]);
+        max_x = std::max(max_x, xs[i]);
+        min_y = std::min(min_y, ys[i]);
+        max_y = std::max(max_y, ys[i]);
+    }
+    const float width = max_x - min_x;
+    const float height = max_y - min_y;
+    cell_size_ = std::max(
+        { cell_size, std::max(width, height) / (2.0f * n), 1e-3f });
+    origin_x_ = min_x;
+    origin_y_ = min_y;
+    cells_x_ = static_cast<int>(width / cell_size_) + 1;
+    cells_y_ = static_cast<int>(height / cell_size_) + 1;
+
+    // Counting sort of the points by cell
+    std::vector<int> cell(n);
+    cell_start_.assign(static_cast<std::size_t>(cells_x_) * cells_y_ + 1, 0);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        cell[i] = cell_y(ys[i]) * cells_x_ + cell_x(xs[i]);
+        ++cell_start_[cell[i] + 1];
+    }
+    for (std::size_t c = 1; c < cell_start_.size(); ++c)
+        cell_start_[c] += cell_start_[c - 1];
+    std::vector<int> next(cell_start_.begin(), cell_start_.end() - 1);
+    order_.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+        order_[next[cell[i]]++] = static_cast<int>(i);
+}
+
+float PointGrid::spacing(const float* xs, const float* ys, std::size_t n)
+{
+    if (n == 0)
+        return 0;
+    const auto [min_x, max_x] = std::minmax_element(xs, xs + n);
+    const auto [min_y, max_y] = std::minmax_element(ys, ys + n);
+    const float width = *max_x - *min_x;
+    const float height = *max_y - *min_y;
+    return std::max(
+        std::sqrt(width * height / n), std::max(width, height) / n);
+}
+
+int PointGrid::cell_x(float x) const
+{
+    const float c = std::floor((x - origin_x_) / cell_size_);
+    // Also for NaN
+    if (!(c > 0))
+        return 0;
+    return c < cells_x_ - 1 ? static_cast<int>(c) : cells_x_ - 1;
+}
+
+int PointGrid::cell_y(float y) const
+{
+    const float c = std::floor((y - origin_y_) / cell_size_);
+    if (!(c > 0))
+        return 0;
+    return c < cells_y_ - 1 ? static_cast<int>(c) : cells_y_ - 1;
+}
+}  // namespace USTC_CG
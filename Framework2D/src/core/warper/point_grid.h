@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace USTC_CG
+{
+// Uniform grid of square cells over a set of points, for the warpers that
+// only look at the control points near a pixel. The points are sorted by
+// cell (row by row of cells), so that the points of a cell, and of a run of
+// cells along a row, are contiguous.
+class PointGrid
+{
+   public:
+    PointGrid() = default;
+    // Grid of cells of cell_size over the bounding box of the n points
+    // (xs[i], ys[i]). cell_size is raised if needed so that there are at
+    // most about 2n + 1 cells along an axis.
+    PointGrid(const float* xs, const float* ys, std::size_t n, float cell_size);
+
+    // Typical distance between neighbors among n points (xs[i], ys[i]): the
+    // side of the area per point in their bounding box, or the length per
+    // point when they lie on a line
+    static float spacing(const float* xs, const float* ys, std::size_t n);
+
+    // Index in the input of each point, in cell order
+    const std::vector<int>& order() const
+    {
+        return order_;
+    }
+
+    float origin_x() const
+    {
+        return origin_x_;
+    }
+    float origin_y() const
+    {
+        return origin_y_;
+    }
+    float cell_size() const
+    {
+        return cell_size_;
+    }
+    int cells_x() const
+    {
+        return cells_x_;
+    }
+    int cells_y() const
+    {
+        return cells_y_;
+    }
+
+    // Cell of a coordinate, clamped to the grid (also for NaN)
+    int cell_x(float x) const;
+    int cell_y(float y) const;
+
+    // Points of cells i0..i1 of row j, in cell order: [begin, end). The
+    // cells must be in the grid.
+    int begin(int i0, int j) const
+    {
+        return cell_start_[static_cast<std::size_t>(j) * cells_x_ + i0];
+    }
+    int end(int i1, int j) const
+    {
+        return cell_start_[static_cast<std::size_t>(j) * cells_x_ + i1 + 1];
+    }
+
+   private:
+    std::vector<int> order_;
+    float origin_x_ = 0, origin_y_ = 0, cell_size_ = 1;
+    int cells_x_ = 1, cells_y_ = 1;
+    // The points of cell c = j * cells_x_ + i are
+    // [cell_start_[c], cell_start_[c + 1]).
+    std::vector<int> cell_start_ = { 0, 0 };
+};
+}  // namespace USTC_CG
@@ -0,0 +1,639 @@
+#include "triangulation_warper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "common/parallel.h"
+#include "common/profiler.h"
+#include "point_grid.h"
+
+namespace USTC_CG
+{
+namespace
+{
+struct Vertex
+{
+    double x, y;
+};
+
+// Error bounds of the determinants below computed in double (Shewchuk's
+// ccwerrboundA and iccerrboundA): a determinant smaller than the bound
+// times its permanent may have the wrong sign, and counts as zero.
+constexpr double kEpsilon = std::numeric_limits<double>::epsilon() / 2;
+constexpr double kOrientBound = (3 + 16 * kEpsilon) * kEpsilon;
+constexpr double kInCircleBound = (10 + 96 * kEpsilon) * kEpsilon;
+
+// Sign of (b - a) x (c - a): 1 if a, b, c turn the way of the triangles of
+// the mesh, -1 the other way, 0 if they are collinear or too close to tell
+int orient(const Vertex& a, const Vertex& b, const Vertex& c)
+{
+    const double left = (b.x - a.x) * (c.y - a.y);
+    const double right = (b.y - a.y) * (c.x - a.x);
+    const double det = left - right;
+    const double bound = kOrientBound * (std::abs(left) + std::abs(right));
+    return det > bound ? 1 : det < -bound ? -1 : 0;
+}
+
+// Whether d is certainly inside the circle through a, b, c (orient() = 1)
+bool in_circle(
+    const Vertex& a,
+    const Vertex& b,
+    const Vertex& c,
+    const Vertex& d)
+{
+    const double adx = a.x - d.x, ady = a.y - d.y;
+    const double bdx = b.x - d.x, bdy = b.y - d.y;
+    const double cdx = c.x - d.x, cdy = c.y - d.y;
+    const double alift = adx * adx + ady * ady;
+    const double blift = bdx * bdx + bdy * bdy;
+    const double clift = cdx * cdx + cdy * cdy;
+    const double det = alift * (bdx * cdy - bdy * cdx) +
+                       blift * (cdx * ady - cdy * adx) +
+                       clift * (adx * bdy - ady * bdx);
+    const double permanent =
+        alift * (std::abs(bdx * cdy) + std::abs(bdy * cdx)) +
+        blift * (std::abs(cdx * ady) + std::abs(cdy * adx)) +
+        clift * (std::abs(adx * bdy) + std::abs(ady * bdx));
+    return det > kInCircleBound * permanent;
+}
+
+// Incremental Delaunay triangulation of a rectangle and the points inside
+// it (Lawson's algorithm). Each point is located by walking from the last
+// triangle created, splits the triangle or the edge it falls on, and the
+// edges around it are flipped until they are all locally Delaunay. Points
+// inserted in spatial order make the walks short.
+class Delaunay
+{
+   public:
+    struct Triangle
+    {
+        int v[3];  // orient() = 1
+        int n[3];  // Triangle across the edge opposite v[i], or -1
+    };
+
+    // Two triangles over the rectangle of vertices c[0..3], in the order
+    // of orient() = 1
+    Delaunay(const std::vector<Vertex>& vertices, const int (&c)[4])
+        : vertices_(vertices)
+    {
+        triangles_.push_back({ { c[0], c[1], c[2] }, { -1, 1, -1 } });
+        triangles_.push_back({ { c[0], c[2], c[3] }, { -1, -1, 0 } });
+    }
+
+    // Adds vertex p, strictly inside the rectangle. Returns false, and
+    // leaves the mesh as it was, if p is already a vertex.
+    bool insert(int p)
+    {
+        const Vertex& point = vertices_[p];
+        int edge = -1;
+        const int t = locate(point, edge);
+        if (t < 0)
+            return false;
+        stack_.clear();
+        if (edge < 0)
+            split_triangle(t, p);
+        else if (!split_edge(t, edge, p))
+            return false;
+        while (!stack_.empty())
+        {
+            const auto [triangle, corner] = stack_.back();
+            stack_.pop_back();
+            legalize(triangle, corner);
+        }
+        return true;
+    }
+
+    const std::vector<Triangle>& triangles() const
+    {
+        return triangles_;
+    }
+
+   private:
+    // Triangle containing the point, with `edge` the index of the edge it
+    // lies on or -1. Returns -1 if the point is one of the vertices.
+    int locate(const Vertex& point, int& edge) const
+    {
+        int t = last_;
+        // A walk always ends in a Delaunay triangulation; the bound only
+        // guards against rounding
+        const std::size_t max_steps = 4 * triangles_.size() + 16;
+        for (std::size_t step = 0; step < max_steps; ++step)
+        {
+            const int found = visit(t, point, static_cast<int>(step % 3), edge);
+            if (found == -2)
+                return -1;
+            if (found == t)
+                return t;
+            if (found < 0)
+                break;
+            t = found;
+        }
+        for (int s = 0; s < static_cast<int>(triangles_.size()); ++s)
+        {
+            const int found = visit(s, point, 0, edge);
+            if (found == -2)
+                return -1;
+            if (found == s)
+                return s;
+        }
+        return -1;
+    }
+
+    // Next triangle of a walk toward the point: t itself if it contains the
+    // point, -1 if the point is outside the mesh, -2 if it is vertex of t.
+    // The edges are tried from `first` on, which varies from step to step
+    // so that the walk cannot cycle.
+    int visit(int t, const Vertex& point, int first, int& edge) const
+    {
+        const Triangle& triangle = triangles_[t];
+        int zeros = 0;
+        edge = -1;
+        for (int k = 0; k < 3; ++k)
+        {
+            const int i = (first + k) % 3;
+            const int o = orient(
+                vertices_[triangle.v[(i + 1) % 3]],
+                vertices_[triangle.v[(i + 2) % 3]],
+                point);
+            if (o < 0)
+                return triangle.n[i];
+            if (o == 0)
+            {
+                edge = i;
+                ++zeros;
+            }
+        }
+        return zeros > 1 ? -2 : t;
+    }
+
+    // Replaces the neighbor `from` of triangle t with `to`
+    void relink(int t, int from, int to)
+    {
+        if (t < 0)
+            return;
+        for (int& n : triangles_[t].n)
+        {
+            if (n == from)
+                n = to;
+        }
+    }
+
+    // Splits t = (a, b, c) into (p, b, c), (a, p, c) and (a, b, p)
+    void split_triangle(int t, int p)
+    {
+        const Triangle old = triangles_[t];
+        const auto [a, b, c] = old.v;
+        const auto [na, nb, nc] = old.n;
+        const int tb = static_cast<int>(triangles_.size());
+        const int tc = tb + 1;
+        triangles_[t] = { { p, b, c }, { na, tb, tc } };
+        triangles_.push_back({ { a, p, c }, { t, nb, tc } });
+        triangles_.push_back({ { a, b, p }, { t, tb, nc } });
+        relink(nb, t, tb);
+        relink(nc, t, tc);
+        last_ = t;
+        stack_.push_back({ t, 0 });
+        stack_.push_back({ tb, 1 });
+        stack_.push_back({ tc, 2 });
+    }
+
+    // Splits the edge of t opposite its vertex `edge`, and the triangle on
+    // its other side, at p
+    bool split_edge(int t, int edge, int p)
+    {
+        const Triangle old = triangles_[t];
+        const int o = old.n[edge];
+        if (o < 0)
+            return false;
+        const int a = old.v[edge];
+        const int b = old.v[(edge + 1) % 3];
+        const int c = old.v[(edge + 2) % 3];
+        const int n_tb = old.n[(edge + 1) % 3];  // Across (c, a)
+        const int n_tc = old.n[(edge + 2) % 3];  // Across (a, b)
+        const Triangle other = triangles_[o];
+        int j = 0;
+        while (other.n[j] != t)
+            ++j;
+        // other = (d, c, b)
+        const int d = other.v[j];
+        const int n_oc = other.n[(j + 1) % 3];  // Across (b, d)
+        const int n_ob = other.n[(j + 2) % 3];  // Across (d, c)
+
+        const int t2 = static_cast<int>(triangles_.size());
+        const int t4 = t2 + 1;
+        triangles_[t] = { { a, b, p }, { o, t2, n_tc } };
+        triangles_.push_back({ { a, p, c }, { t4, n_tb, t } });
+        triangles_[o] = { { d, p, b }, { t, n_oc, t4 } };
+        triangles_.push_back({ { d, c, p }, { t2, o, n_ob } });
+        relink(n_tb, t, t2);
+        relink(n_ob, o, t4);
+        last_ = t;
+        stack_.push_back({ t, 2 });
+        stack_.push_back({ t2, 1 });
+        stack_.push_back({ o, 1 });
+        stack_.push_back({ t4, 2 });
+        return true;
+    }
+
+    // Flips the edge of t opposite its vertex `corner`, the new point, if
+    // the vertex across it is inside the circumcircle of t
+    void legalize(int t, int corner)
+    {
+        const Triangle& triangle = triangles_[t];
+        const int o = triangle.n[corner];
+        if (o < 0)
+            return;
+        const int p = triangle.v[corner];
+        const int b = triangle.v[(corner + 1) % 3];
+        const int c = triangle.v[(corner + 2) % 3];
+        const int n_tb = triangle.n[(corner + 1) % 3];  // Across (c, p)
+        const int n_tc = triangle.n[(corner + 2) % 3];  // Across (p, b)
+        const Triangle& other = triangles_[o];
+        int j = 0;
+        while (other.n[j] != t)
+            ++j;
+        // other = (d, c, b)
+        const int d = other.v[j];
+        if (!in_circle(
+                vertices_[p], vertices_[b], vertices_[c], vertices_[d]))
+            return;
+        const int n_oc = other.n[(j + 1) % 3];  // Across (b, d)
+        const int n_ob = other.n[(j + 2) % 3];  // Across (d, c)
+        // The quad p, b, d, c is convex: (b, c) becomes (p, d)
+        triangles_[t] = { { p, b, d }, { n_oc, o, n_tc } };
+        triangles_[o] = { { p, d, c }, { n_ob, n_tb, t } };
+        relink(n_oc, o, t);
+        relink(n_tb, t, o);
+        stack_.push_back({ t, 0 });
+        stack_.push_back({ o, 0 });
+    }
+
+    const std::vector<Vertex>& vertices_;
+    std::vector<Triangle> triangles_;
+    int last_ = 0;  // Where the next walk starts
+    std::vector<std::pair<int, int>> stack_;  // Edges to legalize
+};
+}  // namespace
+
+TriangulationWarper::TriangulationWarper(
+    const std::vector<Point2f>& start_points,
+    const std::vector<Point2f>& end_points,
+    int width,
+    int height)
+{
+    const std::size_t n = std::min(start_points.size(), end_points.size());
+    // Frame: the image and the start points, with a margin so that no
+    // pixel center or start point lies on its border
+    if (width > 0 && height > 0)
+    {
+        x1_ = static_cast<float>(width - 1);
+        y1_ = static_cast<float>(height - 1);
+    }
+    else if (n > 0)
+    {
+        x0_ = x1_ = start_points[0].x;
+        y0_ = y1_ = start_points[0].y;
+    }
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        x0_ = std::min(x0_, start_points[i].x);
+        x1_ = std::max(x1_, start_points[i].x);
+        y0_ = std::min(y0_, start_points[i].y);
+        y1_ = std::max(y1_, start_points[i].y);
+    }
+    x0_ -= 1;
+    y0_ -= 1;
+    x1_ += 1;
+    y1_ += 1;
+
+    vertices_.assign(start_points.begin(), start_points.begin() + n);
+    std::vector<Point2f> sources(end_points.begin(), end_points.begin() + n);
+    const int c[4] = { static_cast<int>(n),
+                       static_cast<int>(n) + 1,
+                       static_cast<int>(n) + 2,
+                       static_cast<int>(n) + 3 };
+    for (const Point2f& corner :
+         { Point2f{ x0_, y0_ },
+           Point2f{ x1_, y0_ },
+           Point2f{ x1_, y1_ },
+           Point2f{ x0_, y1_ } })
+    {
+        vertices_.push_back(corner);
+        sources.push_back(corner);
+    }
+    std::vector<Vertex> vertices(vertices_.size());
+    for (std::size_t i = 0; i < vertices_.size(); ++i)
+        vertices[i] = { vertices_[i].x, vertices_[i].y };
+
+    // Inserted cell by cell
+    std::vector<float> xs(n), ys(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        xs[i] = start_points[i].x;
+        ys[i] = start_points[i].y;
+    }
+    const PointGrid order(
+        xs.data(),
+        ys.data(),
+        n,
+        PointGrid::spacing(xs.data(), ys.data(), n));
+    Delaunay mesh(vertices, c);
+    for (const int i : order.order())
+        mesh.insert(i);
+
+    // Affine map of each triangle, from the barycentric coordinates
+    triangles_.reserve(mesh.triangles().size());
+    for (const Delaunay::Triangle& t : mesh.triangles())
+    {
+        Triangle triangle;
+        std::copy_n(t.v, 3, triangle.v);
+        const Vertex& p0 = vertices[t.v[0]];
+        const Vertex& p1 = vertices[t.v[1]];
+        const Vertex& p2 = vertices[t.v[2]];
+        const Point2f& q0 = sources[t.v[0]];
+        const Point2f& q1 = sources[t.v[1]];
+        const Point2f& q2 = sources[t.v[2]];
+        const double e1x = p1.x - p0.x, e1y = p1.y - p0.y;
+        const double e2x = p2.x - p0.x, e2y = p2.y - p0.y;
+        const double det = e1x * e2y - e1y * e2x;
+        // Derivatives of the barycentric coordinates of p1 and p2. A
+        // sliver left by rounding covers no pixel center: constant map.
+        double l1x = 0, l1y = 0, l2x = 0, l2y = 0;
+        if (det > 0)
+        {
+            l1x = e2y / det;
+            l1y = -e2x / det;
+            l2x = -e1y / det;
+            l2y = e1x / det;
+        }
+        const double d1x = double(q1.x) - q0.x, d1y = double(q1.y) - q0.y;
+        const double d2x = double(q2.x) - q0.x, d2y = double(q2.y) - q0.y;
+        triangle.ax = l1x * d1x + l2x * d2x;
+        triangle.bx = l1y * d1x + l2y * d2x;
+        triangle.cx = q0.x - triangle.ax * p0.x - triangle.bx * p0.y;
+        triangle.ay = l1x * d1y + l2x * d2y;
+        triangle.by = l1y * d1y + l2y * d2y;
+        triangle.cy = q0.y - triangle.ay * p0.x - triangle.by * p0.y;
+        triangles_.push_back(triangle);
+    }
+
+    // Bucket grid of about one cell per vertex
+    cell_size_ = std::max(
+        PointGrid::spacing(xs.data(), ys.data(), n),
+        std::max(x1_ - x0_, y1_ - y0_) / (n + 4));
+    cells_x_ = static_cast<int>((x1_ - x0_) / cell_size_) + 1;
+    cells_y_ = static_cast<int>((y1_ - y0_) / cell_size_) + 1;
+    auto cell_range = [&](const Triangle& t, int& i0, int& i1, int& j0, int& j1)
+    {
+        float min_x = vertices_[t.v[0]].x, max_x = min_x;
+        float min_y = vertices_[t.v[0]].y, max_y = min_y;
+        for (int k = 1; k < 3; ++k)
+        {
+            min_x = std::min(min_x, vertices_[t.v[k]].x);
+            max_x = std::max(max_x, vertices_[t.v[k]].x);
+            min_y = std::min(min_y, vertices_[t.v[k]].y);
+            max_y = std::max(max_y, vertices_[t.v[k]].y);
+        }
+        auto cell = [this](float v, float origin, int cells)
+        {
+            return std::clamp(
+                static_cast<int>((v - origin) / cell_size_), 0, cells - 1);
+        };
+        i0 = cell(min_x, x0_, cells_x_);
+        i1 = cell(max_x, x0_, cells_x_);
+        j0 = cell(min_y, y0_, cells_y_);
+        j1 = cell(max_y, y0_, cells_y_);
+    };
+    cell_start_.assign(static_cast<std::size_t>(cells_x_) * cells_y_ + 1, 0);
+    for (const Triangle& t : triangles_)
+    {
+        int i0, i1, j0, j1;
+        cell_range(t, i0, i1, j0, j1);
+        for (int j = j0; j <= j1; ++j)
+        {
+            for (int i = i0; i <= i1; ++i)
+                ++cell_start_[static_cast<std::size_t>(j) * cells_x_ + i + 1];
+        }
+    }
+    for (std::size_t k = 1; k < cell_start_.size(); ++k)
+        cell_start_[k] += cell_start_[k - 1];
+    cell_triangles_.resize(cell_start_.back());
+    std::vector<int> next(cell_start_.begin(), cell_start_.end() - 1);
+    for (int t = 0; t < static_cast<int>(triangles_.size()); ++t)
+    {
+        int i0, i1, j0, j1;
+        cell_range(triangles_[t], i0, i1, j0, j1);
+        for (int j = j0; j <= j1; ++j)
+        {
+            for (int i = i0; i <= i1; ++i)
+                cell_triangles_[next[static_cast<std::size_t>(j) * cells_x_ +
+                                     i]++] = t;
+        }
+    }
+}
+
+int TriangulationWarper::locate(double x, double y, int hint) const
+{
+    if (!(x >= x0_ && x <= x1_ && y >= y0_ && y <= y1_))
+        return -1;
+    // Smallest barycentric coordinate of (x, y) in t: >= 0 inside
+    auto inside = [&](int t)
+    {
+        const Point2f& p0 = vertices_[triangles_[t].v[0]];
+        const Point2f& p1 = vertices_[triangles_[t].v[1]];
+        const Point2f& p2 = vertices_[triangles_[t].v[2]];
+        auto cross =
+            [](const Point2f& a, const Point2f& b, double x, double y)
+        {
+            return (double(b.x) - a.x) * (y - a.y) -
+                   (double(b.y) - a.y) * (x - a.x);
+        };
+        const double det = cross(p0, p1, p2.x, p2.y);
+        if (!(det > 0))
+            return -std::numeric_limits<double>::infinity();
+        return std::min(
+                   { cross(p1, p2, x, y),
+                     cross(p2, p0, x, y),
+                     cross(p0, p1, x, y) }) /
+               det;
+    };
+    if (hint >= 0 && inside(hint) >= 0)
+        return hint;
+    const int i = std::clamp(
+        static_cast<int>((x - x0_) / cell_size_), 0, cells_x_ - 1);
+    const int j = std::clamp(
+        static_cast<int>((y - y0_) / cell_size_), 0, cells_y_ - 1);
+    const std::size_t c = static_cast<std::size_t>(j) * cells_x_ + i;
+    // On an edge, rounding may leave the point just outside every triangle:
+    // take the nearest
+    int best = -1;
+    double best_inside = -std::numeric_limits<double>::infinity();
+    for (int k = cell_start_[c]; k < cell_start_[c + 1]; ++k)
+    {
+        const int t = cell_triangles_[k];
+        const double value = inside(t);
+        if (value >= 0)
+            return t;
+        if (value > best_inside)
+        {
+            best = t;
+            best_inside = value;
+        }
+    }
+    return best;
+}
+
+std::pair<float, float> TriangulationWarper::warp(float x, float y)
+{
+    std::pair<float, float> result;
+    warp_batch(&x, &y, &result.first, &result.second, 1);
+    return result;
+}
+
+void TriangulationWarper::warp_batch(
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    // Neighboring points of a row usually share a triangle
+    int hint = -1;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const double x = xs[i], y = ys[i];
+        const int t = locate(x, y, hint);
+        // The frame stays in place, and so does everything outside it
+        if (t < 0)
+        {
+            out_x[i] = xs[i];
+            out_y[i] = ys[i];
+            continue;
+        }
+        hint = t;
+        const Triangle& triangle = triangles_[t];
+        out_x[i] = static_cast<float>(
+            triangle.ax * x + triangle.bx * y + triangle.cx);
+        out_y[i] = static_cast<float>(
+            triangle.ay * x + triangle.by * y + triangle.cy);
+    }
+}
+
+WarpField TriangulationWarper::bake(int width, int height) const
+{
+    static const ProfileStage stage("warp/bake_triangulation");
+    ProfileScope scope(stage);
+
+    // Pixels outside the frame, if any, keep the identity
+    WarpField field(width, height);
+    if (field.empty())
+        return field;
+
+    // Rows y of a triangle: ymin <= y < ymax
+    auto rows = [&](const Triangle& t, int& y0, int& y1)
+    {
+        float min_y = vertices_[t.v[0]].y, max_y = min_y;
+        for (int k = 1; k < 3; ++k)
+        {
+            min_y = std::min(min_y, vertices_[t.v[k]].y);
+            max_y = std::max(max_y, vertices_[t.v[k]].y);
+        }
+        const float rows_end = static_cast<float>(height);
+        y0 = static_cast<int>(std::clamp(std::ceil(min_y), 0.0f, rows_end));
+        y1 = static_cast<int>(std::clamp(std::ceil(max_y), 0.0f, rows_end));
+    };
+    // Triangles of each band of rows
+    const int bands = (height + kBandRows - 1) / kBandRows;
+    std::vector<int> band_start(bands + 1, 0);
+    for (const Triangle& t : triangles_)
+    {
+        int y0, y1;
+        rows(t, y0, y1);
+        for (int b = y0 / kBandRows; y0 < y1 && b <= (y1 - 1) / kBandRows;
+             ++b)
+            ++band_start[b + 1];
+    }
+    for (int b = 0; b < bands; ++b)
+        band_start[b + 1] += band_start[b];
+    std::vector<int> band_triangles(band_start.back());
+    std::vector<int> next(band_start.begin(), band_start.end() - 1);
+    for (int t = 0; t < static_cast<int>(triangles_.size()); ++t)
+    {
+        int y0, y1;
+        rows(triangles_[t], y0, y1);
+        for (int b = y0 / kBandRows; y0 < y1 && b <= (y1 - 1) / kBandRows;
+             ++b)
+            band_triangles[next[b]++] = t;
+    }
+
+    // Where edge (i, j) crosses row y. Both triangles of an edge compute it
+    // from its vertices in the same order, so they get the same value and
+    // split the row there: pixels x < x_edge go to the triangle on the
+    // left, the others to the one on the right. On the row of a vertex,
+    // every edge through it crosses exactly at the vertex.
+    auto crossing = [this](int i, int j, double y)
+    {
+        if (i > j)
+            std::swap(i, j);
+        const Point2f& a = vertices_[i];
+        const Point2f& b = vertices_[j];
+        if (y == a.y)
+            return double(a.x);
+        if (y == b.y)
+            return double(b.x);
+        return a.x + (y - a.y) * (double(b.x) - a.x) / (double(b.y) - a.y);
+    };
+    auto rasterize = [&](const Triangle& t, int y_begin, int y_end)
+    {
+        int v[3] = { t.v[0], t.v[1], t.v[2] };
+        std::sort(
+            v,
+            v + 3,
+            [this](int i, int j) { return vertices_[i].y < vertices_[j].y; });
+        const double middle_y = vertices_[v[1]].y;
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            // Between the long edge and one of the two short ones
+            const double xa = crossing(v[0], v[2], y);
+            const double xb = y < middle_y ? crossing(v[0], v[1], y)
+                                           : crossing(v[1], v[2], y);
+            const int x_begin = static_cast<int>(
+                std::clamp(std::ceil(std::min(xa, xb)), 0.0, double(width)));
+            const int x_end = static_cast<int>(
+                std::clamp(std::ceil(std::max(xa, xb)), 0.0, double(width)));
+            // The barycentric coordinates, and so the position in the
+            // source, are affine along the row
+            const double row_x = t.bx * y + t.cx;
+            const double row_y = t.by * y + t.cy;
+            float* xs = field.xs(y);
+            float* ys = field.ys(y);
+            for (int x = x_begin; x < x_end; ++x)
+            {
+                xs[x] = static_cast<float>(t.ax * x + row_x);
+                ys[x] = static_cast<float>(t.ay * x + row_y);
+            }
+        }
+    };
+    parallel_for(
+        bands,
+        1,
+        [&](int b0, int b1)
+        {
+            for (int b = b0; b < b1; ++b)
+            {
+                const int band_y0 = b * kBandRows;
+                const int band_y1 = std::min(height, band_y0 + kBandRows);
+                for (int k = band_start[b]; k < band_start[b + 1]; ++k)
+                {
+                    const Triangle& t = triangles_[band_triangles[k]];
+                    int y0, y1;
+                    rows(t, y0, y1);
+                    rasterize(
+                        t, std::max(y0, band_y0), std::min(y1, band_y1));
+                }
+            }
+        });
+    return field;
+}
+}  // namespace USTC_CG
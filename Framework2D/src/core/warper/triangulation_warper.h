@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "warp_field.h"
+#include "warper.h"
+
+namespace USTC_CG
+{
+// Piecewise affine map over a Delaunay triangulation of the start points,
+// plus the corners of a frame around the image that stay in place: each
+// triangle is mapped affinely onto the triangle of the matching end points.
+// The frame is the rectangle of the image and the start points, one pixel
+// wider on every side, so the map is the identity on it and outside.
+//
+// The map is continuous but only piecewise smooth, and its cost does not
+// depend on the number of control points: bake() rasterizes the triangles
+// in O(pixels), after an O(n log n) triangulation. Start points given twice
+// keep the first of their end points.
+class TriangulationWarper : public Warper
+{
+   public:
+    TriangulationWarper(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points,
+        int width,
+        int height);
+
+    std::pair<float, float> warp(float x, float y) override;
+    void warp_batch(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) override;
+
+    // Field of the map over width x height pixels, written triangle by
+    // triangle: each row of a triangle is a span between two of its edges,
+    // along which the position in the source is affine in x. Every pixel
+    // is written by exactly one triangle, and the bands of rows are
+    // rasterized in parallel.
+    WarpField bake(int width, int height) const;
+
+    std::size_t triangles() const
+    {
+        return triangles_.size();
+    }
+
+   private:
+    // Rows of the bands rasterized by one task in bake()
+    static constexpr int kBandRows = 64;
+
+    struct Triangle
+    {
+        int v[3];  // Indices in vertices_, counterclockwise
+        // Position in the source: (ax x + bx y + cx, ay x + by y + cy)
+        double ax, bx, cx;
+        double ay, by, cy;
+    };
+
+    // Triangle containing (x, y), trying `hint` first, or -1 outside the
+    // frame
+    int locate(double x, double y, int hint) const;
+
+    std::vector<Point2f> vertices_;  // Start points, then the frame corners
+    std::vector<Triangle> triangles_;
+    float x0_ = 0, y0_ = 0, x1_ = 0, y1_ = 0;  // Frame
+
+    // Triangles overlapping each cell of a grid over the frame, for
+    // locate(): cell c = j * cells_x_ + i holds
+    // cell_triangles_[cell_start_[c], cell_start_[c + 1])
+    float cell_size_ = 1;
+    int cells_x_ = 1, cells_y_ = 1;
+    std::vector<int> cell_start_, cell_triangles_;
+};
+}  // namespace USTC_CG
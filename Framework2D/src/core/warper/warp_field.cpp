@@ -0,0 +1,505 @@
+#include "warp_field.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "common/parallel.h"
+#include "common/profiler.h"
+
+namespace USTC_CG
+{
+namespace
+{
+// Source position
+struct Node
+{
+    float x = 0, y = 0;
+};
+
+Node lerp(const Node& a, const Node& b, float t)
+{
+    return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t };
+}
+
+// Lattice cell: the pixels [x0, x1) x [y0, y1), plus the right column and
+// the bottom row for the last cells of the lattice, so that every pixel is
+// written by exactly one cell. n00, n10, n01 and n11 are the exact
+// positions of the corners (x0, y0), (x1, y0), (x0, y1) and (x1, y1).
+struct Cell
+{
+    int x0, y0, x1, y1;
+    Node n00, n10, n01, n11;
+    bool right, bottom;
+};
+
+// Fills the cells of a lattice for WarpField::bake_coarse().
+class CoarseBaker
+{
+   public:
+    // Largest parts of a cell that are evaluated at every pixel rather than
+    // split further.
+    static constexpr int kExactPixels = 16;
+    // Probes of the first level of a lattice cell
+    static constexpr int kProbes = 5;
+
+    // First-level probes of `c`: the midpoints of its edges and its center
+    static void probes(const Cell& c, float* xs, float* ys)
+    {
+        const float xm = float((c.x0 + c.x1) / 2);
+        const float ym = float((c.y0 + c.y1) / 2);
+        const float px[kProbes] = { xm, xm, float(c.x0), float(c.x1), xm };
+        const float py[kProbes] = { float(c.y0), float(c.y1), ym, ym, ym };
+        std::copy_n(px, kProbes, xs);
+        std::copy_n(py, kProbes, ys);
+    }
+
+    CoarseBaker(Warper& warper, WarpField& field, float tolerance)
+        : warper_(warper),
+          field_(field),
+          tolerance_(tolerance)
+    {
+    }
+
+    // Exact positions of the n points (xs[i], ys[i]), in one batch
+    void evaluate(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        int n,
+        CoarseBakeStats& stats)
+    {
+        warper_.warp_batch(xs, ys, out_x, out_y, n);
+        stats.evaluations += n;
+    }
+
+    void fill_cell(const Cell& c, CoarseBakeStats& stats)
+    {
+        const bool split_x = c.x1 - c.x0 >= 2;
+        const bool split_y = c.y1 - c.y0 >= 2;
+        if (!split_x && !split_y)
+        {
+            interpolate_cell(c);
+            return;
+        }
+
+        const int xm = (c.x0 + c.x1) / 2;
+        const int ym = (c.y0 + c.y1) / 2;
+        // Probes: top, low, left, right and center, those that split the
+        // cell
+        enum
+        {
+            kTop,
+            kLow,
+            kLeft,
+            kRight,
+            kCenter
+        };
+        const float probe_x[5] = { float(xm),   float(xm), float(c.x0),
+                                   float(c.x1), float(xm) };
+        const float probe_y[5] = { float(c.y0), float(c.y1), float(ym),
+                                   float(ym),   float(ym) };
+        const bool used[5] = { split_x, split_x, split_y, split_y,
+                               split_x && split_y };
+        float xs[5], ys[5];
+        int index[5];
+        int n = 0;
+        for (int i = 0; i < 5; ++i)
+        {
+            if (!used[i])
+                continue;
+            xs[n] = probe_x[i];
+            ys[n] = probe_y[i];
+            index[n++] = i;
+        }
+        float exact_x[5], exact_y[5];
+        evaluate(xs, ys, exact_x, exact_y, n, stats);
+        // Error of the interpolation at the probes
+        Node nodes[5];
+        float error = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            const Node approx = interpolate(c, xs[i], ys[i]);
+            error = std::max(
+                error,
+                std::hypot(exact_x[i] - approx.x, exact_y[i] - approx.y));
+            nodes[index[i]] = { exact_x[i], exact_y[i] };
+        }
+        const Node& top = nodes[kTop];
+        const Node& low = nodes[kLow];
+        const Node& left = nodes[kLeft];
+        const Node& right = nodes[kRight];
+        const Node& center = nodes[kCenter];
+        if (error <= tolerance_)
+        {
+            stats.max_error = std::max(stats.max_error, error);
+            interpolate_cell(c);
+            return;
+        }
+        // Probing parts of a few pixels costs about as much as evaluating
+        // them
+        if ((c.x1 - c.x0) * (c.y1 - c.y0) <= 4 * kExactPixels)
+        {
+            evaluate_cell(c, stats);
+            return;
+        }
+
+        if (split_x && split_y)
+        {
+            fill_cell(
+                { c.x0, c.y0, xm, ym, c.n00, top, left, center, false, false },
+                stats);
+            fill_cell(
+                { xm, c.y0, c.x1, ym, top, c.n10, center, right, c.right,
+                  false },
+                stats);
+            fill_cell(
+                { c.x0, ym, xm, c.y1, left, center, c.n01, low, false,
+                  c.bottom },
+                stats);
+            fill_cell(
+                { xm, ym, c.x1, c.y1, center, right, low, c.n11, c.right,
+                  c.bottom },
+                stats);
+        }
+        else if (split_x)
+        {
+            fill_cell(
+                { c.x0, c.y0, xm, c.y1, c.n00, top, c.n01, low, false,
+                  c.bottom },
+                stats);
+            fill_cell(
+                { xm, c.y0, c.x1, c.y1, top, c.n10, low, c.n11, c.right,
+                  c.bottom },
+                stats);
+        }
+        else
+        {
+            fill_cell(
+                { c.x0, c.y0, c.x1, ym, c.n00, c.n10, left, right, c.right,
+                  false },
+                stats);
+            fill_cell(
+                { c.x0, ym, c.x1, c.y1, left, right, c.n01, c.n11, c.right,
+                  c.bottom },
+                stats);
+        }
+    }
+
+    // Bilinear interpolation of the corners of the cell
+    static Node interpolate(const Cell& c, float x, float y)
+    {
+        const float u = c.x1 > c.x0 ? (x - c.x0) / (c.x1 - c.x0) : 0.0f;
+        const float v = c.y1 > c.y0 ? (y - c.y0) / (c.y1 - c.y0) : 0.0f;
+        return lerp(lerp(c.n00, c.n10, u), lerp(c.n01, c.n11, u), v);
+    }
+
+    void interpolate_cell(const Cell& c)
+    {
+        for (int y = c.y0; y < c.y1 + (c.bottom ? 1 : 0); ++y)
+        {
+            float* row_x = field_.xs(y);
+            float* row_y = field_.ys(y);
+            for (int x = c.x0; x < c.x1 + (c.right ? 1 : 0); ++x)
+            {
+                const Node node = interpolate(c, x, y);
+                row_x[x] = node.x;
+                row_y[x] = node.y;
+            }
+        }
+    }
+
+   private:
+
+    void evaluate_cell(const Cell& c, CoarseBakeStats& stats)
+    {
+        const int n = c.x1 - c.x0 + (c.right ? 1 : 0);
+        for (int y = c.y0; y < c.y1 + (c.bottom ? 1 : 0); ++y)
+        {
+            float* row_x = field_.xs(y) + c.x0;
+            float* row_y = field_.ys(y) + c.x0;
+            for (int i = 0; i < n; ++i)
+            {
+                row_x[i] = static_cast<float>(c.x0 + i);
+                row_y[i] = static_cast<float>(y);
+            }
+            warper_.warp_batch(row_x, row_y, row_x, row_y, n);
+            stats.evaluations += n;
+        }
+    }
+
+    Warper& warper_;
+    WarpField& field_;
+    float tolerance_;
+};
+
+// Lattice coordinates along an axis of `size` pixels: every `step` pixels,
+// and the last pixel
+std::vector<int> lattice(int size, int step)
+{
+    std::vector<int> coords;
+    for (int c = 0; c < size - 1; c += step)
+        coords.push_back(c);
+    coords.push_back(size - 1);
+    return coords;
+}
+}  // namespace
+
+WarpField::WarpField(int width, int height) : map_(width, height, 2)
+{
+    parallel_for(
+        height,
+        rows_grain(width),
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                float* row_x = xs(y);
+                float* row_y = ys(y);
+                for (int x = 0; x < width; ++x)
+                {
+                    row_x[x] = static_cast<float>(x);
+                    row_y[x] = static_cast<float>(y);
+                }
+            }
+        });
+}
+
+WarpField WarpField::bake(Warper& warper, int width, int height)
+{
+    static const ProfileStage stage("warp/bake_field");
+    ProfileScope scope(stage);
+
+    WarpField field;
+    field.map_ = ImageF(width, height, 2);
+    // Same grain as warp_image(): evaluating the warper dominates
+    const int grain =
+        warper.is_thread_safe() ? rows_grain(width, 4096) : height;
+    parallel_for(
+        height,
+        grain,
+        [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                float* row_x = field.xs(y);
+                float* row_y = field.ys(y);
+                for (int x = 0; x < width; ++x)
+                {
+                    row_x[x] = static_cast<float>(x);
+                    row_y[x] = static_cast<float>(y);
+                }
+                warper.warp_batch(row_x, row_y, row_x, row_y, width);
+            }
+        });
+    return field;
+}
+
+WarpField WarpField::bake_coarse(
+    Warper& warper,
+    int width,
+    int height,
+    const CoarseBakeOptions& options,
+    CoarseBakeStats* stats)
+{
+    static const ProfileStage stage("warp/bake_coarse");
+    ProfileScope scope(stage);
+
+    if (options.step < 1 || !(options.tolerance >= 0))
+        throw std::invalid_argument("Invalid coarse bake options");
+    // A lattice needs two nodes along each axis
+    if (width < 2 || height < 2)
+    {
+        if (stats)
+            *stats = { static_cast<std::size_t>(width) * height, 0.0f };
+        return bake(warper, width, height);
+    }
+
+    WarpField field;
+    field.map_ = ImageF(width, height, 2);
+    const std::vector<int> xs = lattice(width, options.step);
+    const std::vector<int> ys = lattice(height, options.step);
+    const int nx = static_cast<int>(xs.size());
+    const int ny = static_cast<int>(ys.size());
+    const bool thread_safe = warper.is_thread_safe();
+    CoarseBaker baker(warper, field, options.tolerance);
+    CoarseBakeStats total;
+    std::mutex total_mutex;
+    auto merge = [&](const CoarseBakeStats& part)
+    {
+        std::lock_guard<std::mutex> lock(total_mutex);
+        total.evaluations += part.evaluations;
+        total.max_error = std::max(total.max_error, part.max_error);
+    };
+
+    std::vector<Node> nodes(static_cast<std::size_t>(nx) * ny);
+    parallel_for(
+        ny,
+        thread_safe ? 1 : ny,
+        [&](int j0, int j1)
+        {
+            CoarseBakeStats part;
+            const std::vector<float> row_x(xs.begin(), xs.end());
+            std::vector<float> row_y(nx), out_x(nx), out_y(nx);
+            for (int j = j0; j < j1; ++j)
+            {
+                std::fill(row_y.begin(), row_y.end(), float(ys[j]));
+                baker.evaluate(
+                    row_x.data(),
+                    row_y.data(),
+                    out_x.data(),
+                    out_y.data(),
+                    nx,
+                    part);
+                for (int i = 0; i < nx; ++i)
+                    nodes[j * nx + i] = { out_x[i], out_y[i] };
+            }
+            merge(part);
+        });
+    auto cell = [&](int i, int j) -> Cell
+    {
+        const int k = j * nx + i;
+        return { xs[i], ys[j], xs[i + 1], ys[j + 1], nodes[k],
+                 nodes[k + 1], nodes[k + nx], nodes[k + nx + 1],
+                 i + 2 == nx, j + 2 == ny };
+    };
+
+    // First level of every cell, a row of cells per batch: the warpers are
+    // much faster on long batches than on the few probes of one cell
+    const int cells_x = nx - 1, cells_y = ny - 1;
+    const int probes = CoarseBaker::kProbes;
+    std::vector<unsigned char> refine(
+        static_cast<std::size_t>(cells_x) * cells_y);
+    parallel_for(
+        cells_y,
+        thread_safe ? 1 : cells_y,
+        [&](int j0, int j1)
+        {
+            CoarseBakeStats part;
+            const std::size_t n = static_cast<std::size_t>(cells_x) * probes;
+            std::vector<float> px(n), py(n), ex(n), ey(n);
+            for (int j = j0; j < j1; ++j)
+            {
+                for (int i = 0; i < cells_x; ++i)
+                    CoarseBaker::probes(
+                        cell(i, j), &px[i * probes], &py[i * probes]);
+                baker.evaluate(
+                    px.data(),
+                    py.data(),
+                    ex.data(),
+                    ey.data(),
+                    static_cast<int>(n),
+                    part);
+                for (int i = 0; i < cells_x; ++i)
+                {
+                    const Cell c = cell(i, j);
+                    float error = 0;
+                    for (int p = i * probes; p < (i + 1) * probes; ++p)
+                    {
+                        const Node approx =
+                            CoarseBaker::interpolate(c, px[p], py[p]);
+                        error = std::max(
+                            error,
+                            std::hypot(ex[p] - approx.x, ey[p] - approx.y));
+                    }
+                    const bool refined = error > options.tolerance;
+                    refine[j * cells_x + i] = refined;
+                    if (!refined)
+                        part.max_error = std::max(part.max_error, error);
+                }
+            }
+            merge(part);
+        });
+
+    // Refined cells are evaluated in short batches, down to every pixel
+    // where the map is not smooth: past two thirds of the cells, the exact
+    // bake is as fast or faster
+    const std::size_t refined =
+        std::count(refine.begin(), refine.end(), 1);
+    if (refined * 3 > refine.size() * 2)
+    {
+        if (stats)
+        {
+            stats->evaluations = total.evaluations +
+                                 static_cast<std::size_t>(width) * height;
+            stats->max_error = 0;
+        }
+        return bake(warper, width, height);
+    }
+
+    parallel_for(
+        cells_y,
+        thread_safe ? 1 : cells_y,
+        [&](int j0, int j1)
+        {
+            CoarseBakeStats part;
+            for (int j = j0; j < j1; ++j)
+            {
+                for (int i = 0; i < cells_x; ++i)
+                {
+                    if (refine[j * cells_x + i])
+                        baker.fill_cell(cell(i, j), part);
+                    else
+                        baker.interpolate_cell(cell(i, j));
+                }
+            }
+            merge(part);
+        });
+    if (stats)
+        *stats = total;
+    return field;
+}
+
+std::pair<float, float> WarpField::at(int x, int y) const
+{
+    x = std::clamp(x, 0, width() - 1);
+    y = std::clamp(y, 0, height() - 1);
+    return { xs(y)[x], ys(y)[x] };
+}
+
+FieldWarper::FieldWarper(std::shared_ptr<const WarpField> field)
+    : field_(std::move(field))
+{
+}
+
+std::pair<float, float> FieldWarper::warp(float x, float y)
+{
+    return field_->at(
+        static_cast<int>(std::lround(x)), static_cast<int>(std::lround(y)));
+}
+
+void FieldWarper::warp_batch(
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const WarpField& field = *field_;
+    if (n == 0)
+        return;
+    const float x0 = xs[0], y = ys[0];
+    bool row_span = x0 == std::floor(x0) && y == std::floor(y) && x0 >= 0 &&
+                    y >= 0 && x0 + n <= field.width() && y < field.height();
+    for (std::size_t i = 1; row_span && i < n; ++i)
+        row_span = xs[i] == x0 + i && ys[i] == y;
+    if (row_span)
+    {
+        const int x = static_cast<int>(x0), row = static_cast<int>(y);
+        std::copy_n(field.xs(row) + x, n, out_x);
+        std::copy_n(field.ys(row) + x, n, out_y);
+        return;
+    }
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const auto [sx, sy] = field.at(
+            static_cast<int>(std::lround(xs[i])),
+            static_cast<int>(std::lround(ys[i])));
+        out_x[i] = sx;
+        out_y[i] = sy;
+    }
+}
+}  // namespace USTC_CG
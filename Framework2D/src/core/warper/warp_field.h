@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "common/image_f.h"
+#include "warper.h"
+
+namespace USTC_CG
+{
+// Parameters of WarpField::bake_coarse().
+struct CoarseBakeOptions
+{
+    int step = 16;            // Spacing of the lattice, in pixels
+    float tolerance = 0.25f;  // Largest error allowed, in source pixels
+};
+
+struct CoarseBakeStats
+{
+    std::size_t evaluations = 0;  // Points evaluated by the warper
+    // Largest error measured at the probes of the cells that were
+    // interpolated: an estimate, not a bound, as the error between probes
+    // is not measured. 0 when the exact bake was used.
+    float max_error = 0;
+};
+
+// Dense backward map: for every pixel (x, y) of the result, the position in
+// the source that it samples.
+//
+// Baking evaluates a warper once per pixel; the field can then be applied
+// (see warp_image()) to any number of images of its size, e.g. again after
+// a restore, without evaluating the warper again. The two coordinates are
+// stored as the planes of an ImageF, so a row of either is contiguous and
+// aligned.
+class WarpField
+{
+   public:
+    WarpField() = default;
+    // Identity map
+    WarpField(int width, int height);
+
+    // Evaluates `warper` at every pixel. Rows are baked in parallel unless
+    // the warper is not thread-safe.
+    static WarpField bake(Warper& warper, int width, int height);
+
+    // Approximate bake for smooth maps such as IDW and RBF, whose cost is
+    // dominated by evaluating the warper. The warper is evaluated on a
+    // lattice every options.step pixels, and each lattice cell is filled by
+    // bilinear interpolation of its corners. Before that the warper is
+    // evaluated at the midpoints of the cell edges and at its center; if
+    // bilinear interpolation misses any of them by more than
+    // options.tolerance, the cell is split in four at these points and each
+    // part is checked the same way, down to single pixels. A cell of s x s
+    // pixels thus costs about 5 evaluations instead of s * s where the map
+    // is smooth. The tolerance is only checked at these points, so the
+    // result may be off by more between them, and adjacent cells refined
+    // to different depths may disagree along their common edge. When more
+    // than two thirds of the cells of the lattice fail the check, the
+    // map is not smooth enough at this step for the approximation to pay
+    // off, and the result of bake() is returned instead.
+    static WarpField bake_coarse(
+        Warper& warper,
+        int width,
+        int height,
+        const CoarseBakeOptions& options = {},
+        CoarseBakeStats* stats = nullptr);
+
+    int width() const
+    {
+        return map_.width();
+    }
+    int height() const
+    {
+        return map_.height();
+    }
+    bool empty() const
+    {
+        return map_.width() == 0 || map_.height() == 0;
+    }
+
+    // Source coordinates of row y. No bounds checking.
+    float* xs(int y)
+    {
+        return map_.row(0, y);
+    }
+    const float* xs(int y) const
+    {
+        return map_.row(0, y);
+    }
+    float* ys(int y)
+    {
+        return map_.row(1, y);
+    }
+    const float* ys(int y) const
+    {
+        return map_.row(1, y);
+    }
+
+    // Source position of pixel (x, y), clamped to the field.
+    std::pair<float, float> at(int x, int y) const;
+
+   private:
+    ImageF map_;  // Plane 0: source x, plane 1: source y
+};
+
+// Warper reading a baked field, so that a field can be used wherever a
+// warper is, e.g. in ImagePipeline. Positions are rounded to the nearest
+// pixel: the map is exact at pixel centers only.
+class FieldWarper : public Warper
+{
+   public:
+    explicit FieldWarper(std::shared_ptr<const WarpField> field);
+
+    std::pair<float, float> warp(float x, float y) override;
+    // Copies a span of the field for a run of pixel centers of one row, as
+    // warp_image() asks for
+    void warp_batch(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) override;
+
+    const WarpField& field() const
+    {
+        return *field_;
+    }
+
+   private:
+    std::shared_ptr<const WarpField> field_;
+};
+}  // namespace USTC_CG
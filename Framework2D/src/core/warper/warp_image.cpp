@@ -0,0 +1,391 @@
+#include "warp_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "common/image_f.h"
+#include "common/parallel.h"
+#include "common/profiler.h"
+
+namespace USTC_CG
+{
+using uchar = unsigned char;
+
+namespace
+{
+// Writes the color channels of the source at (x, y) into dst.
+void bilinear_interpolation(const ImageF& source, float x, float y, uchar* dst)
+{
+    int x0 = std::floor(x);
+    int y0 = std::floor(y);
+    int x1 = x0 + 1;
+    int y1 = y0 + 1;
+
+    // 边界检查
+    x0 = std::clamp(x0, 0, source.width() - 1);
+    x1 = std::clamp(x1, 0, source.width() - 1);
+    y0 = std::clamp(y0, 0, source.height() - 1);
+    y1 = std::clamp(y1, 0, source.height() - 1);
+
+    float dx = x - x0;
+    float dy = y - y0;
+
+    for (int i = 0; i < std::min(source.channels(), 3); ++i)
+    {
+        const float* row0 = source.row(i, y0);
+        const float* row1 = source.row(i, y1);
+        float val = (1 - dx) * (1 - dy) * row0[x0] + (1 - dx) * dy * row1[x0] +
+                    dx * (1 - dy) * row0[x1] + dx * dy * row1[x1];
+        dst[i] = static_cast<uchar>(std::clamp(val, 0.0f, 255.0f));
+    }
+}
+
+void nearest_interpolation(const Image& source, float x, float y, uchar* dst)
+{
+    const int nearest_x =
+        std::clamp(static_cast<int>(std::round(x)), 0, source.width() - 1);
+    const int nearest_y =
+        std::clamp(static_cast<int>(std::round(y)), 0, source.height() - 1);
+    std::copy_n(
+        source.row(nearest_y) + nearest_x * source.channels(),
+        std::min(source.channels(), 3),
+        dst);
+}
+
+// Resamples `source_image` at the positions given by
+// map_row(y, buffer_x, buffer_y), which returns the source x and y of every
+// pixel of row y, either in the buffers or in storage of its own, into rows
+// [y0, y1) of `target`. `source` is the planar float copy of the source for
+// bilinear sampling.
+template<typename MapRow>
+void resample_rows(
+    const Image& source_image,
+    const ImageF& source,
+    Interpolation interpolation,
+    int grain,
+    const MapRow& map_row,
+    const WarpRowHook& finish_row,
+    Image& target,
+    int y0,
+    int y1)
+{
+    const int width = target.width();
+    const int channels = target.channels();
+    uchar* const data = target.data();
+    const std::size_t stride = target.stride();
+    parallel_for(
+        y1 - y0,
+        grain,
+        [&](int i0, int i1)
+        {
+            std::vector<float> buffer_x(width), buffer_y(width);
+            for (int y = y0 + i0; y < y0 + i1; y++)
+            {
+                const auto [xs, ys] = map_row(y, buffer_x, buffer_y);
+                uchar* row = data + y * stride;
+                if (interpolation == Interpolation::kNearest)
+                {
+                    for (int x = 0; x < width; x++)
+                        nearest_interpolation(
+                            source_image, xs[x], ys[x], row + x * channels);
+                }
+                else
+                {
+                    for (int x = 0; x < width; x++)
+                        bilinear_interpolation(
+                            source, xs[x], ys[x], row + x * channels);
+                }
+                if (finish_row)
+                    finish_row(row, y);
+            }
+        });
+}
+
+// Planar float copy of the source if bilinear sampling needs one
+ImageF sampling_copy(const Image& source_image, Interpolation interpolation)
+{
+    // Bilinear sampling reads a planar float copy of the source, and
+    // quantizes once per output pixel
+    return interpolation == Interpolation::kBilinear ? ImageF(source_image)
+                                                     : ImageF();
+}
+
+// resample_rows() over the whole image
+template<typename MapRow>
+Image resample(
+    const Image& source_image,
+    Interpolation interpolation,
+    int grain,
+    const MapRow& map_row,
+    const WarpRowHook& finish_row)
+{
+    // The result shares the buffer of the source until its first write, and
+    // keeps the alpha channel of the source
+    Image warped_image(source_image);
+    resample_rows(
+        source_image,
+        sampling_copy(source_image, interpolation),
+        interpolation,
+        grain,
+        map_row,
+        finish_row,
+        warped_image,
+        0,
+        warped_image.height());
+    return warped_image;
+}
+
+// Source positions of row y, read from a baked field whose first row is
+// row first_row of the image
+auto field_rows(const WarpField& field, int first_row = 0)
+{
+    return [&field, first_row](int y, std::vector<float>&, std::vector<float>&)
+    {
+        return std::pair<const float*, const float*>(
+            field.xs(y - first_row), field.ys(y - first_row));
+    };
+}
+
+// Evaluates the wrapped warper `dy` rows further down, so that a band of
+// rows can be baked as a field of its own
+class RowOffsetWarper : public Warper
+{
+   public:
+    RowOffsetWarper(Warper& warper, int dy) : warper_(warper), dy_(dy)
+    {
+    }
+
+    std::pair<float, float> warp(float x, float y) override
+    {
+        return warper_.warp(x, y + dy_);
+    }
+    void warp_batch(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n) override
+    {
+        // The result may overwrite the coordinates, so they are moved in
+        // place
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            out_x[i] = xs[i];
+            out_y[i] = ys[i] + dy_;
+        }
+        warper_.warp_batch(out_x, out_y, out_x, out_y, n);
+    }
+    bool is_thread_safe() const override
+    {
+        return warper_.is_thread_safe();
+    }
+
+   private:
+    Warper& warper_;
+    int dy_;
+};
+}  // namespace
+
+Image warp_image(
+    Warper& warper,
+    const Image& source_image,
+    Interpolation interpolation,
+    const WarpRowHook& finish_row)
+{
+    static const ProfileStage stage("warp/warp_image");
+    ProfileScope scope(stage);
+
+    const int width = source_image.width();
+    // Warps are evaluated per pixel, so a few rows already make a task
+    const int grain = warper.is_thread_safe() ? rows_grain(width, 4096)
+                                              : source_image.height();
+    auto map_row =
+        [&](int y, std::vector<float>& buffer_x, std::vector<float>& buffer_y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            buffer_x[x] = static_cast<float>(x);
+            buffer_y[x] = static_cast<float>(y);
+        }
+        warper.warp_batch(
+            buffer_x.data(),
+            buffer_y.data(),
+            buffer_x.data(),
+            buffer_y.data(),
+            width);
+        return std::pair<const float*, const float*>(
+            buffer_x.data(), buffer_y.data());
+    };
+    return resample(source_image, interpolation, grain, map_row, finish_row);
+}
+
+Image warp_image(
+    const WarpField& field,
+    const Image& source_image,
+    Interpolation interpolation,
+    const WarpRowHook& finish_row)
+{
+    static const ProfileStage stage("warp/apply_field");
+    ProfileScope scope(stage);
+
+    if (field.width() != source_image.width() ||
+        field.height() != source_image.height())
+    {
+        throw std::invalid_argument("Warp field and image do not match");
+    }
+    return resample(
+        source_image,
+        interpolation,
+        rows_grain(source_image.width()),
+        field_rows(field),
+        finish_row);
+}
+
+ProgressiveWarp::ProgressiveWarp(
+    std::shared_ptr<const WarpField> field,
+    Image source,
+    Interpolation interpolation)
+    : field_(std::move(field)),
+      source_image_(std::move(source)),
+      interpolation_(interpolation)
+{
+    if (!field_ || field_->width() != source_image_.width() ||
+        field_->height() != source_image_.height())
+    {
+        throw std::invalid_argument("Warp field and image do not match");
+    }
+    source_ = sampling_copy(source_image_, interpolation_);
+    // A buffer of its own right away, so that advance() never copies the
+    // whole image
+    result_ = Image(
+        source_image_.width(),
+        source_image_.height(),
+        source_image_.channels());
+}
+
+ProgressiveWarp::ProgressiveWarp(
+    std::shared_ptr<Warper> warper,
+    Image source,
+    Interpolation interpolation)
+    : warper_(std::move(warper)),
+      source_image_(std::move(source)),
+      interpolation_(interpolation)
+{
+    if (!warper_)
+        throw std::invalid_argument("No warper");
+    source_ = sampling_copy(source_image_, interpolation_);
+    result_ = Image(
+        source_image_.width(),
+        source_image_.height(),
+        source_image_.channels());
+}
+
+int ProgressiveWarp::advance(int rows)
+{
+    static const ProfileStage stage("warp/progressive");
+    ProfileScope scope(stage);
+
+    const int y0 = rows_done_;
+    const int y1 = std::min(result_.height(), y0 + std::max(rows, 0));
+    if (y0 >= y1)
+        return rows_done_;
+    if (warper_)
+    {
+        RowOffsetWarper band_warper(*warper_, y0);
+        band_ = WarpField::bake_coarse(band_warper, result_.width(), y1 - y0);
+    }
+    // The alpha channel is kept: start from the source rows
+    result_.copy_region_from(source_image_, { 0, y0, result_.width(), y1 });
+    resample_rows(
+        source_image_,
+        source_,
+        interpolation_,
+        rows_grain(result_.width()),
+        warper_ ? field_rows(band_, y0) : field_rows(*field_),
+        nullptr,
+        result_,
+        y0,
+        y1);
+    rows_done_ = y1;
+    return rows_done_;
+}
+
+void warp_image(Warper& warper, const TiledImage& source, TiledImage& target)
+{
+    static const ProfileStage stage("warp/warp_tiled");
+    ProfileScope scope(stage);
+
+    if (source.width() != target.width() ||
+        source.height() != target.height() ||
+        source.channels() != target.channels())
+    {
+        throw std::invalid_argument("Tiled images do not match");
+    }
+    const int width = source.width();
+    const int height = source.height();
+    const int channels = source.channels();
+    const int color_channels = std::min(channels, 3);
+    std::vector<float> map_x, map_y;
+    for (int ty = 0; ty < target.tiles_y(); ++ty)
+    {
+        for (int tx = 0; tx < target.tiles_x(); ++tx)
+        {
+            const PixelRect rect = target.tile_rect(tx, ty);
+            const int tile_width = rect.x1 - rect.x0;
+            map_x.resize(tile_width);
+            map_y.resize(tile_width);
+            for (int y = rect.y0; y < rect.y1; ++y)
+            {
+                for (int i = 0; i < tile_width; ++i)
+                {
+                    map_x[i] = static_cast<float>(rect.x0 + i);
+                    map_y[i] = static_cast<float>(y);
+                }
+                warper.warp_batch(
+                    map_x.data(),
+                    map_y.data(),
+                    map_x.data(),
+                    map_y.data(),
+                    tile_width);
+                for (int x = rect.x0; x < rect.x1; ++x)
+                {
+                    const float src_x = map_x[x - rect.x0];
+                    const float src_y = map_y[x - rect.x0];
+                    // Clamped as in bilinear_interpolation(), so that the
+                    // result matches that of an in-memory image
+                    const int fx = static_cast<int>(std::floor(src_x));
+                    const int fy = static_cast<int>(std::floor(src_y));
+                    const int x0 = std::clamp(fx, 0, width - 1);
+                    const int y0 = std::clamp(fy, 0, height - 1);
+                    const int x1 = std::clamp(fx + 1, 0, width - 1);
+                    const int y1 = std::clamp(fy + 1, 0, height - 1);
+                    const float dx = src_x - x0;
+                    const float dy = src_y - y0;
+                    // At most four source tiles are touched, all of which
+                    // stay mapped (see TiledImage::kMinResidentTiles)
+                    const uchar* p00 = &source.at<uchar>(x0, y0);
+                    const uchar* p01 = &source.at<uchar>(x0, y1);
+                    const uchar* p10 = &source.at<uchar>(x1, y0);
+                    const uchar* p11 = &source.at<uchar>(x1, y1);
+                    uchar* dst = &target.at<uchar>(x, y);
+                    for (int i = 0; i < color_channels; ++i)
+                    {
+                        float val = (1 - dx) * (1 - dy) * p00[i] +
+                                    (1 - dx) * dy * p01[i] +
+                                    dx * (1 - dy) * p10[i] + dx * dy * p11[i];
+                        dst[i] =
+                            static_cast<uchar>(std::clamp(val, 0.0f, 255.0f));
+                    }
+                    // The alpha channel is kept, as for in-memory images
+                    const uchar* alpha = &source.at<uchar>(x, y);
+                    for (int i = color_channels; i < channels; ++i)
+                        dst[i] = alpha[i];
+                }
+            }
+        }
+    }
+}
+}  // namespace USTC_CG
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "common/image.h"
+#include "common/tiled_image.h"
+#include "warp_field.h"
+#include "warper.h"
+
+namespace USTC_CG
+{
+// How the source is sampled between pixel centers
+enum class Interpolation
+{
+    kNearest,
+    kBilinear
+};
+
+// Backward warping: every pixel (x, y) of the result takes the color of the
+// source at warper.warp(x, y), so `warper` must map result coordinates to
+// source coordinates. Positions outside the source are clamped to its
+// border. The alpha channel is kept. Rows are warped in parallel unless the
+// warper is not thread-safe.
+//
+// If given, finish_row(row, y) is called on each output row right after it
+// is warped, on the same thread, so that follow-up per-pixel work runs while
+// the row is still in cache.
+using WarpRowHook = std::function<void(unsigned char* row, int y)>;
+Image warp_image(
+    Warper& warper,
+    const Image& source,
+    Interpolation interpolation = Interpolation::kBilinear,
+    const WarpRowHook& finish_row = nullptr);
+
+// Same, sampling the source at the positions stored in a baked field
+// instead of evaluating a warper. The field must have the size of the
+// source.
+Image warp_image(
+    const WarpField& field,
+    const Image& source,
+    Interpolation interpolation = Interpolation::kBilinear,
+    const WarpRowHook& finish_row = nullptr);
+
+// warp_image(field, source, interpolation), produced band by band of rows
+// from the top, so that the rows done so far can be shown, or the rest
+// dropped, while it runs. The result is the same bytes.
+class ProgressiveWarp
+{
+   public:
+    ProgressiveWarp(
+        std::shared_ptr<const WarpField> field,
+        Image source,
+        Interpolation interpolation = Interpolation::kBilinear);
+    // Same, baking the field of each band with WarpField::bake_coarse() when
+    // the band is warped, so that the first rows come without waiting for
+    // the whole field, and the rows dropped are never evaluated.
+    ProgressiveWarp(
+        std::shared_ptr<Warper> warper,
+        Image source,
+        Interpolation interpolation = Interpolation::kBilinear);
+
+    // Warps the next `rows` rows (fewer at the bottom), and returns
+    // rows_done().
+    int advance(int rows);
+
+    // Rows [0, rows_done()) of result() are final.
+    int rows_done() const
+    {
+        return rows_done_;
+    }
+    bool done() const
+    {
+        return rows_done_ == result_.height();
+    }
+    const Image& result() const
+    {
+        return result_;
+    }
+
+   private:
+    std::shared_ptr<const WarpField> field_;  // Or:
+    std::shared_ptr<Warper> warper_;
+    WarpField band_;  // Field of the last band, baked from warper_
+    Image source_image_;
+    ImageF source_;  // Planar float copy for bilinear sampling
+    Interpolation interpolation_;
+    Image result_;
+    int rows_done_ = 0;
+};
+
+// Out-of-core variant for images larger than RAM. The target is produced
+// tile by tile, so resident memory stays within the budgets of the two tiled
+// images. Both must have the same size and channels. The pixels are those of
+// the bilinear warp_image(warper, source) of the image in memory.
+void warp_image(Warper& warper, const TiledImage& source, TiledImage& target);
+}  // namespace USTC_CG
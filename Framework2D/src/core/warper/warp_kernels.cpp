@@ -0,0 +1,74 @@
+#include "warp_kernels.h"
+
+namespace USTC_CG
+{
+namespace warp_kernels
+{
+namespace
+{
+void idw(
+    const IdwPoints& points,
+    IdwPower power,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    scalar_idw(points, power, xs, ys, out_x, out_y, n);
+}
+
+void tps(
+    const TpsPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    scalar_tps(points, xs, ys, out_x, out_y, n);
+}
+
+void wendland(
+    const WendlandPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    scalar_wendland(points, xs, ys, out_x, out_y, n);
+}
+
+void shepard(const float* dist_sq, float inv_r_sq, float* weight, std::size_t m)
+{
+    scalar_shepard(dist_sq, inv_r_sq, weight, m);
+}
+}  // namespace
+
+const Table& scalar_table()
+{
+    static const Table table{ "scalar",
+                              SimdLevel::kScalar,
+                              idw,
+                              tps,
+                              wendland,
+                              shepard };
+    return table;
+}
+
+const Table& current()
+{
+    // simd_level() only reports levels that the build and the CPU support
+    const Table* table = nullptr;
+    switch (simd_level())
+    {
+        case SimdLevel::kSse4: table = sse4_table(); break;
+        case SimdLevel::kAvx2: table = avx2_table(); break;
+        case SimdLevel::kNeon: table = neon_table(); break;
+        default: break;
+    }
+    return table ? *table : scalar_table();
+}
+}  // namespace warp_kernels
+}  // namespace USTC_CG
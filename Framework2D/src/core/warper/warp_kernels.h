@@ -0,0 +1,300 @@
+#pragma once
+
+// Batch kernels of the IDW, local IDW and RBF warpers (see
+// Warper::warp_batch()), one table per instruction set. The table follows
+// simd_level(), like the color kernels of image_ops.
+//
+// The SIMD kernels vectorize across the points of a batch: every lane sums
+// over the control points in the same order, with the same operations, as
+// the scalar kernel, which also handles the points that do not fill a
+// vector. Results are thus identical at every level, unless the compiler
+// fuses the multiply-adds of the scalar code (e.g. on ARM64).
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "common/image_ops.h"
+
+#if !defined(CG2D_SIMD_X86) &&                                         \
+    (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+     defined(_M_IX86))
+#define CG2D_SIMD_X86 1
+#endif
+#if !defined(CG2D_SIMD_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define CG2D_SIMD_NEON 1
+#endif
+
+namespace USTC_CG
+{
+namespace warp_kernels
+{
+// Exponent mu of the IDW weights 1 / (d^mu + epsilon) that have kernels.
+enum class IdwPower
+{
+    kOne,
+    kTwo,
+    kFour
+};
+
+// IDW control points as arrays: positions, and displacements to add.
+struct IdwPoints
+{
+    const float* x;
+    const float* y;
+    const float* dx;
+    const float* dy;
+    std::size_t count;
+};
+
+// Thin plate spline: (x, y) maps to (x, y) + affine * (x, y, 1) plus the
+// sum of weight * r^2 log r over the control points.
+struct TpsPoints
+{
+    const float* x;
+    const float* y;
+    const float* weight_x;
+    const float* weight_y;
+    std::size_t count;
+    float affine[2][3];
+};
+
+// Compactly supported RBF: (x, y) maps to (x, y) + affine * (x, y, 1) plus
+// the sum of weight * phi(r / support) over the control points, with the
+// Wendland function phi(t) = (1 - t)^4 (4t + 1), which is 0 from t = 1 on.
+struct WendlandPoints
+{
+    const float* x;
+    const float* y;
+    const float* weight_x;
+    const float* weight_y;
+    std::size_t count;
+    float inv_support;
+    float affine[2][3];
+};
+
+struct Table
+{
+    const char* name;
+    SimdLevel level;
+
+    // Warp n points (xs[i], ys[i]) into (out_x[i], out_y[i]). The outputs
+    // may be the inputs.
+    void (*idw)(
+        const IdwPoints& points,
+        IdwPower power,
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n);
+    void (*tps)(
+        const TpsPoints& points,
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n);
+    void (*wendland)(
+        const WendlandPoints& points,
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n);
+    // Weights of the local IDW (see LocalIDWWarper) of m points at squared
+    // distances dist_sq[j]: (1 - dist_sq / R^2)^2 / (dist_sq + epsilon), 0
+    // from R on.
+    void (*shepard)(
+        const float* dist_sq,
+        float inv_r_sq,
+        float* weight,
+        std::size_t m);
+};
+
+// Table of simd_level().
+const Table& current();
+
+// Tables of each instruction set, nullptr when the build does not target
+// it. They do not check that the CPU supports it.
+const Table& scalar_table();
+const Table* sse4_table();
+const Table* avx2_table();
+const Table* neon_table();
+
+constexpr float kIdwEpsilon = 1e-9f;
+// Added to r^2, so that log never sees 0
+constexpr float kTpsEpsilon = 1e-8f;
+
+// Coefficients of log_positive()
+constexpr float kSqrtHalf = 0.707106781186547524f;
+constexpr float kLogP[9] = { 7.0376836292e-2f,  -1.1514610310e-1f,
+                             1.1676998740e-1f,  -1.2420140846e-1f,
+                             1.4249322787e-1f,  -1.6668057665e-1f,
+                             2.0000714765e-1f,  -2.4999993993e-1f,
+                             3.3333331174e-1f };
+constexpr float kLn2Low = -2.12194440e-4f;
+constexpr float kLn2High = 0.693359375f;
+
+// Scalar kernels, also used for the tails of the SIMD ones, with internal
+// linkage (see color_kernels.h).
+namespace
+{
+// Natural logarithm of a positive normal float, within about 1 ulp
+// (Cephes logf). The SIMD versions do the same operations.
+inline float log_positive(float x)
+{
+    const std::uint32_t bits = std::bit_cast<std::uint32_t>(x);
+    // x = m * 2^e with m in [sqrt(1/2), sqrt(2)), then m - 1
+    int e = static_cast<int>(bits >> 23) - 126;
+    float m = std::bit_cast<float>((bits & 0x007FFFFFu) | 0x3F000000u);
+    if (m < kSqrtHalf)
+    {
+        e -= 1;
+        m = m + m - 1.0f;
+    }
+    else
+    {
+        m = m - 1.0f;
+    }
+    const float z = m * m;
+    float y = kLogP[0];
+    for (int i = 1; i < 9; ++i)
+        y = y * m + kLogP[i];
+    y = y * m * z;
+    const float fe = static_cast<float>(e);
+    y = y + fe * kLn2Low;
+    y = y - 0.5f * z;
+    return m + y + fe * kLn2High;
+}
+
+inline float idw_distance_power(float dist_sq, IdwPower power)
+{
+    switch (power)
+    {
+        case IdwPower::kOne: return std::sqrt(dist_sq);
+        case IdwPower::kFour: return dist_sq * dist_sq;
+        default: return dist_sq;
+    }
+}
+
+inline void scalar_idw(
+    const IdwPoints& points,
+    IdwPower power,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const float x = xs[i];
+        const float y = ys[i];
+        float sum_w = 0.0f;
+        float sum_wx = 0.0f;
+        float sum_wy = 0.0f;
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const float dx = x - points.x[k];
+            const float dy = y - points.y[k];
+            const float dist_sq = dx * dx + dy * dy;
+            const float sigma =
+                1.0f / (idw_distance_power(dist_sq, power) + kIdwEpsilon);
+            sum_w += sigma;
+            sum_wx += sigma * points.dx[k];
+            sum_wy += sigma * points.dy[k];
+        }
+        if (sum_w < kIdwEpsilon)
+        {
+            out_x[i] = x;
+            out_y[i] = y;
+        }
+        else
+        {
+            out_x[i] = x + sum_wx / sum_w;
+            out_y[i] = y + sum_wy / sum_w;
+        }
+    }
+}
+
+inline void scalar_wendland(
+    const WendlandPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const auto& a = points.affine;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const float x = xs[i];
+        const float y = ys[i];
+        float sum_x = a[0][0] * x + a[0][1] * y + a[0][2] + x;
+        float sum_y = a[1][0] * x + a[1][1] * y + a[1][2] + y;
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const float dx = x - points.x[k];
+            const float dy = y - points.y[k];
+            const float t = std::sqrt(dx * dx + dy * dy) * points.inv_support;
+            const float s = 1.0f - t;
+            const float s_sq = s * s;
+            const float phi = s_sq * s_sq * (4.0f * t + 1.0f);
+            // Outside the support the SIMD kernels add 0 too
+            const float inside = s > 0.0f ? phi : 0.0f;
+            sum_x += points.weight_x[k] * inside;
+            sum_y += points.weight_y[k] * inside;
+        }
+        out_x[i] = sum_x;
+        out_y[i] = sum_y;
+    }
+}
+
+inline void scalar_shepard(
+    const float* dist_sq,
+    float inv_r_sq,
+    float* weight,
+    std::size_t m)
+{
+    for (std::size_t j = 0; j < m; ++j)
+    {
+        const float taper = 1.0f - dist_sq[j] * inv_r_sq;
+        const float w = taper * taper / (dist_sq[j] + kIdwEpsilon);
+        weight[j] = taper > 0.0f ? w : 0.0f;
+    }
+}
+
+inline void scalar_tps(
+    const TpsPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const auto& a = points.affine;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const float x = xs[i];
+        const float y = ys[i];
+        float sum_x = a[0][0] * x + a[0][1] * y + a[0][2] + x;
+        float sum_y = a[1][0] * x + a[1][1] * y + a[1][2] + y;
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const float dx = x - points.x[k];
+            const float dy = y - points.y[k];
+            const float r_sq = dx * dx + dy * dy + kTpsEpsilon;
+            // r^2 log r = r^2 log(r^2) / 2
+            const float phi = 0.5f * r_sq * log_positive(r_sq);
+            sum_x += points.weight_x[k] * phi;
+            sum_y += points.weight_y[k] * phi;
+        }
+        out_x[i] = sum_x;
+        out_y[i] = sum_y;
+    }
+}
+}  // namespace
+}  // namespace warp_kernels
+}  // namespace USTC_CG
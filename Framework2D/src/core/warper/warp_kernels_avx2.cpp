@@ -0,0 +1,280 @@
+// AVX2 warp kernels, 8 points at a time. The target is AVX2 without FMA, so
+// that every lane rounds as the scalar kernel does.
+#include "warp_kernels.h"
+
+#if defined(CG2D_SIMD_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#define CG2D_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CG2D_TARGET_AVX2
+#endif
+
+namespace USTC_CG
+{
+namespace warp_kernels
+{
+namespace
+{
+// log_positive() of 8 floats
+CG2D_TARGET_AVX2 inline __m256 log_positive(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i bits = _mm256_castps_si256(x);
+    __m256i e =
+        _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+        _mm256_set1_epi32(0x3F000000)));
+    // Where m < sqrt(1/2): e - 1 and m + m - 1, else m - 1
+    const __m256 small =
+        _mm256_cmp_ps(m, _mm256_set1_ps(kSqrtHalf), _CMP_LT_OQ);
+    e = _mm256_add_epi32(e, _mm256_castps_si256(small));
+    m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(small, m)), one);
+
+    const __m256 z = _mm256_mul_ps(m, m);
+    __m256 y = _mm256_set1_ps(kLogP[0]);
+    for (int i = 1; i < 9; ++i)
+        y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(kLogP[i]));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+    const __m256 fe = _mm256_cvtepi32_ps(e);
+    y = _mm256_add_ps(y, _mm256_mul_ps(fe, _mm256_set1_ps(kLn2Low)));
+    y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_set1_ps(0.5f), z));
+    return _mm256_add_ps(
+        _mm256_add_ps(m, y), _mm256_mul_ps(fe, _mm256_set1_ps(kLn2High)));
+}
+
+template <IdwPower power>
+CG2D_TARGET_AVX2 void idw_power(
+    const IdwPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 epsilon = _mm256_set1_ps(kIdwEpsilon);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(xs + i);
+        const __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 sum_w = _mm256_setzero_ps();
+        __m256 sum_wx = _mm256_setzero_ps();
+        __m256 sum_wy = _mm256_setzero_ps();
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const __m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(points.x[k]));
+            const __m256 dy = _mm256_sub_ps(y, _mm256_set1_ps(points.y[k]));
+            const __m256 dist_sq =
+                _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            __m256 d = dist_sq;
+            if constexpr (power == IdwPower::kOne)
+                d = _mm256_sqrt_ps(dist_sq);
+            else if constexpr (power == IdwPower::kFour)
+                d = _mm256_mul_ps(dist_sq, dist_sq);
+            const __m256 sigma = _mm256_div_ps(one, _mm256_add_ps(d, epsilon));
+            sum_w = _mm256_add_ps(sum_w, sigma);
+            sum_wx = _mm256_add_ps(
+                sum_wx, _mm256_mul_ps(sigma, _mm256_set1_ps(points.dx[k])));
+            sum_wy = _mm256_add_ps(
+                sum_wy, _mm256_mul_ps(sigma, _mm256_set1_ps(points.dy[k])));
+        }
+        // Lanes too far from every point keep their position
+        const __m256 moved = _mm256_cmp_ps(sum_w, epsilon, _CMP_NLT_UQ);
+        const __m256 wx = _mm256_add_ps(x, _mm256_div_ps(sum_wx, sum_w));
+        const __m256 wy = _mm256_add_ps(y, _mm256_div_ps(sum_wy, sum_w));
+        _mm256_storeu_ps(out_x + i, _mm256_blendv_ps(x, wx, moved));
+        _mm256_storeu_ps(out_y + i, _mm256_blendv_ps(y, wy, moved));
+    }
+    scalar_idw(points, power, xs + i, ys + i, out_x + i, out_y + i, n - i);
+}
+
+void idw(
+    const IdwPoints& points,
+    IdwPower power,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    switch (power)
+    {
+        case IdwPower::kOne:
+            idw_power<IdwPower::kOne>(points, xs, ys, out_x, out_y, n);
+            break;
+        case IdwPower::kTwo:
+            idw_power<IdwPower::kTwo>(points, xs, ys, out_x, out_y, n);
+            break;
+        case IdwPower::kFour:
+            idw_power<IdwPower::kFour>(points, xs, ys, out_x, out_y, n);
+            break;
+    }
+}
+
+CG2D_TARGET_AVX2 void tps(
+    const TpsPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const auto& a = points.affine;
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 epsilon = _mm256_set1_ps(kTpsEpsilon);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(xs + i);
+        const __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 sum_x = _mm256_add_ps(
+            _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(a[0][0]), x),
+                    _mm256_mul_ps(_mm256_set1_ps(a[0][1]), y)),
+                _mm256_set1_ps(a[0][2])),
+            x);
+        __m256 sum_y = _mm256_add_ps(
+            _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(a[1][0]), x),
+                    _mm256_mul_ps(_mm256_set1_ps(a[1][1]), y)),
+                _mm256_set1_ps(a[1][2])),
+            y);
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const __m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(points.x[k]));
+            const __m256 dy = _mm256_sub_ps(y, _mm256_set1_ps(points.y[k]));
+            const __m256 r_sq = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                epsilon);
+            const __m256 phi = _mm256_mul_ps(
+                _mm256_mul_ps(half, r_sq), log_positive(r_sq));
+            sum_x = _mm256_add_ps(
+                sum_x,
+                _mm256_mul_ps(_mm256_set1_ps(points.weight_x[k]), phi));
+            sum_y = _mm256_add_ps(
+                sum_y,
+                _mm256_mul_ps(_mm256_set1_ps(points.weight_y[k]), phi));
+        }
+        _mm256_storeu_ps(out_x + i, sum_x);
+        _mm256_storeu_ps(out_y + i, sum_y);
+    }
+    scalar_tps(points, xs + i, ys + i, out_x + i, out_y + i, n - i);
+}
+
+CG2D_TARGET_AVX2 void wendland(
+    const WendlandPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const auto& a = points.affine;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    const __m256 inv_support = _mm256_set1_ps(points.inv_support);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(xs + i);
+        const __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 sum_x = _mm256_add_ps(
+            _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(a[0][0]), x),
+                    _mm256_mul_ps(_mm256_set1_ps(a[0][1]), y)),
+                _mm256_set1_ps(a[0][2])),
+            x);
+        __m256 sum_y = _mm256_add_ps(
+            _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(a[1][0]), x),
+                    _mm256_mul_ps(_mm256_set1_ps(a[1][1]), y)),
+                _mm256_set1_ps(a[1][2])),
+            y);
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const __m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(points.x[k]));
+            const __m256 dy = _mm256_sub_ps(y, _mm256_set1_ps(points.y[k]));
+            const __m256 t = _mm256_mul_ps(
+                _mm256_sqrt_ps(_mm256_add_ps(
+                    _mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy))),
+                inv_support);
+            const __m256 s = _mm256_sub_ps(one, t);
+            const __m256 s_sq = _mm256_mul_ps(s, s);
+            const __m256 phi = _mm256_mul_ps(
+                _mm256_mul_ps(s_sq, s_sq),
+                _mm256_add_ps(_mm256_mul_ps(four, t), one));
+            const __m256 inside = _mm256_and_ps(
+                phi, _mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_GT_OQ));
+            sum_x = _mm256_add_ps(
+                sum_x,
+                _mm256_mul_ps(_mm256_set1_ps(points.weight_x[k]), inside));
+            sum_y = _mm256_add_ps(
+                sum_y,
+                _mm256_mul_ps(_mm256_set1_ps(points.weight_y[k]), inside));
+        }
+        _mm256_storeu_ps(out_x + i, sum_x);
+        _mm256_storeu_ps(out_y + i, sum_y);
+    }
+    scalar_wendland(points, xs + i, ys + i, out_x + i, out_y + i, n - i);
+}
+
+CG2D_TARGET_AVX2 void shepard(
+    const float* dist_sq,
+    float inv_r_sq,
+    float* weight,
+    std::size_t m)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 epsilon = _mm256_set1_ps(kIdwEpsilon);
+    const __m256 inv = _mm256_set1_ps(inv_r_sq);
+    std::size_t j = 0;
+    for (; j + 8 <= m; j += 8)
+    {
+        const __m256 d = _mm256_loadu_ps(dist_sq + j);
+        const __m256 taper = _mm256_sub_ps(one, _mm256_mul_ps(d, inv));
+        const __m256 w = _mm256_div_ps(
+            _mm256_mul_ps(taper, taper), _mm256_add_ps(d, epsilon));
+        const __m256 inside =
+            _mm256_cmp_ps(taper, _mm256_setzero_ps(), _CMP_GT_OQ);
+        _mm256_storeu_ps(weight + j, _mm256_and_ps(w, inside));
+    }
+    scalar_shepard(dist_sq + j, inv_r_sq, weight + j, m - j);
+}
+}  // namespace
+
+const Table* avx2_table()
+{
+    static const Table table{ "avx2",
+                              SimdLevel::kAvx2,
+                              idw,
+                              tps,
+                              wendland,
+                              shepard };
+    return &table;
+}
+}  // namespace warp_kernels
+}  // namespace USTC_CG
+
+#else
+
+namespace USTC_CG
+{
+namespace warp_kernels
+{
+const Table* avx2_table()
+{
+    return nullptr;
+}
+}  // namespace warp_kernels
+}  // namespace USTC_CG
+
+#endif
@@ -0,0 +1,248 @@
+// NEON warp kernels (AArch64), 4 points at a time. The compiler may fuse
+// their multiply-adds, and those of the scalar kernel, differently.
+#include "warp_kernels.h"
+
+#if defined(CG2D_SIMD_NEON)
+
+#include <arm_neon.h>
+
+namespace USTC_CG
+{
+namespace warp_kernels
+{
+namespace
+{
+// log_positive() of 4 floats
+inline float32x4_t log_positive(float32x4_t x)
+{
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const uint32x4_t bits = vreinterpretq_u32_f32(x);
+    int32x4_t e = vsubq_s32(
+        vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(126));
+    float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(
+        vandq_u32(bits, vdupq_n_u32(0x007FFFFF)), vdupq_n_u32(0x3F000000)));
+    // Where m < sqrt(1/2): e - 1 and m + m - 1, else m - 1
+    const uint32x4_t small = vcltq_f32(m, vdupq_n_f32(kSqrtHalf));
+    e = vaddq_s32(e, vreinterpretq_s32_u32(small));
+    m = vsubq_f32(
+        vaddq_f32(
+            m,
+            vreinterpretq_f32_u32(vandq_u32(small, vreinterpretq_u32_f32(m)))),
+        one);
+
+    const float32x4_t z = vmulq_f32(m, m);
+    float32x4_t y = vdupq_n_f32(kLogP[0]);
+    for (int i = 1; i < 9; ++i)
+        y = vaddq_f32(vmulq_f32(y, m), vdupq_n_f32(kLogP[i]));
+    y = vmulq_f32(vmulq_f32(y, m), z);
+    const float32x4_t fe = vcvtq_f32_s32(e);
+    y = vaddq_f32(y, vmulq_n_f32(fe, kLn2Low));
+    y = vsubq_f32(y, vmulq_n_f32(z, 0.5f));
+    return vaddq_f32(vaddq_f32(m, y), vmulq_n_f32(fe, kLn2High));
+}
+
+template <IdwPower power>
+void idw_power(
+    const IdwPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t epsilon = vdupq_n_f32(kIdwEpsilon);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const float32x4_t x = vld1q_f32(xs + i);
+        const float32x4_t y = vld1q_f32(ys + i);
+        float32x4_t sum_w = vdupq_n_f32(0.0f);
+        float32x4_t sum_wx = vdupq_n_f32(0.0f);
+        float32x4_t sum_wy = vdupq_n_f32(0.0f);
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const float32x4_t dx = vsubq_f32(x, vdupq_n_f32(points.x[k]));
+            const float32x4_t dy = vsubq_f32(y, vdupq_n_f32(points.y[k]));
+            const float32x4_t dist_sq =
+                vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+            float32x4_t d = dist_sq;
+            if constexpr (power == IdwPower::kOne)
+                d = vsqrtq_f32(dist_sq);
+            else if constexpr (power == IdwPower::kFour)
+                d = vmulq_f32(dist_sq, dist_sq);
+            const float32x4_t sigma = vdivq_f32(one, vaddq_f32(d, epsilon));
+            sum_w = vaddq_f32(sum_w, sigma);
+            sum_wx = vaddq_f32(sum_wx, vmulq_n_f32(sigma, points.dx[k]));
+            sum_wy = vaddq_f32(sum_wy, vmulq_n_f32(sigma, points.dy[k]));
+        }
+        // Lanes too far from every point keep their position
+        const uint32x4_t moved = vmvnq_u32(vcltq_f32(sum_w, epsilon));
+        const float32x4_t wx = vaddq_f32(x, vdivq_f32(sum_wx, sum_w));
+        const float32x4_t wy = vaddq_f32(y, vdivq_f32(sum_wy, sum_w));
+        vst1q_f32(out_x + i, vbslq_f32(moved, wx, x));
+        vst1q_f32(out_y + i, vbslq_f32(moved, wy, y));
+    }
+    scalar_idw(points, power, xs + i, ys + i, out_x + i, out_y + i, n - i);
+}
+
+void idw(
+    const IdwPoints& points,
+    IdwPower power,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    switch (power)
+    {
+        case IdwPower::kOne:
+            idw_power<IdwPower::kOne>(points, xs, ys, out_x, out_y, n);
+            break;
+        case IdwPower::kTwo:
+            idw_power<IdwPower::kTwo>(points, xs, ys, out_x, out_y, n);
+            break;
+        case IdwPower::kFour:
+            idw_power<IdwPower::kFour>(points, xs, ys, out_x, out_y, n);
+            break;
+    }
+}
+
+void tps(
+    const TpsPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const auto& a = points.affine;
+    const float32x4_t epsilon = vdupq_n_f32(kTpsEpsilon);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const float32x4_t x = vld1q_f32(xs + i);
+        const float32x4_t y = vld1q_f32(ys + i);
+        float32x4_t sum_x = vaddq_f32(
+            vaddq_f32(
+                vaddq_f32(vmulq_n_f32(x, a[0][0]), vmulq_n_f32(y, a[0][1])),
+                vdupq_n_f32(a[0][2])),
+            x);
+        float32x4_t sum_y = vaddq_f32(
+            vaddq_f32(
+                vaddq_f32(vmulq_n_f32(x, a[1][0]), vmulq_n_f32(y, a[1][1])),
+                vdupq_n_f32(a[1][2])),
+            y);
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const float32x4_t dx = vsubq_f32(x, vdupq_n_f32(points.x[k]));
+            const float32x4_t dy = vsubq_f32(y, vdupq_n_f32(points.y[k]));
+            const float32x4_t r_sq = vaddq_f32(
+                vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)), epsilon);
+            const float32x4_t phi =
+                vmulq_f32(vmulq_n_f32(r_sq, 0.5f), log_positive(r_sq));
+            sum_x = vaddq_f32(sum_x, vmulq_n_f32(phi, points.weight_x[k]));
+            sum_y = vaddq_f32(sum_y, vmulq_n_f32(phi, points.weight_y[k]));
+        }
+        vst1q_f32(out_x + i, sum_x);
+        vst1q_f32(out_y + i, sum_y);
+    }
+    scalar_tps(points, xs + i, ys + i, out_x + i, out_y + i, n - i);
+}
+
+void wendland(
+    const WendlandPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const auto& a = points.affine;
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const float32x4_t x = vld1q_f32(xs + i);
+        const float32x4_t y = vld1q_f32(ys + i);
+        float32x4_t sum_x = vaddq_f32(
+            vaddq_f32(
+                vaddq_f32(vmulq_n_f32(x, a[0][0]), vmulq_n_f32(y, a[0][1])),
+                vdupq_n_f32(a[0][2])),
+            x);
+        float32x4_t sum_y = vaddq_f32(
+            vaddq_f32(
+                vaddq_f32(vmulq_n_f32(x, a[1][0]), vmulq_n_f32(y, a[1][1])),
+                vdupq_n_f32(a[1][2])),
+            y);
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const float32x4_t dx = vsubq_f32(x, vdupq_n_f32(points.x[k]));
+            const float32x4_t dy = vsubq_f32(y, vdupq_n_f32(points.y[k]));
+            const float32x4_t t = vmulq_n_f32(
+                vsqrtq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy))),
+                points.inv_support);
+            const float32x4_t s = vsubq_f32(one, t);
+            const float32x4_t s_sq = vmulq_f32(s, s);
+            const float32x4_t phi = vmulq_f32(
+                vmulq_f32(s_sq, s_sq), vaddq_f32(vmulq_n_f32(t, 4.0f), one));
+            const float32x4_t inside = vreinterpretq_f32_u32(vandq_u32(
+                vreinterpretq_u32_f32(phi), vcgtq_f32(s, vdupq_n_f32(0.0f))));
+            sum_x = vaddq_f32(sum_x, vmulq_n_f32(inside, points.weight_x[k]));
+            sum_y = vaddq_f32(sum_y, vmulq_n_f32(inside, points.weight_y[k]));
+        }
+        vst1q_f32(out_x + i, sum_x);
+        vst1q_f32(out_y + i, sum_y);
+    }
+    scalar_wendland(points, xs + i, ys + i, out_x + i, out_y + i, n - i);
+}
+
+void shepard(const float* dist_sq, float inv_r_sq, float* weight, std::size_t m)
+{
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t epsilon = vdupq_n_f32(kIdwEpsilon);
+    std::size_t j = 0;
+    for (; j + 4 <= m; j += 4)
+    {
+        const float32x4_t d = vld1q_f32(dist_sq + j);
+        const float32x4_t taper = vsubq_f32(one, vmulq_n_f32(d, inv_r_sq));
+        const float32x4_t w =
+            vdivq_f32(vmulq_f32(taper, taper), vaddq_f32(d, epsilon));
+        const uint32x4_t inside = vcgtq_f32(taper, vdupq_n_f32(0.0f));
+        vst1q_f32(
+            weight + j,
+            vreinterpretq_f32_u32(
+                vandq_u32(vreinterpretq_u32_f32(w), inside)));
+    }
+    scalar_shepard(dist_sq + j, inv_r_sq, weight + j, m - j);
+}
+}  // namespace
+
+const Table* neon_table()
+{
+    static const Table table{ "neon",
+                              SimdLevel::kNeon,
+                              idw,
+                              tps,
+                              wendland,
+                              shepard };
+    return &table;
+}
+}  // namespace warp_kernels
+}  // namespace USTC_CG
+
+#else
+
+namespace USTC_CG
+{
+namespace warp_kernels
+{
+const Table* neon_table()
+{
+    return nullptr;
+}
+}  // namespace warp_kernels
+}  // namespace USTC_CG
+
+#endif
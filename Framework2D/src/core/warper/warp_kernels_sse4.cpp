@@ -0,0 +1,270 @@
+// SSE4.1 warp kernels (SSE4.1 blends), 4 points at a time.
+#include "warp_kernels.h"
+
+#if defined(CG2D_SIMD_X86)
+
+#include <immintrin.h>
+
+// GCC and Clang only emit SSE4.1 for functions marked so; MSVC always
+// accepts the intrinsics.
+#if defined(__GNUC__)
+#define CG2D_TARGET_SSE4 __attribute__((target("sse4.1")))
+#else
+#define CG2D_TARGET_SSE4
+#endif
+
+namespace USTC_CG
+{
+namespace warp_kernels
+{
+namespace
+{
+// log_positive() of 4 floats
+CG2D_TARGET_SSE4 inline __m128 log_positive(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i bits = _mm_castps_si128(x);
+    __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(
+        _mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+        _mm_set1_epi32(0x3F000000)));
+    // Where m < sqrt(1/2): e - 1 and m + m - 1, else m - 1
+    const __m128 small = _mm_cmplt_ps(m, _mm_set1_ps(kSqrtHalf));
+    e = _mm_add_epi32(e, _mm_castps_si128(small));
+    m = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(small, m)), one);
+
+    const __m128 z = _mm_mul_ps(m, m);
+    __m128 y = _mm_set1_ps(kLogP[0]);
+    for (int i = 1; i < 9; ++i)
+        y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(kLogP[i]));
+    y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+    const __m128 fe = _mm_cvtepi32_ps(e);
+    y = _mm_add_ps(y, _mm_mul_ps(fe, _mm_set1_ps(kLn2Low)));
+    y = _mm_sub_ps(y, _mm_mul_ps(_mm_set1_ps(0.5f), z));
+    return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(fe, _mm_set1_ps(kLn2High)));
+}
+
+template <IdwPower power>
+CG2D_TARGET_SSE4 void idw_power(
+    const IdwPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 epsilon = _mm_set1_ps(kIdwEpsilon);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(xs + i);
+        const __m128 y = _mm_loadu_ps(ys + i);
+        __m128 sum_w = _mm_setzero_ps();
+        __m128 sum_wx = _mm_setzero_ps();
+        __m128 sum_wy = _mm_setzero_ps();
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const __m128 dx = _mm_sub_ps(x, _mm_set1_ps(points.x[k]));
+            const __m128 dy = _mm_sub_ps(y, _mm_set1_ps(points.y[k]));
+            const __m128 dist_sq =
+                _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            __m128 d = dist_sq;
+            if constexpr (power == IdwPower::kOne)
+                d = _mm_sqrt_ps(dist_sq);
+            else if constexpr (power == IdwPower::kFour)
+                d = _mm_mul_ps(dist_sq, dist_sq);
+            const __m128 sigma = _mm_div_ps(one, _mm_add_ps(d, epsilon));
+            sum_w = _mm_add_ps(sum_w, sigma);
+            sum_wx = _mm_add_ps(
+                sum_wx, _mm_mul_ps(sigma, _mm_set1_ps(points.dx[k])));
+            sum_wy = _mm_add_ps(
+                sum_wy, _mm_mul_ps(sigma, _mm_set1_ps(points.dy[k])));
+        }
+        // Lanes too far from every point keep their position
+        const __m128 moved = _mm_cmpnlt_ps(sum_w, epsilon);
+        const __m128 wx = _mm_add_ps(x, _mm_div_ps(sum_wx, sum_w));
+        const __m128 wy = _mm_add_ps(y, _mm_div_ps(sum_wy, sum_w));
+        _mm_storeu_ps(out_x + i, _mm_blendv_ps(x, wx, moved));
+        _mm_storeu_ps(out_y + i, _mm_blendv_ps(y, wy, moved));
+    }
+    scalar_idw(points, power, xs + i, ys + i, out_x + i, out_y + i, n - i);
+}
+
+void idw(
+    const IdwPoints& points,
+    IdwPower power,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    switch (power)
+    {
+        case IdwPower::kOne:
+            idw_power<IdwPower::kOne>(points, xs, ys, out_x, out_y, n);
+            break;
+        case IdwPower::kTwo:
+            idw_power<IdwPower::kTwo>(points, xs, ys, out_x, out_y, n);
+            break;
+        case IdwPower::kFour:
+            idw_power<IdwPower::kFour>(points, xs, ys, out_x, out_y, n);
+            break;
+    }
+}
+
+CG2D_TARGET_SSE4 void tps(
+    const TpsPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const auto& a = points.affine;
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 epsilon = _mm_set1_ps(kTpsEpsilon);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(xs + i);
+        const __m128 y = _mm_loadu_ps(ys + i);
+        __m128 sum_x = _mm_add_ps(
+            _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(a[0][0]), x),
+                    _mm_mul_ps(_mm_set1_ps(a[0][1]), y)),
+                _mm_set1_ps(a[0][2])),
+            x);
+        __m128 sum_y = _mm_add_ps(
+            _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(a[1][0]), x),
+                    _mm_mul_ps(_mm_set1_ps(a[1][1]), y)),
+                _mm_set1_ps(a[1][2])),
+            y);
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const __m128 dx = _mm_sub_ps(x, _mm_set1_ps(points.x[k]));
+            const __m128 dy = _mm_sub_ps(y, _mm_set1_ps(points.y[k]));
+            const __m128 r_sq = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), epsilon);
+            const __m128 phi =
+                _mm_mul_ps(_mm_mul_ps(half, r_sq), log_positive(r_sq));
+            sum_x = _mm_add_ps(
+                sum_x, _mm_mul_ps(_mm_set1_ps(points.weight_x[k]), phi));
+            sum_y = _mm_add_ps(
+                sum_y, _mm_mul_ps(_mm_set1_ps(points.weight_y[k]), phi));
+        }
+        _mm_storeu_ps(out_x + i, sum_x);
+        _mm_storeu_ps(out_y + i, sum_y);
+    }
+    scalar_tps(points, xs + i, ys + i, out_x + i, out_y + i, n - i);
+}
+
+CG2D_TARGET_SSE4 void wendland(
+    const WendlandPoints& points,
+    const float* xs,
+    const float* ys,
+    float* out_x,
+    float* out_y,
+    std::size_t n)
+{
+    const auto& a = points.affine;
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 four = _mm_set1_ps(4.0f);
+    const __m128 inv_support = _mm_set1_ps(points.inv_support);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(xs + i);
+        const __m128 y = _mm_loadu_ps(ys + i);
+        __m128 sum_x = _mm_add_ps(
+            _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(a[0][0]), x),
+                    _mm_mul_ps(_mm_set1_ps(a[0][1]), y)),
+                _mm_set1_ps(a[0][2])),
+            x);
+        __m128 sum_y = _mm_add_ps(
+            _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(a[1][0]), x),
+                    _mm_mul_ps(_mm_set1_ps(a[1][1]), y)),
+                _mm_set1_ps(a[1][2])),
+            y);
+        for (std::size_t k = 0; k < points.count; ++k)
+        {
+            const __m128 dx = _mm_sub_ps(x, _mm_set1_ps(points.x[k]));
+            const __m128 dy = _mm_sub_ps(y, _mm_set1_ps(points.y[k]));
+            const __m128 t = _mm_mul_ps(
+                _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))),
+                inv_support);
+            const __m128 s = _mm_sub_ps(one, t);
+            const __m128 s_sq = _mm_mul_ps(s, s);
+            const __m128 phi = _mm_mul_ps(
+                _mm_mul_ps(s_sq, s_sq), _mm_add_ps(_mm_mul_ps(four, t), one));
+            const __m128 inside =
+                _mm_and_ps(phi, _mm_cmpgt_ps(s, _mm_setzero_ps()));
+            sum_x = _mm_add_ps(
+                sum_x, _mm_mul_ps(_mm_set1_ps(points.weight_x[k]), inside));
+            sum_y = _mm_add_ps(
+                sum_y, _mm_mul_ps(_mm_set1_ps(points.weight_y[k]), inside));
+        }
+        _mm_storeu_ps(out_x + i, sum_x);
+        _mm_storeu_ps(out_y + i, sum_y);
+    }
+    scalar_wendland(points, xs + i, ys + i, out_x + i, out_y + i, n - i);
+}
+
+CG2D_TARGET_SSE4 void shepard(
+    const float* dist_sq,
+    float inv_r_sq,
+    float* weight,
+    std::size_t m)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 epsilon = _mm_set1_ps(kIdwEpsilon);
+    const __m128 inv = _mm_set1_ps(inv_r_sq);
+    std::size_t j = 0;
+    for (; j + 4 <= m; j += 4)
+    {
+        const __m128 d = _mm_loadu_ps(dist_sq + j);
+        const __m128 taper = _mm_sub_ps(one, _mm_mul_ps(d, inv));
+        const __m128 w =
+            _mm_div_ps(_mm_mul_ps(taper, taper), _mm_add_ps(d, epsilon));
+        const __m128 inside = _mm_cmpgt_ps(taper, _mm_setzero_ps());
+        _mm_storeu_ps(weight + j, _mm_and_ps(w, inside));
+    }
+    scalar_shepard(dist_sq + j, inv_r_sq, weight + j, m - j);
+}
+}  // namespace
+
+const Table* sse4_table()
+{
+    static const Table table{ "sse4",
+                              SimdLevel::kSse4,
+                              idw,
+                              tps,
+                              wendland,
+                              shepard };
+    return &table;
+}
+}  // namespace warp_kernels
+}  // namespace USTC_CG
+
+#else
+
+namespace USTC_CG
+{
+namespace warp_kernels
+{
+const Table* sse4_table()
+{
+    return nullptr;
+}
+}  // namespace warp_kernels
+}  // namespace USTC_CG
+
+#endif
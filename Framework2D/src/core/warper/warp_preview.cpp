@@ -0,0 +1,206 @@
+#include "warp_preview.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include "common/image_ops.h"
+#include "warp_field.h"
+
+namespace USTC_CG
+{
+WarpPreview::WarpPreview(std::function<void()> on_update)
+    : on_update_(std::move(on_update))
+{
+    worker_ = std::thread(&WarpPreview::worker_loop, this);
+}
+
+WarpPreview::~WarpPreview()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        ++generation_;
+        job_.reset();
+    }
+    cv_.notify_all();
+    worker_.join();
+}
+
+void WarpPreview::set_source(const Image& source, Factory factory)
+{
+    const int factor =
+        downsample_factor(source.width(), source.height(), kProxySize);
+    Image proxy = downsample(source, factor);
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    job_.reset();
+    factory_ = std::move(factory);
+    // Shares the pixels of the caller, which copies them if it edits them
+    source_ = source;
+    proxy_ = std::move(proxy);
+    proxy_factor_ = factor;
+    proxy_result_.reset();
+    full_ = {};
+}
+
+void WarpPreview::request_proxy(
+    const std::vector<Point2f>& start_points,
+    const std::vector<Point2f>& end_points)
+{
+    queue({ 0, false, start_points, end_points });
+}
+
+void WarpPreview::request_full(
+    const std::vector<Point2f>& start_points,
+    const std::vector<Point2f>& end_points)
+{
+    queue({ 0, true, start_points, end_points });
+}
+
+void WarpPreview::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    job_.reset();
+    proxy_result_.reset();
+    full_ = {};
+}
+
+std::shared_ptr<const Image> WarpPreview::take_proxy()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::move(proxy_result_);
+}
+
+WarpPreview::Progress WarpPreview::full_progress() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return full_;
+}
+
+void WarpPreview::queue(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job.generation = ++generation_;
+        job_ = std::move(job);
+        full_ = {};
+    }
+    cv_.notify_one();
+}
+
+bool WarpPreview::stale(const Job& job) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return job.generation != generation_;
+}
+
+void WarpPreview::worker_loop()
+{
+    while (true)
+    {
+        Job job;
+        Factory factory;
+        Image source, proxy;
+        int factor;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || job_.has_value(); });
+            if (stopping_)
+                return;
+            job = std::move(*job_);
+            job_.reset();
+            factory = factory_;
+            source = source_;
+            proxy = proxy_;
+            factor = proxy_factor_;
+        }
+        try
+        {
+            if (!factory)
+                throw std::logic_error("No source to warp");
+            if (job.full)
+                run_full(job, factory, source);
+            else
+                run_proxy(job, factory, proxy, factor);
+        }
+        catch (...)
+        {
+            // No result. A full warp is reported as done without one, so
+            // that the caller stops waiting for it.
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (job.full && job.generation == generation_)
+                full_ = { nullptr, 0, true };
+        }
+        if (on_update_)
+            on_update_();
+    }
+}
+
+void WarpPreview::run_proxy(
+    const Job& job,
+    const Factory& factory,
+    const Image& proxy,
+    int factor)
+{
+    if (proxy.width() == 0 || proxy.height() == 0)
+        return;
+    // Pixel p of the proxy averages source pixels p * factor to
+    // p * factor + factor - 1, so its center is at
+    // p * factor + (factor - 1) / 2 in the source
+    const float offset = 0.5f * (factor - 1);
+    auto to_proxy = [&](const std::vector<Point2f>& points)
+    {
+        std::vector<Point2f> result;
+        result.reserve(points.size());
+        for (const Point2f& p : points)
+            result.push_back({ (p.x - offset) / factor,
+                               (p.y - offset) / factor });
+        return result;
+    };
+    const std::shared_ptr<Warper> warper =
+        factory(to_proxy(job.start_points), to_proxy(job.end_points));
+    if (!warper || stale(job))
+        return;
+    const WarpField field =
+        WarpField::bake_coarse(*warper, proxy.width(), proxy.height());
+    auto result = std::make_shared<const Image>(warp_image(field, proxy));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (job.generation == generation_)
+        proxy_result_ = std::move(result);
+}
+
+void WarpPreview::run_full(
+    const Job& job,
+    const Factory& factory,
+    const Image& source)
+{
+    const std::shared_ptr<Warper> warper =
+        factory(job.start_points, job.end_points);
+    if (!warper || source.width() == 0 || source.height() == 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (job.generation == generation_)
+            full_ = { nullptr, 0, true };
+        return;
+    }
+    if (stale(job))
+        return;
+    // The field is baked band by band along with the warp, so that a newer
+    // request stops it within a band. Only this thread touches the warp; the
+    // caller reads the rows published in full_.
+    auto warp = std::make_shared<ProgressiveWarp>(warper, source);
+    while (!warp->done())
+    {
+        const int rows_done = warp->advance(kBandRows);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (job.generation != generation_)
+                return;
+            full_ = { warp, rows_done, warp->done() };
+        }
+        if (on_update_)
+            on_update_();
+    }
+}
+}  // namespace USTC_CG
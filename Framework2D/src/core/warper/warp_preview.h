@@ -0,0 +1,121 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "common/image.h"
+#include "warp_image.h"
+#include "warper.h"
+
+namespace USTC_CG
+{
+// Warps an image on a background thread while its control points are being
+// edited, so that the UI never waits for a warp.
+//
+// A proxy, the image downsampled to at most kProxySize pixels per side, is
+// warped for every change of the points: it costs a few milliseconds and
+// can be shown stretched over the image right away. When the edit is over,
+// the full resolution warp is produced progressively, band by band (see
+// ProgressiveWarp), and the bands done so far can be shown over the proxy.
+//
+// Only the latest request matters: a new one replaces the job still queued,
+// and the running one stops at its next band.
+class WarpPreview
+{
+   public:
+    // Backward warper from the control points (the start points in the
+    // result, the end points in the source, see warp_image()). Called on
+    // the worker thread; may return null for no warp.
+    using Factory = std::function<std::shared_ptr<Warper>(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points)>;
+
+    // Longest side of the proxy, in pixels
+    static constexpr int kProxySize = 512;
+    // Rows of the full resolution warp produced between two checks for a
+    // newer request
+    static constexpr int kBandRows = 32;
+
+    // on_update, if given, runs on the worker thread after each proxy and
+    // each band of the full warp, e.g. to wake up the UI loop.
+    explicit WarpPreview(std::function<void()> on_update = nullptr);
+    // Drops the jobs and waits for the running one to stop.
+    ~WarpPreview();
+
+    WarpPreview(const WarpPreview&) = delete;
+    WarpPreview& operator=(const WarpPreview&) = delete;
+
+    // Image the warps start from, and how warpers are made. Drops the jobs
+    // and the results.
+    void set_source(const Image& source, Factory factory);
+
+    // Queues a warp of the proxy, for points in pixels of the source.
+    void request_proxy(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points);
+    // Queues a full resolution warp.
+    void request_full(
+        const std::vector<Point2f>& start_points,
+        const std::vector<Point2f>& end_points);
+    // Drops the jobs and the results.
+    void cancel();
+
+    // Warped proxy of the latest proxy request, once per result: null if it
+    // is not done, or was taken already.
+    std::shared_ptr<const Image> take_proxy();
+
+    // Full resolution warp of the latest full request. Rows
+    // [0, rows_done) of warp->result() are final; the others are being
+    // written by the worker and must not be read, nor may the progress
+    // members of *warp. warp is null until the job starts, and when done if
+    // there was no warp (the factory gave no warper or threw).
+    struct Progress
+    {
+        std::shared_ptr<const ProgressiveWarp> warp;
+        int rows_done = 0;
+        bool done = false;
+    };
+    Progress full_progress() const;
+
+   private:
+    struct Job
+    {
+        std::uint64_t generation;
+        bool full;
+        std::vector<Point2f> start_points, end_points;
+    };
+
+    void queue(Job job);
+    void worker_loop();
+    void run_proxy(
+        const Job& job,
+        const Factory& factory,
+        const Image& proxy,
+        int factor);
+    void run_full(const Job& job, const Factory& factory, const Image& source);
+    // Whether a newer request or cancel() made the job useless
+    bool stale(const Job& job) const;
+
+    std::function<void()> on_update_;
+    std::thread worker_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    // Incremented by each request, so that older jobs know they are stale
+    std::uint64_t generation_ = 0;
+    std::optional<Job> job_;  // Queued, not started yet
+
+    Factory factory_;
+    Image source_, proxy_;
+    int proxy_factor_ = 1;
+
+    std::shared_ptr<const Image> proxy_result_;
+    Progress full_;
+};
+}  // namespace USTC_CG
@@ -0,0 +1,55 @@
+// HW2_TODO: Please implement the abstract class Warper
+// 1. The Warper class should abstract the **mathematical mapping** involved in
+// the warping problem, **independent of image**.
+// 2. The Warper class should have a virtual function warp(...) to be called in
+// our image warping application.
+//    - You should design the inputs and outputs of warp(...) according to the
+//    mathematical abstraction discussed in class.
+//    - Generally, the warping map should map one input point to another place.
+// 3. Subclasses of Warper, IDWWarper and RBFWarper, should implement the
+// warp(...) function to perform the actual warping.
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+namespace USTC_CG
+{
+// Control point in image coordinates (pixels). The warpers are independent
+// of the GUI, so they do not use ImVec2.
+struct Point2f
+{
+    float x = 0.0f;
+    float y = 0.0f;
+};
+
+class Warper
+{
+   public:
+    virtual ~Warper() = default;
+    // HW2_TODO: A virtual function warp(...)
+    virtual std::pair<float,float> warp(float x, float y) = 0;  
+    // Warps n points (xs[i], ys[i]) into (out_x[i], out_y[i]); out_x and
+    // out_y may be xs and ys. The default calls warp() for each point;
+    // warpers override it with kernels that run over a whole row.
+    virtual void warp_batch(
+        const float* xs,
+        const float* ys,
+        float* out_x,
+        float* out_y,
+        std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const auto [x, y] = warp(xs[i], ys[i]);
+            out_x[i] = x;
+            out_y[i] = y;
+        }
+    }
+    // Whether warp() may be called from several threads at once
+    virtual bool is_thread_safe() const
+    {
+        return true;
+    }
+    // HW2_TODO: other functions or variables if you need
+};
+}  // namespace USTC_CG
\ No newline at end of file
@@ -0,0 +1,182 @@
+// Checks the allocation-free pixel access of Image (row(), row_as<>(),
+// at<>() and pixel()) against the copying get_pixel() / set_pixel(), on
+// random images of every supported channel count. Exits with 1 on the
+// first mismatch.
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "common/image.h"
+
+namespace
+{
+using namespace USTC_CG;
+using uchar = unsigned char;
+
+int failures = 0;
+
+void check(bool condition, const char* what, int x, int y, int channels)
+{
+    if (condition)
+        return;
+    std::fprintf(
+        stderr,
+        "FAILED: %s at (%d, %d), %d channels\n",
+        what,
+        x,
+        y,
+        channels);
+    ++failures;
+}
+
+Image random_image(int width, int height, int channels, std::mt19937& rng)
+{
+    Image image(width, height, channels);
+    for (int y = 0; y < height; ++y)
+        for (uchar& value : image.row_span(y))
+            value = static_cast<uchar>(rng() >> 24);
+    return image;
+}
+
+template<typename Pixel>
+void check_typed(const Image& image)
+{
+    const int channels = image.channels();
+    for (int y = 0; y < image.height(); ++y)
+    {
+        const auto row = image.row_as<Pixel>(y);
+        for (int x = 0; x < image.width(); ++x)
+        {
+            const auto expected = image.get_pixel(x, y);
+            const auto* typed = reinterpret_cast<const uchar*>(&row[x]);
+            const auto* at =
+                reinterpret_cast<const uchar*>(&image.at<Pixel>(x, y));
+            bool same = true;
+            for (int c = 0; c < channels; ++c)
+                same = same && typed[c] == expected[c] && at[c] == expected[c];
+            check(same, "row_as / at", x, y, channels);
+        }
+    }
+}
+
+void check_reads(const Image& image)
+{
+    const int channels = image.channels();
+    for (int y = 0; y < image.height(); ++y)
+    {
+        const uchar* row = image.row(y);
+        check(
+            image.row_span(y).size() == image.stride(),
+            "row_span size",
+            0,
+            y,
+            channels);
+        for (int x = 0; x < image.width(); ++x)
+        {
+            const auto expected = image.get_pixel(x, y);
+            const auto pixel = image.pixel(x, y);
+            bool same = pixel.size() == expected.size();
+            for (int c = 0; c < channels; ++c)
+            {
+                same = same && pixel[c] == expected[c] &&
+                       row[x * channels + c] == expected[c];
+            }
+            check(same, "row / pixel", x, y, channels);
+        }
+    }
+    if (channels == 1)
+        check_typed<Gray8>(image);
+    else if (channels == 3)
+        check_typed<RGB8>(image);
+    else if (channels == 4)
+        check_typed<RGBA8>(image);
+}
+
+// Writes the same random values through set_pixel() into one copy and
+// through pixel() into another, which must end up equal
+void check_writes(const Image& image, std::mt19937& rng)
+{
+    const int channels = image.channels();
+    Image old_path = image, new_path = image;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        for (int x = 0; x < image.width(); ++x)
+        {
+            std::vector<uchar> values(channels);
+            for (uchar& value : values)
+                value = static_cast<uchar>(rng() >> 24);
+            old_path.set_pixel(x, y, values);
+            const auto pixel = new_path.pixel(x, y);
+            for (int c = 0; c < channels; ++c)
+                pixel[c] = values[c];
+        }
+    }
+    bool same = true;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        const auto a = old_path.row_span(y), b = new_path.row_span(y);
+        for (std::size_t i = 0; i < a.size(); ++i)
+            same = same && a[i] == b[i];
+    }
+    check(same, "set_pixel / pixel writes", -1, -1, channels);
+    check(
+        !old_path.shares_data_with(image) && !new_path.shares_data_with(image),
+        "copy on write",
+        -1,
+        -1,
+        channels);
+}
+
+// Both paths throw std::out_of_range outside the image
+void check_bounds(const Image& image)
+{
+    const int channels = image.channels();
+    const int outside[][2] = { { -1, 0 },
+                               { 0, -1 },
+                               { image.width(), 0 },
+                               { 0, image.height() } };
+    for (const auto& [x, y] : outside)
+    {
+        bool old_throws = false, new_throws = false;
+        try
+        {
+            image.get_pixel(x, y);
+        }
+        catch (const std::out_of_range&)
+        {
+            old_throws = true;
+        }
+        try
+        {
+            image.pixel(x, y);
+        }
+        catch (const std::out_of_range&)
+        {
+            new_throws = true;
+        }
+        check(old_throws && new_throws, "out of range", x, y, channels);
+    }
+}
+}  // namespace
+
+int main()
+{
+    std::mt19937 rng(1);
+    // Odd sizes, so that rows are not multiples of any vector width
+    for (int channels : { 1, 2, 3, 4 })
+    {
+        const Image image = random_image(67, 41, channels, rng);
+        check_reads(image);
+        check_writes(image, rng);
+        check_bounds(image);
+    }
+    if (failures > 0)
+    {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
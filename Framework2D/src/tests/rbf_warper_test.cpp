@@ -0,0 +1,204 @@
+// Checks that RBFWarper interpolates its control points with either
+// backend, the dense thin plate spline and the compact Wendland kernels,
+// through warp() and warp_batch(), and that refit() after moving end
+// points, moving, adding or removing start points warps like a new
+// RBFWarper of the same points. Exits with 1 on the first mismatch.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "warper/RBF_warper.h"
+
+namespace
+{
+using namespace USTC_CG;
+
+// Control points are spread over an image of this size
+constexpr float kWidth = 1024;
+constexpr float kHeight = 1024;
+// Largest error allowed at a control point, in pixels
+constexpr float kTolerance = 0.05f;
+
+int failures = 0;
+
+void check(bool condition, const char* what, std::size_t points)
+{
+    if (condition)
+        return;
+    std::fprintf(stderr, "FAILED: %s (%zu points)\n", what, points);
+    ++failures;
+}
+
+// n points in distinct cells of a square grid, each in the middle half of
+// its cell: no two points are closer than half a cell, as for control
+// points picked by hand or matched between images
+std::vector<Point2f> random_points(std::size_t n, std::mt19937& rng)
+{
+    const std::size_t cells = static_cast<std::size_t>(
+        std::ceil(std::sqrt(static_cast<double>(n))));
+    const float size_x = kWidth / cells, size_y = kHeight / cells;
+    std::vector<std::size_t> order(cells * cells);
+    for (std::size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    std::uniform_real_distribution<float> jitter(0.25f, 0.75f);
+    std::vector<Point2f> points;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        points.push_back({ (order[i] % cells + jitter(rng)) * size_x,
+                           (order[i] / cells + jitter(rng)) * size_y });
+    }
+    return points;
+}
+
+Point2f displaced(const Point2f& p, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> offset(-30, 30);
+    return { p.x + offset(rng), p.y + offset(rng) };
+}
+
+// Largest distance from the warp of each start point to its end point
+float interpolation_error(
+    RBFWarper& warper,
+    const std::vector<Point2f>& start,
+    const std::vector<Point2f>& end,
+    bool batch)
+{
+    const std::size_t n = start.size();
+    std::vector<float> xs(n), ys(n), out_x(n), out_y(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        xs[i] = start[i].x;
+        ys[i] = start[i].y;
+        if (!batch)
+            std::tie(out_x[i], out_y[i]) = warper.warp(xs[i], ys[i]);
+    }
+    if (batch)
+        warper.warp_batch(xs.data(), ys.data(), out_x.data(), out_y.data(), n);
+    float error = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        error = std::max(
+            error, std::hypot(out_x[i] - end[i].x, out_y[i] - end[i].y));
+    }
+    return error;
+}
+
+// Largest distance between the warps of a and b on a lattice over the image
+float difference(RBFWarper& a, RBFWarper& b)
+{
+    std::vector<float> xs, ys;
+    for (float y = 0; y < kHeight; y += 31)
+    {
+        for (float x = 0; x < kWidth; x += 31)
+        {
+            xs.push_back(x);
+            ys.push_back(y);
+        }
+    }
+    const std::size_t n = xs.size();
+    std::vector<float> ax(n), ay(n), bx(n), by(n);
+    a.warp_batch(xs.data(), ys.data(), ax.data(), ay.data(), n);
+    b.warp_batch(xs.data(), ys.data(), bx.data(), by.data(), n);
+    float error = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        error = std::max(error, std::hypot(ax[i] - bx[i], ay[i] - by[i]));
+    return error;
+}
+
+void check_interpolation(std::size_t n, std::mt19937& rng)
+{
+    std::vector<Point2f> start = random_points(n, rng), end;
+    for (const Point2f& p : start)
+        end.push_back(displaced(p, rng));
+    RBFWarper warper(start, end);
+    check(
+        warper.compact() == (n > RBFWarper::kDenseMaxPoints),
+        "backend",
+        n);
+    const float single = interpolation_error(warper, start, end, false);
+    const float batch = interpolation_error(warper, start, end, true);
+    std::printf(
+        "%zu points, %s: error %.4f px (warp), %.4f px (warp_batch)\n",
+        n,
+        warper.compact() ? "compact" : "dense",
+        single,
+        batch);
+    check(single <= kTolerance, "interpolation by warp()", n);
+    check(batch <= kTolerance, "interpolation by warp_batch()", n);
+}
+
+void check_refit(std::size_t n, std::mt19937& rng)
+{
+    // The last points are the new positions of the edits
+    std::vector<Point2f> start = random_points(n + 4, rng), end;
+    std::vector<Point2f> spare(start.begin() + n, start.end());
+    start.resize(n);
+    for (const Point2f& p : start)
+        end.push_back(displaced(p, rng));
+    RBFWarper warper(start, end);
+    auto expect_fresh = [&](const char* what)
+    {
+        RBFWarper fresh(start, end);
+        check(difference(warper, fresh) <= kTolerance, what, n);
+        check(
+            interpolation_error(warper, start, end, true) <= kTolerance,
+            what,
+            n);
+    };
+
+    for (Point2f& p : end)
+        p = displaced(p, rng);
+    warper.refit(start, end);
+    expect_fresh("refit() of moved end points");
+
+    // Few enough changes for the dense backend to update its inverse
+    for (int i = 0; i < 3; ++i)
+    {
+        const std::size_t j = rng() % n;
+        start[j] = spare[i];
+        end[j] = displaced(start[j], rng);
+    }
+    warper.refit(start, end);
+    expect_fresh("refit() of moved start points");
+
+    start.push_back(spare[3]);
+    end.push_back(displaced(start.back(), rng));
+    warper.refit(start, end);
+    expect_fresh("refit() of an added point");
+
+    start.erase(start.begin() + rng() % start.size());
+    end.resize(start.size());
+    for (std::size_t i = 0; i < start.size(); ++i)
+        end[i] = displaced(start[i], rng);
+    warper.refit(start, end);
+    expect_fresh("refit() of a removed point");
+}
+}  // namespace
+
+int main()
+{
+    std::mt19937 rng(1);
+    // Both sides of the switch from the dense spline to compact kernels
+    for (std::size_t n :
+         { std::size_t(3),
+           std::size_t(16),
+           std::size_t(64),
+           RBFWarper::kDenseMaxPoints,
+           RBFWarper::kDenseMaxPoints + 1,
+           std::size_t(1000) })
+    {
+        check_interpolation(n, rng);
+        check_refit(n, rng);
+    }
+    if (failures > 0)
+    {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
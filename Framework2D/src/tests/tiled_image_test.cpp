@@ -0,0 +1,203 @@
+// Checks the out-of-core path of the command line tools against the
+// in-memory one, with tiled images held to the smallest memory budget on an
+// image several times larger: a PAM file streamed into a TiledImage and back
+// out holds the same pixels, with its channels converted like load_image();
+// the tiled warp_image() of IDWWarper gives the bytes of the in-memory warp,
+// including pixels that sample outside the source; clone_into_tiled() gives
+// the bytes of Seamless and MixGradient on the whole target. Exits with 1 on
+// the first mismatch.
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CloneMethods/Mixgradient.h"
+#include "CloneMethods/Seamless.h"
+#include "common/image.h"
+#include "common/image_io.h"
+#include "common/tiled_image.h"
+#include "warper/IDW_warper.h"
+#include "warper/warp_image.h"
+
+namespace
+{
+using namespace USTC_CG;
+
+// 6 x 5 tiles, against a budget of TiledImage::kMinResidentTiles
+constexpr int kWidth = 1300;
+constexpr int kHeight = 1100;
+
+int failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if (condition)
+        return;
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+}
+
+bool same_pixels(const Image& a, const Image& b)
+{
+    if (a.width() != b.width() || a.height() != b.height() ||
+        a.channels() != b.channels())
+        return false;
+    for (int y = 0; y < a.height(); ++y)
+    {
+        if (std::memcmp(a.row(y), b.row(y), a.stride()) != 0)
+            return false;
+    }
+    return true;
+}
+
+Image whole(const TiledImage& image)
+{
+    return image.read_region({ 0, 0, image.width(), image.height() });
+}
+
+// The budget was honored, and was small enough to evict tiles
+void check_budget(const TiledImage& image, const char* what)
+{
+    const TiledImage::Stats& stats = image.stats();
+    const std::size_t tile_bytes = std::size_t(TiledImage::kTileSize) *
+                                   TiledImage::kTileSize * image.channels();
+    check(
+        stats.peak_resident_bytes <=
+            TiledImage::kMinResidentTiles * tile_bytes,
+        what);
+    check(stats.evictions > 0, what);
+}
+
+// Smooth random colors, so that the clone methods and the interpolation
+// see gradients rather than noise
+Image random_image(int width, int height, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> noise(-8, 8);
+    std::uniform_real_distribution<float> phase(0, 6.2832f);
+    Image image(width, height, 4);
+    float phases[4];
+    for (float& p : phases)
+        p = phase(rng);
+    for (int y = 0; y < height; ++y)
+    {
+        unsigned char* row = image.row(y);
+        for (int x = 0; x < width; ++x)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                const float wave =
+                    std::sin(x * 0.02f + phases[c]) * std::cos(y * 0.03f);
+                const int value =
+                    128 + static_cast<int>(100 * wave) + noise(rng);
+                row[x * 4 + c] = static_cast<unsigned char>(value);
+            }
+        }
+    }
+    return image;
+}
+
+void check_streaming(const Image& image, const std::string& path)
+{
+    save_image(path, image);
+    TiledImage tiled(kWidth, kHeight, 4, 0);
+    load_image(path, tiled);
+    check(same_pixels(whole(tiled), image), "load_image() of a PAM file");
+    check_budget(tiled, "budget of load_image()");
+
+    const std::string copy = path + ".copy.pam";
+    save_image(copy, tiled);
+    check(
+        same_pixels(load_image(copy), image), "save_image() of a PAM file");
+    std::filesystem::remove(copy);
+
+    TiledImage rgb(kWidth, kHeight, 3, 0);
+    load_image(path, rgb);
+    check(
+        same_pixels(whole(rgb), load_image(path, 3)),
+        "load_image() converting the channels");
+}
+
+void check_warp(const Image& image, const std::string& path, std::mt19937& rng)
+{
+    // Displacements of up to 60 pixels, which sample outside the source
+    // near the edges
+    std::uniform_real_distribution<float> x(0, kWidth), y(0, kHeight);
+    std::uniform_real_distribution<float> offset(-60, 60);
+    std::vector<Point2f> start, end;
+    for (int i = 0; i < 12; ++i)
+    {
+        start.push_back({ x(rng), y(rng) });
+        end.push_back({ start.back().x + offset(rng),
+                        start.back().y + offset(rng) });
+    }
+    start.push_back({ 0, 0 });
+    end.push_back({ -40, -40 });
+    IDWWarper warper(start, end);
+
+    TiledImage source(kWidth, kHeight, 4, 0);
+    load_image(path, source);
+    TiledImage target(kWidth, kHeight, 4, 0);
+    warp_image(warper, source, target);
+    check(
+        same_pixels(whole(target), warp_image(warper, image)),
+        "tiled warp_image()");
+    check_budget(source, "budget of the tiled warp source");
+    check_budget(target, "budget of the tiled warp target");
+}
+
+template<typename Method>
+void check_clone(
+    const Image& image,
+    const std::string& path,
+    std::mt19937& rng,
+    const char* what)
+{
+    // An ellipse across tile edges of the target
+    constexpr int kSourceWidth = 200, kSourceHeight = 150;
+    constexpr int kOffsetX = 700, kOffsetY = 420;
+    auto source = std::make_shared<Image>(
+        random_image(kSourceWidth, kSourceHeight, rng));
+    auto mask = std::make_shared<Image>(kSourceWidth, kSourceHeight, 1);
+    for (int y = 0; y < kSourceHeight; ++y)
+    {
+        for (int x = 0; x < kSourceWidth; ++x)
+        {
+            const float u = (x - 100) / 90.0f, v = (y - 75) / 65.0f;
+            mask->row(y)[x] = u * u + v * v <= 1 ? 255 : 0;
+        }
+    }
+
+    auto target = std::make_shared<Image>(image);
+    const std::shared_ptr<Image> expected =
+        Method(source, target, mask, kOffsetX, kOffsetY).solve();
+    TiledImage tiled(kWidth, kHeight, 4, 0);
+    load_image(path, tiled);
+    clone_into_tiled<Method>(source, tiled, mask, kOffsetX, kOffsetY);
+    check(same_pixels(whole(tiled), *expected), what);
+}
+}  // namespace
+
+int main()
+{
+    std::mt19937 rng(1);
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "tiled_image_test.pam")
+            .string();
+    const Image image = random_image(kWidth, kHeight, rng);
+    check_streaming(image, path);
+    check_warp(image, path, rng);
+    check_clone<Seamless>(image, path, rng, "clone_into_tiled<Seamless>");
+    check_clone<MixGradient>(image, path, rng, "clone_into_tiled<MixGradient>");
+    std::filesystem::remove(path);
+    if (failures > 0)
+    {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,227 @@
+// Checks that UndoHistory restores every recorded state bit for bit: random
+// edits undone to the start and redone to the end, the trimming of old
+// steps past the memory limit, commits of a partial changed rect and the
+// reset on a change of size. The edits mix dense rectangles with sparse
+// bytes, so that the zero runs and literal runs of the delta encoding take
+// every length around the thresholds. Exits with 1 on the first mismatch.
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "common/image.h"
+#include "common/undo_history.h"
+
+namespace
+{
+using namespace USTC_CG;
+using uchar = unsigned char;
+
+int failures = 0;
+
+void check(bool condition, const char* what, int step)
+{
+    if (condition)
+        return;
+    std::fprintf(stderr, "FAILED: %s (step %d)\n", what, step);
+    ++failures;
+}
+
+// Copy with its own buffer, so that no later write can reach it
+Image clone(const Image& image)
+{
+    Image copy(image.width(), image.height(), image.channels());
+    for (int y = 0; y < image.height(); ++y)
+    {
+        const auto src = image.row_span(y);
+        std::copy(src.begin(), src.end(), copy.row(y));
+    }
+    return copy;
+}
+
+bool same_pixels(const Image& a, const Image& b)
+{
+    if (a.width() != b.width() || a.height() != b.height() ||
+        a.channels() != b.channels())
+        return false;
+    for (int y = 0; y < a.height(); ++y)
+    {
+        const auto row_a = a.row_span(y), row_b = b.row_span(y);
+        for (std::size_t i = 0; i < row_a.size(); ++i)
+            if (row_a[i] != row_b[i])
+                return false;
+    }
+    return true;
+}
+
+Image random_image(int width, int height, int channels, std::mt19937& rng)
+{
+    Image image(width, height, channels);
+    for (int y = 0; y < height; ++y)
+        for (uchar& value : image.row_span(y))
+            value = static_cast<uchar>(rng());
+    return image;
+}
+
+PixelRect random_rect(const Image& image, std::mt19937& rng)
+{
+    const int x0 = static_cast<int>(rng() % image.width());
+    const int y0 = static_cast<int>(rng() % image.height());
+    const int x1 = x0 + 1 + static_cast<int>(rng() % (image.width() - x0));
+    const int y1 = y0 + 1 + static_cast<int>(rng() % (image.height() - y0));
+    return { x0, y0, x1, y1 };
+}
+
+// Changes bytes of `rect`: all of them, or each with a small probability
+// and always the first one, so that every edit is a step
+void edit(Image& image, const PixelRect& rect, std::mt19937& rng)
+{
+    const int channels = image.channels();
+    const unsigned sparse = rng() % 3 == 0 ? 0 : 2 + rng() % 8;
+    for (int y = rect.y0; y < rect.y1; ++y)
+    {
+        uchar* row = image.row(y);
+        for (int i = rect.x0 * channels; i < rect.x1 * channels; ++i)
+        {
+            const bool first = y == rect.y0 && i == rect.x0 * channels;
+            if (first || sparse == 0 || rng() % sparse == 0)
+                row[i] = static_cast<uchar>(row[i] + 1 + rng() % 255);
+        }
+    }
+}
+
+// Random edits, undone to the start and redone to the end
+void check_round_trip(int width, int height, int channels, std::mt19937& rng)
+{
+    Image image = random_image(width, height, channels, rng);
+    UndoHistory history;
+    history.reset(image);
+    std::vector<Image> states{ clone(image) };
+    for (int step = 0; step < 20; ++step)
+    {
+        edit(image, random_rect(image, rng), rng);
+        history.commit(image);
+        states.push_back(clone(image));
+    }
+    for (int step = static_cast<int>(states.size()) - 2; step >= 0; --step)
+    {
+        history.undo(image);
+        check(same_pixels(image, states[step]), "undo", step);
+        check(same_pixels(history.current(), image), "current", step);
+    }
+    check(!history.can_undo(), "undo past the start", 0);
+    for (std::size_t step = 1; step < states.size(); ++step)
+    {
+        history.redo(image);
+        check(same_pixels(image, states[step]), "redo", int(step));
+    }
+    check(!history.can_redo(), "redo past the end", 0);
+}
+
+// The oldest steps are dropped past the memory limit, the others still
+// restore their states
+void check_memory_limit(std::mt19937& rng)
+{
+    Image image = random_image(200, 150, 4, rng);
+    UndoHistory history(64 << 10);
+    history.reset(image);
+    std::vector<Image> states{ clone(image) };
+    for (int step = 0; step < 30; ++step)
+    {
+        edit(image, random_rect(image, rng), rng);
+        history.commit(image);
+        states.push_back(clone(image));
+        check(
+            history.memory_usage() <= history.memory_limit() ||
+                history.undo_steps() <= 1,
+            "memory limit",
+            step);
+    }
+    check(history.undo_steps() < 30, "trimmed steps", 0);
+    const int kept = static_cast<int>(history.undo_steps());
+    const int last = static_cast<int>(states.size()) - 1;
+    for (int step = last - 1; step >= last - kept; --step)
+    {
+        history.undo(image);
+        check(same_pixels(image, states[step]), "undo after trim", step);
+    }
+    check(!history.can_undo(), "undo past the kept steps", 0);
+
+    // Lowering the limit drops the redo steps furthest from the current
+    // state, the others still redo
+    history.set_memory_limit(history.memory_usage() / 2);
+    check(
+        history.redo_steps() > 0 &&
+            history.redo_steps() < static_cast<std::size_t>(kept),
+        "redo steps trimmed",
+        0);
+    for (int step = last - kept + 1; history.can_redo(); ++step)
+    {
+        history.redo(image);
+        check(same_pixels(image, states[step]), "redo after trim", step);
+    }
+}
+
+// Only the tiles inside `changed` are compared, whatever its alignment
+void check_partial_commit(std::mt19937& rng)
+{
+    Image image = random_image(173, 91, 3, rng);
+    UndoHistory history;
+    history.reset(image);
+    const Image before = clone(image);
+    const PixelRect changed{ 37, 5, 130, 70 };
+    edit(image, changed, rng);
+    history.commit(image, changed);
+    const Image after = clone(image);
+    const PixelRect undone = history.undo(image);
+    check(same_pixels(image, before), "partial undo", 0);
+    check(
+        undone.x0 <= changed.x0 && undone.y0 <= changed.y0 &&
+            undone.x1 >= changed.x1 && undone.y1 >= changed.y1,
+        "partial undo rect",
+        0);
+    history.redo(image);
+    check(same_pixels(image, after), "partial redo", 0);
+}
+
+// A change of size resets the history to the new image
+void check_size_change(std::mt19937& rng)
+{
+    Image image = random_image(64, 64, 4, rng);
+    UndoHistory history;
+    history.reset(image);
+    edit(image, { 0, 0, 10, 10 }, rng);
+    history.commit(image);
+    check(history.can_undo(), "step before resize", 0);
+
+    Image resized = random_image(65, 64, 4, rng);
+    const Image expected = clone(resized);
+    history.commit(resized);
+    check(!history.can_undo() && !history.can_redo(), "resize reset", 0);
+    check(same_pixels(history.current(), expected), "resize current", 0);
+    check(history.undo(resized).empty(), "undo after reset", 0);
+    check(same_pixels(resized, expected), "image after reset", 0);
+}
+}  // namespace
+
+int main()
+{
+    std::mt19937 rng(1);
+    // Sizes that are not multiples of the tile size, with every channel
+    // count
+    for (int channels : { 1, 2, 3, 4 })
+    {
+        check_round_trip(1, 1, channels, rng);
+        check_round_trip(150, 97, channels, rng);
+        check_round_trip(64, 200, channels, rng);
+    }
+    check_memory_limit(rng);
+    check_partial_commit(rng);
+    check_size_change(rng);
+    if (failures > 0)
+    {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
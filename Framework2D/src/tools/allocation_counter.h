@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+namespace USTC_CG
+{
+// Heap allocations made so far by the program. Linking
+// allocation_counter.cpp replaces the global operator new and delete with
+// counting versions, so this is only meant for benchmarks.
+std::uint64_t allocation_count();
+}  // namespace USTC_CG
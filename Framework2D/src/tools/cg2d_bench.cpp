@@ -0,0 +1,1154 @@
+// Benchmarks of the cg2d_core kernels on seeded synthetic inputs.
+//
+//   cg2d_bench [--filter <substring>] [--repeat <n>] [--seed <n>]
+//              [--max-mp <megapixels>] [--max-seconds <s>] [--quick]
+//              [--threads <n>] [--deterministic] [--simd <level>]
+//              [--output <file.json>]
+//
+// Every case runs `repeat` times (fewer once a case has taken more than
+// `max-seconds`), after one untimed warm-up run for cases shorter than
+// 100 ms. The results are written as JSON, to stdout unless --output is
+// given; progress goes to stderr. Inputs only depend on the seed, so two
+// runs with the same options measure the same work.
+//
+// Throughput is reported in megapixels per second of output: accessed,
+// warped, filtered or encoded pixels, or unknowns (masked pixels) for
+// Poisson editing. Cases of approximations also report "metrics", such as
+// their error, and the pixel access cases their heap allocations per pixel.
+//
+// The full suite is slow: the largest Poisson masks and control-point sets
+// take minutes per run. --quick limits images to 4 MP, control points to
+// 256 (4096 for local IDW and RBF, which scale) and masks to 10%, for a run
+// of a few minutes; --filter selects cases by name (e.g.
+// "warp/idw", "poisson/seamless/factorize").
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "CloneMethods/Mixgradient.h"
+#include "CloneMethods/Seamless.h"
+#include "common/image_io.h"
+#include "common/image_ops.h"
+#include "common/image_pipeline.h"
+#include "common/parallel.h"
+#include "common/undo_history.h"
+#include "warper/IDW_warper.h"
+#include "warper/NN_warper.h"
+#include "warper/RBF_warper.h"
+#include "warper/forward_warp.h"
+#include "warper/triangulation_warper.h"
+#include "warper/local_IDW_warper.h"
+#include "warper/warp_image.h"
+
+#include "allocation_counter.h"
+
+namespace
+{
+using namespace USTC_CG;
+using Clock = std::chrono::steady_clock;
+using uchar = unsigned char;
+using Params = std::vector<std::pair<std::string, double>>;
+
+struct Options
+{
+    std::string filter;
+    std::string output;
+    int repeat = 5;
+    std::uint32_t seed = 1;
+    double max_megapixels = 50;
+    double max_seconds = 10;
+    int threads = 0;  // Scheduler default if 0
+    std::string simd;  // Color op kernels, best available if empty
+    bool quick = false;
+    bool deterministic = false;
+};
+
+// std::mt19937 is specified bit for bit, unlike the standard distributions,
+// so inputs are the same with every standard library.
+class Random
+{
+   public:
+    explicit Random(std::uint32_t seed) : engine_(seed)
+    {
+    }
+    float uniform(float lo, float hi)
+    {
+        return lo + (hi - lo) * static_cast<float>(engine_() >> 8) *
+                        (1.0f / 16777216.0f);
+    }
+
+   private:
+    std::mt19937 engine_;
+};
+
+// Size of an image of about `megapixels`, with a 16:9 aspect ratio
+std::pair<int, int> image_size(double megapixels)
+{
+    const int width =
+        static_cast<int>(std::lround(std::sqrt(megapixels * 1e6 * 16 / 9)));
+    return { width, static_cast<int>(std::lround(width * 9.0 / 16)) };
+}
+
+// Smooth color ramps plus noise, so that interpolation does real work
+Image make_image(int width, int height, Random& random)
+{
+    Image image(width, height, 4);
+    for (int y = 0; y < height; ++y)
+    {
+        uchar* row = image.row(y);
+        const float v = 255.0f * y / height;
+        for (int x = 0; x < width; ++x)
+        {
+            const float u = 255.0f * x / width;
+            const float noise = random.uniform(-16.0f, 16.0f);
+            uchar* pixel = row + x * 4;
+            pixel[0] = static_cast<uchar>(std::clamp(u + noise, 0.0f, 255.0f));
+            pixel[1] = static_cast<uchar>(std::clamp(v + noise, 0.0f, 255.0f));
+            pixel[2] = static_cast<uchar>(
+                std::clamp(255.0f - (u + v) / 2 + noise, 0.0f, 255.0f));
+            pixel[3] = 255;
+        }
+    }
+    return image;
+}
+
+// `count` control pairs inside the image, moved by up to 5% of its size
+void make_points(
+    int count,
+    int width,
+    int height,
+    Random& random,
+    std::vector<Point2f>& source_points,
+    std::vector<Point2f>& target_points)
+{
+    source_points.clear();
+    target_points.clear();
+    const float dx = 0.05f * width, dy = 0.05f * height;
+    for (int i = 0; i < count; ++i)
+    {
+        const Point2f p{ random.uniform(0.0f, float(width)),
+                         random.uniform(0.0f, float(height)) };
+        source_points.push_back(p);
+        target_points.push_back(
+            { p.x + random.uniform(-dx, dx), p.y + random.uniform(-dy, dy) });
+    }
+}
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Centered elliptic mask (255 inside) covering `fraction` of the image,
+// with the aspect ratio of the image
+Image make_mask(int width, int height, double fraction)
+{
+    Image mask(width, height, 1);
+    // Area of the ellipse: pi * a * b with a / b = width / height
+    const double a = std::sqrt(fraction * width * height / kPi * width /
+                               height);
+    const double b = a * height / width;
+    const double cx = width / 2.0, cy = height / 2.0;
+    for (int y = 0; y < height; ++y)
+    {
+        uchar* row = mask.row(y);
+        const double ny = (y + 0.5 - cy) / b;
+        for (int x = 0; x < width; ++x)
+        {
+            const double nx = (x + 0.5 - cx) / a;
+            row[x] = nx * nx + ny * ny <= 1.0 ? 255 : 0;
+        }
+    }
+    return mask;
+}
+
+std::size_t count_masked(const Image& mask)
+{
+    std::size_t count = 0;
+    for (int y = 0; y < mask.height(); ++y)
+    {
+        const uchar* row = mask.row(y);
+        for (int x = 0; x < mask.width(); ++x)
+            count += row[x] > 128;
+    }
+    return count;
+}
+
+// Exposes the stages of a Poisson clone method, which are protected
+template<typename Method>
+class PoissonStages : public Method
+{
+   public:
+    using Method::Method;
+
+    void build()
+    {
+        this->build_poisson_equation();
+    }
+    void factorize()
+    {
+        this->precompute_matrix();
+    }
+    void solve_channels()
+    {
+        for (int c = 0; c < 3; ++c)
+            this->solve_channel(c);
+    }
+};
+
+double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+class Bench
+{
+   public:
+    explicit Bench(const Options& options) : options_(options)
+    {
+    }
+
+    bool enabled(const std::string& name) const
+    {
+        return name.find(options_.filter) != std::string::npos;
+    }
+
+    // Times `body` options_.repeat times. A case that was already measured
+    // is skipped.
+    void measure(
+        const std::string& name,
+        const Params& params,
+        double megapixels,
+        const std::function<void()>& body)
+    {
+        if (!enabled(name) || find_case(name, params) != nullptr)
+            return;
+        Case& result = add_case(name, params, megapixels);
+        double total_ms = 0;
+        for (int run = 0; run < options_.repeat; ++run)
+        {
+            const auto start = Clock::now();
+            body();
+            const double ms = elapsed_ms(start);
+            if (run == 0 && ms < 100 && !result.warmed_up)
+            {
+                // The first run was the warm-up
+                result.warmed_up = true;
+                --run;
+                continue;
+            }
+            result.ms.push_back(ms);
+            total_ms += ms;
+            if (total_ms > options_.max_seconds * 1000)
+                break;
+        }
+        report(result);
+    }
+
+    // Adds one sample to a case, for benchmarks that time several stages
+    // per run. Returns false once the case has used its time budget.
+    bool record(
+        const std::string& name,
+        const Params& params,
+        double megapixels,
+        double ms)
+    {
+        Case* result = find_case(name, params);
+        if (result == nullptr)
+            result = &add_case(name, params, megapixels);
+        result->ms.push_back(ms);
+        double total_ms = 0;
+        for (double t : result->ms)
+            total_ms += t;
+        return total_ms <= options_.max_seconds * 1000;
+    }
+
+    // Attaches a value to a case measured before, e.g. the error of an
+    // approximation
+    void set_metric(
+        const std::string& name,
+        const Params& params,
+        const std::string& key,
+        double value)
+    {
+        Case* c = find_case(name, params);
+        if (c == nullptr)
+            return;
+        for (auto& metric : c->metrics)
+        {
+            if (metric.first == key)
+            {
+                metric.second = value;
+                return;
+            }
+        }
+        c->metrics.emplace_back(key, value);
+    }
+
+    void write_json(std::ostream& out) const
+    {
+        out << "{\n";
+        out << "  \"schema\": 1,\n";
+        out << "  \"seed\": " << options_.seed << ",\n";
+        out << "  \"repeat\": " << options_.repeat << ",\n";
+        out << "  \"quick\": " << (options_.quick ? "true" : "false") << ",\n";
+#ifdef NDEBUG
+        out << "  \"build_type\": \"release\",\n";
+#else
+        out << "  \"build_type\": \"debug\",\n";
+#endif
+        out << "  \"hardware_threads\": " << std::thread::hardware_concurrency()
+            << ",\n";
+        out << "  \"threads\": " << TaskScheduler::instance().num_threads()
+            << ",\n";
+        out << "  \"deterministic\": "
+            << (TaskScheduler::instance().deterministic() ? "true" : "false")
+            << ",\n";
+        out << "  \"simd\": \"" << simd_level_name(simd_level())
+            << "\",\n";
+        out << "  \"results\": [";
+        for (std::size_t i = 0; i < cases_.size(); ++i)
+        {
+            const Case& c = cases_[i];
+            std::vector<double> sorted = c.ms;
+            std::sort(sorted.begin(), sorted.end());
+            double mean = 0;
+            for (double t : sorted)
+                mean += t / sorted.size();
+            const double median = sorted.empty() ? 0 : sorted[sorted.size() / 2];
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << c.name
+                << "\", \"params\": {";
+            for (std::size_t p = 0; p < c.params.size(); ++p)
+                out << (p ? ", " : "") << "\"" << c.params[p].first
+                    << "\": " << c.params[p].second;
+            out << "}, \"runs\": " << sorted.size() << ", \"ms\": {\"min\": "
+                << (sorted.empty() ? 0 : sorted.front())
+                << ", \"median\": " << median << ", \"mean\": " << mean
+                << ", \"max\": " << (sorted.empty() ? 0 : sorted.back())
+                << "}, \"megapixels\": " << c.megapixels
+                << ", \"mpix_per_s\": "
+                << (median > 0 ? c.megapixels / (median / 1000) : 0);
+            if (!c.metrics.empty())
+            {
+                out << ", \"metrics\": {";
+                for (std::size_t m = 0; m < c.metrics.size(); ++m)
+                    out << (m ? ", " : "") << "\"" << c.metrics[m].first
+                        << "\": " << c.metrics[m].second;
+                out << "}";
+            }
+            out << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    const Options& options() const
+    {
+        return options_;
+    }
+
+    // Prints the median time of a case to stderr
+    void report(const std::string& name, const Params& params)
+    {
+        if (const Case* c = find_case(name, params))
+            report(*c);
+    }
+
+   private:
+    struct Case
+    {
+        std::string name;
+        Params params;
+        double megapixels = 0;
+        std::vector<double> ms;
+        bool warmed_up = false;
+        Params metrics;  // Measured quantities other than time
+    };
+
+    Case& add_case(
+        const std::string& name,
+        const Params& params,
+        double megapixels)
+    {
+        cases_.push_back({ name, params, megapixels, {}, false, {} });
+        return cases_.back();
+    }
+    Case* find_case(const std::string& name, const Params& params)
+    {
+        for (Case& c : cases_)
+            if (c.name == name && c.params == params)
+                return &c;
+        return nullptr;
+    }
+    void report(const Case& c) const
+    {
+        std::vector<double> sorted = c.ms;
+        std::sort(sorted.begin(), sorted.end());
+        std::cerr << c.name;
+        for (const auto& [key, value] : c.params)
+            std::cerr << " " << key << "=" << value;
+        std::cerr << ": "
+                  << (sorted.empty() ? 0 : sorted[sorted.size() / 2])
+                  << " ms" << std::endl;
+    }
+
+    Options options_;
+    std::vector<Case> cases_;
+};
+
+std::unique_ptr<Warper> make_warper(
+    const std::string& method,
+    const std::vector<Point2f>& source_points,
+    const std::vector<Point2f>& target_points,
+    int width,
+    int height)
+{
+    // Backward warping, as in the GUI: from the result to the source
+    if (method == "idw")
+        return std::make_unique<IDWWarper>(target_points, source_points);
+    if (method == "local_idw")
+        return std::make_unique<LocalIDWWarper>(target_points, source_points);
+    if (method == "rbf")
+        return std::make_unique<RBFWarper>(target_points, source_points);
+    if (method == "triangulation")
+        return std::make_unique<TriangulationWarper>(
+            target_points, source_points, width, height);
+    // Measure the training, not the cache
+    NNWarper::clear_cache();
+    return std::make_unique<NNWarper>(target_points, source_points);
+}
+
+// Times a per-pixel loop over width x height pixels, and attaches the heap
+// allocations it makes per pixel
+void measure_access(
+    Bench& bench,
+    const std::string& name,
+    const Params& params,
+    int width,
+    int height,
+    const std::function<void()>& body)
+{
+    std::uint64_t allocations = 0;
+    bench.measure(
+        name,
+        params,
+        width * 1e-6 * height,
+        [&]
+        {
+            const std::uint64_t start = allocation_count();
+            body();
+            allocations = allocation_count() - start;
+        });
+    bench.set_metric(
+        name,
+        params,
+        "allocations_per_pixel",
+        static_cast<double>(allocations) / (double(width) * height));
+}
+
+// The per-pixel loops of the warping and Poisson editing tools, written
+// with the copying get_pixel() / set_pixel() they used to call, with the
+// bounds-checked pixel() views and with row access
+void bench_access(Bench& bench)
+{
+    const Options& options = bench.options();
+    for (double mp : { 1.0, 4.0 })
+    {
+        if (mp > options.max_megapixels)
+            continue;
+        const auto [width, height] = image_size(mp);
+        Random random(options.seed);
+        Image image = make_image(width, height, random);
+        const Params params{ { "megapixels", mp } };
+
+        // Invert of the warping tool
+        measure_access(
+            bench,
+            "access/invert/get_pixel",
+            params,
+            width,
+            height,
+            [&]
+            {
+                for (int y = 0; y < height; ++y)
+                {
+                    for (int x = 0; x < width; ++x)
+                    {
+                        const auto p = image.get_pixel(x, y);
+                        image.set_pixel(
+                            x,
+                            y,
+                            { static_cast<uchar>(255 - p[0]),
+                              static_cast<uchar>(255 - p[1]),
+                              static_cast<uchar>(255 - p[2]) });
+                    }
+                }
+            });
+        measure_access(
+            bench,
+            "access/invert/pixel",
+            params,
+            width,
+            height,
+            [&]
+            {
+                for (int y = 0; y < height; ++y)
+                {
+                    for (int x = 0; x < width; ++x)
+                    {
+                        const auto p = image.pixel(x, y);
+                        for (int c = 0; c < 3; ++c)
+                            p[c] = static_cast<uchar>(255 - p[c]);
+                    }
+                }
+            });
+        measure_access(
+            bench,
+            "access/invert/row_as",
+            params,
+            width,
+            height,
+            [&]
+            {
+                for (int y = 0; y < height; ++y)
+                {
+                    for (RGBA8& p : image.row_as<RGBA8>(y))
+                    {
+                        p.r = static_cast<uchar>(255 - p.r);
+                        p.g = static_cast<uchar>(255 - p.g);
+                        p.b = static_cast<uchar>(255 - p.b);
+                    }
+                }
+            });
+
+        // Laplacian of the source, as in the right-hand side of the Poisson
+        // equations
+        const Image& source = image;
+        std::vector<float> laplacian(
+            static_cast<std::size_t>(width) * height * 3);
+        auto store = [&](int x, int y, int c, int value)
+        {
+            laplacian[(static_cast<std::size_t>(y) * width + x) * 3 + c] =
+                static_cast<float>(value);
+        };
+        measure_access(
+            bench,
+            "access/laplacian/get_pixel",
+            params,
+            width,
+            height,
+            [&]
+            {
+                for (int y = 1; y < height - 1; ++y)
+                {
+                    for (int x = 1; x < width - 1; ++x)
+                    {
+                        const auto p = source.get_pixel(x, y);
+                        const auto l = source.get_pixel(x - 1, y);
+                        const auto r = source.get_pixel(x + 1, y);
+                        const auto u = source.get_pixel(x, y - 1);
+                        const auto d = source.get_pixel(x, y + 1);
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            store(
+                                x,
+                                y,
+                                c,
+                                4 * p[c] - l[c] - r[c] - u[c] - d[c]);
+                        }
+                    }
+                }
+            });
+        measure_access(
+            bench,
+            "access/laplacian/pixel",
+            params,
+            width,
+            height,
+            [&]
+            {
+                for (int y = 1; y < height - 1; ++y)
+                {
+                    for (int x = 1; x < width - 1; ++x)
+                    {
+                        const auto p = source.pixel(x, y);
+                        const auto l = source.pixel(x - 1, y);
+                        const auto r = source.pixel(x + 1, y);
+                        const auto u = source.pixel(x, y - 1);
+                        const auto d = source.pixel(x, y + 1);
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            store(
+                                x,
+                                y,
+                                c,
+                                4 * p[c] - l[c] - r[c] - u[c] - d[c]);
+                        }
+                    }
+                }
+            });
+        measure_access(
+            bench,
+            "access/laplacian/row",
+            params,
+            width,
+            height,
+            [&]
+            {
+                const int channels = source.channels();
+                for (int y = 1; y < height - 1; ++y)
+                {
+                    const uchar* up = source.row(y - 1);
+                    const uchar* row = source.row(y);
+                    const uchar* down = source.row(y + 1);
+                    for (int x = 1; x < width - 1; ++x)
+                    {
+                        const int i = x * channels;
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            store(
+                                x,
+                                y,
+                                c,
+                                4 * row[i + c] - row[i - channels + c] -
+                                    row[i + channels + c] - up[i + c] -
+                                    down[i + c]);
+                        }
+                    }
+                }
+            });
+    }
+}
+
+void bench_ops(Bench& bench)
+{
+    const Options& options = bench.options();
+    for (double mp : { 0.25, 1.0, 4.0, 16.0, 50.0 })
+    {
+        if (mp > options.max_megapixels)
+            continue;
+        const auto [width, height] = image_size(mp);
+        Random random(options.seed);
+        Image image = make_image(width, height, random);
+        const Params params{ { "megapixels", mp } };
+        const double pixels = width * 1e-6 * height;
+        bench.measure("ops/invert", params, pixels, [&] { invert(image); });
+        bench.measure(
+            "ops/mirror_horizontal",
+            params,
+            pixels,
+            [&] { mirror(image, true, false); });
+        bench.measure(
+            "ops/mirror_vertical",
+            params,
+            pixels,
+            [&] { mirror(image, false, true); });
+        bench.measure(
+            "ops/mirror_both",
+            params,
+            pixels,
+            [&] { mirror(image, true, true); });
+        bench.measure(
+            "ops/gray_scale", params, pixels, [&] { gray_scale(image); });
+        bench.measure(
+            "ops/gray_luminance",
+            params,
+            pixels,
+            [&] { gray_scale(image, GrayMode::kLuminance); });
+        bench.measure(
+            "ops/swizzle",
+            params,
+            pixels,
+            [&] { swizzle_channels(image, { 2, 1, 0, 3 }); });
+        // The edits of the warping tool, one pass each or fused into one
+        bench.measure(
+            "ops/chain_eager",
+            params,
+            pixels,
+            [&]
+            {
+                gray_scale(image);
+                invert(image);
+                mirror(image, true, false);
+                swizzle_channels(image, { 2, 1, 0, 3 });
+            });
+        bench.measure(
+            "ops/chain_fused",
+            params,
+            pixels,
+            [&]
+            {
+                ImagePipeline pipeline(std::move(image));
+                pipeline.gray_scale().invert().mirror(true, false);
+                pipeline.swizzle_channels({ 2, 1, 0, 3 });
+                image = pipeline.evaluate();
+            });
+        Image rgb = rgba_to_rgb(image);
+        bench.measure(
+            "ops/rgba_to_rgb",
+            params,
+            pixels,
+            [&] { rgb = rgba_to_rgb(image); });
+        bench.measure(
+            "ops/rgb_to_rgba",
+            params,
+            pixels,
+            [&] { image = rgb_to_rgba(rgb); });
+        // Undo and redo of a 256x256 edit cost the same whatever the size of
+        // the image
+        UndoHistory history;
+        history.reset(image);
+        const int edit_width = std::min(width, 256);
+        const int edit_height = std::min(height, 256);
+        for (int y = 0; y < edit_height; ++y)
+            std::fill_n(image.row(y), edit_width * image.channels(), 0);
+        history.commit(image, { 0, 0, edit_width, edit_height });
+        bench.measure(
+            "ops/undo_redo_256",
+            params,
+            pixels,
+            [&]
+            {
+                history.undo(image);
+                history.redo(image);
+            });
+    }
+}
+
+void bench_io(Bench& bench)
+{
+    const Options& options = bench.options();
+    const std::pair<ImageFormat, const char*> formats[] = {
+        { ImageFormat::kPng, "png" },
+        { ImageFormat::kQoi, "qoi" },
+        { ImageFormat::kPam, "pam" },
+    };
+    for (double mp : { 1.0, 4.0, 16.0 })
+    {
+        if (mp > options.max_megapixels)
+            continue;
+        const auto [width, height] = image_size(mp);
+        Random random(options.seed);
+        const Image image = make_image(width, height, random);
+        const Params params{ { "megapixels", mp } };
+        const double pixels = width * 1e-6 * height;
+        for (const auto& [format, name] : formats)
+        {
+            std::vector<unsigned char> encoded;
+            bench.measure(
+                std::string("io/encode_") + name,
+                params,
+                pixels,
+                [&] { encoded = encode_image(image, format); });
+        }
+    }
+}
+
+void bench_warp_case(
+    Bench& bench,
+    const std::string& method,
+    int points,
+    double mp,
+    Interpolation interpolation)
+{
+    const std::string interp =
+        interpolation == Interpolation::kNearest ? "nearest" : "bilinear";
+    const std::string setup_name = "warp_setup/" + method;
+    const std::string warp_name = "warp/" + method + "/" + interp;
+    // The same warp in two steps: evaluating the warper into a WarpField,
+    // then resampling through the field
+    const std::string bake_name = "warp_bake/" + method;
+    const std::string apply_name = "warp_apply/" + method + "/" + interp;
+    // Approximate bake on a lattice, with its error against the exact field
+    const std::string coarse_name = "warp_bake_coarse/" + method;
+    // Triangulation only: the field rasterized triangle by triangle
+    const std::string raster_name = "warp_rasterize/" + method;
+    if (!bench.enabled(setup_name) && !bench.enabled(warp_name) &&
+        !bench.enabled(bake_name) && !bench.enabled(apply_name) &&
+        !bench.enabled(coarse_name) && !bench.enabled(raster_name))
+        return;
+
+    const auto [width, height] = image_size(mp);
+    Random random(bench.options().seed);
+    const Image source = make_image(width, height, random);
+    std::vector<Point2f> source_points, target_points;
+    make_points(points, width, height, random, source_points, target_points);
+
+    std::unique_ptr<Warper> warper;
+    bench.measure(
+        setup_name,
+        { { "points", points } },
+        0,
+        [&]
+        {
+            warper = make_warper(
+                method, source_points, target_points, width, height);
+        });
+    if (!warper)
+        warper = make_warper(
+            method, source_points, target_points, width, height);
+    bench.measure(
+        warp_name,
+        { { "points", points }, { "megapixels", mp } },
+        width * 1e-6 * height,
+        [&] { warp_image(*warper, source, interpolation); });
+    const Params params{ { "points", points }, { "megapixels", mp } };
+    const double pixels = width * 1e-6 * height;
+    WarpField field;
+    auto exact_field = [&]() -> const WarpField&
+    {
+        if (field.empty())
+            field = WarpField::bake(*warper, width, height);
+        return field;
+    };
+    // Baking does not depend on the interpolation
+    if (interpolation == Interpolation::kBilinear)
+    {
+        bench.measure(
+            bake_name,
+            params,
+            pixels,
+            [&] { field = WarpField::bake(*warper, width, height); });
+    }
+    if (method == "triangulation" &&
+        interpolation == Interpolation::kBilinear)
+    {
+        const auto& mesh = static_cast<const TriangulationWarper&>(*warper);
+        bench.measure(
+            raster_name,
+            params,
+            pixels,
+            [&] { field = mesh.bake(width, height); });
+    }
+    WarpField coarse;
+    CoarseBakeStats stats;
+    if (interpolation == Interpolation::kBilinear)
+    {
+        bench.measure(
+            coarse_name,
+            params,
+            pixels,
+            [&]
+            {
+                coarse = WarpField::bake_coarse(
+                    *warper, width, height, CoarseBakeOptions(), &stats);
+            });
+    }
+    if (!coarse.empty())
+    {
+        const WarpField& exact = exact_field();
+        float max_error = 0;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                max_error = std::max(
+                    max_error,
+                    std::hypot(
+                        coarse.xs(y)[x] - exact.xs(y)[x],
+                        coarse.ys(y)[x] - exact.ys(y)[x]));
+            }
+        }
+        bench.set_metric(coarse_name, params, "max_error", max_error);
+        bench.set_metric(
+            coarse_name, params, "estimated_error", stats.max_error);
+        bench.set_metric(
+            coarse_name,
+            params,
+            "evaluations_per_pixel",
+            stats.evaluations / (pixels * 1e6));
+    }
+    if (bench.enabled(apply_name))
+    {
+        exact_field();
+        bench.measure(
+            apply_name,
+            params,
+            pixels,
+            [&] { warp_image(field, source, interpolation); });
+    }
+}
+
+// RBFWarper::refit() after an edit of one control pair, against a new fit
+// (warp_setup/rbf): each run moves the pair and the next moves it back
+void bench_rbf_refit(Bench& bench)
+{
+    const std::string end_name = "warp_refit/rbf/end";
+    const std::string start_name = "warp_refit/rbf/start";
+    if (!bench.enabled(end_name) && !bench.enabled(start_name))
+        return;
+    const int max_points = bench.options().quick ? 1024 : 4096;
+    for (int points = 64; points <= max_points; points *= 4)
+    {
+        const auto [width, height] = image_size(1.0);
+        Random random(bench.options().seed);
+        std::vector<Point2f> source_points, target_points;
+        make_points(
+            points, width, height, random, source_points, target_points);
+        RBFWarper warper(target_points, source_points);
+        for (const std::string& name : { end_name, start_name })
+        {
+            // Moving a source point changes the right-hand side, a target
+            // point the system (backward warping)
+            auto& moved = name == end_name ? source_points : target_points;
+            float offset = 3.0f;
+            bench.measure(
+                name,
+                { { "points", points } },
+                0,
+                [&]
+                {
+                    moved[points / 2].x += offset;
+                    offset = -offset;
+                    warper.refit(target_points, source_points);
+                });
+        }
+    }
+}
+
+// Scaling about the center of a width x height image, as a forward map
+class ZoomWarper : public Warper
+{
+   public:
+    ZoomWarper(int width, int height, float scale)
+        : center_x_(width / 2.0f),
+          center_y_(height / 2.0f),
+          scale_(scale)
+    {
+    }
+
+    std::pair<float, float> warp(float x, float y) override
+    {
+        return { center_x_ + (x - center_x_) * scale_,
+                 center_y_ + (y - center_y_) * scale_ };
+    }
+
+   private:
+    float center_x_, center_y_, scale_;
+};
+
+// Forward warps: magnifying leaves gaps between the splats everywhere,
+// shrinking leaves a background around them
+void bench_forward_warp(Bench& bench)
+{
+    for (double mp : { 1.0, 4.0, 16.0 })
+    {
+        if (mp > bench.options().max_megapixels)
+            continue;
+        const auto [width, height] = image_size(mp);
+        Random random(bench.options().seed);
+        const Image image = make_image(width, height, random);
+        const double pixels = width * 1e-6 * height;
+        for (const auto& [name, scale] :
+             { std::pair<std::string, float>("magnify", 2.5f),
+               std::pair<std::string, float>("shrink", 0.5f) })
+        {
+            ZoomWarper zoom(width, height, scale);
+            bench.measure(
+                "warp_forward/" + name,
+                { { "megapixels", mp } },
+                pixels,
+                [&] { forward_warp(zoom, image); });
+        }
+    }
+}
+
+void bench_warp(Bench& bench)
+{
+    const Options& options = bench.options();
+    const int max_points = options.quick ? 256 : 4096;
+    // Dlib trains for up to NNWarper::kMaxSteps mini-batches of 32 points
+    const int max_nn_points = options.quick ? 16 : 64;
+    // Local IDW, RBF past RBFWarper::kDenseMaxPoints and the triangulation
+    // are meant for dense correspondences
+    const int max_local_points = options.quick ? 4096 : 16384;
+    for (const std::string method :
+         { "idw", "local_idw", "rbf", "nn", "triangulation" })
+    {
+        // Cost of the number of control points at a fixed size
+        const bool scalable = method == "local_idw" || method == "rbf" ||
+                              method == "triangulation";
+        const int method_max_points = method == "nn" ? max_nn_points
+                                      : scalable     ? max_local_points
+                                                     : max_points;
+        for (int points = 4; points <= method_max_points; points *= 4)
+        {
+            bench_warp_case(
+                bench, method, points, 1.0, Interpolation::kBilinear);
+        }
+        // Cost of the image size at a fixed number of points
+        for (double mp : { 0.25, 4.0, 16.0, 50.0 })
+        {
+            if (mp <= options.max_megapixels)
+                bench_warp_case(
+                    bench, method, 16, mp, Interpolation::kBilinear);
+        }
+        // Interpolation modes
+        bench_warp_case(bench, method, 16, 1.0, Interpolation::kNearest);
+    }
+    bench_rbf_refit(bench);
+    bench_forward_warp(bench);
+}
+
+template<typename Method>
+void bench_poisson_method(Bench& bench, const std::string& method)
+{
+    const Options& options = bench.options();
+    const std::string prefix = "poisson/" + method + "/";
+    if (!bench.enabled(prefix + "build") &&
+        !bench.enabled(prefix + "factorize") &&
+        !bench.enabled(prefix + "solve"))
+        return;
+
+    // A 4K target, cloned onto itself at offset zero so that every mask
+    // fits
+    const int width = 3840, height = 2160;
+    Random random(options.seed);
+    auto source = std::make_shared<Image>(make_image(width, height, random));
+    auto target = std::make_shared<Image>(make_image(width, height, random));
+    for (double percent : { 1.0, 5.0, 10.0, 25.0, 50.0 })
+    {
+        if (options.quick && percent > 10)
+            break;
+        auto mask =
+            std::make_shared<Image>(make_mask(width, height, percent / 100));
+        const double unknowns = count_masked(*mask) * 1e-6;
+        const Params params{ { "mask_percent", percent } };
+        bool more = true;
+        for (int run = 0; run < options.repeat && more; ++run)
+        {
+            PoissonStages<Method> stages(source, target, mask, 0, 0);
+            auto start = Clock::now();
+            stages.build();
+            more &= bench.record(
+                prefix + "build", params, unknowns, elapsed_ms(start));
+            start = Clock::now();
+            stages.factorize();
+            more &= bench.record(
+                prefix + "factorize", params, unknowns, elapsed_ms(start));
+            start = Clock::now();
+            stages.solve_channels();
+            more &= bench.record(
+                prefix + "solve", params, unknowns, elapsed_ms(start));
+        }
+        for (const char* stage : { "build", "factorize", "solve" })
+            bench.report(prefix + stage, params);
+    }
+}
+
+void bench_poisson(Bench& bench)
+{
+    bench_poisson_method<Seamless>(bench, "seamless");
+    bench_poisson_method<MixGradient>(bench, "mixgradient");
+}
+
+SimdLevel parse_simd_level(const std::string& name)
+{
+    for (SimdLevel level : { SimdLevel::kScalar,
+                             SimdLevel::kSse4,
+                             SimdLevel::kAvx2,
+                             SimdLevel::kNeon })
+    {
+        if (name == simd_level_name(level))
+            return level;
+    }
+    throw std::invalid_argument("Unknown SIMD level " + name);
+}
+
+Options parse_options(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string
+        {
+            if (i + 1 >= argc)
+                throw std::invalid_argument("Missing value for " + arg);
+            return argv[++i];
+        };
+        if (arg == "--filter")
+            options.filter = value();
+        else if (arg == "--output")
+            options.output = value();
+        else if (arg == "--repeat")
+            options.repeat = std::max(1, std::stoi(value()));
+        else if (arg == "--seed")
+            options.seed = static_cast<std::uint32_t>(std::stoul(value()));
+        else if (arg == "--max-mp")
+            options.max_megapixels = std::stod(value());
+        else if (arg == "--max-seconds")
+            options.max_seconds = std::stod(value());
+        else if (arg == "--threads")
+            options.threads = std::stoi(value());
+        else if (arg == "--deterministic")
+            options.deterministic = true;
+        else if (arg == "--simd")
+            options.simd = value();
+        else if (arg == "--quick")
+            options.quick = true;
+        else
+            throw std::invalid_argument("Unknown option " + arg);
+    }
+    if (options.quick)
+        options.max_megapixels = std::min(options.max_megapixels, 4.0);
+    return options;
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Bench bench(parse_options(argc, argv));
+        TaskScheduler& scheduler = TaskScheduler::instance();
+        if (bench.options().threads > 0)
+            scheduler.set_num_threads(bench.options().threads);
+        scheduler.set_deterministic(bench.options().deterministic);
+        if (!bench.options().simd.empty())
+            set_simd_level(parse_simd_level(bench.options().simd));
+        bench_access(bench);
+        bench_ops(bench);
+        bench_io(bench);
+        bench_warp(bench);
+        bench_poisson(bench);
+
+        if (bench.options().output.empty())
+        {
+            bench.write_json(std::cout);
+        }
+        else
+        {
+            std::ofstream file(bench.options().output);
+            if (!file)
+            {
+                throw std::runtime_error(
+                    "Failed to open " + bench.options().output);
+            }
+            bench.write_json(file);
+        }
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(
+            stderr,
+            "Error: %s\n"
+            "Usage: %s [--filter <substring>] [--repeat <n>] [--seed <n>] "
+            "[--max-mp <megapixels>] [--max-seconds <s>] [--quick] "
+            "[--threads <n>] [--deterministic] [--simd <level>] "
+            "[--output <file.json>]\n",
+            e.what(),
+            argv[0]);
+        return 1;
+    }
+}
@@ -0,0 +1,115 @@
+// Poisson image editing without any window.
+//
+//   poisson_cli <seamless|mixgradient> <source> <mask> <target>
+//               <offset x> <offset y> <output> [--tiled <MiB>]
+//
+// The mask has the size of the source; its non-zero pixels (first channel)
+// are the selected region. Source pixel (x, y) lands on (x + offset x,
+// y + offset y) in the target, as in the GUI.
+//
+// With --tiled, the target is held in a tiled image of at most `MiB`
+// mebibytes of mapped pixels, for targets larger than RAM, and only the
+// window of the selection is solved in memory (see clone_into_tiled()).
+// PAM files are streamed in and out; other formats go through memory once.
+// The output is the same as without --tiled.
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "CloneMethods/Mixgradient.h"
+#include "CloneMethods/Seamless.h"
+#include "common/image_io.h"
+#include "common/tiled_image.h"
+
+namespace
+{
+using namespace USTC_CG;
+using Clock = std::chrono::steady_clock;
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const bool tiled = argc == 10 && std::string(argv[8]) == "--tiled";
+    if (argc != 8 && !tiled)
+    {
+        fprintf(
+            stderr,
+            "Usage: %s <seamless|mixgradient> <source> <mask> <target> "
+            "<offset x> <offset y> <output> [--tiled <MiB>]\n",
+            argv[0]);
+        return 2;
+    }
+    try
+    {
+        const std::string method = argv[1];
+        // RGBA, as in the GUI
+        auto source = std::make_shared<Image>(load_image(argv[2], 4));
+        auto mask = std::make_shared<Image>(load_image(argv[3], 1));
+        const int offset_x = std::stoi(argv[5]);
+        const int offset_y = std::stoi(argv[6]);
+        if (mask->width() != source->width() ||
+            mask->height() != source->height())
+        {
+            throw std::invalid_argument("The mask must have the source size");
+        }
+        if (method != "seamless" && method != "mixgradient")
+            throw std::invalid_argument("Unknown clone method " + method);
+
+        if (tiled)
+        {
+            int width = 0, height = 0, channels = 0;
+            if (!read_image_info(argv[4], width, height, channels))
+            {
+                throw std::runtime_error(
+                    std::string("Failed to read image file ") + argv[4]);
+            }
+            TiledImage target(width, height, 4, std::stoull(argv[9]) << 20);
+            load_image(argv[4], target);
+            const auto start = Clock::now();
+            if (method == "seamless")
+                clone_into_tiled<Seamless>(
+                    source, target, mask, offset_x, offset_y);
+            else
+                clone_into_tiled<MixGradient>(
+                    source, target, mask, offset_x, offset_y);
+            const double solve_ms =
+                std::chrono::duration<double, std::milli>(Clock::now() - start)
+                    .count();
+            save_image(argv[7], target);
+            std::cout << method << ": " << mask_bounds(*mask).width() << "x"
+                      << mask_bounds(*mask).height() << " selection, solve "
+                      << solve_ms << " ms, peak resident "
+                      << (target.stats().peak_resident_bytes >> 20)
+                      << " MiB of the target" << std::endl;
+            return 0;
+        }
+
+        auto target = std::make_shared<Image>(load_image(argv[4], 4));
+        const auto start = Clock::now();
+        std::unique_ptr<CloneMethod> clone;
+        if (method == "seamless")
+            clone = std::make_unique<Seamless>(
+                source, target, mask, offset_x, offset_y);
+        else
+            clone = std::make_unique<MixGradient>(
+                source, target, mask, offset_x, offset_y);
+        const std::shared_ptr<Image> result = clone->solve();
+        const double solve_ms =
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+                .count();
+
+        save_image(argv[7], *result);
+        std::cout << method << ": " << mask_bounds(*mask).width() << "x"
+                  << mask_bounds(*mask).height() << " selection, solve "
+                  << solve_ms << " ms" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+}
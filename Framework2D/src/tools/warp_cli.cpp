@@ -0,0 +1,211 @@
+// Warps an image with control points, without any window.
+//
+//   warp_cli <idw|local_idw|rbf|nn|triangulation> <input image>
+//            <points file> <output image> [--coarse <step> | --tiled <MiB>]
+//
+// Every non-empty line of the points file holds one control pair
+// "sx sy tx ty": the pixel at (sx, sy) of the input moves to (tx, ty) in the
+// output. Lines starting with '#' are ignored. local_idw only blends the
+// nearest control points of each pixel, for files of thousands of pairs
+// (see LocalIDWWarper). triangulation maps the triangles of the control
+// points affinely, and is rasterized in one pass over the pixels (see
+// TriangulationWarper).
+//
+// With --coarse, the warp is only evaluated on a lattice every `step`
+// pixels and refined where needed (see WarpField::bake_coarse()).
+//
+// With --tiled, the input and the output are held in tiled images of at most
+// `MiB` mebibytes of mapped pixels each, for images larger than RAM (see
+// TiledImage). PAM files are streamed in and out; other formats go through
+// memory once. The output is the same as without --tiled; triangulation
+// evaluates its warper per pixel instead of rasterizing the mesh.
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common/image_io.h"
+#include "common/tiled_image.h"
+#include "warper/IDW_warper.h"
+#include "warper/NN_warper.h"
+#include "warper/local_IDW_warper.h"
+#include "warper/RBF_warper.h"
+#include "warper/triangulation_warper.h"
+#include "warper/warp_image.h"
+
+namespace
+{
+using namespace USTC_CG;
+using Clock = std::chrono::steady_clock;
+
+void read_points(
+    const std::string& filename,
+    std::vector<Point2f>& source_points,
+    std::vector<Point2f>& target_points)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open points file " + filename);
+    }
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line))
+    {
+        ++line_number;
+        std::istringstream stream(line);
+        std::string first;
+        if (!(stream >> first) || first[0] == '#')
+            continue;
+        Point2f s, t;
+        stream.clear();
+        stream.str(line);
+        if (!(stream >> s.x >> s.y >> t.x >> t.y))
+        {
+            throw std::runtime_error(
+                filename + ":" + std::to_string(line_number) +
+                ": expected \"sx sy tx ty\"");
+        }
+        source_points.push_back(s);
+        target_points.push_back(t);
+    }
+}
+
+double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const bool coarse = argc == 7 && std::string(argv[5]) == "--coarse";
+    const bool tiled = argc == 7 && std::string(argv[5]) == "--tiled";
+    if (argc != 5 && !coarse && !tiled)
+    {
+        fprintf(
+            stderr,
+            "Usage: %s <idw|local_idw|rbf|nn|triangulation> <input image> "
+            "<points file> <output image> [--coarse <step> | --tiled <MiB>]\n",
+            argv[0]);
+        return 2;
+    }
+    try
+    {
+        const std::string method = argv[1];
+        Image source;
+        std::unique_ptr<TiledImage> tiled_source;
+        std::size_t budget = 0;
+        int width = 0, height = 0, channels = 0;
+        if (tiled)
+        {
+            if (!read_image_info(argv[2], width, height, channels))
+            {
+                throw std::runtime_error(
+                    std::string("Failed to read image file ") + argv[2]);
+            }
+            budget = std::stoull(argv[6]) << 20;
+            tiled_source =
+                std::make_unique<TiledImage>(width, height, channels, budget);
+            load_image(argv[2], *tiled_source);
+        }
+        else
+        {
+            source = load_image(argv[2]);
+            width = source.width();
+            height = source.height();
+        }
+        std::vector<Point2f> source_points, target_points;
+        read_points(argv[3], source_points, target_points);
+
+        // Backward warping: the map goes from the output to the input
+        auto start = Clock::now();
+        std::unique_ptr<Warper> warper;
+        TriangulationWarper* mesh = nullptr;
+        if (method == "idw")
+            warper = std::make_unique<IDWWarper>(target_points, source_points);
+        else if (method == "local_idw")
+            warper = std::make_unique<LocalIDWWarper>(
+                target_points, source_points);
+        else if (method == "rbf")
+            warper = std::make_unique<RBFWarper>(target_points, source_points);
+        else if (method == "nn")
+            warper = std::make_unique<NNWarper>(target_points, source_points);
+        else if (method == "triangulation")
+        {
+            auto triangulation = std::make_unique<TriangulationWarper>(
+                target_points, source_points, width, height);
+            mesh = triangulation.get();
+            warper = std::move(triangulation);
+        }
+        else
+            throw std::invalid_argument("Unknown warping method " + method);
+        const double setup_ms = elapsed_ms(start);
+
+        start = Clock::now();
+        Image result;
+        std::unique_ptr<TiledImage> tiled_result;
+        CoarseBakeStats stats;
+        if (tiled)
+        {
+            tiled_result =
+                std::make_unique<TiledImage>(width, height, channels, budget);
+            warp_image(*warper, *tiled_source, *tiled_result);
+        }
+        else if (coarse)
+        {
+            CoarseBakeOptions options;
+            options.step = std::stoi(argv[6]);
+            const WarpField field = WarpField::bake_coarse(
+                *warper, width, height, options, &stats);
+            result = warp_image(field, source);
+        }
+        else if (mesh)
+        {
+            result = warp_image(mesh->bake(width, height), source);
+        }
+        else
+        {
+            result = warp_image(*warper, source);
+        }
+        const double warp_ms = elapsed_ms(start);
+
+        if (tiled)
+            save_image(argv[4], *tiled_result);
+        else
+            save_image(argv[4], result);
+        std::cout << method << ": " << width << "x" << height << ", "
+                  << source_points.size()
+                  << " points, setup " << setup_ms << " ms, warp " << warp_ms
+                  << " ms" << std::endl;
+        if (coarse)
+        {
+            std::cout << "coarse: " << stats.evaluations
+                      << " evaluations, max error " << stats.max_error
+                      << " px at the probes" << std::endl;
+        }
+        if (tiled)
+        {
+            std::cout << "tiled: peak resident "
+                      << (tiled_source->stats().peak_resident_bytes >> 20)
+                      << " + "
+                      << (tiled_result->stats().peak_resident_bytes >> 20)
+                      << " MiB, "
+                      << tiled_source->stats().tile_loads +
+                             tiled_result->stats().tile_loads
+                      << " tile loads" << std::endl;
+        }
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+}